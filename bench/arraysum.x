@@ -0,0 +1,35 @@
+fn sum(values: int[]): int{
+    let total: int = 0;
+    for (let i: int = 0; i < len(values); i = i + 1){
+        total = total + values[i];
+    }
+    return total;
+}
+
+fn gather(values: int[], order: int[]): int{
+    let total: int = 0;
+    for (let i: int = 0; i < len(order); i = i + 1){
+        total = total + values[order[i]];
+    }
+    return total;
+}
+
+fn main(): int{
+    let n: int = 100000;
+    let values: int[];
+    let order: int[];
+    for (let i: int = 0; i < n; i = i + 1){
+        push(values, i - i / 1000 * 1000);
+        let k: int = i * 7919;
+        push(order, (k - k / n * n) / 2);
+    }
+    let direct: int = 0;
+    let gathered: int = 0;
+    for (let round: int = 0; round < 200; round = round + 1){
+        values[round] = round * 3;
+        direct = sum(values);
+        gathered = gather(values, order);
+    }
+    println("sum {} gathered {}", direct, gathered);
+    return 0;
+}
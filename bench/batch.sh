@@ -0,0 +1,49 @@
+#!/bin/sh
+# Compares compiling many small files one process per file against a single
+# batch-mode process, in files per second.
+# usage: bench/batch.sh [files] [compiler flags...]
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+compiler=$root/bin/LanguageC
+files=${1:-500}
+[ $# -gt 0 ] && shift
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work"
+mkdir src single batch
+
+awk -v n="$files" 'BEGIN {
+    for (f = 0; f < n; f++) {
+        file = sprintf("src/m%d.x", f)
+        for (i = 0; i < 4; i++) {
+            printf "fn g%d(a: int, b: int): int {\n", i > file
+            printf "    let x: int = a * %d + b;\n", f % 5 + i > file
+            printf "    while (x > 100) {\n        x = x - b;\n    }\n" > file
+            printf "    return x;\n}\n" > file
+        }
+        printf "fn main(): int {\n" > file
+        printf "    println(\"{}\", g3(g2(1, 2), g1(3, 4)) + g0(5, 6));\n" > file
+        printf "    return 0;\n}\n" > file
+        close(file)
+    }
+}'
+
+now() { date +%s.%N; }
+rate() { awk -v start="$1" -v end="$(now)" -v n="$files" \
+    'BEGIN { printf "%.3f s, %.0f files/s", end - start, n / (end - start) }'; }
+
+start=$(now)
+for program in src/*.x; do
+    "$compiler" "$@" -o "single/$(basename "$program" .x).c" "$program" \
+        > /dev/null
+done
+printf "%-22s %s\n" "one process per file:" "$(rate "$start")"
+
+start=$(now)
+"$compiler" "$@" -j "$(nproc)" -o batch src/*.x
+printf "%-22s %s\n" "batch (-j $(nproc)):" "$(rate "$start")"
+
+for output in single/*.c; do
+    cmp -s "$output" "batch/$(basename "$output")" ||
+        { echo "$output differs" >&2; exit 1; }
+done
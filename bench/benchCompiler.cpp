@@ -0,0 +1,212 @@
+// End-to-end compiler benchmark: compiles each program several times, to C
+// and to x86-64 (assembly and machine code), and reports the best time of
+// every phase with its throughput in source bytes, tokens and AST nodes per
+// second, and the peak resident set size. Meant for corpora from
+// generate_corpus; see bench/compiler.sh.
+//
+// usage: bench_compiler [-O0] [--repeat=N] [--output=FILE] file.x...
+//
+// With --output, one JSON object per program is appended to FILE:
+//     {"file": ..., "bytes": ..., "tokens": ..., "nodes": ...,
+//      "repeat": ..., "peakResidentBytes": ...,
+//      "phases": [{"phase": ..., "seconds": ..., "bytesPerSecond": ...,
+//                  "tokensPerSecond": ..., "nodesPerSecond": ...}, ...]}
+// Phases nest as in --time-report: "front end" includes "parse", which
+// includes "parse function". The peak resident set size is the process's,
+// so run one program per process for a figure that belongs to it alone.
+
+#include "XIR.hpp"
+#include "emitter.hpp"
+#include "lir.hpp"
+#include "thelang.hpp"
+#include "timing.hpp"
+#include "x86.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Measure {
+    std::string phase;
+    // The best over the repetitions, in nanoseconds.
+    long long time = 0;
+};
+
+// Keeps the fastest time of each phase of `timeline`, in order of first use.
+void keepBest(const Timeline &timeline, std::vector<Measure> &best) {
+    for (const auto &total : timeline.totals()) {
+        auto it = std::find_if(best.begin(), best.end(),
+                               [&](const Measure &measure) {
+                                   return measure.phase == total.phase;
+                               });
+        if (it == best.end()) {
+            best.push_back({total.phase, total.time});
+        } else {
+            it->time = std::min(it->time, total.time);
+        }
+    }
+}
+
+// Runs the front end on a context of its own, so each back end starts from
+// the tree analyze() leaves. Throws std::runtime_error on errors.
+ASTGen &analyze(CompilationContext &context, const CompileOptions &options) {
+    TimeScope scope(options.timeline, "front end");
+    ASTGen &ast = context.analyze(options);
+    if (context.diagnostics.errorCount() > 0) {
+        context.flushDiagnostics();
+        throw std::runtime_error("the program has errors");
+    }
+    return ast;
+}
+
+double perSecond(double count, long long nanoseconds) {
+    return nanoseconds > 0 ? count * 1e9 / nanoseconds : 0;
+}
+
+// Four significant digits, as JSON.
+std::string number(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof buffer, "%.4g", value);
+    return buffer;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    int repeat = 5;
+    bool optimize = true;
+    std::string outputPath;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-O0") {
+            optimize = false;
+        } else if (arg == "-O1") {
+            optimize = true;
+        } else if (arg.rfind("--repeat=", 0) == 0) {
+            repeat = std::atoi(arg.c_str() + 9);
+        } else if (arg.rfind("--output=", 0) == 0) {
+            outputPath = arg.substr(9);
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty() || repeat < 1) {
+        std::cerr << "usage: " << argv[0]
+                  << " [-O0] [--repeat=N] [--output=FILE] file.x..."
+                  << std::endl;
+        return 1;
+    }
+
+    std::string json;
+    Emitter record(json);
+    for (const auto &file : files) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) {
+            std::cerr << "cannot read " << file << std::endl;
+            return 1;
+        }
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        std::string source = buffer.str();
+
+        size_t tokens = 0;
+        size_t nodes = 0;
+        std::vector<Measure> best;
+        try {
+            for (int i = 0; i < repeat; ++i) {
+                CompileOptions options;
+                options.optimize = optimize;
+
+                Timeline c;
+                c.sampleMemory = true;
+                options.timeline = &c;
+                {
+                    CompilationContext context(file, source, std::cerr);
+                    ASTGen &ast = analyze(context, options);
+                    tokens = context.lexer.tokens.size();
+                    nodes = ast.arena.size();
+                    TimeScope scope(&c, "C back end");
+                    std::string output;
+                    Emitter out(output);
+                    IR ir(ast, &context.parser, out);
+                    ir.timeline = &c;
+                    ir.GenIR();
+                }
+                keepBest(c, best);
+
+                Timeline x86;
+                x86.sampleMemory = true;
+                options.timeline = &x86;
+                {
+                    CompilationContext context(file, source, std::cerr);
+                    ASTGen &ast = analyze(context, options);
+                    TimeScope scope(&x86, "x86-64 back end");
+                    LModule module;
+                    {
+                        TimeScope lower(&x86, "lower");
+                        module = Lowering(ast).run();
+                    }
+                    x86::MModule machine;
+                    {
+                        TimeScope select(&x86, "select instructions");
+                        machine = x86::selectInstructions(module);
+                    }
+                    {
+                        TimeScope write(&x86, "write assembly");
+                        x86::writeAssembly(machine);
+                    }
+                    TimeScope encode(&x86, "encode");
+                    x86::encode(machine);
+                }
+                keepBest(x86, best);
+            }
+        } catch (const std::runtime_error &error) {
+            std::cerr << file << ": " << error.what() << std::endl;
+            return 1;
+        }
+
+        size_t peak = peakResidentBytes();
+        std::printf("%s: %zu bytes, %zu tokens, %zu nodes, best of %d, "
+                    "%.1f MiB peak RSS\n",
+                    file.c_str(), source.size(), tokens, nodes, repeat,
+                    peak / (1024.0 * 1024.0));
+        std::printf("  %-26s %10s %10s %12s %12s\n", "phase", "ms", "MB/s",
+                    "tokens/s", "nodes/s");
+        record.write("{\"file\":", jsonString(file),
+                     ",\"bytes\":", source.size(), ",\"tokens\":", tokens,
+                     ",\"nodes\":", nodes, ",\"repeat\":", repeat,
+                     ",\"peakResidentBytes\":", peak, ",\"phases\":[");
+        for (size_t i = 0; i < best.size(); ++i) {
+            const Measure &measure = best[i];
+            double bytesPerSecond = perSecond(source.size(), measure.time);
+            double tokensPerSecond = perSecond(tokens, measure.time);
+            double nodesPerSecond = perSecond(nodes, measure.time);
+            std::printf("  %-26s %10.3f %10.1f %12.4g %12.4g\n",
+                        measure.phase.c_str(), measure.time / 1e6,
+                        bytesPerSecond / 1e6, tokensPerSecond, nodesPerSecond);
+            record.write(i ? "," : "", "{\"phase\":", jsonString(measure.phase),
+                         ",\"seconds\":", number(measure.time / 1e9),
+                         ",\"bytesPerSecond\":", number(bytesPerSecond),
+                         ",\"tokensPerSecond\":", number(tokensPerSecond),
+                         ",\"nodesPerSecond\":", number(nodesPerSecond), '}');
+        }
+        record.write("]}\n");
+    }
+
+    if (!outputPath.empty()) {
+        std::ofstream out(outputPath, std::ios::app);
+        if (!(out << json)) {
+            std::cerr << "cannot write " << outputPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
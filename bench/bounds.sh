@@ -0,0 +1,19 @@
+#!/bin/sh
+# Shows what array bounds checks cost: runs the runtime suite on the
+# programs that index arrays at -O0 (every access checked), at -O1 (checks
+# that range analysis proves redundant removed) and at -O1 with
+# --no-bounds-checks (none left). The rows of the last two tables differ
+# by the checks -O1 cannot remove, such as arraysum's gather through an
+# index array.
+# usage: bench/bounds.sh [compiler flags...]
+#   REPEAT=3 TARGETS=x86-64 bench/bounds.sh
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+export BENCHMARKS=${BENCHMARKS:-arraysum histogram matrix sieve}
+
+for flags in "-O0" "-O1" "-O1 --no-bounds-checks"; do
+    echo "== $flags${*:+ $*}"
+    # $flags is split into separate options on purpose.
+    "$root/bench/runtime.sh" $flags "$@"
+    echo
+done
@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+static int sum(const int *values, int count) {
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+        total += values[i];
+    }
+    return total;
+}
+
+static int gather(const int *values, const int *order, int count) {
+    int total = 0;
+    for (int i = 0; i < count; i++) {
+        total += values[order[i]];
+    }
+    return total;
+}
+
+int main(void) {
+    int n = 100000;
+    int *values = malloc(n * sizeof(int));
+    int *order = malloc(n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        values[i] = i % 1000;
+        order[i] = i * 7919 % n / 2;
+    }
+    int direct = 0;
+    int gathered = 0;
+    for (int round = 0; round < 200; round++) {
+        values[round] = round * 3;
+        direct = sum(values, n);
+        gathered = gather(values, order, n);
+    }
+    printf("sum %d gathered %d\n", direct, gathered);
+    free(values);
+    free(order);
+    return 0;
+}
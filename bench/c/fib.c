@@ -0,0 +1,13 @@
+#include <stdio.h>
+
+static int fib(int n) {
+    if (n < 2) {
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
+
+int main(void) {
+    printf("fib(30) is %d\n", fib(30));
+    return 0;
+}
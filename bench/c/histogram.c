@@ -0,0 +1,24 @@
+#include <stdint.h>
+#include <stdio.h>
+
+int main(void) {
+    int buckets[16] = {0};
+    uint32_t seed = 12345;
+    for (int i = 0; i < 2000000; i++) {
+        seed = seed * 1103515245u + 12345u;
+        int r = (int32_t)seed / 65536;
+        int b = r % 16;
+        if (b < 0) {
+            b += 16;
+        }
+        buckets[b]++;
+    }
+    int largest = 0;
+    for (int b = 0; b < 16; b++) {
+        if (buckets[b] > largest) {
+            largest = buckets[b];
+        }
+    }
+    printf("largest bucket %d\n", largest);
+    return 0;
+}
@@ -0,0 +1,13 @@
+#include <stdio.h>
+
+int main(void) {
+    int total = 0;
+    for (int i = 0; i < 3000; i++) {
+        for (int j = 0; j < 1000; j++) {
+            total = (int)((unsigned)total + (unsigned)(i * j) -
+                          (unsigned)(total / 7));
+        }
+    }
+    printf("total is %d\n", total);
+    return 0;
+}
@@ -0,0 +1,37 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+static int multiply(int n, int rounds) {
+    int *a = malloc(sizeof(int) * n * n);
+    int *b = malloc(sizeof(int) * n * n);
+    int *c = malloc(sizeof(int) * n * n);
+    for (int i = 0; i < n * n; i++) {
+        a[i] = i % 7;
+        b[i] = i % 5 - 2;
+    }
+    int trace = 0;
+    for (int round = 0; round < rounds; round++) {
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                int sum = 0;
+                for (int k = 0; k < n; k++) {
+                    sum += a[i * n + k] * b[k * n + j];
+                }
+                c[i * n + j] = sum;
+            }
+        }
+        for (int i = 0; i < n; i++) {
+            trace += c[i * n + i];
+        }
+        a[round]++;
+    }
+    free(a);
+    free(b);
+    free(c);
+    return trace;
+}
+
+int main(void) {
+    printf("trace %d\n", multiply(200, 10));
+    return 0;
+}
@@ -0,0 +1,8 @@
+#include <stdio.h>
+
+int main(void) {
+    for (int i = 0; i < 1000000; i++) {
+        printf("line %d of %d: times seven %d\n", i, 1000000, i * 7);
+    }
+    return 0;
+}
@@ -0,0 +1,26 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+static int sieve(int limit) {
+    char *composite = calloc(limit, 1);
+    int primes = 0;
+    for (int p = 2; p < limit; p++) {
+        if (!composite[p]) {
+            primes++;
+            for (int m = p + p; m < limit; m += p) {
+                composite[m] = 1;
+            }
+        }
+    }
+    free(composite);
+    return primes;
+}
+
+int main(void) {
+    int found = 0;
+    for (int round = 0; round < 20; round++) {
+        found = sieve(200000);
+    }
+    printf("primes below 200000: %d\n", found);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#!/bin/sh
+# Generates synthetic corpora of several sizes and shapes and measures every
+# compiler phase on each, one process per corpus so the peak memory is its
+# own. Prints a table per corpus and appends one JSON object per corpus to
+# the results file (see bench/benchCompiler.cpp for the fields).
+# Needs: cmake --build <build> --target generate_corpus bench_compiler
+# usage: bench/compiler.sh [results.jsonl] [bench_compiler flags...]
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+results=$(realpath -m "${1:-compiler.jsonl}")
+[ $# -gt 0 ] && shift
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+: > "$results"
+
+corpus() {
+    name=$1
+    shift
+    "$root/bin/generate_corpus" "$@" -o "$work/$name.x"
+}
+
+corpus small --functions=100
+corpus medium --functions=1000
+corpus large --functions=10000
+corpus deep --functions=1000 --depth=6 --statements=4
+corpus expressions --functions=1000 --expression=16
+corpus prints --functions=1000 --prints=60
+corpus identifiers --functions=1000 --identifiers=48
+
+for program in small medium large deep expressions prints identifiers; do
+    (cd "$work" && "$root/bin/bench_compiler" --output="$results" "$@" \
+        "$program.x")
+done
+echo "results in $results"
@@ -0,0 +1,11 @@
+fn fib(n: int): int{
+    if (n < 2){
+        return n;
+    }
+    return fib(n - 1) + fib(n - 2);
+}
+
+fn main(): int{
+    println("fib(30) is {}", fib(30));
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Benchmarks the runtime's number formatting against printf, and checks
+// float formatting exhaustively.
+//
+// usage: format_bench             time xrt_format_int/float against snprintf
+//        format_bench --exhaustive  check every float reads back unchanged
+//                                   from its text and, for a sample, that
+//                                   one digit fewer would not
+
+#include "xrt.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define THREADS 8
+
+static double seconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static uint32_t next_random(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void benchmark(void) {
+    enum { COUNT = 10000000 };
+    char text[64];
+    size_t sink = 0;
+    uint32_t state = 2463534242u;
+
+    double start = seconds();
+    for (int i = 0; i < COUNT; i++) {
+        sink += xrt_format_int(text, (int32_t)next_random(&state));
+    }
+    double ours = seconds() - start;
+    start = seconds();
+    for (int i = 0; i < COUNT; i++) {
+        sink += (size_t)snprintf(text, sizeof(text), "%d",
+                                 (int32_t)next_random(&state));
+    }
+    double theirs = seconds() - start;
+    printf("int    xrt %6.1f ns  snprintf %%d    %6.1f ns\n",
+           ours * 1e9 / COUNT, theirs * 1e9 / COUNT);
+
+    // Random finite floats over the whole exponent range.
+    float *values = malloc(COUNT * sizeof(float));
+    for (int i = 0; i < COUNT; i++) {
+        uint32_t bits = next_random(&state) & 0xFF7FFFFFu;
+        memcpy(&values[i], &bits, sizeof(bits));
+    }
+    start = seconds();
+    for (int i = 0; i < COUNT; i++) {
+        sink += xrt_format_float(text, values[i]);
+    }
+    ours = seconds() - start;
+    start = seconds();
+    for (int i = 0; i < COUNT; i++) {
+        sink += (size_t)snprintf(text, sizeof(text), "%.9g", values[i]);
+    }
+    theirs = seconds() - start;
+    start = seconds();
+    for (int i = 0; i < COUNT; i++) {
+        sink += (size_t)snprintf(text, sizeof(text), "%f", values[i]);
+    }
+    double fixed = seconds() - start;
+    printf("float  xrt %6.1f ns  snprintf %%.9g %6.1f ns  %%f %6.1f ns\n",
+           ours * 1e9 / COUNT, theirs * 1e9 / COUNT, fixed * 1e9 / COUNT);
+    free(values);
+    if (sink == 0) {
+        puts("");
+    }
+}
+
+struct range {
+    uint64_t begin, end;
+    uint64_t failures;
+};
+
+// Digits from the first nonzero one to the last nonzero one.
+static int significant_digits(const char *text) {
+    int first = -1;
+    int last = -1;
+    int position = 0;
+    for (const char *p = text; *p && *p != 'e'; p++) {
+        if (*p < '0' || *p > '9') {
+            continue;
+        }
+        if (*p != '0') {
+            if (first < 0) {
+                first = position;
+            }
+            last = position;
+        }
+        position++;
+    }
+    return first < 0 ? 0 : last - first + 1;
+}
+
+static void *check_range(void *argument) {
+    struct range *range = argument;
+    char text[XRT_FLOAT_CHARS + 1];
+    char shorter[64];
+    for (uint64_t bits = range->begin; bits < range->end; bits++) {
+        uint32_t pattern = (uint32_t)bits;
+        float value;
+        memcpy(&value, &pattern, sizeof(value));
+        if (value != value) {
+            continue;
+        }
+        text[xrt_format_float(text, value)] = '\0';
+        float back = strtof(text, NULL);
+        int digits = significant_digits(text);
+        int fails = memcmp(&back, &value, sizeof(value)) != 0;
+        // printf is slow, so shortness is only checked for a sample.
+        if (!fails && bits % 61 == 0 && digits > 1 &&
+            (pattern & 0x7F800000u) != 0x7F800000u) {
+            snprintf(shorter, sizeof(shorter), "%.*e", digits - 2, value);
+            fails = strtof(shorter, NULL) == value;
+        }
+        if (fails && range->failures++ < 10) {
+            fprintf(stderr, "%08x: %s (%.9g)\n", pattern, text, value);
+        }
+    }
+    return NULL;
+}
+
+static int exhaustive(void) {
+    pthread_t threads[THREADS];
+    struct range ranges[THREADS];
+    uint64_t total = 1ull << 32;
+    double start = seconds();
+    for (int t = 0; t < THREADS; t++) {
+        ranges[t].begin = total / THREADS * t;
+        ranges[t].end = total / THREADS * (t + 1);
+        ranges[t].failures = 0;
+        pthread_create(&threads[t], NULL, check_range, &ranges[t]);
+    }
+    uint64_t failures = 0;
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        failures += ranges[t].failures;
+    }
+    printf("checked all floats in %.0f s: %llu failures\n", seconds() - start,
+           (unsigned long long)failures);
+    return failures != 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--exhaustive") == 0) {
+        return exhaustive();
+    }
+    benchmark();
+    return 0;
+}
@@ -0,0 +1,346 @@
+// Writes a synthetic program of a given size and shape, for measuring the
+// compiler on inputs larger than the tests. The same options and seed always
+// give the same program.
+//
+// usage: generate_corpus [--functions=N] [--statements=N] [--depth=N]
+//                        [--expression=N] [--prints=PERCENT]
+//                        [--identifiers=LENGTH] [--seed=N] [-o file.x]
+//
+//   --functions    functions besides main (100)
+//   --statements   statements per block (8)
+//   --depth        how deeply ifs and loops nest (2)
+//   --expression   operands per expression, at most (4)
+//   --prints       percentage of statements that are println (10)
+//   --identifiers  length of the names of functions and variables (8)
+//
+// Every program compiles without errors. Every fourth function is a leaf,
+// which calls nothing; the others call leaves defined before them, outside
+// loops, and all loops are counted, so programs also run quickly, though
+// their arithmetic is not kept from overflowing.
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Shape {
+    int functions = 100;
+    int statements = 8;
+    int depth = 2;
+    int expression = 4;
+    int prints = 10;
+    int identifiers = 8;
+};
+
+struct Function {
+    std::string name;
+    int parameters;
+};
+
+class Generator {
+public:
+    Generator(const Shape &shape, unsigned long long seed)
+        : shape(shape), random(seed) {}
+
+    std::string program() {
+        for (int i = 0; i < shape.functions; ++i) {
+            function(i);
+        }
+        out += "fn main(): int {\n";
+        calls = true;
+        locals = 0;
+        scopes.assign(1, {});
+        std::string total = local();
+        out += "    let " + total + ": int = 0;\n";
+        // Call a spread of functions so all of them are reachable.
+        int calls = std::min(shape.functions, 16);
+        for (int i = 0; i < calls; ++i) {
+            const Function &callee =
+                functions[functions.size() - 1 - i * functions.size() / calls];
+            out += "    " + total + " = " + total + " + " + call(callee, 1) +
+                   ";\n";
+        }
+        out += "    println(\"total {}\", " + total + ");\n";
+        out += "    return 0;\n}\n";
+        return std::move(out);
+    }
+
+private:
+    int below(int n) {
+        if (n <= 0) {
+            return 0;
+        }
+        return std::uniform_int_distribution<int>(0, n - 1)(random);
+    }
+
+    bool percent(int chance) { return below(100) < chance; }
+
+    // `prefix` and a number, padded with zeros to the identifier length.
+    std::string name(char prefix, int number) {
+        std::string digits = std::to_string(number);
+        int padding = shape.identifiers - 1 - static_cast<int>(digits.size());
+        return prefix + std::string(std::max(padding, 0), '0') + digits;
+    }
+
+    std::string local() {
+        std::string variable = name('v', locals++);
+        scopes.back().push_back(variable);
+        return variable;
+    }
+
+    // A variable visible here, or a literal if there is none.
+    std::string variable() {
+        size_t count = 0;
+        for (const auto &scope : scopes) {
+            count += scope.size();
+        }
+        if (count == 0) {
+            return std::to_string(below(100));
+        }
+        size_t pick = below(static_cast<int>(count));
+        for (const auto &scope : scopes) {
+            if (pick < scope.size()) {
+                return scope[pick];
+            }
+            pick -= scope.size();
+        }
+        return scopes.front().front();
+    }
+
+    std::string call(const Function &callee, int operands) {
+        std::string text = callee.name + "(";
+        for (int i = 0; i < callee.parameters; ++i) {
+            text += (i ? ", " : "") + expression(operands);
+        }
+        return text + ")";
+    }
+
+    std::string operand(int budget) {
+        int choice = below(10);
+        if (choice < 4) {
+            return variable();
+        }
+        if (choice < 7) {
+            return std::to_string(below(1000));
+        }
+        if (choice < 9 && budget > 1) {
+            return "(" + expression(budget / 2) + ")";
+        }
+        if (calls && loops == 0 && !leaves.empty() && budget > 1) {
+            // Mostly recent functions, as in real code.
+            int recent = std::min<int>(leaves.size(), 8);
+            return call(leaves[leaves.size() - 1 - below(recent)], budget / 2);
+        }
+        return variable();
+    }
+
+    std::string expression(int budget) {
+        int operands = 1 + below(std::max(budget, 1));
+        std::string text = operand(budget);
+        for (int i = 1; i < operands; ++i) {
+            switch (below(4)) {
+            case 0:
+                text += " + " + operand(budget);
+                break;
+            case 1:
+                text += " - " + operand(budget);
+                break;
+            case 2:
+                text += " * " + operand(budget);
+                break;
+            default:
+                // Never by zero.
+                text += " / " + std::to_string(1 + below(9));
+                break;
+            }
+        }
+        return text;
+    }
+
+    std::string condition() {
+        static const char *comparisons[] = {"<", ">", "<=", ">=", "!=", "="};
+        return expression(2) + " " + comparisons[below(6)] + " " +
+               expression(2);
+    }
+
+    void indent(int level) { out.append(4 * level, ' '); }
+
+    void statement(int level, int depth) {
+        int choice = below(100);
+        if (choice < shape.prints) {
+            indent(level);
+            int values = 1 + below(3);
+            std::string format;
+            std::string arguments;
+            for (int i = 0; i < values; ++i) {
+                format += (i ? " {}" : "value {}");
+                arguments += ", " + expression(shape.expression / 2);
+            }
+            out += "println(\"" + format + "\"" + arguments + ");\n";
+            return;
+        }
+        choice = below(100);
+        if (depth < shape.depth && choice < 15) {
+            indent(level);
+            out += "if (" + condition() + ") {\n";
+            block(level + 1, depth + 1);
+            indent(level);
+            if (percent(50)) {
+                out += "} else {\n";
+                block(level + 1, depth + 1);
+                indent(level);
+            }
+            out += "}\n";
+            return;
+        }
+        if (depth < shape.depth && choice < 25) {
+            indent(level);
+            std::string counter = name('i', locals++);
+            out += "for (let " + counter + ": int = 0; " + counter + " < " +
+                   std::to_string(2 + below(4)) + "; " + counter + " = " +
+                   counter + " + 1) {\n";
+            scopes.push_back({counter});
+            loops++;
+            block(level + 1, depth + 1);
+            loops--;
+            scopes.pop_back();
+            indent(level);
+            out += "}\n";
+            return;
+        }
+        if (depth < shape.depth && choice < 30) {
+            indent(level);
+            std::string counter = local();
+            out += "let " + counter + ": int = 0;\n";
+            indent(level);
+            out += "while (" + counter + " < " + std::to_string(2 + below(4)) +
+                   ") {\n";
+            scopes.push_back({});
+            loops++;
+            block(level + 1, depth + 1);
+            loops--;
+            scopes.pop_back();
+            indent(level + 1);
+            out += counter + " = " + counter + " + 1;\n";
+            indent(level);
+            out += "}\n";
+            return;
+        }
+        if (choice < 65 || scopes.back().empty()) {
+            indent(level);
+            std::string value = expression(shape.expression);
+            out += "let " + local() + ": int = " + value + ";\n";
+            return;
+        }
+        indent(level);
+        // Only the innermost block's own variables, never a loop counter, so
+        // loops stay counted.
+        std::string target = scopes.back()[below(scopes.back().size())];
+        out += target + " = " + expression(shape.expression) + ";\n";
+    }
+
+    void block(int level, int depth) {
+        scopes.push_back({});
+        int statements = 1 + below(shape.statements);
+        for (int i = 0; i < statements; ++i) {
+            statement(level, depth);
+        }
+        scopes.pop_back();
+    }
+
+    void function(int index) {
+        Function function{name('f', index), below(4)};
+        calls = index % 4 != 0;
+        locals = 0;
+        scopes.assign(1, {});
+        out += "fn " + function.name + "(";
+        for (int i = 0; i < function.parameters; ++i) {
+            std::string parameter = local();
+            out += (i ? ", " : "") + parameter + ": int";
+        }
+        out += "): int {\n";
+        // Something to assign to, whatever the parameters.
+        std::string value = expression(2);
+        out += "    let " + local() + ": int = " + value + ";\n";
+        for (int i = 0; i < shape.statements; ++i) {
+            statement(1, 0);
+        }
+        out += "    return " + expression(shape.expression) + ";\n}\n\n";
+        functions.push_back(function);
+        if (!calls) {
+            leaves.push_back(function);
+        }
+    }
+
+    Shape shape;
+    std::mt19937_64 random;
+    std::string out;
+    std::vector<Function> functions;
+    std::vector<Function> leaves;
+    // Whether the function being written may call leaves, and how many
+    // loops the statement being written is in.
+    bool calls = false;
+    int loops = 0;
+    // The variables in scope, innermost last.
+    std::vector<std::vector<std::string>> scopes;
+    int locals = 0;
+};
+
+bool option(const std::string &arg, const char *name, int &value) {
+    std::string prefix = std::string("--") + name + "=";
+    if (arg.rfind(prefix, 0) != 0) {
+        return false;
+    }
+    value = std::atoi(arg.c_str() + prefix.size());
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    Shape shape;
+    int seed = 1;
+    std::string outputPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "-o" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (!option(arg, "functions", shape.functions) &&
+                   !option(arg, "statements", shape.statements) &&
+                   !option(arg, "depth", shape.depth) &&
+                   !option(arg, "expression", shape.expression) &&
+                   !option(arg, "prints", shape.prints) &&
+                   !option(arg, "identifiers", shape.identifiers) &&
+                   !option(arg, "seed", seed)) {
+            std::cerr << "usage: " << argv[0]
+                      << " [--functions=N] [--statements=N] [--depth=N]"
+                         " [--expression=N] [--prints=PERCENT]"
+                         " [--identifiers=LENGTH] [--seed=N] [-o file.x]"
+                      << std::endl;
+            return 1;
+        }
+    }
+    if (shape.functions < 1 || shape.statements < 1 || shape.depth < 0 ||
+        shape.expression < 1 || shape.identifiers < 2) {
+        std::cerr << "sizes must be positive, identifiers at least 2 long"
+                  << std::endl;
+        return 1;
+    }
+
+    std::string program = Generator(shape, seed).program();
+    if (outputPath.empty()) {
+        std::cout << program;
+        return 0;
+    }
+    std::ofstream file(outputPath, std::ios::binary);
+    if (!(file << program)) {
+        std::cerr << "cannot write " << outputPath << std::endl;
+        return 1;
+    }
+    return 0;
+}
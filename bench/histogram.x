@@ -0,0 +1,24 @@
+fn main(): int{
+    let buckets: int[16];
+    for (let b: int = 0; b < 16; b = b + 1){
+        buckets[b] = 0;
+    }
+    let seed: int = 12345;
+    for (let i: int = 0; i < 2000000; i = i + 1){
+        seed = seed * 1103515245 + 12345;
+        let r: int = seed / 65536;
+        let b: int = r - r / 16 * 16;
+        if (b < 0){
+            b = b + 16;
+        }
+        buckets[b] = buckets[b] + 1;
+    }
+    let largest: int = 0;
+    for (let b: int = 0; b < 16; b = b + 1){
+        if (buckets[b] > largest){
+            largest = buckets[b];
+        }
+    }
+    println("largest bucket {}", largest);
+    return 0;
+}
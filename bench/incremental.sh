@@ -0,0 +1,61 @@
+#!/bin/sh
+# Times rebuilding a generated program after editing one function: a full
+# build of output.c against a --cache build that only compiles the units
+# that changed.
+# usage: bench/incremental.sh [functions] [compiler flags...]
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+compiler=$root/bin/LanguageC
+cc=${CC:-cc}
+functions=${1:-2000}
+[ $# -gt 0 ] && shift
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work"
+
+# f<i> calls f<i-1>; `scale` only changes the body of the middle function.
+generate() {
+    awk -v n="$functions" -v scale="$1" 'BEGIN {
+        for (i = 0; i < n; i++) {
+            k = i == int(n / 2) ? scale : i % 7 + 2
+            printf "fn f%d(a: int, b: int): int {\n", i
+            printf "    let x: int = a * %d + b;\n", k
+            printf "    if (x > 100) {\n        x = x - b;\n    }\n"
+            if (i > 0) {
+                printf "    return x / 2 + f%d(b, 3);\n}\n", i - 1
+            } else {
+                printf "    return x;\n}\n"
+            }
+        }
+        printf "fn main(): int {\n"
+        printf "    println(\"{}\", f%d(1, 2));\n", n - 1
+        printf "    return 0;\n}\n"
+    }' > program.x
+}
+
+now() { date +%s.%N; }
+since() { awk -v start="$1" -v end="$(now)" 'BEGIN { printf "%.3f s", end - start }'; }
+
+full() {
+    "$compiler" "$@" program.x > /dev/null
+    $cc -O2 -w -I "$root/runtime" output.c "$root/bin/libxrt.a" -o full
+}
+
+incremental() {
+    "$compiler" --cache=units "$@" program.x > /dev/null 2>&1
+    for unit in $(cat output.units); do
+        [ -e "${unit%.c}.o" ] || echo "$unit"
+    done | xargs -r -P "$(nproc)" -n 1 sh -c \
+        "$cc -O2 -w -c -I '$root/runtime' \"\$0\" -o \"\${0%.c}.o\""
+    $cc $(sed 's/\.c$/.o/' output.units) "$root/bin/libxrt.a" -o incremental
+}
+
+generate 3
+start=$(now); full "$@"; echo "full build:                $(since "$start")"
+start=$(now); incremental "$@"; echo "cold cache build:          $(since "$start")"
+
+generate 5
+start=$(now); full "$@"; echo "full rebuild after edit:   $(since "$start")"
+start=$(now); incremental "$@"; echo "cached rebuild after edit: $(since "$start")"
+
+[ "$(./full)" = "$(./incremental)" ] || { echo "outputs differ" >&2; exit 1; }
@@ -0,0 +1,119 @@
+// Stress test for libthelang: compiles each program serially under every
+// combination of options to get the expected results, then compiles them all
+// again from many threads at once, each compilation in a context of its own,
+// and checks that every result is the same.
+//
+// usage: library_stress [--threads=N] [--rounds=N] file.x...
+
+#include "thelang.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct Case {
+    size_t program;
+    CompileOptions options;
+    CompileResult expected;
+};
+
+static std::string describe(const std::string &name,
+                            const CompileOptions &options) {
+    return name + (options.optimize ? " -O1" : " -O0") + " --target=" +
+           options.target + (options.boundsChecks ? "" : " --no-bounds-checks");
+}
+
+int main(int argc, char *argv[]) {
+    unsigned threads = 8;
+    unsigned rounds = 20;
+    std::vector<std::string> names;
+    std::vector<std::string> sources;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--threads=", 0) == 0) {
+            threads = std::atoi(arg.c_str() + 10);
+        } else if (arg.rfind("--rounds=", 0) == 0) {
+            rounds = std::atoi(arg.c_str() + 9);
+        } else {
+            std::ifstream file(arg);
+            if (!file) {
+                std::cerr << "cannot read " << arg << std::endl;
+                return 1;
+            }
+            std::stringstream source;
+            source << file.rdbuf();
+            names.push_back(arg);
+            sources.push_back(source.str());
+        }
+    }
+    if (sources.empty() || threads == 0) {
+        std::cerr << "usage: " << argv[0]
+                  << " [--threads=N] [--rounds=N] file.x..." << std::endl;
+        return 1;
+    }
+
+    std::vector<Case> cases;
+    for (size_t program = 0; program < sources.size(); ++program) {
+        for (bool optimize : {false, true}) {
+            for (const char *target : {"c", "x86-64"}) {
+                for (bool boundsChecks : {true, false}) {
+                    CompileOptions options;
+                    options.optimize = optimize;
+                    options.target = target;
+                    options.boundsChecks = boundsChecks;
+                    // Code generation threads inside compilation threads.
+                    options.threads = 1 + program % 2;
+                    cases.push_back(
+                        {program, options, compile(sources[program], options)});
+                }
+            }
+        }
+    }
+
+    std::atomic<size_t> compilations = 0;
+    std::atomic<size_t> mismatches = 0;
+    auto work = [&](unsigned thread) {
+        for (unsigned round = 0; round < rounds; ++round) {
+            // Each thread walks the cases from a different starting point,
+            // so different programs are compiled side by side.
+            for (size_t i = 0; i < cases.size(); ++i) {
+                const Case &c =
+                    cases[(i + thread * 7 + round * 13) % cases.size()];
+                CompileResult result = compile(sources[c.program], c.options);
+                compilations++;
+                if (result.ok != c.expected.ok ||
+                    result.output != c.expected.output ||
+                    result.diagnostics != c.expected.diagnostics) {
+                    if (mismatches++ == 0) {
+                        std::string message =
+                            "mismatch: " +
+                            describe(names[c.program], c.options) + "\n";
+                        std::cerr << message;
+                    }
+                }
+            }
+        }
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> pool;
+    for (unsigned thread = 0; thread < threads; ++thread) {
+        pool.emplace_back(work, thread);
+    }
+    for (auto &thread : pool) {
+        thread.join();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    std::cout << compilations << " compilations on " << threads
+              << " threads in " << elapsed.count() << " s, " << mismatches
+              << " mismatches" << std::endl;
+    return mismatches == 0 ? 0 : 1;
+}
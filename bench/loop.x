@@ -0,0 +1,10 @@
+fn main(): int{
+    let total: int = 0;
+    for (let i: int = 0; i < 3000; i = i + 1){
+        for (let j: int = 0; j < 1000; j = j + 1){
+            total = total + i * j - (total / 7);
+        }
+    }
+    println("total is {}", total);
+    return 0;
+}
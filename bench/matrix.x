@@ -0,0 +1,32 @@
+fn multiply(n: int, rounds: int): int{
+    let a: int[];
+    let b: int[];
+    let c: int[];
+    for (let i: int = 0; i < n * n; i = i + 1){
+        push(a, i - i / 7 * 7);
+        push(b, i - i / 5 * 5 - 2);
+        push(c, 0);
+    }
+    let trace: int = 0;
+    for (let round: int = 0; round < rounds; round = round + 1){
+        for (let i: int = 0; i < n; i = i + 1){
+            for (let j: int = 0; j < n; j = j + 1){
+                let sum: int = 0;
+                for (let k: int = 0; k < n; k = k + 1){
+                    sum = sum + a[i * n + k] * b[k * n + j];
+                }
+                c[i * n + j] = sum;
+            }
+        }
+        for (let i: int = 0; i < n; i = i + 1){
+            trace = trace + c[i * n + i];
+        }
+        a[round] = a[round] + 1;
+    }
+    return trace;
+}
+
+fn main(): int{
+    println("trace {}", multiply(200, 10));
+    return 0;
+}
@@ -0,0 +1,75 @@
+#!/bin/sh
+# Times a module build (--build) of a generated program: a full build, a
+# rebuild with nothing changed, and rebuilds after editing a function body
+# and after adding a function, then checks the program still runs the
+# same as when built as a single file.
+# usage: bench/modules.sh [modules] [compiler flags...]
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+compiler=$root/bin/LanguageC
+cc=${CC:-cc}
+modules=${1:-64}
+[ $# -gt 0 ] && shift
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work"
+
+# m<i> imports m<i-1> and m<i/2>; `scale` changes one function body, and
+# `extra` adds a function to the module's interface.
+generate() {
+    awk -v m="$1" -v scale="$2" -v extra="$3" 'BEGIN {
+        if (m > 0) printf "import m%d;\n", m - 1
+        if (m > 1 && int(m / 2) != m - 1) printf "import m%d;\n", int(m / 2)
+        for (i = 0; i < 20; i++) {
+            k = i == 10 ? scale : i % 7 + 2
+            printf "fn m%d_f%d(a: int, b: int): int {\n", m, i
+            printf "    let x: int = a * %d + b;\n", k
+            printf "    if (x > 100) {\n        x = x - b;\n    }\n"
+            if (i > 0) {
+                printf "    return x / 2 + m%d_f%d(b, 3);\n}\n", m, i - 1
+            } else if (m > 0) {
+                printf "    return x / 2 + m%d_f19(b, 3);\n}\n", m - 1
+            } else {
+                printf "    return x;\n}\n"
+            }
+        }
+        if (extra) printf "fn m%d_extra(a: int): int {\n    return a;\n}\n", m
+    }' > "m$1.x"
+}
+
+i=0
+while [ $i -lt "$modules" ]; do
+    generate $i 3 0
+    i=$((i + 1))
+done
+last=$((modules - 1))
+cat > main.x << MAIN
+import m$last;
+fn main(): int {
+    println("{}", m${last}_f19(1, 2));
+    return 0;
+}
+MAIN
+
+now() { date +%s.%N; }
+since() { awk -v start="$1" -v end="$(now)" 'BEGIN { printf "%.3f s", end - start }'; }
+build() {
+    start=$(now)
+    report=$("$compiler" --build=out "$@" main.x 2>&1)
+    echo "$(since "$start"), ${report#build: }"
+}
+
+echo "full build:            $(build "$@")"
+echo "nothing changed:       $(build "$@")"
+generate $((modules / 2)) 5 0
+echo "function body edited:  $(build "$@")"
+generate $((modules / 2)) 5 1
+echo "function added:        $(build "$@")"
+
+$cc -O2 -w -I "$root/runtime" $(cat out/main.modules) "$root/bin/libxrt.a" \
+    -o modules
+# The same program in one file, without the imports.
+cat $(sed 's|^out/\(.*\)\.c$|\1.x|' out/main.modules) | grep -v '^import' > all.x
+"$compiler" -o all.c "$@" all.x > /dev/null
+$cc -O2 -w -I "$root/runtime" all.c "$root/bin/libxrt.a" -o all
+[ "$(./modules)" = "$(./all)" ] || { echo "outputs differ" >&2; exit 1; }
@@ -0,0 +1,6 @@
+fn main(): int{
+    for (let i: int = 0; i < 1000000; i = i + 1){
+        println("line {} of {}: times seven {}", i, 1000000, i * 7);
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+#!/bin/sh
+# Compares how fast compiled programs run against hand-written C: each
+# bench/<name>.x that has a bench/c/<name>.c is built with every target and
+# the C with $CC -O2, outputs are checked to match, and after warmup runs
+# the best of several timed runs is reported with its slowdown against C.
+# Targets: x86-64 (object linked with libxrt), c (output.c built with
+# $CC -O2) and vm (interpreted, compile time included).
+# BENCHMARKS limits the run to the named programs.
+# usage: bench/runtime.sh [compiler flags...]
+#   REPEAT=5 WARMUP=1 TARGETS="x86-64 c" bench/runtime.sh -O1
+#   BENCHMARKS="sieve matrix" bench/runtime.sh
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+compiler=$root/bin/LanguageC
+cc=${CC:-cc}
+repeat=${REPEAT:-5}
+warmup=${WARMUP:-1}
+targets=${TARGETS:-x86-64 c}
+benchmarks=${BENCHMARKS:-}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+cd "$work"
+
+now() { date +%s.%N; }
+
+# Prints the best of $repeat runs of a command in milliseconds, after
+# $warmup untimed runs.
+best() {
+    i=0
+    while [ "$i" -lt "$warmup" ]; do
+        "$@" > /dev/null
+        i=$((i + 1))
+    done
+    i=0
+    times=
+    while [ "$i" -lt "$repeat" ]; do
+        start=$(now)
+        "$@" > /dev/null
+        times="$times $start $(now)"
+        i=$((i + 1))
+    done
+    echo "$times" | awk '{
+        for (i = 1; i < NF; i += 2) {
+            t = ($(i + 1) - $i) * 1000
+            if (i == 1 || t < min) min = t
+        }
+        printf "%.1f", min
+    }'
+}
+
+# Builds bench/$1.x for target $2 with the compiler flags after them.
+build() {
+    name=$1
+    target=$2
+    shift 2
+    case $target in
+    x86-64)
+        "$compiler" "$@" --target=x86-64 --emit=obj -o "$name.o" \
+            "$root/bench/$name.x"
+        "$cc" "$name.o" "$root/bin/libxrt.a" -lpthread -o "$name.x86-64"
+        ;;
+    c)
+        "$compiler" "$@" -o "$name.c" "$root/bench/$name.x"
+        "$cc" -O2 -w -I "$root/runtime" "$name.c" "$root/bin/libxrt.a" \
+            -lpthread -o "$name.c.out"
+        ;;
+    vm)
+        printf '#!/bin/sh\nexec "%s" --vm %s "%s"\n' "$compiler" "$*" \
+            "$root/bench/$name.x" > "$name.vm"
+        chmod +x "$name.vm"
+        ;;
+    *)
+        echo "unknown target $target" >&2
+        exit 1
+        ;;
+    esac
+}
+
+executable() {
+    case $2 in
+    x86-64) echo "./$1.x86-64" ;;
+    c) echo "./$1.c.out" ;;
+    vm) echo "./$1.vm" ;;
+    esac
+}
+
+printf '%-12s %10s' benchmark "C ms"
+for target in $targets; do
+    printf ' %10s %7s' "$target ms" ratio
+done
+printf '\n'
+
+ratios=
+for reference in "$root"/bench/c/*.c; do
+    name=$(basename "$reference" .c)
+    [ -f "$root/bench/$name.x" ] || continue
+    case " ${benchmarks:-$name} " in
+    *" $name "*) ;;
+    *) continue ;;
+    esac
+    "$cc" -O2 -o "$name.ref" "$reference"
+    "./$name.ref" > "$name.expected"
+    c=$(best "./$name.ref")
+    printf '%-12s %10s' "$name" "$c"
+    for target in $targets; do
+        build "$name" "$target" "$@" > "$name.$target.log" 2>&1 ||
+            { cat "$name.$target.log" >&2; exit 1; }
+        program=$(executable "$name" "$target")
+        "$program" > "$name.$target.txt"
+        cmp -s "$name.expected" "$name.$target.txt" ||
+            { echo "$name: $target output differs from C" >&2; exit 1; }
+        t=$(best "$program")
+        ratio=$(awk -v t="$t" -v c="$c" \
+            'BEGIN { printf "%.2f", (c > 0 ? t / c : 0) }')
+        ratios="$ratios $target=$ratio"
+        printf ' %10s %6sx' "$t" "$ratio"
+    done
+    printf '\n'
+done
+
+# The geometric mean of each target's slowdowns.
+printf '%-12s %10s' "geomean" ""
+for target in $targets; do
+    echo "$ratios" | awk -v target="$target" '{
+        n = 0; sum = 0
+        for (i = 1; i <= NF; i++) {
+            split($i, pair, "=")
+            if (pair[1] == target && pair[2] > 0) {
+                sum += log(pair[2])
+                n++
+            }
+        }
+        printf " %10s %6.2fx", "", n ? exp(sum / n) : 0
+    }'
+done
+printf '\n'
@@ -0,0 +1,71 @@
+#!/bin/sh
+# Times the rebuilds of a watch loop: a project of generated files is
+# rebuilt after each edit to one of them, first by a fresh LanguageC
+# process each time, then through a --server that already saw the project.
+# usage: bench/server.sh [files] [edits] [compiler flags...]
+set -e
+root=$(cd "$(dirname "$0")/.." && pwd)
+compiler=$root/bin/LanguageC
+files=${1:-200}
+[ $# -gt 0 ] && shift
+edits=${1:-20}
+[ $# -gt 0 ] && shift
+work=$(mktemp -d)
+trap 'kill $server 2> /dev/null; rm -rf "$work"' EXIT
+cd "$work"
+
+# m<i>.x holds 20 functions; `scale` changes the body of one of them.
+generate() {
+    awk -v scale="$2" 'BEGIN {
+        for (i = 0; i < 20; i++) {
+            k = i == 10 ? scale : i % 7 + 2
+            printf "fn f%d(a: int, b: int): int {\n", i
+            printf "    let x: int = a * %d + b;\n", k
+            printf "    if (x > 100) {\n        x = x - b;\n    }\n"
+            if (i > 0) {
+                printf "    return x / 2 + f%d(b, 3);\n}\n", i - 1
+            } else {
+                printf "    return x;\n}\n"
+            }
+        }
+        printf "fn main(): int {\n"
+        printf "    println(\"{}\", f19(1, 2));\n"
+        printf "    return 0;\n}\n"
+    }' > "m$1.x"
+}
+
+mkdir out
+i=0
+while [ $i -lt "$files" ]; do
+    generate $i 3
+    echo "m$i.x" >> files
+    i=$((i + 1))
+done
+
+now() { date +%s.%N; }
+since() { awk -v start="$1" -v end="$(now)" -v n="$edits" \
+    'BEGIN { printf "%.1f ms per rebuild", (end - start) * 1000 / n }'; }
+
+# Edits a different file before each rebuild.
+rebuilds() {
+    edit=0
+    while [ $edit -lt "$edits" ]; do
+        generate $((edit * 7 % files)) $((edit + 4))
+        "$@" -o out @files
+        edit=$((edit + 1))
+    done
+}
+
+start=$(now); rebuilds "$compiler" "$@"
+echo "$files files, one edited, fresh process: $(since "$start")"
+mv out cold && mkdir out
+
+"$compiler" --server="$work/socket" 2> /dev/null &
+server=$!
+while [ ! -S socket ]; do sleep 0.01; done
+# The server's first build is as cold as any other.
+"$compiler" --connect=socket "$@" -o out @files
+start=$(now); rebuilds "$compiler" --connect=socket "$@"
+echo "$files files, one edited, --server:       $(since "$start")"
+
+diff -r cold out > /dev/null || { echo "outputs differ" >&2; exit 1; }
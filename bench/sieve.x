@@ -0,0 +1,25 @@
+fn sieve(limit: int): int{
+    let composite: int[];
+    for (let i: int = 0; i < limit; i = i + 1){
+        push(composite, 0);
+    }
+    let primes: int = 0;
+    for (let p: int = 2; p < limit; p = p + 1){
+        if (composite[p] == 0){
+            primes = primes + 1;
+            for (let m: int = p + p; m < limit; m = m + p){
+                composite[m] = 1;
+            }
+        }
+    }
+    return primes;
+}
+
+fn main(): int{
+    let found: int = 0;
+    for (let round: int = 0; round < 20; round = round + 1){
+        found = sieve(200000);
+    }
+    println("primes below 200000: {}", found);
+    return 0;
+}
@@ -0,0 +1,8 @@
+#!/bin/sh
+# Reports interpreter throughput on each benchmark program.
+# usage: bench/vm.sh [compiler flags...]
+root=$(dirname "$0")/..
+for program in "$root"/bench/*.x; do
+    printf '%-14s ' "$(basename "$program")"
+    "$root/bin/LanguageC" --vm --vm-stats "$@" "$program" 2>&1 >/dev/null
+done
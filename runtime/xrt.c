@@ -0,0 +1,546 @@
+#include "xrt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+char xrt_buffer[XRT_BUFFER_SIZE];
+size_t xrt_used;
+static int xrt_line_buffered;
+
+void xrt_flush(void) {
+    if (xrt_used) {
+        fwrite(xrt_buffer, 1, xrt_used, stdout);
+        xrt_used = 0;
+    }
+    fflush(stdout);
+}
+
+__attribute__((constructor)) static void xrt_init_output(void) {
+    xrt_line_buffered = isatty(STDOUT_FILENO);
+    atexit(xrt_flush);
+}
+
+// Number formatting. Both formatters write to a caller's buffer with no
+// allocation and no locale, and return the number of characters written.
+
+static const char xrt_digit_pairs[201] = "00010203040506070809"
+                                         "10111213141516171819"
+                                         "20212223242526272829"
+                                         "30313233343536373839"
+                                         "40414243444546474849"
+                                         "50515253545556575859"
+                                         "60616263646566676869"
+                                         "70717273747576777879"
+                                         "80818283848586878889"
+                                         "90919293949596979899";
+
+// Writes the digits of `value` so that they end just before `end`, two at a
+// time, and returns where they start.
+static inline char *xrt_format_digits(char *end, uint32_t value) {
+    while (value >= 100) {
+        uint32_t pair = value % 100;
+        value /= 100;
+        end -= 2;
+        memcpy(end, xrt_digit_pairs + pair * 2, 2);
+    }
+    if (value >= 10) {
+        end -= 2;
+        memcpy(end, xrt_digit_pairs + value * 2, 2);
+    } else {
+        *--end = (char)('0' + value);
+    }
+    return end;
+}
+
+static inline uint32_t xrt_digit_count(uint32_t value) {
+    uint32_t count = 1;
+    while (value >= 10) {
+        value /= 10;
+        count++;
+    }
+    return count;
+}
+
+size_t xrt_format_int(char *out, int32_t value) {
+    char digits[XRT_INT_CHARS];
+    char *end = digits + sizeof(digits);
+    uint32_t magnitude = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    char *start = xrt_format_digits(end, magnitude);
+    if (value < 0) {
+        *--start = '-';
+    }
+    size_t length = (size_t)(end - start);
+    memcpy(out, start, length);
+    return length;
+}
+
+// Shortest round-trip digits of a float, after Ryu (Ulf Adams, PLDI 2018):
+// the value and the halfway points to its neighbours are scaled by a power
+// of ten using 64-bit fixed-point approximations of 5^i and 5^-i, then
+// digits are removed for as long as the bounds still differ. The result is
+// the fewest digits that read back as the same float, correctly rounded.
+
+static const uint64_t xrt_pow5_inv_split[31] = {
+    576460752303423489u, 461168601842738791u, 368934881474191033u,
+    295147905179352826u, 472236648286964522u, 377789318629571618u,
+    302231454903657294u, 483570327845851670u, 386856262276681336u,
+    309485009821345069u, 495176015714152110u, 396140812571321688u,
+    316912650057057351u, 507060240091291761u, 405648192073033409u,
+    324518553658426727u, 519229685853482763u, 415383748682786211u,
+    332306998946228969u, 531691198313966350u, 425352958651173080u,
+    340282366920938464u, 544451787073501542u, 435561429658801234u,
+    348449143727040987u, 557518629963265579u, 446014903970612463u,
+    356811923176489971u, 570899077082383953u, 456719261665907162u,
+    365375409332725730u,
+};
+
+static const uint64_t xrt_pow5_split[47] = {
+    1152921504606846976u, 1441151880758558720u, 1801439850948198400u,
+    2251799813685248000u, 1407374883553280000u, 1759218604441600000u,
+    2199023255552000000u, 1374389534720000000u, 1717986918400000000u,
+    2147483648000000000u, 1342177280000000000u, 1677721600000000000u,
+    2097152000000000000u, 1310720000000000000u, 1638400000000000000u,
+    2048000000000000000u, 1280000000000000000u, 1600000000000000000u,
+    2000000000000000000u, 1250000000000000000u, 1562500000000000000u,
+    1953125000000000000u, 1220703125000000000u, 1525878906250000000u,
+    1907348632812500000u, 1192092895507812500u, 1490116119384765625u,
+    1862645149230957031u, 1164153218269348144u, 1455191522836685180u,
+    1818989403545856475u, 2273736754432320594u, 1421085471520200371u,
+    1776356839400250464u, 2220446049250313080u, 1387778780781445675u,
+    1734723475976807094u, 2168404344971008868u, 1355252715606880542u,
+    1694065894508600678u, 2117582368135750847u, 1323488980084844279u,
+    1654361225106055349u, 2067951531382569187u, 1292469707114105741u,
+    1615587133892632177u, 2019483917365790221u,
+};
+
+static inline int32_t xrt_pow5_bits(int32_t e) {
+    return (int32_t)(((uint32_t)e * 1217359) >> 19) + 1;
+}
+
+static inline uint32_t xrt_log10_pow2(int32_t e) {
+    return ((uint32_t)e * 78913) >> 18;
+}
+
+static inline uint32_t xrt_log10_pow5(int32_t e) {
+    return ((uint32_t)e * 732923) >> 20;
+}
+
+static inline int xrt_multiple_of_pow5(uint32_t value, uint32_t p) {
+    uint32_t count = 0;
+    while (value % 5 == 0) {
+        value /= 5;
+        count++;
+    }
+    return count >= p;
+}
+
+static inline int xrt_multiple_of_pow2(uint32_t value, uint32_t p) {
+    return (value & ((1u << p) - 1)) == 0;
+}
+
+static inline uint32_t xrt_mul_shift(uint32_t m, uint64_t factor,
+                                     int32_t shift) {
+    uint64_t low = (uint64_t)m * (uint32_t)factor;
+    uint64_t high = (uint64_t)m * (uint32_t)(factor >> 32);
+    return (uint32_t)(((low >> 32) + high) >> (shift - 32));
+}
+
+// Sets `digits` and `exponent` so that digits * 10^exponent is the shortest
+// representation of the finite, nonzero float with the given fields.
+static void xrt_shortest(uint32_t fraction, uint32_t biased, uint32_t *digits,
+                         int32_t *exponent) {
+    int32_t e2;
+    uint32_t m2;
+    if (biased == 0) {
+        e2 = 1 - 127 - 23 - 2;
+        m2 = fraction;
+    } else {
+        e2 = (int32_t)biased - 127 - 23 - 2;
+        m2 = (1u << 23) | fraction;
+    }
+    int accept_bounds = (m2 & 1) == 0;
+
+    // The value and its halfway points, times 4.
+    uint32_t mv = 4 * m2;
+    uint32_t mp = 4 * m2 + 2;
+    uint32_t mm_shift = fraction != 0 || biased <= 1;
+    uint32_t mm = 4 * m2 - 1 - mm_shift;
+
+    uint32_t vr, vp, vm;
+    int32_t e10;
+    int vm_trailing_zeros = 0;
+    int vr_trailing_zeros = 0;
+    uint32_t last_removed = 0;
+    if (e2 >= 0) {
+        uint32_t q = xrt_log10_pow2(e2);
+        e10 = (int32_t)q;
+        int32_t k = 59 + xrt_pow5_bits((int32_t)q) - 1;
+        int32_t i = -e2 + (int32_t)q + k;
+        vr = xrt_mul_shift(mv, xrt_pow5_inv_split[q], i);
+        vp = xrt_mul_shift(mp, xrt_pow5_inv_split[q], i);
+        vm = xrt_mul_shift(mm, xrt_pow5_inv_split[q], i);
+        if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+            // One removed digit is needed even if the loop below removes
+            // none.
+            int32_t l = 59 + xrt_pow5_bits((int32_t)q - 1) - 1;
+            last_removed = xrt_mul_shift(mv, xrt_pow5_inv_split[q - 1],
+                                         -e2 + (int32_t)q - 1 + l) %
+                           10;
+        }
+        if (q <= 9) {
+            // At most one of mp, mv and mm is a multiple of 5.
+            if (mv % 5 == 0) {
+                vr_trailing_zeros = xrt_multiple_of_pow5(mv, q);
+            } else if (accept_bounds) {
+                vm_trailing_zeros = xrt_multiple_of_pow5(mm, q);
+            } else {
+                vp -= xrt_multiple_of_pow5(mp, q);
+            }
+        }
+    } else {
+        uint32_t q = xrt_log10_pow5(-e2);
+        e10 = (int32_t)q + e2;
+        int32_t i = -e2 - (int32_t)q;
+        int32_t k = xrt_pow5_bits(i) - 61;
+        int32_t j = (int32_t)q - k;
+        vr = xrt_mul_shift(mv, xrt_pow5_split[i], j);
+        vp = xrt_mul_shift(mp, xrt_pow5_split[i], j);
+        vm = xrt_mul_shift(mm, xrt_pow5_split[i], j);
+        if (q != 0 && (vp - 1) / 10 <= vm / 10) {
+            j = (int32_t)q - 1 - (xrt_pow5_bits(i + 1) - 61);
+            last_removed = xrt_mul_shift(mv, xrt_pow5_split[i + 1], j) % 10;
+        }
+        if (q <= 1) {
+            // mv has at least two trailing zero bits, mp at least one, and
+            // mm one exactly when mm_shift is set.
+            vr_trailing_zeros = 1;
+            if (accept_bounds) {
+                vm_trailing_zeros = mm_shift == 1;
+            } else {
+                --vp;
+            }
+        } else if (q < 31) {
+            vr_trailing_zeros = xrt_multiple_of_pow2(mv, q - 1);
+        }
+    }
+
+    int32_t removed = 0;
+    uint32_t output;
+    if (vm_trailing_zeros || vr_trailing_zeros) {
+        while (vp / 10 > vm / 10) {
+            vm_trailing_zeros &= vm % 10 == 0;
+            vr_trailing_zeros &= last_removed == 0;
+            last_removed = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        if (vm_trailing_zeros) {
+            while (vm % 10 == 0) {
+                vr_trailing_zeros &= last_removed == 0;
+                last_removed = vr % 10;
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
+            }
+        }
+        if (vr_trailing_zeros && last_removed == 5 && vr % 2 == 0) {
+            // Exactly halfway: round to even.
+            last_removed = 4;
+        }
+        output = vr + ((vr == vm && (!accept_bounds || !vm_trailing_zeros)) ||
+                       last_removed >= 5);
+    } else {
+        while (vp / 10 > vm / 10) {
+            last_removed = vr % 10;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        output = vr + (vr == vm || last_removed >= 5);
+    }
+    *digits = output;
+    *exponent = e10 + removed;
+}
+
+// Plain notation (12.5, 0.001, 100.0) for decimal exponents from -5 to 15,
+// scientific (1.5e+20, 1e-07) beyond, as Python prints floats.
+size_t xrt_format_float(char *out, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t fraction = bits & ((1u << 23) - 1);
+    uint32_t biased = (bits >> 23) & 0xFF;
+    char *p = out;
+    if (biased == 0xFF && fraction != 0) {
+        memcpy(p, "nan", 3);
+        return 3;
+    }
+    if (bits >> 31) {
+        *p++ = '-';
+    }
+    if (biased == 0xFF) {
+        memcpy(p, "inf", 3);
+        return (size_t)(p - out) + 3;
+    }
+    if (biased == 0 && fraction == 0) {
+        memcpy(p, "0.0", 3);
+        return (size_t)(p - out) + 3;
+    }
+
+    uint32_t digits;
+    int32_t exponent;
+    xrt_shortest(fraction, biased, &digits, &exponent);
+    char text[10];
+    int32_t count = (int32_t)xrt_digit_count(digits);
+    xrt_format_digits(text + count, digits);
+    // Position of the decimal point relative to the first digit.
+    int32_t point = count + exponent;
+
+    if (point - 1 < -5 || point - 1 > 15) {
+        *p++ = text[0];
+        if (count > 1) {
+            *p++ = '.';
+            memcpy(p, text + 1, (size_t)count - 1);
+            p += count - 1;
+        }
+        int32_t scientific = point - 1;
+        *p++ = 'e';
+        *p++ = scientific < 0 ? '-' : '+';
+        uint32_t magnitude = (uint32_t)(scientific < 0 ? -scientific
+                                                       : scientific);
+        memcpy(p, xrt_digit_pairs + magnitude * 2, 2);
+        return (size_t)(p - out) + 2;
+    }
+    if (point <= 0) {
+        memcpy(p, "0.", 2);
+        p += 2;
+        memset(p, '0', (size_t)-point);
+        p += -point;
+        memcpy(p, text, (size_t)count);
+        return (size_t)(p - out) + (size_t)count;
+    }
+    if (point >= count) {
+        memcpy(p, text, (size_t)count);
+        p += count;
+        memset(p, '0', (size_t)(point - count));
+        p += point - count;
+        memcpy(p, ".0", 2);
+        return (size_t)(p - out) + 2;
+    }
+    memcpy(p, text, (size_t)point);
+    p += point;
+    *p++ = '.';
+    memcpy(p, text + point, (size_t)(count - point));
+    return (size_t)(p - out) + (size_t)(count - point);
+}
+
+// Space for `length` more bytes, flushing first if they do not fit.
+static inline char *xrt_reserve(size_t length) {
+    if (xrt_used + length > XRT_BUFFER_SIZE) {
+        xrt_flush();
+    }
+    return xrt_buffer + xrt_used;
+}
+
+void xrt_print_str(const char *text, int64_t length) {
+    size_t size = (size_t)length;
+    if (size >= XRT_BUFFER_SIZE) {
+        xrt_flush();
+        fwrite(text, 1, size, stdout);
+        return;
+    }
+    memcpy(xrt_reserve(size), text, size);
+    xrt_used += size;
+}
+
+void xrt_print_cstr(const char *text) {
+    xrt_print_str(text, (int64_t)strlen(text));
+}
+
+void xrt_print_int(int32_t value) {
+    xrt_used += xrt_format_int(xrt_reserve(XRT_INT_CHARS), value);
+}
+
+void xrt_print_float(float value) {
+    xrt_used += xrt_format_float(xrt_reserve(XRT_FLOAT_CHARS), value);
+}
+
+void xrt_print_bool(int32_t value) {
+    if (value) {
+        xrt_print_literal("true");
+    } else {
+        xrt_print_literal("false");
+    }
+}
+
+void xrt_print_char(int32_t value) {
+    *xrt_reserve(1) = (char)value;
+    xrt_used++;
+}
+
+void xrt_print_newline(void) {
+    *xrt_reserve(1) = '\n';
+    xrt_used++;
+    if (xrt_line_buffered) {
+        xrt_flush();
+    }
+}
+
+void xrt_push(xrt_array *array, int64_t value) {
+    if (array->len == array->cap) {
+        array->cap = array->cap ? array->cap * 2 : 8;
+        array->data = realloc(array->data, array->cap * sizeof(int64_t));
+        if (!array->data) {
+            fputs("out of memory\n", stderr);
+            exit(1);
+        }
+    }
+    array->data[array->len++] = value;
+}
+
+void xrt_grow(void **data, int32_t *cap, size_t size) {
+    *cap = *cap ? *cap * 2 : 8;
+    *data = realloc(*data, (size_t)*cap * size);
+    if (!*data) {
+        fputs("out of memory\n", stderr);
+        exit(1);
+    }
+}
+
+void xrt_index_error(int32_t index, int32_t length) {
+    xrt_flush();
+    fprintf(stderr, "index %d out of bounds for length %d\n", index, length);
+    exit(1);
+}
+
+// Profiling.
+
+xrt_profile_frame *xrt_profile_stack;
+int32_t xrt_profile_depth;
+int32_t xrt_profile_capacity;
+
+typedef struct {
+    const char *source;
+    xrt_profile_function *functions;
+    int32_t function_count;
+    xrt_profile_branch *branches;
+    int32_t branch_count;
+} xrt_profile_module;
+
+static xrt_profile_module *xrt_profile_modules;
+static int32_t xrt_profile_module_count;
+// When the first module registered, to work out the ticks in a second.
+static uint64_t xrt_profile_start_ticks;
+static uint64_t xrt_profile_start_clock;
+
+uint64_t xrt_clock_ticks(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+void xrt_profile_grow(void) {
+    xrt_grow((void **)&xrt_profile_stack, &xrt_profile_capacity,
+             sizeof(xrt_profile_frame));
+}
+
+// The profile is little-endian whatever the machine:
+//
+//     "XRTPROF1", u64 ticks per second, u32 modules, then per module
+//     string source, u32 functions, u32 branches,
+//     per function: i32 line, string name, u64 calls, inclusive, exclusive
+//     per branch: i32 line, i32 column, u64 taken, not taken
+//
+// where a string is a u32 length and that many bytes.
+static void xrt_put(FILE *out, uint64_t value, int size) {
+    unsigned char bytes[8];
+    for (int i = 0; i < size; i++) {
+        bytes[i] = (unsigned char)(value >> (8 * i));
+    }
+    fwrite(bytes, 1, (size_t)size, out);
+}
+
+static void xrt_put_string(FILE *out, const char *text) {
+    size_t length = strlen(text);
+    xrt_put(out, length, 4);
+    fwrite(text, 1, length, out);
+}
+
+static void xrt_profile_write(void) {
+    // Calls cut short by exit() end now.
+    while (xrt_profile_depth > 0) {
+        xrt_profile_exit();
+    }
+    uint64_t ticks = xrt_ticks() - xrt_profile_start_ticks;
+    uint64_t nanoseconds = xrt_clock_ticks() - xrt_profile_start_clock;
+    uint64_t per_second =
+        nanoseconds ? (uint64_t)((double)ticks * 1e9 / (double)nanoseconds)
+                    : 1000000000u;
+
+    const char *path = getenv("XRT_PROFILE");
+    if (!path || !*path) {
+        path = "xrt.profile";
+    }
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        fprintf(stderr, "cannot write profile %s\n", path);
+        return;
+    }
+    fwrite("XRTPROF1", 1, 8, out);
+    xrt_put(out, per_second, 8);
+    xrt_put(out, (uint64_t)xrt_profile_module_count, 4);
+    for (int32_t m = 0; m < xrt_profile_module_count; m++) {
+        const xrt_profile_module *module = &xrt_profile_modules[m];
+        xrt_put_string(out, module->source);
+        xrt_put(out, (uint64_t)module->function_count, 4);
+        xrt_put(out, (uint64_t)module->branch_count, 4);
+        for (int32_t i = 0; i < module->function_count; i++) {
+            const xrt_profile_function *function = &module->functions[i];
+            xrt_put(out, (uint32_t)function->line, 4);
+            xrt_put_string(out, function->name);
+            xrt_put(out, function->calls, 8);
+            xrt_put(out, function->inclusive, 8);
+            xrt_put(out, function->exclusive, 8);
+        }
+        for (int32_t i = 0; i < module->branch_count; i++) {
+            const xrt_profile_branch *branch = &module->branches[i];
+            xrt_put(out, (uint32_t)branch->line, 4);
+            xrt_put(out, (uint32_t)branch->column, 4);
+            xrt_put(out, branch->taken, 8);
+            xrt_put(out, branch->not_taken, 8);
+        }
+    }
+    if (fclose(out) != 0) {
+        fprintf(stderr, "cannot write profile %s\n", path);
+    }
+}
+
+void xrt_profile_register(const char *source, xrt_profile_function *functions,
+                          int32_t function_count, xrt_profile_branch *branches,
+                          int32_t branch_count) {
+    if (xrt_profile_module_count == 0) {
+        xrt_profile_start_clock = xrt_clock_ticks();
+        xrt_profile_start_ticks = xrt_ticks();
+        atexit(xrt_profile_write);
+    }
+    size_t size = (size_t)(xrt_profile_module_count + 1) *
+                  sizeof(xrt_profile_module);
+    xrt_profile_modules = realloc(xrt_profile_modules, size);
+    if (!xrt_profile_modules) {
+        fputs("out of memory\n", stderr);
+        exit(1);
+    }
+    xrt_profile_module *module =
+        &xrt_profile_modules[xrt_profile_module_count++];
+    module->source = source;
+    module->functions = functions;
+    module->function_count = function_count;
+    module->branches = branches;
+    module->branch_count = branch_count;
+}
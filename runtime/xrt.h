@@ -0,0 +1,177 @@
+#ifndef XRT_H_
+#define XRT_H_
+
+// Runtime support for compiled programs.
+//
+// Everything here follows the System V calling convention, so generated
+// assembly calls these functions directly. `int` values are 32 bits wide;
+// array elements always occupy 8 bytes regardless of their type. C
+// generated by the C backend includes this header (and xrt_arrays.h) and
+// links with libxrt.a.
+//
+// Output is buffered in the runtime rather than in stdio. The buffer is
+// written out when it fills, at exit, before an index error is reported,
+// on xrt_flush, and after every line when stdout is a terminal.
+//
+// C generated with --instrument also counts the calls and time of each
+// function and how often each if is taken into tables of its own, which
+// it registers here; the runtime writes them all to a profile at exit.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bumped whenever generated code needs something new from the runtime;
+// output.c refuses to compile against an older header.
+#define XRT_VERSION 3
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A growable array. Fixed-size arrays are a bare run of 8-byte slots.
+typedef struct {
+    int64_t *data;
+    int64_t len;
+    int64_t cap;
+} xrt_array;
+
+#define XRT_BUFFER_SIZE (1 << 16)
+
+// The output buffer and how much of it is filled, shared with
+// xrt_print_bytes.
+extern char xrt_buffer[XRT_BUFFER_SIZE];
+extern size_t xrt_used;
+
+void xrt_print_str(const char *text, int64_t length);
+
+// xrt_print_str, appending inline when the text fits, for C generated code.
+static inline void xrt_print_bytes(const char *text, size_t length) {
+    if (xrt_used + length <= XRT_BUFFER_SIZE) {
+        __builtin_memcpy(xrt_buffer + xrt_used, text, length);
+        xrt_used += length;
+    } else {
+        xrt_print_str(text, (int64_t)length);
+    }
+}
+
+// Prints a string literal, whose length is known at compile time.
+#define xrt_print_literal(text) xrt_print_bytes(text, sizeof(text) - 1)
+void xrt_print_cstr(const char *text);
+void xrt_print_int(int32_t value);
+void xrt_print_bool(int32_t value);
+void xrt_print_char(int32_t value);
+void xrt_print_float(float value);
+void xrt_print_newline(void);
+void xrt_flush(void);
+
+// Write the text of a number to `out`, which must have room for
+// XRT_INT_CHARS or XRT_FLOAT_CHARS characters, and return its length. No
+// terminator is written. Floats print as the shortest text that reads back
+// as the same value.
+#define XRT_INT_CHARS 11
+#define XRT_FLOAT_CHARS 24
+size_t xrt_format_int(char *out, int32_t value);
+size_t xrt_format_float(char *out, float value);
+
+void xrt_push(xrt_array *array, int64_t value);
+// Doubles the capacity of a C backend array of `size`-byte elements.
+void xrt_grow(void **data, int32_t *cap, size_t size);
+__attribute__((noreturn, cold)) void xrt_index_error(int32_t index,
+                                                     int32_t length);
+
+// Profiling. Times are in ticks of the time-stamp counter where there is
+// one, and nanoseconds elsewhere; the profile records how many make a
+// second.
+
+// A function of an instrumented module.
+typedef struct {
+    const char *name;
+    int32_t line;
+    // Calls that have not returned, so a recursive function's inclusive
+    // time counts only its outermost call.
+    int32_t active;
+    uint64_t calls;
+    // Time in the function and its callees, and in the function alone.
+    uint64_t inclusive;
+    uint64_t exclusive;
+} xrt_profile_function;
+
+// An if statement of an instrumented module, by where it starts.
+typedef struct {
+    int32_t line;
+    int32_t column;
+    uint64_t taken;
+    uint64_t not_taken;
+} xrt_profile_branch;
+
+// A call that has not returned.
+typedef struct {
+    xrt_profile_function *function;
+    uint64_t start;
+    // Time spent in the calls it made.
+    uint64_t children;
+} xrt_profile_frame;
+
+extern xrt_profile_frame *xrt_profile_stack;
+extern int32_t xrt_profile_depth;
+extern int32_t xrt_profile_capacity;
+void xrt_profile_grow(void);
+
+// Adds a module's tables to the profile, which is written at exit to the
+// file named by $XRT_PROFILE, or xrt.profile.
+void xrt_profile_register(const char *source, xrt_profile_function *functions,
+                          int32_t function_count, xrt_profile_branch *branches,
+                          int32_t branch_count);
+
+uint64_t xrt_clock_ticks(void);
+
+static inline uint64_t xrt_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return xrt_clock_ticks();
+#endif
+}
+
+static inline void xrt_profile_enter(xrt_profile_function *function) {
+    if (xrt_profile_depth == xrt_profile_capacity) {
+        xrt_profile_grow();
+    }
+    xrt_profile_frame *frame = &xrt_profile_stack[xrt_profile_depth++];
+    frame->function = function;
+    frame->children = 0;
+    function->calls++;
+    function->active++;
+    frame->start = xrt_ticks();
+}
+
+// Ends the innermost call; generated code calls it before each return.
+static inline void xrt_profile_exit(void) {
+    uint64_t now = xrt_ticks();
+    xrt_profile_frame *frame = &xrt_profile_stack[--xrt_profile_depth];
+    xrt_profile_function *function = frame->function;
+    uint64_t elapsed = now - frame->start;
+    function->exclusive += elapsed - frame->children;
+    if (--function->active == 0) {
+        function->inclusive += elapsed;
+    }
+    if (xrt_profile_depth > 0) {
+        xrt_profile_stack[xrt_profile_depth - 1].children += elapsed;
+    }
+}
+
+// Counts `condition` for `branch` and returns it.
+static inline int xrt_profile_if(xrt_profile_branch *branch, int condition) {
+    if (condition) {
+        branch->taken++;
+    } else {
+        branch->not_taken++;
+    }
+    return condition;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // XRT_H_
@@ -0,0 +1,41 @@
+#ifndef XRT_ARRAYS_H_
+#define XRT_ARRAYS_H_
+
+// Arrays for programs compiled by the C backend.
+//
+// Growable arrays are a struct per element type, always handled through a
+// pointer so locals and parameters read the same way. Index checks go
+// through xrt_check_index, whose single unsigned compare also rejects
+// negative indexes.
+
+#include "xrt.h"
+
+#include <stdbool.h>
+
+static inline int xrt_check_index(int index, int length) {
+    if (__builtin_expect((unsigned)index >= (unsigned)length, 0)) {
+        xrt_index_error(index, length);
+    }
+    return index;
+}
+
+#define XRT_ARRAY(T, NAME)                                                     \
+    typedef struct {                                                           \
+        T *data;                                                               \
+        int len;                                                               \
+        int cap;                                                               \
+    } xrt_array_##NAME;                                                        \
+    static inline void xrt_push_##NAME(xrt_array_##NAME *a, T value) {         \
+        if (a->len == a->cap) {                                                \
+            xrt_grow((void **)&a->data, &a->cap, sizeof(T));                   \
+        }                                                                      \
+        a->data[a->len++] = value;                                             \
+    }
+
+XRT_ARRAY(int, int)
+XRT_ARRAY(float, float)
+XRT_ARRAY(bool, bool)
+XRT_ARRAY(char, char)
+XRT_ARRAY(char *, string)
+
+#endif // XRT_ARRAYS_H_
@@ -1,283 +1,498 @@
+#include "analysis.hpp"
 #include "astGen.hpp"
+#include "compileCache.hpp"
+#include "emitter.hpp"
+#include "hash.hpp"
 #include "parser.hpp"
+#include "xrt.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <unordered_map>
 
+// Generates C from the AST into an Emitter; the caller decides where the
+// text goes.
 class IR {
 public:
-    IR(std::string inputFileName, std::string outputFileName, ASTGen &astGen,
-       Parser *parser)
-        : inputFileName(inputFileName), outputFileName(outputFileName),
-          astGen(astGen), parser(parser), indentationLevel(0) {
-        openInputFile();
-        createOutputFile();
+    IR(ASTGen &astGen, Parser *parser, Emitter &out)
+        : astGen(astGen), parser(parser), out(out), indentationLevel(0) {}
+
+    // Cleared by --no-bounds-checks.
+    bool boundsChecks = true;
+    // Threads GenIR generates functions on; 0 means one per core.
+    unsigned threads = 0;
+    // Set at -O1, where a caller's code depends on whether its callees are
+    // pure; writeUnits keys on it.
+    const PurityAnalysis *purity = nullptr;
+    // Times code generation and each function when set.
+    Timeline *timeline = nullptr;
+    // -g: the source file, named in a #line directive before each function
+    // and statement so that debuggers and profilers such as perf point into
+    // it rather than into the C. No directives are written when empty.
+    std::string sourceName;
+    // --instrument: the source file, which the profile names. Each function
+    // then counts its calls and times them, and each if counts how often it
+    // is taken, in tables registered with the runtime. Nothing is
+    // instrumented when empty.
+    std::string profileSource;
+
+    // Bump when the C generated for a function changes, so that units
+    // cached by an older compiler are not reused.
+    static constexpr uint64_t unitVersion = 3;
+
+    void increaseIndentation() { indentationLevel += 1; }
+
+    void decreaseIndentation() { indentationLevel -= 1; }
+
+    void writeTabs() { out.spaces(indentationLevel * 4); }
+
+    // The runtime is precompiled into libxrt.a; output.c only includes its
+    // header.
+    void writeIncludes() {
+        out.write("#include <stdbool.h>\n");
+        out.write(astGen.usesArrays ? "#include \"xrt_arrays.h\"\n"
+                                    : "#include \"xrt.h\"\n");
+        out.write("\n#if XRT_VERSION < ", XRT_VERSION, "\n");
+        out.write("#error \"output.c needs version ", XRT_VERSION,
+                  " of the xrt runtime\"\n");
+        out.write("#endif\n\n");
     }
 
-    void closeFiles() {
-        if (inputFile) {
-            fclose(inputFile);
+    void writeExpression(const Expression *expression, int precedence = 0) {
+        if (!expression) {
+            return;
         }
-        if (outputFile) {
-            fclose(outputFile);
+        if (writeOrdered(expression)) {
+            return;
+        }
+        switch (expression->type) {
+        case Expression::Type::BINARY_OPERATION: {
+            int own = operationPrecedence(expression->operation);
+            if (own < precedence) {
+                out.write("(");
+            }
+            writeExpression(expression->left_operand, own);
+            out.write(' ', operationToString(expression->operation), ' ');
+            // Binary operators are left-associative, so a right operand of the
+            // same precedence needs parentheses.
+            writeExpression(expression->right_operand, own + 1);
+            if (own < precedence) {
+                out.write(")");
+            }
+            break;
+        }
+        case Expression::Type::INDEX:
+            writeIndex(expression);
+            break;
+        case Expression::Type::FUNCTION_CALL:
+            if (expression->function_name == "len") {
+                writeLength(expression->arguments[0]);
+                break;
+            }
+            if (expression->function_name == "push") {
+                out.write("xrt_push_",
+                          dataTypeToCArraySuffix(
+                              expression->arguments[0]
+                                  ->variable_type.elementType()),
+                          '(');
+                writeExpression(expression->arguments[0]);
+                out.write(", ");
+                writeExpression(expression->arguments[1]);
+                out.write(")");
+                break;
+            }
+            out.write(expression->function_name, '(');
+            for (size_t i = 0; i < expression->arguments.size(); ++i) {
+                if (i > 0) {
+                    out.write(", ");
+                }
+                writeExpression(expression->arguments[i]);
+            }
+            out.write(")");
+            break;
+        case Expression::Type::VARIABLE_REFERENCE:
+        case Expression::Type::VARIABLE_ASSIGNMENT:
+            out.write(expression->variable_name);
+            break;
+        default:
+            out.write(expression->literal_value);
+            break;
         }
     }
 
-    void openInputFile() {
-        inputFile = fopen(inputFileName.c_str(), "r");
-        if (!inputFile) {
-            throw std::runtime_error("Failed to open input file");
+    // C leaves the order in which operands and arguments are evaluated
+    // unspecified, and gcc evaluates call arguments right to left, while
+    // the native backends go left to right. Where the order can show, the
+    // operands are evaluated into temporaries first, in a statement
+    // expression so that this works in conditions too:
+    //
+    //     f(x, g(1), h())
+    //
+    // becomes
+    //
+    //     ({ int __arg0 = g(1); int __arg1 = h(); f(x, __arg0, __arg1); })
+    //
+    // Returns false, writing nothing, where the order cannot show.
+    bool writeOrdered(const Expression *expression) {
+        std::vector<const Expression *> operands;
+        if (expression->type == Expression::Type::BINARY_OPERATION) {
+            operands = {expression->left_operand, expression->right_operand};
+        } else if (expression->type == Expression::Type::FUNCTION_CALL &&
+                   expression->function_name != "len" &&
+                   expression->function_name != "push") {
+            operands.assign(expression->arguments.begin(),
+                            expression->arguments.end());
         }
+        bool effects = false;
+        size_t hoisted = 0;
+        for (auto operand : operands) {
+            effects = effects || hasEffects(operand);
+            hoisted += !isStable(operand);
+        }
+        if (!effects || hoisted < 2) {
+            return false;
+        }
+
+        out.write("({ ");
+        std::vector<std::string> names;
+        for (auto operand : operands) {
+            if (isStable(operand)) {
+                names.emplace_back();
+                continue;
+            }
+            names.push_back(reservedPrefix + "arg" +
+                            std::to_string(temporaries++));
+            out.write(dataTypeToCType(operand->variable_type), ' ',
+                      names.back(), " = ");
+            writeExpression(operand);
+            out.write("; ");
+        }
+        auto operand = [&](size_t i, int precedence) {
+            if (names[i].empty()) {
+                writeExpression(operands[i], precedence);
+            } else {
+                out.write(names[i]);
+            }
+        };
+        if (expression->type == Expression::Type::BINARY_OPERATION) {
+            int own = operationPrecedence(expression->operation);
+            operand(0, own);
+            out.write(' ', operationToString(expression->operation), ' ');
+            operand(1, own + 1);
+        } else {
+            out.write(expression->function_name, '(');
+            for (size_t i = 0; i < operands.size(); ++i) {
+                if (i > 0) {
+                    out.write(", ");
+                }
+                operand(i, 0);
+            }
+            out.write(')');
+        }
+        out.write("; })");
+        return true;
+    }
+
+    // Whether evaluating `expression` may do something other operands
+    // could see or be cut short by: call a function that is not
+    // speculatable, or fail an index check.
+    bool hasEffects(const Expression *expression) const {
+        if (!expression) {
+            return false;
+        }
+        if (expression->type == Expression::Type::FUNCTION_CALL &&
+            !(effects && effects->isSpeculatable(expression->function_name))) {
+            return true;
+        }
+        if (expression->type == Expression::Type::INDEX &&
+            expression->bounds_checked && boundsChecks) {
+            return true;
+        }
+        if (hasEffects(expression->left_operand) ||
+            hasEffects(expression->right_operand)) {
+            return true;
+        }
+        for (auto argument : expression->arguments) {
+            if (hasEffects(argument)) {
+                return true;
+            }
+        }
+        return false;
     }
 
-    void createOutputFile() {
-        outputFile = fopen(outputFileName.c_str(), "w+");
-        if (!outputFile) {
-            throw std::runtime_error("Failed to create output file");
+    // Whether `expression` has the same value whenever it is evaluated
+    // within one statement: a literal, a local, or an array, whose
+    // elements may change but whose address does not.
+    static bool isStable(const Expression *expression) {
+        switch (expression->type) {
+        case Expression::Type::LITERAL:
+            return true;
+        case Expression::Type::VARIABLE_REFERENCE:
+            return !expression->is_global ||
+                   expression->variable_type.isArray();
+        default:
+            return false;
         }
     }
 
-    void copyInputToFile() {
-        if (inputFile && outputFile) {
-            char buffer[1024];
-            size_t bytesRead;
+    void writeLength(const Expression *array) {
+        const DataType &type = array->variable_type;
+        if (type.isFixedArray()) {
+            out.write(type.length);
+        } else {
+            writeExpression(array);
+            out.write("->len");
+        }
+    }
 
-            while ((bytesRead = fread(buffer, 1, sizeof(buffer), inputFile)) >
-                   0) {
-                fwrite(buffer, 1, bytesRead, outputFile);
+    void writeIndex(const Expression *expression) {
+        const Expression *array = expression->left_operand;
+        auto alias = restrictAliases.find(array->variable_name);
+        if (alias != restrictAliases.end()) {
+            out.write(alias->second);
+        } else {
+            writeExpression(array);
+            if (!array->variable_type.isFixedArray()) {
+                out.write("->data");
             }
         }
+
+        out.write("[");
+        if (expression->bounds_checked && boundsChecks) {
+            out.write("xrt_check_index(");
+            writeExpression(expression->right_operand);
+            out.write(", ");
+            writeLength(array);
+            out.write(")");
+        } else {
+            writeExpression(expression->right_operand);
+        }
+        out.write("]");
     }
 
-    void increaseIndentation() { indentationLevel += 1; }
+    void writeArrayDeclaration(VariableDeclaration *v) {
+        const DataType &type = v->variable_type;
+        std::string element = dataTypeToCType(type.elementType());
+        writeTabs();
+        if (type.isFixedArray()) {
+            out.write(element, ' ', v->name, '[', type.length, "] = {0};\n");
+            return;
+        }
+        std::string header = reservedPrefix + v->name + "_array";
+        out.write(dataTypeToCArrayType(type.elementType()), ' ', header,
+                  " = {0};\n");
+        writeTabs();
+        out.write(dataTypeToCType(type), ' ', v->name, " = &", header,
+                  ";\n");
+    }
 
-    void decreaseIndentation() { indentationLevel -= 1; }
+    // Opens a block that loads the data pointer of each array in `arrays`
+    // into a restrict-qualified local, which indexing inside the block then
+    // uses. Returns the arrays newly aliased, to be passed to
+    // closeRestrictBlock.
+    std::vector<std::string>
+    openRestrictBlock(const std::vector<std::string> &arrays,
+                      const std::vector<VariableDeclaration *> &declarations) {
+        std::vector<std::string> opened;
+        for (const auto &array : arrays) {
+            if (restrictAliases.count(array)) {
+                continue;
+            }
+            DataType type;
+            for (auto declaration : declarations) {
+                if (declaration->name == array) {
+                    type = declaration->variable_type;
+                }
+            }
+            if (!type.isArray()) {
+                continue;
+            }
+            if (opened.empty()) {
+                writeTabs();
+                out.write("{\n");
+                increaseIndentation();
+            }
+            std::string alias = reservedPrefix + array + "_data";
+            writeTabs();
+            out.write(dataTypeToCType(type.elementType()), " *restrict ",
+                      alias, " = ", array, "->data;\n");
+            restrictAliases[array] = alias;
+            opened.push_back(array);
+        }
+        return opened;
+    }
 
-    void writeTabs() {
-        for (int i = 0; i < indentationLevel; ++i) {
-            writeToFile("\t");
+    void closeRestrictBlock(const std::vector<std::string> &opened) {
+        if (opened.empty()) {
+            return;
         }
+        for (const auto &array : opened) {
+            restrictAliases.erase(array);
+        }
+        decreaseIndentation();
+        writeTabs();
+        out.write("}\n");
     }
 
-    void writeIncludes() {
-        writeToFile("#include <stdio.h>\n");
-        writeToFile("#include <stdlib.h>\n");
-        writeToFile("#include <string.h>\n");
-        writeToFile("#include <stdarg.h>\n");
-        writeToFile("#include <stdbool.h>\n");
-        writeToFile("\n\n");
-
-        const char *printlnfunction =
-            "void println(const char *format, ...) {\n"
-            "    va_list args;\n"
-            "    va_start(args, format);\n"
-            "\n"
-            "    for (int i = 0; format[i] != '\\0'; i++) {\n"
-            "        if (format[i] == '{' && format[i + 2] == ':' && format[i "
-            "+ 3] == '}') {\n"
-            "            char spec = format[i + 1];\n"
-            "\n"
-            "            if (spec == 'd' || spec == 'i') {\n"
-            "                int arg = va_arg(args, int);\n"
-            "                printf(\"%d\", arg);\n"
-            "            } else if (spec == 'f') {\n"
-            "                double arg = va_arg(args, double);\n"
-            "                printf(\"%f\", arg);\n"
-            "            } else if (spec == 'c') {\n"
-            "                int arg = va_arg(args, int);\n"
-            "                putchar(arg);\n"
-            "            } else if (spec == 's') {\n"
-            "                const char *arg = va_arg(args, const char *);\n"
-            "                printf(\"%s\", arg);\n"
-            "            } else if (spec == 'b') {\n"
-            "                bool arg = va_arg(args, int);\n"
-            "                printf(\"%s\", arg ? \"true\" : \"false\");\n"
-            "            }\n"
-            "            i += 3;\n"
-            "        } else {\n"
-            "            putchar(format[i]);\n"
-            "        }\n"
-            "    }\n"
-            "\n"
-            "    va_end(args);\n"
-            "    printf(\"\\n\");\n"
-            "}\n";
-
-        writeToFile(printlnfunction);
-
-        writeToFile("\n\n");
+    // Every statement gets a directive, even on the line of the one before:
+    // the C compiler counts lines on from each directive.
+    void writeLine(const Instruction *node) {
+        if (sourceName.empty() || node->line == 0) {
+            return;
+        }
+        out.write("#line ", node->line, ' ');
+        writeString(sourceName);
+        out.write('\n');
     }
 
-    void writeToFile(const std::string &str) {
-        if (outputFile) {
-            fwrite(str.c_str(), sizeof(char), str.size(), outputFile);
-        } else {
-            throw std::runtime_error("Output file is not open");
+    // `text` as a C string literal.
+    void writeString(std::string_view text) {
+        out.write('"');
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out.write('\\');
+            }
+            out.write(c);
         }
+        out.write('"');
     }
 
     void writeFunctionBody(const std::vector<Instruction *> &instructions) {
         for (auto instruction : instructions) {
+            writeLine(instruction);
             switch (instruction->type) {
             case NodeType::VARIABLE_DECLARATION: {
                 VariableDeclaration *v =
                     dynamic_cast<VariableDeclaration *>(instruction);
-                switch (v->initialization_value->type) {
-                case Expression::Type::VARIABLE_REFERENCE:
-                    writeToFile(dataTypeToCType(v->variable_type) + "    " +
-                                v->name + " = ");
-                    writeToFile(v->initialization_value->variable_name);
-                    writeToFile(";\n");
-                    break;
-                case Expression::Type::FUNCTION_CALL:
-                    writeToFile("    " + dataTypeToCType(v->variable_type) +
-                                " " + v->name + " = ");
-                    writeToFile(v->initialization_value->function_name);
-                    writeToFile("(");
-                    for (size_t i = 0;
-                         i < v->initialization_value->arguments.size(); ++i) {
-                        if (i > 0) {
-                            writeToFile(", ");
-                        }
-                        writeToFile(v->initialization_value->arguments[i]
-                                        ->variable_name);
-                    }
-                    writeToFile(")");
-                    writeToFile(";\n");
-                    break;
-                default:
-                    writeToFile("    " + dataTypeToCType(v->variable_type) +
-                                " " + v->name + " = ");
-                    writeToFile(v->initialization_value->literal_value);
-                    writeToFile(";\n");
+                declarations.push_back(v);
+                if (v->variable_type.isArray()) {
+                    writeArrayDeclaration(v);
                     break;
                 }
+                writeTabs();
+                out.write(dataTypeToCType(v->variable_type), ' ', v->name);
+                if (v->initialization_value) {
+                    out.write(" = ");
+                    writeExpression(v->initialization_value);
+                }
+                out.write(";\n");
                 break;
             }
             case NodeType::VARIABLE_ASSIGNMENT: {
                 VariableAssignment *assign =
                     dynamic_cast<VariableAssignment *>(instruction);
-                switch (assign->newValue->type) {
-                case Expression::Type::VARIABLE_REFERENCE:
-                    writeToFile("    " + assign->variable->name + " = ");
-                    writeToFile(assign->newValue->variable_name);
-                    writeToFile(";\n");
-                    break;
-                default:
-                    writeToFile("    " + assign->variable->name + " = ");
-                    writeToFile(assign->newValue->literal_value);
-                };
-                writeToFile(";\n");
+                writeTabs();
+                if (assign->element) {
+                    writeExpression(assign->element);
+                    out.write(" = ");
+                } else {
+                    out.write(assign->variable->name, " = ");
+                }
+                writeExpression(assign->newValue);
+                out.write(";\n");
                 break;
             }
-            case NodeType::FUNCTION_CALL: {
-                FunctionCall *f = dynamic_cast<FunctionCall *>(instruction);
-                writeToFile("    " + f->function_name + "(");
-                for (size_t i = 0; i < f->arguments.size(); ++i) {
-                    if (i > 0) {
-                        writeToFile(", ");
-                    }
-                    writeToFile(f->arguments[i]->literal_value);
-                }
-                writeToFile(");\n");
+            case NodeType::EXPRESSION: {
+                Expression *e = dynamic_cast<Expression *>(instruction);
+                writeTabs();
+                writeExpression(e);
+                out.write(";\n");
                 break;
             }
             case NodeType::RETURN_STATEMENT: {
                 ReturnStatement *ret =
                     dynamic_cast<ReturnStatement *>(instruction);
-                auto table = parser->globalSymbolTable;
-                auto &left = ret->returned_value->left_operand;
-                auto &right = ret->returned_value->right_operand;
-                writeToFile("    return ");
-                if (left->literal_value.empty()) {
-                    writeToFile(ret->returned_value->variable_name);
-                } else {
-                    writeToFile(left->literal_value + " ");
-                }
-                writeToFile(operationToString(ret->returned_value->operation) +
-                            " ");
-                if (right->old_value.empty()) {
-                    writeToFile(right->variable_name);
-                } else {
-                    writeToFile(right->old_value);
+                if (profile) {
+                    writeProfiledReturn(ret);
+                    break;
                 }
-                writeToFile(";\n");
+                writeTabs();
+                out.write("return ");
+                writeExpression(ret->returned_value);
+                out.write(";\n");
                 break;
             }
             case NodeType::IF: {
                 IfStatement *if_ = dynamic_cast<IfStatement *>(instruction);
-                writeToFile("\tif(");
-                writeToFile(if_->condition->left_operand->literal_value);
-                writeToFile(" ");
-                writeToFile(operationToString(if_->condition->operation));
-                writeToFile(" ");
-                writeToFile(if_->condition->right_operand->literal_value);
-                writeToFile(")");
-                writeToFile("{\n");
-                increaseIndentation();
                 writeTabs();
+                if (profile) {
+                    out.write("if (xrt_profile_if(&__profile_branches[",
+                              profile->branches.at(if_), "], ");
+                    writeExpression(if_->condition);
+                    out.write(")) {\n");
+                } else {
+                    out.write("if (");
+                    writeExpression(if_->condition);
+                    out.write(") {\n");
+                }
+                increaseIndentation();
                 writeIFBody(*if_->ifBody);
                 decreaseIndentation();
                 writeTabs();
-                writeToFile("}\n");
-                decreaseIndentation();
+                out.write("}\n");
                 break;
             }
             case NodeType::ELSE: {
                 ElseStatement *else_ =
                     dynamic_cast<ElseStatement *>(instruction);
-                writeToFile("\telse");
-                writeToFile("{\n");
+                writeTabs();
+                out.write("else {\n");
                 increaseIndentation();
                 writeIFBody(*else_->elseBody);
                 decreaseIndentation();
                 writeTabs();
-                decreaseIndentation();
-                writeToFile("}\n");
+                out.write("}\n");
                 break;
             }
-            case NodeType::PRINT_NODE: {
-                PrintNode *printNode = dynamic_cast<PrintNode *>(instruction);
+            case NodeType::WHILE: {
+                WhileStatement *loop =
+                    dynamic_cast<WhileStatement *>(instruction);
+                auto restricted =
+                    openRestrictBlock(loop->restrictArrays, declarations);
+                writeUnrollHint(loop->unrollHint);
+                writeTabs();
+                out.write("while (");
+                writeExpression(loop->condition);
+                out.write(") {\n");
                 increaseIndentation();
+                writeFunctionBody(loop->body->getInstructions());
+                decreaseIndentation();
                 writeTabs();
-                writeToFile("println(");
-
-                size_t varIndex = 0;
-
-                for (size_t i = 0; i < printNode->arguments.size(); ++i) {
-                    if (i > 0) {
-                        writeToFile(", ");
-                    }
-
-                    std::string argument = printNode->arguments[i];
-                    size_t found = argument.find("{}");
-
-                    while (found != std::string::npos) {
-                        std::string typeSpecifier = DataTypeToStringFormat(
-                            printNode->arguments2[varIndex]->variable_type);
-                        std::string variableName =
-                            printNode->arguments2[varIndex]->variable_name;
-
-                        argument.replace(found, 2, "{" + typeSpecifier + "}");
-
-                        found =
-                            argument.find("{}", found + typeSpecifier.length() +
-                                                    variableName.length());
-                        varIndex++;
-                    }
-                    writeToFile("\"");
-                    writeToFile(argument);
-                    writeToFile("\"");
-                }
-
-                for (size_t i = 0; i < printNode->arguments2.size(); ++i) {
-                    if (i > 0 || !printNode->arguments.empty()) {
-                        writeToFile(", ");
-                    }
-                    writeToFile(printNode->arguments2[i]->variable_name);
+                out.write("}\n");
+                closeRestrictBlock(restricted);
+                break;
+            }
+            case NodeType::FOR: {
+                ForStatement *loop = dynamic_cast<ForStatement *>(instruction);
+                auto restricted =
+                    openRestrictBlock(loop->restrictArrays, declarations);
+                if (loop->unrollFactor > 1) {
+                    writeUnrolledLoop(loop);
+                    closeRestrictBlock(restricted);
+                    break;
                 }
-
-                writeToFile(");\n");
+                writeUnrollHint(loop->unrollHint);
+                writeTabs();
+                out.write("for (", dataTypeToCType(loop->init->variable_type),
+                          ' ', loop->init->name, " = ");
+                writeExpression(loop->init->initialization_value);
+                out.write("; ");
+                writeExpression(loop->condition);
+                out.write("; ", loop->step->variable->name, " = ");
+                writeExpression(loop->step->newValue);
+                out.write(") {\n");
+                increaseIndentation();
+                writeFunctionBody(loop->body->getInstructions());
                 decreaseIndentation();
+                writeTabs();
+                out.write("}\n");
+                closeRestrictBlock(restricted);
                 break;
             }
+            case NodeType::PRINT_NODE:
+                writePrint(dynamic_cast<PrintNode *>(instruction));
+                break;
 
             default:
                 break;
@@ -285,72 +500,601 @@ public:
         }
     }
 
+    // println is specialized at compile time: the format is split at each
+    // `{}` into literal segments, written with their length known, and one
+    // typed write per argument.
+    //
+    //     println("x is {}", f(x));
+    //
+    // becomes
+    //
+    //     {
+    //         int _print0 = f(x);
+    //         xrt_print_literal("x is ");
+    //         xrt_print_int(_print0);
+    //         xrt_print_newline();
+    //     }
+    //
+    // Arguments other than literals and variables are evaluated into
+    // temporaries first, so a call that prints, or an index that fails,
+    // still does so before any of the line is written.
+    void writePrint(PrintNode *print) {
+        std::vector<std::string> values;
+        bool hoisted = false;
+        for (size_t i = 0; i < print->arguments2.size(); ++i) {
+            const Expression *argument = print->arguments2[i];
+            if (argument->type == Expression::Type::LITERAL) {
+                values.push_back(argument->literal_value);
+                continue;
+            }
+            if (argument->type == Expression::Type::VARIABLE_REFERENCE) {
+                values.push_back(argument->variable_name);
+                continue;
+            }
+            if (!hoisted) {
+                writeTabs();
+                out.write("{\n");
+                increaseIndentation();
+                hoisted = true;
+            }
+            std::string name = reservedPrefix + "print" + std::to_string(i);
+            writeTabs();
+            out.write(dataTypeToCType(argument->variable_type), ' ', name,
+                      " = ");
+            writeExpression(argument);
+            out.write(";\n");
+            values.push_back(name);
+        }
+
+        std::string_view format;
+        if (!print->arguments.empty()) {
+            format = print->arguments[0];
+        }
+        size_t pos = 0;
+        for (size_t i = 0; i < values.size(); ++i) {
+            size_t found = format.find("{}", pos);
+            if (found == std::string_view::npos) {
+                break;
+            }
+            writeLiteral(format.substr(pos, found - pos));
+            writeTabs();
+            const DataType &type = print->arguments2[i]->variable_type;
+            out.write("xrt_print_", dataTypeToPrintSuffix(type), '(',
+                      values[i], ");\n");
+            pos = found + 2;
+        }
+        writeLiteral(format.substr(pos));
+        writeTabs();
+        out.write("xrt_print_newline();\n");
+
+        if (hoisted) {
+            decreaseIndentation();
+            writeTabs();
+            out.write("}\n");
+        }
+    }
+
+    void writeLiteral(std::string_view text) {
+        if (!text.empty()) {
+            writeTabs();
+            out.write("xrt_print_literal(\"", text, "\");\n");
+        }
+    }
+
+    void writeUnrollHint(int factor) {
+        if (factor > 1) {
+            out.write("#pragma GCC unroll ", factor, '\n');
+        }
+    }
+
+    // A counted loop with a known trip count, unrolled by
+    // `loop->unrollFactor`. Each copy of the body gets its own block so its
+    // declarations do not clash, and the counter is stepped between copies:
+    //
+    //     { int i = A; while (i < END) { {body} i = i + s; ... } {body} ... }
+    //
+    // where END is where the unrolled iterations stop and the leftover trip
+    // count modulo the factor is emitted as straight-line copies.
+    void writeUnrolledLoop(ForStatement *loop) {
+        long long chunks = loop->tripCount / loop->unrollFactor;
+        long long remainder = loop->tripCount % loop->unrollFactor;
+        long long start =
+            std::stoll(loop->init->initialization_value->literal_value);
+        long long end =
+            start + chunks * loop->unrollFactor * loop->stepValue;
+
+        auto writeIteration = [&]() {
+            writeTabs();
+            out.write("{\n");
+            increaseIndentation();
+            writeFunctionBody(loop->body->getInstructions());
+            decreaseIndentation();
+            writeTabs();
+            out.write("}\n");
+            writeFunctionBody({loop->step});
+        };
+
+        writeTabs();
+        out.write("{\n");
+        increaseIndentation();
+        writeFunctionBody({loop->init});
+        if (chunks == 1) {
+            remainder += loop->unrollFactor;
+        } else {
+            writeTabs();
+            out.write("while (", loop->init->name,
+                      loop->stepValue > 0 ? " < " : " > ", end, ") {\n");
+            increaseIndentation();
+            for (int i = 0; i < loop->unrollFactor; ++i) {
+                writeIteration();
+            }
+            decreaseIndentation();
+            writeTabs();
+            out.write("}\n");
+        }
+        for (long long i = 0; i < remainder; ++i) {
+            writeIteration();
+        }
+        decreaseIndentation();
+        writeTabs();
+        out.write("}\n");
+    }
+
     void writeIFBody(const FunctionBody &body) {
         writeFunctionBody(body.getInstructions());
     }
 
+    // Where each function and if statement of an instrumented module counts:
+    // their indices in __profile_functions and __profile_branches.
+    struct ProfileTables {
+        std::unordered_map<const Instruction *, size_t> functions;
+        std::unordered_map<const Instruction *, size_t> branches;
+        std::vector<const FunctionDeclaration *> functionOrder;
+        std::vector<const IfStatement *> branchOrder;
+    };
+
+    // The value is computed before the call ends, since computing it may
+    // call other functions:
+    //
+    //     {
+    //         int __profile_value = fib(n - 1) + fib(n - 2);
+    //         xrt_profile_exit();
+    //         return __profile_value;
+    //     }
+    void writeProfiledReturn(const ReturnStatement *ret) {
+        writeTabs();
+        out.write("{\n");
+        increaseIndentation();
+        if (ret->returned_value) {
+            writeTabs();
+            out.write(dataTypeToCType(function->return_type),
+                      " __profile_value = ");
+            writeExpression(ret->returned_value);
+            out.write(";\n");
+        }
+        writeTabs();
+        out.write("xrt_profile_exit();\n");
+        writeTabs();
+        out.write(ret->returned_value ? "return __profile_value;\n"
+                                      : "return;\n");
+        decreaseIndentation();
+        writeTabs();
+        out.write("}\n");
+    }
+
+    // Numbers the functions and if statements of an instrumented module in
+    // source order.
+    void collectProfileTables(ProfileTables &tables) {
+        for (auto node : astGen.nodes) {
+            if (node->type == NodeType::FUNCTION_DECLARATION) {
+                auto func = dynamic_cast<FunctionDeclaration *>(node);
+                tables.functions.emplace(func, tables.functionOrder.size());
+                tables.functionOrder.push_back(func);
+                collectBranches(func->body->getInstructions(), tables);
+            }
+        }
+    }
+
+    void collectBranches(const std::vector<Instruction *> &instructions,
+                         ProfileTables &tables) {
+        for (auto instruction : instructions) {
+            switch (instruction->type) {
+            case NodeType::IF: {
+                auto if_ = dynamic_cast<IfStatement *>(instruction);
+                tables.branches.emplace(if_, tables.branchOrder.size());
+                tables.branchOrder.push_back(if_);
+                collectBranches(if_->ifBody->getInstructions(), tables);
+                break;
+            }
+            case NodeType::ELSE:
+                collectBranches(dynamic_cast<ElseStatement *>(instruction)
+                                    ->elseBody->getInstructions(),
+                                tables);
+                break;
+            case NodeType::WHILE:
+                collectBranches(dynamic_cast<WhileStatement *>(instruction)
+                                    ->body->getInstructions(),
+                                tables);
+                break;
+            case NodeType::FOR:
+                collectBranches(dynamic_cast<ForStatement *>(instruction)
+                                    ->body->getInstructions(),
+                                tables);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+
+    // The tables the instrumented code counts into, and a constructor that
+    // registers them with the runtime before main runs.
+    void writeProfileTables(const ProfileTables &tables) {
+        if (!tables.functionOrder.empty()) {
+            out.write("static xrt_profile_function __profile_functions[] = "
+                      "{\n");
+            for (auto func : tables.functionOrder) {
+                out.write("    {\"", func->name, "\", ", func->line, "},\n");
+            }
+            out.write("};\n");
+        }
+        if (!tables.branchOrder.empty()) {
+            out.write("static xrt_profile_branch __profile_branches[] = {\n");
+            for (auto if_ : tables.branchOrder) {
+                out.write("    {", if_->line, ", ", if_->column, "},\n");
+            }
+            out.write("};\n");
+        }
+        out.write("\n__attribute__((constructor)) static void "
+                  "__profile_register(void) {\n");
+        out.write("    xrt_profile_register(");
+        writeString(profileSource);
+        out.write(", ");
+        if (tables.functionOrder.empty()) {
+            out.write("0, 0, ");
+        } else {
+            out.write("__profile_functions, ", tables.functionOrder.size(),
+                      ", ");
+        }
+        if (tables.branchOrder.empty()) {
+            out.write("0, 0);\n");
+        } else {
+            out.write("__profile_branches, ", tables.branchOrder.size(),
+                      ");\n");
+        }
+        out.write("}\n\n");
+    }
+
+    // Functions only depend on each other's signatures, which are declared
+    // up front, so each top-level node is generated into its own buffer in
+    // parallel. The buffers are joined in source order, so the output does
+    // not depend on the thread count.
     void GenIR() {
+        TimeScope scope(timeline, "generate C");
         if (astGen.nodes.empty()) {
-            std::cerr << "AST is empty" << std::endl;
+            parser->error("AST is empty");
             return;
         }
 
         writeIncludes();
+        writePrototypes();
+        PurityAnalysis calls;
+        calls.run(astGen);
+        effects = &calls;
+        ProfileTables tables;
+        if (!profileSource.empty()) {
+            collectProfileTables(tables);
+            writeProfileTables(tables);
+            profile = &tables;
+        }
 
-        for (auto &node : astGen.nodes) {
-            switch (node->type) {
-            case NodeType::FUNCTION_DECLARATION: {
-                FunctionDeclaration *func =
-                    dynamic_cast<FunctionDeclaration *>(node);
-
-                writeToFile(dataTypeToCType(func->return_type) + " " +
-                            func->name + "(");
-
-                for (size_t i = 0; i < func->parameters.size(); ++i) {
-                    if (i > 0) {
-                        writeToFile(", ");
-                    }
-                    writeToFile(
-                        dataTypeToCType(func->parameters[i]->variable_type) +
-                        " " + func->parameters[i]->name);
+        std::vector<std::string> chunks(astGen.nodes.size());
+        parallelFor(chunks.size(), [&](size_t i) {
+            TimeScope function(timeline, "generate function",
+                               timeline ? nameOf(astGen.nodes[i]) : "");
+            Emitter chunk(chunks[i]);
+            IR writer(astGen, parser, chunk);
+            writer.boundsChecks = boundsChecks;
+            writer.sourceName = sourceName;
+            writer.profile = profile;
+            writer.effects = effects;
+            writer.writeTopLevel(astGen.nodes[i]);
+        });
+        for (const auto &chunk : chunks) {
+            out.write(chunk);
+        }
+    }
+
+    // --cache: writes each function to `cache` as a translation unit of its
+    // own and returns the units in source order, preceded by one defining
+    // the globals if there are any. A unit's key covers everything its text
+    // depends on: the function's tokens, the globals, the options, and the
+    // signature of each function it calls (plus, at -O1, whether the callee
+    // is pure). Units already in the cache are not generated again.
+    // `purity` must be set exactly when the AST has been optimized.
+    std::vector<std::string> writeUnits(CompileCache &cache) {
+        TimeScope scope(timeline, "generate units");
+        PurityAnalysis calls;
+        calls.run(astGen);
+        effects = &calls;
+        // Every unit starts with the includes and the globals, declared
+        // extern; only the first unit defines them.
+        std::string header;
+        Emitter headerOut(header);
+        IR headerWriter(astGen, parser, headerOut);
+        headerWriter.writeIncludes();
+        headerWriter.writeExterns();
+
+        std::string globals;
+        Emitter globalsOut(globals);
+        IR globalsWriter(astGen, parser, globalsOut);
+        globalsWriter.sourceName = sourceName;
+        std::unordered_map<std::string, std::string> signatures;
+        for (auto func : astGen.externs) {
+            Emitter signature(signatures[func->name]);
+            IR(astGen, parser, signature).writeSignature(func);
+        }
+        for (auto node : astGen.nodes) {
+            if (node->type == NodeType::VARIABLE_DECLARATION) {
+                globalsWriter.writeTopLevel(node);
+            } else if (node->type == NodeType::FUNCTION_DECLARATION) {
+                auto func = dynamic_cast<FunctionDeclaration *>(node);
+                Emitter signature(signatures[func->name]);
+                IR(astGen, parser, signature).writeSignature(func);
+            }
+        }
+
+        std::vector<std::string> units;
+        if (!globals.empty()) {
+            std::string text;
+            Emitter unit(text);
+            IR(astGen, parser, unit).writeIncludes();
+            unit.write(globals);
+            Hasher key;
+            key.add(unitVersion);
+            key.add(text);
+            if (!cache.contains(key.value())) {
+                cache.store(key.value(), text);
+            }
+            units.push_back(cache.path(key.value()));
+        }
+
+        std::vector<FunctionDeclaration *> functions;
+        for (auto node : astGen.nodes) {
+            if (node->type == NodeType::FUNCTION_DECLARATION) {
+                functions.push_back(dynamic_cast<FunctionDeclaration *>(node));
+            }
+        }
+        size_t first = units.size();
+        units.resize(first + functions.size());
+        parallelFor(functions.size(), [&](size_t i) {
+            FunctionDeclaration *func = functions[i];
+            Hasher key;
+            key.add(unitVersion);
+            key.add(header);
+            key.add(boundsChecks ? "checked" : "unchecked");
+            key.add(purity ? "-O1" : "-O0");
+            key.add(func->tokenHash);
+            if (!sourceName.empty()) {
+                key.add(sourceName);
+                key.add(func->lineHash);
+            }
+            std::vector<const std::string *> callees;
+            for (const auto &name : calledFunctions(func->body)) {
+                auto signature = signatures.find(name);
+                if (signature == signatures.end()) {
+                    continue;
+                }
+                callees.push_back(&signature->second);
+                key.add(signature->second);
+                // Calls are ordered around those that are not
+                // speculatable, at -O0 too.
+                key.add(effects->isSpeculatable(name) ? "safe" : "unsafe");
+                if (purity) {
+                    key.add(purity->isPure(name) ? "pure" : "impure");
+                    key.add(purity->isSpeculatable(name) ? "safe" : "unsafe");
+                }
+            }
+
+            units[first + i] = cache.path(key.value());
+            if (cache.contains(key.value())) {
+                cache.reused++;
+                return;
+            }
+            TimeScope function(timeline, "generate function", func->name);
+            std::string text = header;
+            Emitter unit(text);
+            for (auto callee : callees) {
+                unit.write(*callee, ";\n");
+            }
+            if (!callees.empty()) {
+                unit.write('\n');
+            }
+            IR writer(astGen, parser, unit);
+            writer.boundsChecks = boundsChecks;
+            writer.sourceName = sourceName;
+            writer.effects = effects;
+            writer.writeTopLevel(func);
+            cache.store(key.value(), text);
+            cache.written++;
+        });
+        return units;
+    }
+
+    // Calls work(i) for every i < count on `threads` threads, then rethrows
+    // the exception of the lowest i that threw, so errors are reported the
+    // same way whichever thread hit them.
+    template <typename Work> void parallelFor(size_t count, const Work &work) {
+        std::vector<std::exception_ptr> errors(count);
+        std::atomic<size_t> next = 0;
+        auto run = [&]() {
+            for (size_t i; (i = next++) < count;) {
+                try {
+                    work(i);
+                } catch (...) {
+                    errors[i] = std::current_exception();
                 }
+            }
+        };
 
-                writeToFile(") {\n");
+        unsigned workers = threads;
+        if (workers == 0) {
+            workers = std::max(1u, std::thread::hardware_concurrency());
+        }
+        std::vector<std::thread> pool;
+        for (size_t i = 1; i < std::min<size_t>(workers, count); ++i) {
+            pool.emplace_back(run);
+        }
+        run();
+        for (auto &thread : pool) {
+            thread.join();
+        }
 
-                writeFunctionBody(func->body->getInstructions());
-                writeToFile("}\n");
-                fflush(outputFile);
-                break;
+        for (const auto &error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
             }
-            default:
-                break;
+        }
+    }
+
+    // What a span of work on `node` is called in a --trace.
+    static std::string_view nameOf(const Instruction *node) {
+        switch (node->type) {
+        case NodeType::FUNCTION_DECLARATION:
+            return dynamic_cast<const FunctionDeclaration *>(node)->name;
+        case NodeType::VARIABLE_DECLARATION:
+            return dynamic_cast<const VariableDeclaration *>(node)->name;
+        default:
+            return {};
+        }
+    }
+
+    void writeExterns() {
+        bool any = false;
+        for (auto node : astGen.nodes) {
+            if (node->type != NodeType::VARIABLE_DECLARATION) {
+                continue;
+            }
+            auto v = dynamic_cast<VariableDeclaration *>(node);
+            const DataType &type = v->variable_type;
+            if (type.isFixedArray()) {
+                out.write("extern ", dataTypeToCType(type.elementType()), ' ',
+                          v->name, '[', type.length, "];\n");
+            } else {
+                out.write("extern ", dataTypeToCType(type), ' ', v->name,
+                          ";\n");
+            }
+            any = true;
+        }
+        if (any) {
+            out.write('\n');
+        }
+    }
+
+    void writePrototypes() {
+        bool any = false;
+        for (auto func : astGen.externs) {
+            writeSignature(func);
+            out.write(";\n");
+            any = true;
+        }
+        for (auto &node : astGen.nodes) {
+            if (node->type == NodeType::FUNCTION_DECLARATION) {
+                writeSignature(dynamic_cast<FunctionDeclaration *>(node));
+                out.write(";\n");
+                any = true;
+            }
+        }
+        if (any) {
+            out.write('\n');
+        }
+    }
+
+    void writeSignature(const FunctionDeclaration *func) {
+        out.write(dataTypeToCType(func->return_type), ' ', func->name, '(');
+        for (size_t i = 0; i < func->parameters.size(); ++i) {
+            if (i > 0) {
+                out.write(", ");
+            }
+            out.write(dataTypeToCType(func->parameters[i]->variable_type), ' ',
+                      func->parameters[i]->name);
+        }
+        out.write(')');
+    }
+
+    void writeTopLevel(Instruction *node) {
+        switch (node->type) {
+        case NodeType::VARIABLE_DECLARATION: {
+            writeFunctionBody({node});
+            break;
+        }
+        case NodeType::FUNCTION_DECLARATION: {
+            FunctionDeclaration *func =
+                dynamic_cast<FunctionDeclaration *>(node);
+            writeLine(func);
+            writeSignature(func);
+            out.write(" {\n");
+            declarations = func->parameters;
+            function = func;
+            increaseIndentation();
+            if (profile) {
+                writeTabs();
+                out.write("xrt_profile_enter(&__profile_functions[",
+                          profile->functions.at(func), "]);\n");
+            }
+            const auto &instructions = func->body->getInstructions();
+            writeFunctionBody(instructions);
+            if (profile && (instructions.empty() ||
+                            instructions.back()->type !=
+                                NodeType::RETURN_STATEMENT)) {
+                writeTabs();
+                out.write("xrt_profile_exit();\n");
             }
+            decreaseIndentation();
+            out.write("}\n");
+            break;
+        }
+        default:
+            break;
         }
     }
 
-    std::string DataTypeToStringFormat(DataType type) {
+    // The xrt_print_* routine that prints a value of `type`.
+    std::string dataTypeToPrintSuffix(const DataType &type) {
         switch (type.category) {
         case DataType::Category::INT:
-            return "i:";
+            return "int";
         case DataType::Category::FLOAT:
-            return "f:";
+            return "float";
         case DataType::Category::BOOL:
-            return "b:";
+            return "bool";
         case DataType::Category::CHAR:
-            return "c:";
+            return "char";
         case DataType::Category::STRING:
-            return "s:";
+            return "cstr";
         default:
-            return "Unknown";
+            throw std::runtime_error("cannot print a " +
+                                     dataTypeToString(type));
         }
     }
 
 private:
-    std::string inputFileName;
-    std::string outputFileName;
-    FILE *inputFile;
-    FILE *outputFile;
     ASTGen &astGen;
     Parser *parser;
+    Emitter &out;
     int indentationLevel;
+    // Set while GenIR writes an instrumented module; only read while the
+    // functions are generated in parallel.
+    const ProfileTables *profile = nullptr;
+    // The function being written.
+    const FunctionDeclaration *function = nullptr;
+    // Which calls writeOrdered must keep in order; set by GenIR and
+    // writeUnits for their writers.
+    const PurityAnalysis *effects = nullptr;
+    // Temporaries writeOrdered has named in this function.
+    int temporaries = 0;
+
+    // Declarations seen so far in the current function, parameters first.
+    std::vector<VariableDeclaration *> declarations;
+    std::unordered_map<std::string, std::string> restrictAliases;
 };
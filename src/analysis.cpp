@@ -0,0 +1,249 @@
+#include "analysis.hpp"
+
+std::vector<Expression *> statementExpressions(Instruction *instruction) {
+    std::vector<Expression *> expressions;
+    switch (instruction->type) {
+    case NodeType::VARIABLE_DECLARATION:
+        expressions.push_back(
+            dynamic_cast<VariableDeclaration *>(instruction)
+                ->initialization_value);
+        break;
+    case NodeType::VARIABLE_ASSIGNMENT: {
+        auto assign = dynamic_cast<VariableAssignment *>(instruction);
+        expressions.push_back(assign->element);
+        expressions.push_back(assign->newValue);
+        break;
+    }
+    case NodeType::EXPRESSION:
+        expressions.push_back(dynamic_cast<Expression *>(instruction));
+        break;
+    case NodeType::RETURN_STATEMENT:
+        expressions.push_back(
+            dynamic_cast<ReturnStatement *>(instruction)->returned_value);
+        break;
+    case NodeType::IF:
+        expressions.push_back(
+            dynamic_cast<IfStatement *>(instruction)->condition);
+        break;
+    case NodeType::WHILE:
+        expressions.push_back(
+            dynamic_cast<WhileStatement *>(instruction)->condition);
+        break;
+    case NodeType::FOR:
+        expressions.push_back(
+            dynamic_cast<ForStatement *>(instruction)->condition);
+        break;
+    case NodeType::PRINT_NODE:
+        expressions = dynamic_cast<PrintNode *>(instruction)->arguments2;
+        break;
+    default:
+        break;
+    }
+    expressions.erase(
+        std::remove(expressions.begin(), expressions.end(), nullptr),
+        expressions.end());
+    return expressions;
+}
+
+bool isIntegerLiteral(const Expression *expression, long long &value) {
+    if (!expression || expression->type != Expression::Type::LITERAL ||
+        expression->variable_type.category != DataType::Category::INT) {
+        return false;
+    }
+    try {
+        value = std::stoll(expression->literal_value);
+    } catch (std::exception &) {
+        return false;
+    }
+    return true;
+}
+
+bool isReferenceTo(const Expression *expression, const std::string &name) {
+    return expression &&
+           expression->type == Expression::Type::VARIABLE_REFERENCE &&
+           expression->variable_name == name;
+}
+
+void collectAssignedVariables(FunctionBody *body,
+                              std::unordered_set<std::string> &assigned) {
+    forEachInstruction(body, [&](Instruction *instruction) {
+        if (instruction->type == NodeType::VARIABLE_DECLARATION) {
+            assigned.insert(
+                dynamic_cast<VariableDeclaration *>(instruction)->name);
+        } else if (instruction->type == NodeType::VARIABLE_ASSIGNMENT) {
+            assigned.insert(dynamic_cast<VariableAssignment *>(instruction)
+                                ->variable->name);
+        }
+    });
+}
+
+static void collectCalls(const Expression *expression,
+                         std::vector<std::string> &called) {
+    if (!expression) {
+        return;
+    }
+    if (expression->type == Expression::Type::FUNCTION_CALL &&
+        std::find(called.begin(), called.end(), expression->function_name) ==
+            called.end()) {
+        called.push_back(expression->function_name);
+    }
+    collectCalls(expression->left_operand, called);
+    collectCalls(expression->right_operand, called);
+    for (auto argument : expression->arguments) {
+        collectCalls(argument, called);
+    }
+}
+
+std::vector<std::string> calledFunctions(FunctionBody *body) {
+    std::vector<std::string> called;
+    forEachExpression(body, [&](Expression *expression) {
+        collectCalls(expression, called);
+    });
+    return called;
+}
+
+// Purity starts optimistic and removes offenders until nothing changes, so
+// (mutually) recursive functions without side effects stay pure.
+// Speculatability starts pessimistic and only admits functions whose callees
+// are already known to be safe, so recursion is never speculated.
+void PurityAnalysis::run(ASTGen &ast) {
+    // Callers never get reuse out of `len` anyway: array operands are never
+    // value numbered or treated as loop invariant, since pushes through
+    // another reference can change them.
+    pureFunctions.insert("len");
+    speculatableFunctions.insert("len");
+
+    std::vector<FunctionDeclaration *> functions;
+    for (auto node : ast.nodes) {
+        if (node->type == NodeType::FUNCTION_DECLARATION) {
+            auto function = dynamic_cast<FunctionDeclaration *>(node);
+            functions.push_back(function);
+            pureFunctions.insert(function->name);
+        }
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto function : functions) {
+            if (isPure(function->name) && hasSideEffects(function->body)) {
+                pureFunctions.erase(function->name);
+                changed = true;
+            }
+        }
+    }
+
+    changed = true;
+    while (changed) {
+        changed = false;
+        for (auto function : functions) {
+            if (isPure(function->name) && !isSpeculatable(function->name) &&
+                isSpeculatable(function->body)) {
+                speculatableFunctions.insert(function->name);
+                changed = true;
+            }
+        }
+    }
+}
+
+bool PurityAnalysis::hasSideEffects(FunctionBody *body) const {
+    bool effects = false;
+    forEachInstruction(body, [&](Instruction *instruction) {
+        if (instruction->type == NodeType::PRINT_NODE) {
+            effects = true;
+        } else if (instruction->type == NodeType::VARIABLE_ASSIGNMENT) {
+            // Arrays are shared by reference, so any element store may be
+            // visible to the caller.
+            auto assign = dynamic_cast<VariableAssignment *>(instruction);
+            if (assign->variable->is_global || assign->element) {
+                effects = true;
+            }
+        }
+    });
+    forEachExpression(body, [&](Expression *expression) {
+        effects = effects || hasSideEffects(expression);
+    });
+    return effects;
+}
+
+bool PurityAnalysis::hasSideEffects(Expression *expression) const {
+    if (!expression) {
+        return false;
+    }
+    switch (expression->type) {
+    case Expression::Type::VARIABLE_REFERENCE:
+        // Reading a global makes the result depend on more than the
+        // arguments, which is just as bad for reuse as writing one.
+        return expression->is_global;
+    case Expression::Type::BINARY_OPERATION:
+        return hasSideEffects(expression->left_operand) ||
+               hasSideEffects(expression->right_operand);
+    case Expression::Type::INDEX:
+        return hasSideEffects(expression->left_operand) ||
+               hasSideEffects(expression->right_operand);
+    case Expression::Type::FUNCTION_CALL:
+        if (!isPure(expression->function_name)) {
+            return true;
+        }
+        for (auto argument : expression->arguments) {
+            if (hasSideEffects(argument)) {
+                return true;
+            }
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+bool PurityAnalysis::isSpeculatable(FunctionBody *body) const {
+    bool speculatable = true;
+    forEachInstruction(body, [&](Instruction *instruction) {
+        // Loops may not terminate.
+        if (instruction->type == NodeType::WHILE ||
+            instruction->type == NodeType::FOR) {
+            speculatable = false;
+        }
+    });
+    forEachExpression(body, [&](Expression *expression) {
+        speculatable = speculatable && isSpeculatable(expression);
+    });
+    return speculatable;
+}
+
+bool PurityAnalysis::isSpeculatable(Expression *expression) const {
+    if (!expression) {
+        return true;
+    }
+    switch (expression->type) {
+    case Expression::Type::BINARY_OPERATION: {
+        if (expression->operation == Operation::DIVIDE) {
+            const Expression *divisor = expression->right_operand;
+            bool constantDivisor =
+                divisor && divisor->type == Expression::Type::LITERAL &&
+                divisor->literal_value.find_first_not_of("0.") !=
+                    std::string::npos;
+            if (!constantDivisor) {
+                return false;
+            }
+        }
+        return isSpeculatable(expression->left_operand) &&
+               isSpeculatable(expression->right_operand);
+    }
+    case Expression::Type::INDEX:
+        // May fail its bounds check.
+        return false;
+    case Expression::Type::FUNCTION_CALL:
+        if (!isSpeculatable(expression->function_name)) {
+            return false;
+        }
+        for (auto argument : expression->arguments) {
+            if (!isSpeculatable(argument)) {
+                return false;
+            }
+        }
+        return true;
+    default:
+        return true;
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef ANALYSIS_HPP_
+#define ANALYSIS_HPP_
+
+#include "astGen.hpp"
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Expressions owned directly by a statement: initializers, assigned values,
+// conditions, returned values and println arguments. Nested blocks are not
+// included.
+std::vector<Expression *> statementExpressions(Instruction *instruction);
+
+// Calls `visit` on every statement in `body`, descending into if/else and
+// loop bodies. The init and step of a for loop are visited as statements.
+template <typename F> void forEachInstruction(FunctionBody *body, F &&visit) {
+    for (auto instruction : body->getInstructions()) {
+        visit(instruction);
+        switch (instruction->type) {
+        case NodeType::IF: {
+            auto if_ = dynamic_cast<IfStatement *>(instruction);
+            forEachInstruction(if_->ifBody, visit);
+            if (if_->elseBody) {
+                forEachInstruction(if_->elseBody, visit);
+            }
+            break;
+        }
+        case NodeType::ELSE:
+            forEachInstruction(
+                dynamic_cast<ElseStatement *>(instruction)->elseBody, visit);
+            break;
+        case NodeType::WHILE:
+            forEachInstruction(
+                dynamic_cast<WhileStatement *>(instruction)->body, visit);
+            break;
+        case NodeType::FOR: {
+            auto loop = dynamic_cast<ForStatement *>(instruction);
+            visit(loop->init);
+            visit(loop->step);
+            forEachInstruction(loop->body, visit);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+template <typename F> void forEachExpression(FunctionBody *body, F &&visit) {
+    forEachInstruction(body, [&](Instruction *instruction) {
+        for (auto expression : statementExpressions(instruction)) {
+            visit(expression);
+        }
+    });
+}
+
+bool isIntegerLiteral(const Expression *expression, long long &value);
+bool isReferenceTo(const Expression *expression, const std::string &name);
+
+// Names of variables declared or assigned anywhere inside `body`.
+void collectAssignedVariables(FunctionBody *body,
+                              std::unordered_set<std::string> &assigned);
+
+// Functions called anywhere inside `body`, builtins included, each listed
+// once in the order of its first call.
+std::vector<std::string> calledFunctions(FunctionBody *body);
+
+// Classifies functions as pure (no output, no globals, only pure callees)
+// and speculatable (pure, and also cannot trap or fail to terminate, so a
+// call may be evaluated even where the source would not have evaluated it).
+class PurityAnalysis {
+public:
+    void run(ASTGen &ast);
+
+    bool isPure(const std::string &functionName) const {
+        return pureFunctions.count(functionName) > 0;
+    }
+
+    bool isSpeculatable(const std::string &functionName) const {
+        return speculatableFunctions.count(functionName) > 0;
+    }
+
+    bool hasSideEffects(Expression *expression) const;
+    bool isSpeculatable(Expression *expression) const;
+
+private:
+    bool hasSideEffects(FunctionBody *body) const;
+    bool isSpeculatable(FunctionBody *body) const;
+
+    std::unordered_set<std::string> pureFunctions;
+    std::unordered_set<std::string> speculatableFunctions;
+};
+
+#endif // ANALYSIS_HPP_
@@ -0,0 +1,107 @@
+#ifndef ARENA_HPP_
+#define ARENA_HPP_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+// Owns the AST of one compilation. Nodes are carved out of large blocks and
+// destroyed together with the arena, so passes can unlink and replace nodes
+// without tracking who frees them, and a compilation never leaks its tree.
+class Arena {
+public:
+    Arena() = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    ~Arena() {
+        for (auto it = objects.rbegin(); it != objects.rend(); ++it) {
+            it->kind->destroy(it->object);
+        }
+    }
+
+    template <typename T, typename... Args> T *make(Args &&...args) {
+        static_assert(sizeof(T) <= blockSize &&
+                      alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+        T *object = new (allocate(sizeof(T), alignof(T)))
+            T(std::forward<Args>(args)...);
+        objects.push_back({object, &kindOf<T>});
+        return object;
+    }
+
+    // The number of objects made.
+    size_t size() const { return objects.size(); }
+
+    // How many objects of one type the arena holds, and their size.
+    struct Usage {
+        const std::type_info *type;
+        size_t count;
+        size_t bytes;
+    };
+
+    // The objects made, by type in order of first use.
+    std::vector<Usage> usage() const {
+        std::vector<Usage> result;
+        for (const auto &object : objects) {
+            auto it = std::find_if(result.begin(), result.end(),
+                                   [&](const Usage &usage) {
+                                       return *usage.type == *object.kind->type;
+                                   });
+            if (it == result.end()) {
+                result.push_back({object.kind->type, 0, 0});
+                it = result.end() - 1;
+            }
+            it->count++;
+            it->bytes += object.kind->size;
+        }
+        return result;
+    }
+
+    // The bytes of the blocks and of the list of objects to destroy.
+    size_t reservedBytes() const {
+        return blocks.size() * blockSize +
+               blocks.capacity() * sizeof(blocks[0]) +
+               objects.capacity() * sizeof(Object);
+    }
+
+private:
+    static constexpr size_t blockSize = 64 * 1024;
+
+    void *allocate(size_t size, size_t align) {
+        size_t offset = (used + align - 1) & ~(align - 1);
+        if (blocks.empty() || offset + size > blockSize) {
+            blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(
+                blockSize));
+            offset = 0;
+        }
+        used = offset + size;
+        return blocks.back().get() + offset;
+    }
+
+    // What the arena knows of a type; one static instance per type keeps
+    // each object's entry two pointers long.
+    struct Kind {
+        void (*destroy)(void *);
+        const std::type_info *type;
+        size_t size;
+    };
+
+    template <typename T>
+    static constexpr Kind kindOf = {
+        [](void *p) { static_cast<T *>(p)->~T(); }, &typeid(T), sizeof(T)};
+
+    struct Object {
+        void *object;
+        const Kind *kind;
+    };
+
+    std::vector<std::unique_ptr<std::byte[]>> blocks;
+    size_t used = 0;
+    std::vector<Object> objects;
+};
+
+#endif // ARENA_HPP_
@@ -1,4 +1,5 @@
 #include "ast.hpp"
+#include <cctype>
 
 std::string nodeTypeToString(NodeType type) {
     switch (type) {
@@ -24,6 +25,10 @@ std::string nodeTypeToString(NodeType type) {
         return "ElseStatement";
     case NodeType::PRINT_NODE:
         return "Print";
+    case NodeType::WHILE:
+        return "WhileStatement";
+    case NodeType::FOR:
+        return "ForStatement";
     default:
         return "Unknown";
     }
@@ -41,6 +46,9 @@ std::string dataTypeToString(DataType type) {
         return "CHAR";
     case DataType::Category::STRING:
         return "STRING";
+    case DataType::Category::ARRAY:
+        return dataTypeToString(type.elementType()) + "[" +
+               (type.isFixedArray() ? std::to_string(type.length) : "") + "]";
     default:
         return "Unknown";
     }
@@ -58,11 +66,26 @@ std::string dataTypeToCType(DataType type) {
         return "char";
     case DataType::Category::STRING:
         return "char*";
+    case DataType::Category::ARRAY:
+        return type.isFixedArray()
+                   ? dataTypeToCType(type.elementType()) + "*"
+                   : dataTypeToCArrayType(type.elementType()) + "*";
     default:
         return "Unknown";
     }
 }
 
+std::string dataTypeToCArrayType(DataType element) {
+    return "xrt_array_" + dataTypeToCArraySuffix(element);
+}
+
+std::string dataTypeToCArraySuffix(DataType element) {
+    std::string name = dataTypeToString(element);
+    std::transform(name.begin(), name.end(), name.begin(),
+                   [](unsigned char c) { return std::tolower(c); });
+    return name;
+}
+
 std::string operationToString(Operation op) {
     switch (op) {
     case Operation::ADD:
@@ -75,7 +98,78 @@ std::string operationToString(Operation op) {
         return "/";
     case Operation::EQUAL:
         return "==";
+    case Operation::NOT_EQUAL:
+        return "!=";
+    case Operation::LESS:
+        return "<";
+    case Operation::LESS_EQUAL:
+        return "<=";
+    case Operation::GREATER:
+        return ">";
+    case Operation::GREATER_EQUAL:
+        return ">=";
     default:
         return "Unknown";
     }
 }
+
+DataType operationResultType(Operation op, const Expression *left) {
+    if (operationPrecedence(op) <= 2) {
+        return DataType::Category::BOOL;
+    }
+    return left ? left->variable_type : DataType::Category::UNKNOWN;
+}
+
+int operationPrecedence(Operation op) {
+    switch (op) {
+    case Operation::MULTIPLY:
+    case Operation::DIVIDE:
+        return 4;
+    case Operation::ADD:
+    case Operation::SUBTRACT:
+        return 3;
+    case Operation::LESS:
+    case Operation::LESS_EQUAL:
+    case Operation::GREATER:
+    case Operation::GREATER_EQUAL:
+        return 2;
+    case Operation::EQUAL:
+    case Operation::NOT_EQUAL:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+void Expression::becomeReference(VariableDeclaration *declaration) {
+    type = Type::VARIABLE_REFERENCE;
+    variable_name = declaration->name;
+    this->declaration = declaration;
+    literal_value.clear();
+    function_name.clear();
+    left_operand = nullptr;
+    right_operand = nullptr;
+    arguments.clear();
+    variable_reference = nullptr;
+    is_global = false;
+}
+
+VariableDeclaration *Expression::hoistInto(Arena &arena,
+                                           const std::string &name) {
+    Expression *computed = nullptr;
+    if (type == Type::BINARY_OPERATION) {
+        computed = arena.make<Expression>(operation, left_operand,
+                                          right_operand);
+    } else if (type == Type::FUNCTION_CALL) {
+        computed =
+            arena.make<Expression>(function_name, arguments, variable_type);
+        arguments.clear();
+    } else {
+        computed = arena.make<Expression>(literal_value, variable_type);
+    }
+    computed->variable_type = variable_type;
+    auto declaration =
+        arena.make<VariableDeclaration>(name, variable_type, computed);
+    becomeReference(declaration);
+    return declaration;
+}
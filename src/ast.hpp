@@ -1,18 +1,47 @@
+#include "arena.hpp"
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <vector>
 
 struct DataType {
-    enum class Category { INT, FLOAT, BOOL, CHAR, STRING, UNKNOWN };
+    enum class Category { INT, FLOAT, BOOL, CHAR, STRING, ARRAY, UNKNOWN };
 
     Category category;
+    // For arrays: the element type, and the length of a fixed-size array or
+    // -1 for a growable one.
+    Category element = Category::UNKNOWN;
+    int length = -1;
 
     DataType() : category(Category::UNKNOWN) {}
     DataType(Category c) : category(c) {}
+
+    static DataType array(Category element, int length) {
+        DataType type(Category::ARRAY);
+        type.element = element;
+        type.length = length;
+        return type;
+    }
+
+    bool isArray() const { return category == Category::ARRAY; }
+    bool isFixedArray() const { return isArray() && length >= 0; }
+    DataType elementType() const { return DataType(element); }
 };
 
-enum class Operation { ADD, SUBTRACT, MULTIPLY, DIVIDE, EQUAL };
+enum class Operation {
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    EQUAL,
+    NOT_EQUAL,
+    LESS,
+    LESS_EQUAL,
+    GREATER,
+    GREATER_EQUAL
+};
 
 enum class NodeType {
     // Variables
@@ -29,17 +58,33 @@ enum class NodeType {
     // expressions
     EXPRESSION,
     IF,
-    ELSE
+    ELSE,
+    WHILE,
+    FOR
 };
 
 std::string nodeTypeToString(NodeType type);
 std::string dataTypeToString(DataType type);
 std::string operationToString(Operation op);
 std::string dataTypeToCType(DataType type);
+std::string dataTypeToCArrayType(DataType element);
+// Lowercase element name used in the runtime's per-type array helpers.
+std::string dataTypeToCArraySuffix(DataType element);
+DataType operationResultType(Operation op, const struct Expression *left);
+int operationPrecedence(Operation op);
+
+// Names the compiler makes up, for the temporaries of its passes and the
+// helpers of the C it writes, start with this. The lexer rejects user names
+// that do, so the two can never meet.
+inline const std::string reservedPrefix = "__";
 
 struct Instruction {
 public:
     NodeType type;
+    // Where the statement or function starts in the source, 1-based; 0 for
+    // nodes inside statements and for those the passes make.
+    int line = 0;
+    int column = 0;
     virtual ~Instruction() {}
 
     const auto getChildren() const { return children; }
@@ -58,7 +103,8 @@ struct Expression : public Instruction {
         VARIABLE_REFERENCE,
         VARIABLE_ASSIGNMENT,
         EQUAL_OPERATION,
-        PRINT
+        PRINT,
+        INDEX
     };
 
     Type type;
@@ -71,7 +117,8 @@ struct Expression : public Instruction {
     // Binary operation expression constructor
     Expression(Operation op, Expression *left, Expression *right)
         : Instruction(NodeType::EXPRESSION), type(Type::BINARY_OPERATION),
-          operation(op), left_operand(left), right_operand(right) {}
+          operation(op), left_operand(left), right_operand(right),
+          variable_type(operationResultType(op, left)) {}
 
     // Function call expression constructor
     Expression(const std::string &func_name, std::vector<Expression *> args,
@@ -108,6 +155,12 @@ struct Expression : public Instruction {
         : Instruction(NodeType::EXPRESSION), type(Type::PRINT),
           function_name(functionName_), arguments(args) {}
 
+    // Array element: left_operand is the array, right_operand the index
+    Expression(Expression *array, Expression *index, DataType elementType)
+        : Instruction(NodeType::EXPRESSION), type(Type::INDEX),
+          left_operand(array), right_operand(index),
+          variable_type(elementType) {}
+
     // bool expression
     Expression(bool value)
         : Instruction(NodeType::EXPRESSION), type(Type::LITERAL),
@@ -119,11 +172,26 @@ struct Expression : public Instruction {
     std::string old_value;
     DataType variable_type;
     Operation operation;
-    std::unique_ptr<Expression> left_operand;
-    std::unique_ptr<Expression> right_operand;
+    Expression *left_operand = nullptr;
+    Expression *right_operand = nullptr;
     std::string function_name;
     std::vector<Expression *> arguments;
     VariableReference *variable_reference = nullptr;
+    // The declaration a reference made by a pass reads; null for references
+    // from the source, which are resolved by name.
+    struct VariableDeclaration *declaration = nullptr;
+    bool is_global = false;
+    // INDEX only; cleared by BoundsCheckElimination when provably in range.
+    bool bounds_checked = true;
+
+    // Turns this node into a reference to `declaration`, dropping its
+    // operands.
+    void becomeReference(struct VariableDeclaration *declaration);
+    // Moves this node's computation into the initializer of a new
+    // declaration of `name` and turns this node into a reference to it.
+    // Returns the declaration, for the caller to insert.
+    struct VariableDeclaration *hoistInto(Arena &arena,
+                                          const std::string &name);
 };
 
 struct VariableDeclaration : public Instruction {
@@ -133,6 +201,7 @@ struct VariableDeclaration : public Instruction {
     Expression *oldValue;
     Expression *newValue;
     bool valueChanged;
+    bool is_global = false;
 
     VariableDeclaration(const std::string &n, DataType type, Expression *init)
         : Instruction(NodeType::VARIABLE_DECLARATION), name(n),
@@ -155,6 +224,12 @@ struct FunctionDeclaration : public Instruction {
     std::vector<VariableDeclaration *> parameters;
     DataType return_type;
     struct FunctionBody *body;
+    // Hash of the tokens the declaration was parsed from: the function's
+    // source with whitespace and comments normalized away (see --cache).
+    uint64_t tokenHash = 0;
+    // Hash of the lines those tokens are on, which its code also depends on
+    // when it has #line directives (see -g).
+    uint64_t lineHash = 0;
 
     FunctionDeclaration(const std::string &n,
                         const std::vector<VariableDeclaration *> &p, DataType r,
@@ -190,8 +265,21 @@ public:
         instructions.push_back(instruction);
     }
 
-    auto addReturnStatement(Expression *rv) {
-        auto ret = new ReturnStatement(rv);
+    // A new node without a location takes that of `position`, the
+    // statement it was split out of.
+    void insertInstructionBefore(Instruction *position,
+                                 Instruction *instruction) {
+        if (instruction->line == 0) {
+            instruction->line = position->line;
+            instruction->column = position->column;
+        }
+        auto it =
+            std::find(instructions.begin(), instructions.end(), position);
+        instructions.insert(it, instruction);
+    }
+
+    auto addReturnStatement(Arena &arena, Expression *rv) {
+        auto ret = arena.make<ReturnStatement>(rv);
         addInstruction(ret);
         return ret;
     }
@@ -209,6 +297,8 @@ struct VariableAssignment : public Instruction {
     VariableDeclaration *variable;
     Expression *oldValue;
     Expression *newValue;
+    // Set for `a[i] = value`: the INDEX expression being stored to.
+    Expression *element = nullptr;
 
     VariableAssignment(VariableDeclaration *var, Expression *oldVal,
                        Expression *newVal)
@@ -237,6 +327,38 @@ struct ElseStatement : public Instruction {
         : Instruction(NodeType::ELSE), elseBody(elseBody), ifBody(ifBody) {}
 };
 
+struct WhileStatement : public Instruction {
+    Expression *condition;
+    FunctionBody *body;
+    // Emit `#pragma GCC unroll` with this factor when non-zero.
+    int unrollHint = 0;
+    // Growable arrays whose data pointer may be loaded once before the loop
+    // into a `restrict` pointer; set by BoundsCheckElimination.
+    std::vector<std::string> restrictArrays;
+
+    WhileStatement(Expression *cond, FunctionBody *body)
+        : Instruction(NodeType::WHILE), condition(cond), body(body) {}
+};
+
+struct ForStatement : public Instruction {
+    VariableDeclaration *init;
+    Expression *condition;
+    VariableAssignment *step;
+    FunctionBody *body;
+
+    // Filled in by LoopOptimizer for counted loops.
+    long long tripCount = -1;
+    long long stepValue = 0;
+    int unrollFactor = 1;
+    int unrollHint = 0;
+    std::vector<std::string> restrictArrays;
+
+    ForStatement(VariableDeclaration *init, Expression *cond,
+                 VariableAssignment *step, FunctionBody *body)
+        : Instruction(NodeType::FOR), init(init), condition(cond), step(step),
+          body(body) {}
+};
+
 struct PrintNode : public Instruction {
     std::string function_name;
     std::vector<Expression *> arguments2;
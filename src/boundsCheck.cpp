@@ -0,0 +1,380 @@
+#include "boundsCheck.hpp"
+
+static bool isLenOf(const Expression *expression, std::string &array) {
+    if (!expression || expression->type != Expression::Type::FUNCTION_CALL ||
+        expression->function_name != "len" ||
+        expression->arguments.size() != 1 ||
+        expression->arguments[0]->type !=
+            Expression::Type::VARIABLE_REFERENCE) {
+        return false;
+    }
+    array = expression->arguments[0]->variable_name;
+    return true;
+}
+
+void BoundsCheckElimination::run() {
+    purity.run(ast);
+
+    for (auto node : ast.nodes) {
+        if (node->type != NodeType::FUNCTION_DECLARATION) {
+            continue;
+        }
+        auto function = dynamic_cast<FunctionDeclaration *>(node);
+        ranges.clear();
+        arrayParameters.clear();
+        assignedArrays.clear();
+        for (auto param : function->parameters) {
+            if (param->variable_type.isArray()) {
+                arrayParameters.insert(param->name);
+            }
+        }
+        forEachInstruction(function->body, [&](Instruction *instruction) {
+            auto assign = dynamic_cast<VariableAssignment *>(instruction);
+            if (assign && !assign->element &&
+                assign->variable->variable_type.isArray()) {
+                assignedArrays.insert(assign->variable->name);
+                if (assign->newValue) {
+                    assignedArrays.insert(assign->newValue->variable_name);
+                }
+            }
+        });
+        processBody(function->body);
+    }
+}
+
+void BoundsCheckElimination::processBody(FunctionBody *body) {
+    for (auto instruction : body->getInstructions()) {
+        switch (instruction->type) {
+        case NodeType::IF: {
+            auto if_ = dynamic_cast<IfStatement *>(instruction);
+            processExpression(if_->condition);
+            processBody(if_->ifBody);
+            if (if_->elseBody) {
+                processBody(if_->elseBody);
+            }
+            break;
+        }
+        case NodeType::ELSE:
+            processBody(dynamic_cast<ElseStatement *>(instruction)->elseBody);
+            break;
+        case NodeType::WHILE: {
+            auto loop = dynamic_cast<WhileStatement *>(instruction);
+            processExpression(loop->condition);
+            processBody(loop->body);
+            planRestrict(loop->body, {loop->condition}, loop->restrictArrays);
+            break;
+        }
+        case NodeType::FOR: {
+            auto loop = dynamic_cast<ForStatement *>(instruction);
+            const std::string &counter = loop->init->name;
+            processExpression(loop->init->initialization_value);
+
+            // The counter shadows any outer variable of the same name, so
+            // drop that range even when the loop itself is not counted.
+            auto saved = ranges;
+            ranges.erase(counter);
+            processExpression(loop->condition);
+            processExpression(loop->step->newValue);
+
+            Range range;
+            if (counterRange(loop, range)) {
+                ranges[counter] = range;
+            }
+            processBody(loop->body);
+            ranges = saved;
+
+            planRestrict(loop->body, {loop->condition, loop->step->newValue},
+                         loop->restrictArrays);
+            break;
+        }
+        default:
+            for (auto expression : statementExpressions(instruction)) {
+                processExpression(expression);
+            }
+            break;
+        }
+    }
+}
+
+void BoundsCheckElimination::processExpression(Expression *expression) {
+    if (!expression) {
+        return;
+    }
+    if (expression->type == Expression::Type::INDEX) {
+        const Expression *array = expression->left_operand;
+        const DataType &type = array->variable_type;
+        Range range;
+        bool inRange = false;
+        if (rangeOf(expression->right_operand, range) &&
+            range.low >= 0) {
+            if (type.isFixedArray()) {
+                inRange = range.lengthOf.empty() && range.high < type.length;
+            } else {
+                inRange = range.lengthOf == array->variable_name &&
+                          range.high <= -1;
+            }
+        }
+        if (inRange) {
+            expression->bounds_checked = false;
+            removedCount++;
+        } else {
+            remainingCount++;
+        }
+    }
+
+    processExpression(expression->left_operand);
+    processExpression(expression->right_operand);
+    for (auto argument : expression->arguments) {
+        processExpression(argument);
+    }
+}
+
+bool BoundsCheckElimination::rangeOf(const Expression *index,
+                                     Range &range) const {
+    long long value = 0;
+    if (index->type == Expression::Type::VARIABLE_REFERENCE) {
+        auto it = ranges.find(index->variable_name);
+        if (it == ranges.end()) {
+            return false;
+        }
+        range = it->second;
+        return true;
+    }
+    Bound bound;
+    if (boundOf(index, bound) && bound.lengthOf.empty()) {
+        range = {bound.value, bound.value, ""};
+        return true;
+    }
+    if (index->type != Expression::Type::BINARY_OPERATION) {
+        return false;
+    }
+
+    const Expression *left = index->left_operand;
+    const Expression *right = index->right_operand;
+    if (index->operation == Operation::ADD && isIntegerLiteral(left, value)) {
+        std::swap(left, right);
+    }
+    if (!isIntegerLiteral(right, value) || !rangeOf(left, range)) {
+        return false;
+    }
+    if (index->operation == Operation::ADD) {
+        range.low += value;
+        range.high += value;
+        return true;
+    }
+    if (index->operation == Operation::SUBTRACT) {
+        range.low -= value;
+        range.high -= value;
+        return true;
+    }
+    return false;
+}
+
+// A constant, `len(array)` or either plus or minus a constant. The length of
+// a fixed-size array folds to a constant.
+bool BoundsCheckElimination::boundOf(const Expression *expression,
+                                     Bound &bound) const {
+    std::string array;
+    if (isIntegerLiteral(expression, bound.value)) {
+        bound.lengthOf.clear();
+        return true;
+    }
+    if (isLenOf(expression, array)) {
+        const DataType &type = expression->arguments[0]->variable_type;
+        if (type.isFixedArray()) {
+            bound = {type.length, ""};
+        } else {
+            bound = {0, array};
+        }
+        return true;
+    }
+    long long value = 0;
+    if (expression->type != Expression::Type::BINARY_OPERATION ||
+        !isIntegerLiteral(expression->right_operand, value) ||
+        !boundOf(expression->left_operand, bound)) {
+        return false;
+    }
+    if (expression->operation == Operation::ADD) {
+        bound.value += value;
+        return true;
+    }
+    if (expression->operation == Operation::SUBTRACT) {
+        bound.value -= value;
+        return true;
+    }
+    return false;
+}
+
+// The values the counter of `loop` takes inside its body, for loops that
+// step a counter the body never assigns by a positive constant towards a
+// bound.
+bool BoundsCheckElimination::counterRange(ForStatement *loop,
+                                          Range &range) const {
+    const std::string &counter = loop->init->name;
+    Expression *condition = loop->condition;
+    Expression *increment = loop->step->newValue;
+    long long step = 0;
+    Bound start, end;
+
+    if (loop->step->variable->name != counter ||
+        !boundOf(loop->init->initialization_value, start) ||
+        condition->type != Expression::Type::BINARY_OPERATION ||
+        !isReferenceTo(condition->left_operand, counter) ||
+        !boundOf(condition->right_operand, end) ||
+        increment->type != Expression::Type::BINARY_OPERATION ||
+        !isReferenceTo(increment->left_operand, counter) ||
+        !isIntegerLiteral(increment->right_operand, step) || step <= 0) {
+        return false;
+    }
+
+    std::unordered_set<std::string> assigned;
+    collectAssignedVariables(loop->body, assigned);
+    if (assigned.count(counter)) {
+        return false;
+    }
+
+    Bound low, high;
+    if (increment->operation == Operation::ADD) {
+        low = start;
+        high = end;
+        if (condition->operation == Operation::LESS) {
+            high.value -= 1;
+        } else if (condition->operation != Operation::LESS_EQUAL) {
+            return false;
+        }
+    } else if (increment->operation == Operation::SUBTRACT) {
+        low = end;
+        high = start;
+        if (condition->operation == Operation::GREATER) {
+            low.value += 1;
+        } else if (condition->operation != Operation::GREATER_EQUAL) {
+            return false;
+        }
+    } else {
+        return false;
+    }
+
+    // Only the upper bound may be relative to a length; the lower one has to
+    // be proven non-negative.
+    if (!low.lengthOf.empty()) {
+        return false;
+    }
+    if (!high.lengthOf.empty() &&
+        !isStable(high.lengthOf, loop->body,
+                  {loop->condition, loop->step->newValue})) {
+        return false;
+    }
+    range = {low.value, high.value, high.lengthOf};
+    return true;
+}
+
+// Whether `array` keeps its length throughout the loop: it is not a global,
+// never assigned whole, not redeclared in the loop, and not handed to
+// anything but `len`.
+bool BoundsCheckElimination::isStable(
+    const std::string &array, FunctionBody *loopBody,
+    const std::vector<Expression *> &header) const {
+    if (assignedArrays.count(array)) {
+        return false;
+    }
+    bool stable = true;
+    auto check = [&](Expression *expression) {
+        std::vector<Expression *> work = {expression};
+        while (!work.empty() && stable) {
+            Expression *e = work.back();
+            work.pop_back();
+            if (!e) {
+                continue;
+            }
+            if (e->type == Expression::Type::VARIABLE_REFERENCE &&
+                e->variable_name == array && e->is_global) {
+                stable = false;
+            }
+            if (e->type == Expression::Type::FUNCTION_CALL &&
+                e->function_name != "len") {
+                for (auto argument : e->arguments) {
+                    if (isReferenceTo(argument, array)) {
+                        stable = false;
+                    }
+                }
+            }
+            work.push_back(e->left_operand);
+            work.push_back(e->right_operand);
+            work.insert(work.end(), e->arguments.begin(), e->arguments.end());
+        }
+    };
+
+    for (auto expression : header) {
+        check(expression);
+    }
+    forEachInstruction(loopBody, [&](Instruction *instruction) {
+        if (instruction->type == NodeType::VARIABLE_DECLARATION &&
+            dynamic_cast<VariableDeclaration *>(instruction)->name == array) {
+            stable = false;
+        }
+        for (auto expression : statementExpressions(instruction)) {
+            check(expression);
+        }
+    });
+    return stable;
+}
+
+// Growable arrays indexed in the loop whose data pointer cannot change and
+// cannot alias another array written through in the loop. Two parameters may
+// point at the same array, so at most one parameter array qualifies, and
+// only when the loop calls nothing that could reach it through a global.
+void BoundsCheckElimination::planRestrict(
+    FunctionBody *loopBody, const std::vector<Expression *> &header,
+    std::vector<std::string> &restrictArrays) const {
+    std::vector<std::string> candidates;
+    std::unordered_set<std::string> seen;
+    bool impureCall = false;
+
+    auto visit = [&](Expression *expression) {
+        std::vector<Expression *> work = {expression};
+        while (!work.empty()) {
+            Expression *e = work.back();
+            work.pop_back();
+            if (!e) {
+                continue;
+            }
+            if (e->type == Expression::Type::INDEX) {
+                const Expression *array = e->left_operand;
+                if (array->type == Expression::Type::VARIABLE_REFERENCE &&
+                    array->variable_type.isArray() &&
+                    !array->variable_type.isFixedArray() &&
+                    !array->is_global &&
+                    seen.insert(array->variable_name).second) {
+                    candidates.push_back(array->variable_name);
+                }
+            }
+            if (e->type == Expression::Type::FUNCTION_CALL &&
+                e->function_name != "len" && !purity.isPure(e->function_name)) {
+                impureCall = true;
+            }
+            work.push_back(e->left_operand);
+            work.push_back(e->right_operand);
+            work.insert(work.end(), e->arguments.begin(), e->arguments.end());
+        }
+    };
+    for (auto expression : header) {
+        visit(expression);
+    }
+    forEachExpression(loopBody, visit);
+
+    std::vector<std::string> locals, parameters;
+    for (const auto &array : candidates) {
+        if (!isStable(array, loopBody, header)) {
+            continue;
+        }
+        if (arrayParameters.count(array)) {
+            parameters.push_back(array);
+        } else {
+            locals.push_back(array);
+        }
+    }
+    restrictArrays = locals;
+    if (parameters.size() == 1 && !impureCall) {
+        restrictArrays.push_back(parameters.front());
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef BOUNDS_CHECK_HPP_
+#define BOUNDS_CHECK_HPP_
+
+#include "analysis.hpp"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// Removes array bounds checks that range analysis proves redundant.
+//
+// A counted for loop whose counter is not assigned in the body, such as
+// `for (let i: int = 0; i < len(v); i = i + 1)` or the decreasing form,
+// bounds the counter inside the body. Each bound is a constant or
+// `len(v)` plus a constant, provided `v` cannot be resized inside the loop.
+// Indexes of the form `i`, `i + k`, `i - k` and literals are checked against
+// those ranges, and accesses proven in range lose their check.
+//
+// The same "cannot be resized or aliased" facts decide which growable
+// arrays a loop may read through a hoisted `restrict` data pointer. An array
+// assigned whole (`a = b`) shares its elements with another name, so it is
+// never treated as stable.
+class BoundsCheckElimination {
+public:
+    BoundsCheckElimination(ASTGen &ast) : ast(ast) {}
+
+    void run();
+
+    size_t removed() const { return removedCount; }
+    size_t remaining() const { return remainingCount; }
+
+private:
+    // low <= value <= high, where high is relative to len(lengthOf) when
+    // lengthOf is set.
+    struct Range {
+        long long low = 0;
+        long long high = 0;
+        std::string lengthOf;
+    };
+
+    struct Bound {
+        long long value = 0;
+        std::string lengthOf;
+    };
+
+    void processBody(FunctionBody *body);
+    void processExpression(Expression *expression);
+    bool rangeOf(const Expression *index, Range &range) const;
+    bool boundOf(const Expression *expression, Bound &bound) const;
+    bool counterRange(ForStatement *loop, Range &range) const;
+    bool isStable(const std::string &array, FunctionBody *loopBody,
+                  const std::vector<Expression *> &header) const;
+    void planRestrict(FunctionBody *loopBody,
+                      const std::vector<Expression *> &header,
+                      std::vector<std::string> &restrictArrays) const;
+
+    ASTGen &ast;
+    PurityAnalysis purity;
+    std::unordered_map<std::string, Range> ranges;
+    std::unordered_set<std::string> arrayParameters;
+    // Arrays on either side of an `a = b` anywhere in the function, which
+    // may refer to the same array as another name.
+    std::unordered_set<std::string> assignedArrays;
+
+    size_t removedCount = 0;
+    size_t remainingCount = 0;
+};
+
+#endif // BOUNDS_CHECK_HPP_
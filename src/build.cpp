@@ -0,0 +1,319 @@
+#include "build.hpp"
+#include "emitter.hpp"
+#include "hash.hpp"
+#include "thelang.hpp"
+#include "timing.hpp"
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+struct Module {
+    std::string name;
+    std::string path;
+    std::string source;
+    // Indexes of the modules this one imports and of those importing it.
+    std::vector<size_t> imports;
+    std::vector<size_t> importers;
+    // Imports not built yet.
+    size_t waiting = 0;
+    std::string interface;
+    // Built or up to date; failed, or not built because an import failed.
+    bool done = false;
+    bool failed = false;
+};
+
+// Bump when the output for unchanged sources and options changes, so that
+// stamps written by an older compiler do not match.
+constexpr uint64_t buildVersion = 1;
+
+} // namespace
+
+// The modules `source` imports, in order of first import.
+static std::vector<std::string> importsOf(const Module &module) {
+    Lexer lexer(module.path, module.source);
+    // Without diagnostics, errors are dropped; the compilation proper
+    // reports them.
+    lexer.read();
+    lexer.lex();
+    lexer.tokenalize();
+    std::vector<std::string> names;
+    for (size_t i = 0; i + 1 < lexer.tokens.size(); ++i) {
+        if (lexer.tokens[i]->type == IMPORT &&
+            lexer.tokens[i + 1]->type == IDENTIFIER) {
+            names.push_back(lexer.tokens[i + 1]->value);
+        }
+    }
+    return names;
+}
+
+// Puts the modules in `order` with every module after its imports, and
+// throws if the imports form a cycle.
+static void sortModules(const std::vector<Module> &modules, size_t module,
+                        std::vector<int> &state, std::vector<size_t> &path,
+                        std::vector<size_t> &order) {
+    if (state[module] == 2) {
+        return;
+    }
+    path.push_back(module);
+    if (state[module] == 1) {
+        std::string cycle;
+        auto first = std::find(path.begin(), path.end(), module);
+        for (auto it = first; it != path.end(); ++it) {
+            cycle += (it == first ? "" : " -> ") + modules[*it].name;
+        }
+        throw std::runtime_error("import cycle: " + cycle);
+    }
+    state[module] = 1;
+    for (size_t imported : modules[module].imports) {
+        sortModules(modules, imported, state, path, order);
+    }
+    state[module] = 2;
+    path.pop_back();
+    order.push_back(module);
+}
+
+static std::string readIfExists(const std::filesystem::path &path) {
+    return std::filesystem::exists(path) ? readFile(path.string()) : "";
+}
+
+// Compiles `module` unless its stamp is current. Returns whether it was
+// compiled; throws std::runtime_error if it failed.
+static bool buildModule(const Options &options,
+                        const std::filesystem::path &directory,
+                        Module &module, bool root,
+                        const std::map<std::string, std::string> &interfaces,
+                        std::ostream &diagnostics) {
+    std::filesystem::path output = directory / outputName(options, module.name);
+    std::filesystem::path interfacePath = directory / (module.name + ".xi");
+    std::filesystem::path stampPath = directory / (module.name + ".stamp");
+
+    TimeScope scope(options.timeline, "build module", module.name);
+    Hasher key;
+    key.add(buildVersion);
+    key.add(module.source);
+    key.add(options.optimize ? "-O1" : "-O0");
+    key.add(options.boundsChecks ? "checked" : "unchecked");
+    key.add(options.debugLines ? "-g" : "");
+    key.add(options.instrument ? "--instrument" : "");
+    key.add(options.target);
+    key.add(options.emit);
+    key.add(options.cacheDirectory);
+    for (const auto &[name, interface] : interfaces) {
+        key.add(name);
+        key.add(interface);
+    }
+    std::string stamp = std::to_string(key.value()) + "\n";
+    if (readIfExists(stampPath) == stamp &&
+        std::filesystem::exists(output) &&
+        std::filesystem::exists(interfacePath)) {
+        module.interface = readFile(interfacePath.string());
+        return false;
+    }
+    std::filesystem::remove(stampPath);
+
+    std::ostringstream errors;
+    CompilationContext context(module.path, module.source, errors);
+    CompileOptions compileOptions;
+    compileOptions.optimize = options.optimize;
+    compileOptions.interfaces = interfaces;
+    compileOptions.timeline = options.timeline;
+    compileOptions.memory = options.memory;
+    ASTGen &ast = context.analyze(compileOptions);
+    if (context.diagnostics.errorCount() > 0) {
+        diagnostics << errors.str();
+        throw std::runtime_error("module " + module.name + " has errors");
+    }
+    if (!root) {
+        for (auto node : ast.nodes) {
+            if (node->type == NodeType::FUNCTION_DECLARATION &&
+                dynamic_cast<FunctionDeclaration *>(node)->name == "main") {
+                throw std::runtime_error(
+                    "only the root module may define main");
+            }
+        }
+    }
+    int status = 0;
+    std::string lines;
+    std::string text = generate(options, module.path, context, ast,
+                                diagnostics, status, &lines);
+    context.flushDiagnostics();
+    if (!errors.str().empty()) {
+        diagnostics << errors.str();
+        throw std::runtime_error("module " + module.name + " has errors");
+    }
+
+    TimeScope writing(options.timeline, "write output");
+    Emitter::writeFile(output.string(), text);
+    if (!lines.empty()) {
+        Emitter::writeFile(output.string() + ".lines", lines);
+    }
+    if (options.memory) {
+        options.memory->add("output", 1, text.capacity());
+    }
+    module.interface = moduleInterface(ast);
+    // Left alone when unchanged, for tools that watch it.
+    if (!std::filesystem::exists(interfacePath) ||
+        readFile(interfacePath.string()) != module.interface) {
+        Emitter::writeFile(interfacePath.string(), module.interface);
+    }
+    Emitter::writeFile(stampPath.string(), stamp);
+    return true;
+}
+
+// Finds every module of the program through the imports, starting from
+// the root, which comes first.
+static std::vector<Module> findModules(const std::string &rootFile,
+                                       Timeline *timeline) {
+    TimeScope scope(timeline, "find modules");
+    std::filesystem::path sourceDirectory =
+        std::filesystem::path(rootFile).parent_path();
+    std::vector<Module> modules(1);
+    modules[0].name = std::filesystem::path(rootFile).stem().string();
+    modules[0].path = rootFile;
+    std::map<std::string, size_t> byName = {{modules[0].name, 0}};
+    for (size_t i = 0; i < modules.size(); ++i) {
+        modules[i].source = readFile(modules[i].path);
+        for (const auto &name : importsOf(modules[i])) {
+            auto [found, added] = byName.emplace(name, modules.size());
+            if (added) {
+                std::filesystem::path file = sourceDirectory / (name + ".x");
+                if (!std::filesystem::exists(file)) {
+                    throw std::runtime_error(modules[i].path + " imports " +
+                                             name + ", but there is no " +
+                                             file.string());
+                }
+                modules.emplace_back();
+                modules.back().name = name;
+                modules.back().path = file.string();
+            }
+            size_t imported = found->second;
+            auto &imports = modules[i].imports;
+            if (std::find(imports.begin(), imports.end(), imported) ==
+                imports.end()) {
+                imports.push_back(imported);
+                modules[imported].importers.push_back(i);
+            }
+        }
+    }
+    return modules;
+}
+
+int buildModules(const Options &options, const std::string &rootFile,
+                 const std::string &outputDirectory, unsigned jobs,
+                 std::ostream &diagnostics) {
+    std::vector<Module> modules = findModules(rootFile, options.timeline);
+    std::vector<int> state(modules.size());
+    std::vector<size_t> path;
+    std::vector<size_t> order;
+    sortModules(modules, 0, state, path, order);
+    std::filesystem::create_directories(outputDirectory);
+
+    // Workers take modules whose imports are all built; finishing one may
+    // make its importers ready.
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<size_t> ready;
+    size_t remaining = modules.size();
+    size_t compiled = 0;
+    for (size_t i = 0; i < modules.size(); ++i) {
+        modules[i].waiting = modules[i].imports.size();
+        if (modules[i].waiting == 0) {
+            ready.push_back(i);
+        }
+    }
+    auto fail = [&](size_t i, auto &fail) -> void {
+        if (modules[i].done) {
+            return;
+        }
+        modules[i].done = true;
+        modules[i].failed = true;
+        remaining--;
+        for (size_t importer : modules[i].importers) {
+            fail(importer, fail);
+        }
+    };
+
+    auto work = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [&] { return !ready.empty() || remaining == 0; });
+            if (ready.empty()) {
+                return;
+            }
+            size_t i = ready.back();
+            ready.pop_back();
+            std::map<std::string, std::string> interfaces;
+            for (size_t imported : modules[i].imports) {
+                const Module &module = modules[imported];
+                interfaces[module.name] = module.interface;
+            }
+            lock.unlock();
+
+            std::ostringstream messages;
+            bool ok = true;
+            bool built = false;
+            try {
+                built = buildModule(options, outputDirectory, modules[i],
+                                    i == 0, interfaces, messages);
+            } catch (const std::runtime_error &error) {
+                messages << modules[i].path << ": error: " << error.what()
+                         << "\n";
+                ok = false;
+            }
+
+            lock.lock();
+            diagnostics << messages.str() << std::flush;
+            if (!ok) {
+                fail(i, fail);
+            } else {
+                compiled += built;
+                modules[i].done = true;
+                remaining--;
+                for (size_t importer : modules[i].importers) {
+                    if (--modules[importer].waiting == 0 &&
+                        !modules[importer].done) {
+                        ready.push_back(importer);
+                    }
+                }
+            }
+            wake.notify_all();
+        }
+    };
+
+    if (jobs == 0) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < std::min<size_t>(jobs, modules.size()); ++i) {
+        pool.emplace_back(work);
+    }
+    work();
+    for (auto &thread : pool) {
+        thread.join();
+    }
+
+    bool failed = false;
+    std::string outputs;
+    for (size_t i : order) {
+        failed = failed || modules[i].failed;
+        outputs += (std::filesystem::path(outputDirectory) /
+                    outputName(options, modules[i].name))
+                       .string() +
+                   "\n";
+    }
+    diagnostics << "build: compiled " << compiled << " of " << modules.size()
+                << " modules" << std::endl;
+    if (failed) {
+        return 1;
+    }
+    Emitter::writeFile((std::filesystem::path(outputDirectory) /
+                        (modules[0].name + ".modules"))
+                           .string(),
+                       outputs);
+    return 0;
+}
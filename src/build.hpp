@@ -0,0 +1,33 @@
+#ifndef BUILD_HPP_
+#define BUILD_HPP_
+
+#include "driver.hpp"
+#include <ostream>
+#include <string>
+
+// --build=DIR: separate compilation of a program split into modules.
+//
+// `import util;` in a module makes the functions of util.x, found beside
+// the root file, callable. The build starts from the root file, follows
+// its imports to every module of the program, and compiles each module to
+// an output of its own in DIR (util.c, util.s or util.o), along with its
+// interface, util.xi: the declarations of the functions it defines. A
+// module is compiled once the interfaces of its imports are known, so
+// modules that do not depend on each other are compiled in parallel, `jobs`
+// at a time.
+//
+// util.stamp records a hash of everything the module's output depends on:
+// its source, the options, and the interfaces it imports. A module whose
+// stamp still matches is not compiled again, so editing a function body
+// recompiles its module, but modules importing it only when its interface
+// changed. DIR/<root>.modules lists the outputs to link, imported modules
+// first:
+//     cc -I runtime $(cat DIR/main.modules) bin/libxrt.a
+//
+// Returns 1 if any module failed; a module that reported errors is not
+// stamped, and the modules importing it are not compiled.
+int buildModules(const Options &options, const std::string &rootFile,
+                 const std::string &outputDirectory, unsigned jobs,
+                 std::ostream &diagnostics);
+
+#endif // BUILD_HPP_
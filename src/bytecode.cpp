@@ -0,0 +1,564 @@
+#include "bytecode.hpp"
+#include "regAlloc.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+
+std::string opcodeToString(Opcode op) {
+    static const char *names[] = {
+#define BYTECODE_NAME(name) #name,
+        BYTECODE_OPCODES(BYTECODE_NAME)
+#undef BYTECODE_NAME
+    };
+    return names[static_cast<int>(op)];
+}
+
+namespace {
+
+bool fitsInt32(long long value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+Opcode jumpOpcode(Cond cond, bool immediate) {
+    switch (cond) {
+    case Cond::EQ:
+        return immediate ? Opcode::JEQI : Opcode::JEQ;
+    case Cond::NE:
+        return immediate ? Opcode::JNEI : Opcode::JNE;
+    case Cond::LT:
+        return immediate ? Opcode::JLTI : Opcode::JLT;
+    case Cond::LE:
+        return immediate ? Opcode::JLEI : Opcode::JLE;
+    case Cond::GT:
+        return immediate ? Opcode::JGTI : Opcode::JGT;
+    case Cond::GE:
+        return immediate ? Opcode::JGEI : Opcode::JGE;
+    }
+    return Opcode::JMP;
+}
+
+// The loop back-edge superinstruction for `cond`, if there is one.
+bool incrementJumpOpcode(Cond cond, bool immediate, Opcode &op) {
+    switch (cond) {
+    case Cond::LT:
+        op = immediate ? Opcode::ADDI_JLTI : Opcode::ADDI_JLT;
+        return true;
+    case Cond::LE:
+        op = immediate ? Opcode::ADDI_JLEI : Opcode::ADDI_JLE;
+        return true;
+    case Cond::GT:
+        op = immediate ? Opcode::ADDI_JGTI : Opcode::ADDI_JGT;
+        return true;
+    case Cond::GE:
+        op = immediate ? Opcode::ADDI_JGEI : Opcode::ADDI_JGE;
+        return true;
+    case Cond::NE:
+        op = immediate ? Opcode::ADDI_JNEI : Opcode::ADDI_JNE;
+        return true;
+    default:
+        return false;
+    }
+}
+
+class BytecodeCompiler {
+public:
+    explicit BytecodeCompiler(const LModule &module) : module(module) {}
+
+    BModule run();
+
+private:
+    void layoutData();
+    BFunction compileFunction(const LFunction &function);
+    void compile(const LInst &inst);
+    void compileCall(const LInst &inst);
+    // Superinstructions starting at instruction `i`; each returns how many
+    // LIR instructions it consumed, or 0.
+    size_t fuseIncrementJump(size_t i);
+    size_t fuseLoadAddStore(size_t i);
+    // Whether `u` and `v` are single definitions of the same address.
+    bool sameAddress(int u, int v) const;
+
+    // A register holding `operand`, loading an immediate into scratch.
+    int32_t reg(const LOperand &operand, int width = 4);
+    BInst &emit(Opcode op);
+
+    const LModule &module;
+    BModule out;
+    std::unordered_map<std::string, int> functionIndexes;
+    std::unordered_map<std::string, int64_t> stringOffsets;
+    std::unordered_map<std::string, int64_t> globalOffsets;
+
+    // Per function.
+    const LFunction *function = nullptr;
+    BFunction *current = nullptr;
+    std::vector<int64_t> frameOffsets;
+    std::vector<int> uses, defs, defInst;
+    int scratchBase = 0;
+    int scratchUsed = 0;
+};
+
+BModule BytecodeCompiler::run() {
+    for (size_t f = 0; f < module.functions.size(); ++f) {
+        functionIndexes[module.functions[f].name] = static_cast<int>(f);
+    }
+    layoutData();
+    for (const auto &function : module.functions) {
+        out.functions.push_back(compileFunction(function));
+    }
+    auto main = functionIndexes.find("main");
+    out.main = main != functionIndexes.end() ? main->second : -1;
+    return std::move(out);
+}
+
+void BytecodeCompiler::layoutData() {
+    for (const auto &[label, text] : module.strings) {
+        stringOffsets[label] = static_cast<int64_t>(out.rodata.size());
+        std::string bytes = unescapeString(text);
+        out.rodata.insert(out.rodata.end(), bytes.begin(), bytes.end());
+        out.rodata.push_back('\0');
+    }
+    for (const auto &global : module.globals) {
+        out.data.resize((out.data.size() + 7) & ~size_t(7), 0);
+        int64_t offset = static_cast<int64_t>(out.data.size());
+        globalOffsets[global.name] = offset;
+        if (!global.stringLabel.empty()) {
+            out.dataPointers.emplace_back(offset,
+                                          stringOffsets.at(global.stringLabel));
+            out.data.resize(out.data.size() + 8, 0);
+        } else if (global.size == 4) {
+            int32_t value = static_cast<int32_t>(global.value);
+            out.data.resize(out.data.size() + 4);
+            std::memcpy(&out.data[offset], &value, sizeof(value));
+        } else {
+            out.data.resize(out.data.size() + global.size, 0);
+        }
+    }
+}
+
+BFunction BytecodeCompiler::compileFunction(const LFunction &lir) {
+    BFunction result;
+    result.name = lir.name;
+    function = &lir;
+    current = &result;
+
+    int numVregs = static_cast<int>(lir.vregWidths.size());
+    scratchBase = numVregs;
+    // Arguments that are never read land in the first scratch register.
+    result.numRegisters = numVregs + 1;
+    result.paramRegisters.assign(lir.numParams, scratchBase);
+
+    frameOffsets.clear();
+    for (int size : lir.frameObjects) {
+        frameOffsets.push_back(result.frameSize);
+        result.frameSize += (size + 7) & ~7;
+    }
+
+    uses.assign(numVregs, 0);
+    defs.assign(numVregs, 0);
+    defInst.assign(numVregs, -1);
+    std::vector<int> operands;
+    for (size_t i = 0; i < lir.instructions.size(); ++i) {
+        lirUses(lir.instructions[i], operands);
+        for (int vreg : operands) {
+            uses[vreg]++;
+        }
+        int dst = lirDef(lir.instructions[i]);
+        if (dst >= 0) {
+            defs[dst]++;
+            defInst[dst] = static_cast<int>(i);
+        }
+    }
+
+    std::vector<int32_t> labels(lir.numLabels, -1);
+    for (size_t i = 0; i < lir.instructions.size();) {
+        scratchUsed = 0;
+        const LInst &inst = lir.instructions[i];
+        if (inst.op == LOp::LABEL) {
+            labels[inst.label] = static_cast<int32_t>(result.code.size());
+            ++i;
+            continue;
+        }
+        size_t consumed = fuseIncrementJump(i);
+        if (!consumed) {
+            consumed = fuseLoadAddStore(i);
+        }
+        if (!consumed) {
+            compile(inst);
+            consumed = 1;
+        }
+        i += consumed;
+    }
+    // Branches hold LIR labels until every label has a position.
+    for (auto &inst : result.code) {
+        if (inst.target >= 0) {
+            inst.target = labels[inst.target];
+        }
+    }
+    // Falling off the end returns 0, as the native backend's main does.
+    emit(Opcode::RETI).k = 0;
+    return result;
+}
+
+int32_t BytecodeCompiler::reg(const LOperand &operand, int width) {
+    if (operand.isReg()) {
+        return operand.vreg;
+    }
+    int32_t scratch = scratchBase + scratchUsed++;
+    if (scratch >= current->numRegisters) {
+        current->numRegisters = scratch + 1;
+    }
+    BInst &load = emit(Opcode::LOADI);
+    load.a = scratch;
+    load.k = width == 4 ? static_cast<int32_t>(operand.imm) : operand.imm;
+    return scratch;
+}
+
+BInst &BytecodeCompiler::emit(Opcode op) {
+    current->code.emplace_back();
+    current->code.back().op = op;
+    return current->code.back();
+}
+
+void BytecodeCompiler::compile(const LInst &inst) {
+    switch (inst.op) {
+    case LOp::CONST: {
+        BInst &load = emit(Opcode::LOADI);
+        load.a = inst.dst;
+        load.k = inst.width == 4 ? static_cast<int32_t>(inst.a.imm)
+                                 : inst.a.imm;
+        break;
+    }
+    case LOp::MOV:
+        if (inst.a.isImm()) {
+            BInst &load = emit(Opcode::LOADI);
+            load.a = inst.dst;
+            load.k = inst.width == 4 ? static_cast<int32_t>(inst.a.imm)
+                                     : inst.a.imm;
+        } else {
+            BInst &move = emit(Opcode::MOV);
+            move.a = inst.dst;
+            move.b = inst.a.vreg;
+        }
+        break;
+    case LOp::ADDR: {
+        BInst &load = emit(Opcode::LOADA);
+        load.a = inst.dst;
+        auto string = stringOffsets.find(inst.symbol);
+        if (string != stringOffsets.end()) {
+            load.b = SEGMENT_RODATA;
+            load.k = string->second;
+        } else {
+            auto global = globalOffsets.find(inst.symbol);
+            if (global == globalOffsets.end()) {
+                throw std::runtime_error("address of unknown symbol '" +
+                                         inst.symbol + "'");
+            }
+            load.b = SEGMENT_DATA;
+            load.k = global->second;
+        }
+        break;
+    }
+    case LOp::FRAME: {
+        BInst &frame = emit(Opcode::FRAME);
+        frame.a = inst.dst;
+        frame.k = frameOffsets[inst.disp];
+        break;
+    }
+    case LOp::BIN: {
+        if (inst.width != 4) {
+            throw std::runtime_error(
+                "the interpreter only supports 32-bit arithmetic");
+        }
+        Opcode reg, imm;
+        switch (inst.operation) {
+        case Operation::ADD:
+            reg = Opcode::ADD, imm = Opcode::ADDI;
+            break;
+        case Operation::SUBTRACT:
+            reg = Opcode::SUB, imm = Opcode::SUBI;
+            break;
+        case Operation::MULTIPLY:
+            reg = Opcode::MUL, imm = Opcode::MULI;
+            break;
+        case Operation::DIVIDE:
+            reg = Opcode::DIV, imm = Opcode::DIVI;
+            break;
+        default:
+            throw std::runtime_error("unsupported binary operation " +
+                                     operationToString(inst.operation));
+        }
+        int32_t left = this->reg(inst.a);
+        BInst &bin = emit(inst.b.isImm() ? imm : reg);
+        bin.a = inst.dst;
+        bin.b = left;
+        if (inst.b.isImm()) {
+            bin.k = static_cast<int32_t>(inst.b.imm);
+        } else {
+            bin.c = inst.b.vreg;
+        }
+        break;
+    }
+    case LOp::CMP: {
+        int32_t left = reg(inst.a, inst.width);
+        BInst &cmp = emit(inst.b.isImm() ? Opcode::CMPI : Opcode::CMP);
+        cmp.a = inst.dst;
+        cmp.b = left;
+        cmp.cond = inst.cond;
+        if (inst.b.isImm()) {
+            cmp.k = inst.b.imm;
+        } else {
+            cmp.c = inst.b.vreg;
+        }
+        break;
+    }
+    case LOp::LOAD: {
+        int32_t base = reg(inst.a, 8);
+        bool indexed = inst.b.isReg();
+        BInst &load = emit(indexed ? (inst.width == 4 ? Opcode::LOADX32
+                                                      : Opcode::LOADX64)
+                                   : (inst.width == 4 ? Opcode::LOAD32
+                                                      : Opcode::LOAD64));
+        load.a = inst.dst;
+        load.b = base;
+        load.c = indexed ? inst.b.vreg : 0;
+        load.k = inst.disp;
+        break;
+    }
+    case LOp::STORE: {
+        int32_t base = reg(inst.a, 8);
+        int32_t value = reg(inst.c, inst.width);
+        bool indexed = inst.b.isReg();
+        BInst &store = emit(indexed ? (inst.width == 4 ? Opcode::STOREX32
+                                                       : Opcode::STOREX64)
+                                    : (inst.width == 4 ? Opcode::STORE32
+                                                       : Opcode::STORE64));
+        store.a = value;
+        store.b = base;
+        store.c = indexed ? inst.b.vreg : 0;
+        store.k = inst.disp;
+        break;
+    }
+    case LOp::CALL:
+        compileCall(inst);
+        break;
+    case LOp::PARAM:
+        current->paramRegisters[inst.disp] = inst.dst;
+        break;
+    case LOp::JMP:
+        emit(Opcode::JMP).target = inst.label;
+        break;
+    case LOp::JCC: {
+        int32_t left = reg(inst.a, inst.width);
+        BInst &jump = emit(jumpOpcode(inst.cond, inst.b.isImm()));
+        jump.a = left;
+        jump.target = inst.label;
+        if (inst.b.isImm()) {
+            jump.k = inst.b.imm;
+        } else {
+            jump.b = inst.b.vreg;
+        }
+        break;
+    }
+    case LOp::LABEL:
+        break;
+    case LOp::RET:
+        if (inst.a.isReg()) {
+            emit(Opcode::RET).a = inst.a.vreg;
+        } else {
+            emit(Opcode::RETI).k = inst.a.isImm() ? inst.a.imm : 0;
+        }
+        break;
+    case LOp::CHECK: {
+        int32_t index = reg(inst.a);
+        BInst &check = emit(inst.b.isImm() ? Opcode::CHECKI : Opcode::CHECK);
+        check.a = index;
+        if (inst.b.isImm()) {
+            check.k = inst.b.imm;
+        } else {
+            check.b = inst.b.vreg;
+        }
+        break;
+    }
+    }
+}
+
+// Runtime calls become instructions; println in particular never leaves
+// the interpreter loop.
+void BytecodeCompiler::compileCall(const LInst &inst) {
+    static const std::unordered_map<std::string, Opcode> builtins = {
+        {"xrt_print_int", Opcode::PRINT_INT},
+        {"xrt_print_bool", Opcode::PRINT_BOOL},
+        {"xrt_print_char", Opcode::PRINT_CHAR},
+        {"xrt_print_cstr", Opcode::PRINT_STR},
+        {"xrt_print_newline", Opcode::PRINT_NEWLINE},
+        {"xrt_push", Opcode::PUSH},
+    };
+    auto builtin = builtins.find(inst.symbol);
+    if (builtin != builtins.end()) {
+        std::vector<int32_t> args;
+        for (const auto &argument : inst.args) {
+            args.push_back(reg(argument, 8));
+        }
+        BInst &call = emit(builtin->second);
+        call.a = args.size() > 0 ? args[0] : 0;
+        call.b = args.size() > 1 ? args[1] : 0;
+        return;
+    }
+
+    auto callee = functionIndexes.find(inst.symbol);
+    if (callee == functionIndexes.end()) {
+        throw std::runtime_error("call to unknown function " + inst.symbol);
+    }
+    std::vector<int32_t> args;
+    for (const auto &argument : inst.args) {
+        args.push_back(reg(argument));
+    }
+    BInst &call = emit(Opcode::CALL);
+    call.a = callee->second;
+    call.b = inst.dst;
+    call.c = static_cast<int32_t>(current->callArgs.size());
+    call.k = static_cast<int64_t>(args.size());
+    current->callArgs.insert(current->callArgs.end(), args.begin(),
+                             args.end());
+}
+
+// i = i + k immediately followed by a branch on i.
+size_t BytecodeCompiler::fuseIncrementJump(size_t i) {
+    const auto &code = function->instructions;
+    if (i + 1 >= code.size()) {
+        return 0;
+    }
+    const LInst &bin = code[i];
+    const LInst &jump = code[i + 1];
+    if (bin.op != LOp::BIN || bin.width != 4 || !bin.a.isReg() ||
+        bin.a.vreg != bin.dst || !bin.b.isImm() ||
+        (bin.operation != Operation::ADD &&
+         bin.operation != Operation::SUBTRACT)) {
+        return 0;
+    }
+    if (jump.op != LOp::JCC || !jump.a.isReg() || jump.a.vreg != bin.dst ||
+        (jump.b.isImm() && !fitsInt32(jump.b.imm))) {
+        return 0;
+    }
+    long long step =
+        bin.operation == Operation::ADD ? bin.b.imm : -bin.b.imm;
+    Opcode op;
+    if (!fitsInt32(step) ||
+        !incrementJumpOpcode(jump.cond, jump.b.isImm(), op)) {
+        return 0;
+    }
+    BInst &fused = emit(op);
+    fused.a = bin.dst;
+    fused.k = static_cast<int32_t>(step);
+    if (jump.b.isImm()) {
+        fused.b = static_cast<int32_t>(jump.b.imm);
+    } else {
+        fused.b = jump.b.vreg;
+    }
+    fused.target = jump.label;
+    return 2;
+}
+
+bool BytecodeCompiler::sameAddress(int u, int v) const {
+    if (u == v) {
+        return true;
+    }
+    if (defs[u] != 1 || defs[v] != 1) {
+        return false;
+    }
+    const LInst &a = function->instructions[defInst[u]];
+    const LInst &b = function->instructions[defInst[v]];
+    if (a.op != b.op) {
+        return false;
+    }
+    return (a.op == LOp::FRAME && a.disp == b.disp) ||
+           (a.op == LOp::ADDR && a.symbol == b.symbol);
+}
+
+// t = [m]; t2 = t + x; [m] = t2, where nothing else reads t or t2. The
+// store may recompute the address of m first.
+size_t BytecodeCompiler::fuseLoadAddStore(size_t i) {
+    const auto &code = function->instructions;
+    if (i + 2 >= code.size()) {
+        return 0;
+    }
+    const LInst &load = code[i];
+    const LInst &bin = code[i + 1];
+    if (load.op != LOp::LOAD || load.width != 4 || !load.a.isReg() ||
+        uses[load.dst] != 1) {
+        return 0;
+    }
+    if (bin.op != LOp::BIN || bin.width != 4 || uses[bin.dst] != 1) {
+        return 0;
+    }
+    LOperand addend;
+    if (bin.operation == Operation::ADD && bin.a.isReg() &&
+        bin.a.vreg == load.dst) {
+        addend = bin.b;
+    } else if (bin.operation == Operation::ADD && bin.b.isReg() &&
+               bin.b.vreg == load.dst) {
+        addend = bin.a;
+    } else if (bin.operation == Operation::SUBTRACT && bin.a.isReg() &&
+               bin.a.vreg == load.dst && bin.b.isImm()) {
+        addend = LOperand::constant(-bin.b.imm);
+    } else {
+        return 0;
+    }
+    if (addend.isImm() && !fitsInt32(addend.imm)) {
+        return 0;
+    }
+
+    // Skip address computations only the store uses.
+    size_t j = i + 2;
+    while (j < code.size() &&
+           (code[j].op == LOp::FRAME || code[j].op == LOp::ADDR) &&
+           uses[code[j].dst] == 1) {
+        ++j;
+    }
+    if (j >= code.size()) {
+        return 0;
+    }
+    const LInst &store = code[j];
+    if (store.op != LOp::STORE || store.width != 4 || !store.c.isReg() ||
+        store.c.vreg != bin.dst || store.disp != load.disp ||
+        !store.a.isReg() || !sameAddress(load.a.vreg, store.a.vreg)) {
+        return 0;
+    }
+    bool indexed = load.b.isReg();
+    if (indexed != store.b.isReg() ||
+        (indexed && load.b.vreg != store.b.vreg)) {
+        return 0;
+    }
+    Opcode op = indexed ? (addend.isImm() ? Opcode::ADDXMI : Opcode::ADDXM)
+                        : (addend.isImm() ? Opcode::ADDMI : Opcode::ADDM);
+    BInst &fused = emit(op);
+    fused.a = addend.isImm() ? static_cast<int32_t>(addend.imm) : addend.vreg;
+    fused.b = load.a.vreg;
+    fused.c = indexed ? load.b.vreg : 0;
+    fused.k = load.disp;
+    return j - i + 1;
+}
+
+} // namespace
+
+BModule compileBytecode(const LModule &module) {
+    return BytecodeCompiler(module).run();
+}
+
+std::string bytecodeToString(const BFunction &function) {
+    std::string out = function.name + ":\n";
+    for (size_t i = 0; i < function.code.size(); ++i) {
+        const BInst &inst = function.code[i];
+        out += "  " + std::to_string(i) + ": " + opcodeToString(inst.op);
+        out += " a=" + std::to_string(inst.a) + " b=" + std::to_string(inst.b) +
+               " c=" + std::to_string(inst.c) + " k=" + std::to_string(inst.k);
+        if (inst.op == Opcode::CMP || inst.op == Opcode::CMPI) {
+            out += " " + condToString(inst.cond);
+        }
+        if (inst.target >= 0) {
+            out += " -> " + std::to_string(inst.target);
+        }
+        out += "\n";
+    }
+    return out;
+}
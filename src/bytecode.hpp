@@ -0,0 +1,135 @@
+#ifndef BYTECODE_HPP_
+#define BYTECODE_HPP_
+
+#include "lir.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A register bytecode for the interpreter (--vm), compiled from LIR.
+//
+// Every LIR virtual register gets a 64-bit slot in the function's register
+// window; 4-byte values are kept sign-extended. Operand fields follow one
+// convention: `a` is the destination (or the value read by stores, prints
+// and branches), `b` and `c` are sources, `k` is an immediate or a
+// displacement, and `target` is a branch target in the same function.
+// Opcodes ending in I take their last operand as an immediate: in `k`, or
+// when `k` already holds a displacement or increment, in the field the
+// register would have used.
+//
+// Superinstructions cover the common sequences:
+//   ADDI_Jcc   a += k, then branch if a cc b (a loop back edge)
+//   ADDM       [b + c * 8 + k] += a (a load-add-store on one element)
+// LIR's JCC is already a fused compare-and-branch, so it maps to a single
+// Jcc instruction.
+#define BYTECODE_OPCODES(X)                                                    \
+    X(MOV)                                                                     \
+    X(LOADI)                                                                   \
+    X(LOADA)                                                                   \
+    X(FRAME)                                                                   \
+    X(ADD)                                                                     \
+    X(ADDI)                                                                    \
+    X(SUB)                                                                     \
+    X(SUBI)                                                                    \
+    X(MUL)                                                                     \
+    X(MULI)                                                                    \
+    X(DIV)                                                                     \
+    X(DIVI)                                                                    \
+    X(CMP)                                                                     \
+    X(CMPI)                                                                    \
+    X(LOAD32)                                                                  \
+    X(LOAD64)                                                                  \
+    X(LOADX32)                                                                 \
+    X(LOADX64)                                                                 \
+    X(STORE32)                                                                 \
+    X(STORE64)                                                                 \
+    X(STOREX32)                                                                \
+    X(STOREX64)                                                                \
+    X(JMP)                                                                     \
+    X(JEQ)                                                                     \
+    X(JNE)                                                                     \
+    X(JLT)                                                                     \
+    X(JLE)                                                                     \
+    X(JGT)                                                                     \
+    X(JGE)                                                                     \
+    X(JEQI)                                                                    \
+    X(JNEI)                                                                    \
+    X(JLTI)                                                                    \
+    X(JLEI)                                                                    \
+    X(JGTI)                                                                    \
+    X(JGEI)                                                                    \
+    X(CALL)                                                                    \
+    X(RET)                                                                     \
+    X(RETI)                                                                    \
+    X(CHECK)                                                                   \
+    X(CHECKI)                                                                  \
+    X(PRINT_INT)                                                               \
+    X(PRINT_BOOL)                                                              \
+    X(PRINT_CHAR)                                                              \
+    X(PRINT_STR)                                                               \
+    X(PRINT_NEWLINE)                                                           \
+    X(PUSH)                                                                    \
+    X(ADDI_JLT)                                                                \
+    X(ADDI_JLE)                                                                \
+    X(ADDI_JGT)                                                                \
+    X(ADDI_JGE)                                                                \
+    X(ADDI_JNE)                                                                \
+    X(ADDI_JLTI)                                                               \
+    X(ADDI_JLEI)                                                               \
+    X(ADDI_JGTI)                                                               \
+    X(ADDI_JGEI)                                                               \
+    X(ADDI_JNEI)                                                               \
+    X(ADDM)                                                                    \
+    X(ADDMI)                                                                   \
+    X(ADDXM)                                                                   \
+    X(ADDXMI)
+
+enum class Opcode : uint8_t {
+#define BYTECODE_ENUM(name) name,
+    BYTECODE_OPCODES(BYTECODE_ENUM)
+#undef BYTECODE_ENUM
+};
+
+std::string opcodeToString(Opcode op);
+
+struct BInst {
+    Opcode op;
+    // CMP and CMPI only.
+    Cond cond = Cond::EQ;
+    int32_t a = 0, b = 0, c = 0;
+    int32_t target = -1;
+    int64_t k = 0;
+};
+
+// LOADA's `b`: which of the module's buffers `k` is an offset into.
+enum : int32_t { SEGMENT_RODATA = 0, SEGMENT_DATA = 1 };
+
+struct BFunction {
+    std::string name;
+    std::vector<BInst> code;
+    int numRegisters = 0;
+    // Register receiving each incoming argument.
+    std::vector<int32_t> paramRegisters;
+    // Bytes of frame objects, which FRAME addresses by offset.
+    int64_t frameSize = 0;
+    // Argument registers of every CALL, which refers to them by position.
+    std::vector<int32_t> callArgs;
+};
+
+struct BModule {
+    std::vector<BFunction> functions;
+    int main = -1;
+    // String literals, NUL-terminated, and the initial global variables.
+    std::vector<char> rodata;
+    std::vector<uint8_t> data;
+    // Offsets of `data` slots that hold a pointer to a string, and the
+    // string's offset in `rodata`.
+    std::vector<std::pair<int64_t, int64_t>> dataPointers;
+};
+
+// Throws std::runtime_error for calls to unknown symbols.
+BModule compileBytecode(const LModule &module);
+
+std::string bytecodeToString(const BFunction &function);
+
+#endif // BYTECODE_HPP_
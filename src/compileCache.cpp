@@ -0,0 +1,45 @@
+#include "compileCache.hpp"
+#include "emitter.hpp"
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+
+CompileCache::CompileCache(std::string directory)
+    : directory(std::move(directory)) {
+    std::error_code error;
+    std::filesystem::create_directories(this->directory, error);
+    if (error) {
+        throw std::runtime_error("cannot create " + this->directory + ": " +
+                                 error.message());
+    }
+}
+
+std::string CompileCache::path(uint64_t key) const {
+    static const char digits[] = "0123456789abcdef";
+    std::string name(16, '0');
+    for (int i = 15; i >= 0; --i, key >>= 4) {
+        name[i] = digits[key & 15];
+    }
+    return directory + "/" + name + ".c";
+}
+
+bool CompileCache::contains(uint64_t key) const {
+    return std::filesystem::exists(path(key));
+}
+
+void CompileCache::store(uint64_t key, std::string_view text) {
+    std::string final = path(key);
+    // Unique to this process and thread, since batch mode may store the
+    // same unit from two files at once.
+    size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    std::string temporary = final + "." + std::to_string(getpid()) + "." +
+                            std::to_string(thread) + ".tmp";
+    Emitter::writeFile(temporary, text);
+    std::error_code error;
+    std::filesystem::rename(temporary, final, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        throw std::runtime_error("cannot write " + final);
+    }
+}
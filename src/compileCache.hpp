@@ -0,0 +1,36 @@
+#ifndef COMPILE_CACHE_HPP_
+#define COMPILE_CACHE_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// The directory behind --cache. The C backend writes each function as its
+// own translation unit named by a hash of everything its text depends on,
+// so a unit that exists is up to date: an edit produces a new unit instead
+// of changing an old one, and object files built next to the units stay
+// valid for as long as their unit does. Stale units are never removed.
+class CompileCache {
+public:
+    // Creates `directory` if needed; throws std::runtime_error on failure.
+    explicit CompileCache(std::string directory);
+
+    // Where the unit for `key` lives.
+    std::string path(uint64_t key) const;
+
+    bool contains(uint64_t key) const;
+
+    // Writes the unit for `key` through a temporary file, so a build that
+    // is interrupted or runs concurrently never sees a partial unit.
+    void store(uint64_t key, std::string_view text);
+
+    // Units found in the cache and units written by this run.
+    std::atomic<size_t> reused = 0;
+    std::atomic<size_t> written = 0;
+
+private:
+    std::string directory;
+};
+
+#endif // COMPILE_CACHE_HPP_
@@ -0,0 +1,44 @@
+#include "diagnostics.hpp"
+#include "emitter.hpp"
+
+void Diagnostics::error(std::string file, int line, int column,
+                        std::string message, std::string text) {
+    // A mismatch checked by `expect` and again by `consume` is one error.
+    if (!diagnostics.empty()) {
+        const Diagnostic &last = diagnostics.back();
+        if (last.line == line && last.column == column &&
+            last.message == message && last.file == file) {
+            return;
+        }
+    }
+    diagnostics.push_back({std::move(file), line, column, std::move(message),
+                           std::move(text)});
+    errors++;
+}
+
+void Diagnostics::flush(std::ostream &out) {
+    if (diagnostics.empty()) {
+        return;
+    }
+    std::string buffer;
+    Emitter text(buffer);
+    for (const auto &diagnostic : diagnostics) {
+        text.write(diagnostic.file);
+        if (diagnostic.line > 0) {
+            text.write(':', diagnostic.line, ':', diagnostic.column);
+        }
+        text.write(": error: ", diagnostic.message, '\n');
+        if (!diagnostic.text.empty()) {
+            text.write("    ", diagnostic.text, "\n    ");
+            // Tabs are kept so the caret lines up under them.
+            for (int i = 0; i + 1 < diagnostic.column &&
+                            i < static_cast<int>(diagnostic.text.size());
+                 ++i) {
+                text.write(diagnostic.text[i] == '\t' ? '\t' : ' ');
+            }
+            text.write("^\n");
+        }
+    }
+    out << buffer << std::flush;
+    diagnostics.clear();
+}
@@ -0,0 +1,48 @@
+#ifndef DIAGNOSTICS_HPP_
+#define DIAGNOSTICS_HPP_
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Errors found while compiling, collected with where they are in the
+// source. The lexer and parser only record them; the compilation writes
+// them out together once it is done, so compiling a correct program does no
+// I/O at all.
+
+struct Diagnostic {
+    std::string file;
+    // 1-based; 0 for an error not tied to a place in the source.
+    int line = 0;
+    int column = 0;
+    std::string message;
+    // The source line, shown under the message with a caret at `column`.
+    std::string text;
+};
+
+class Diagnostics {
+public:
+    // Records an error; one identical to the last recorded, at the same
+    // place, is dropped.
+    void error(std::string file, int line, int column, std::string message,
+               std::string text = {});
+
+    // Errors recorded so far, including those already written.
+    size_t errorCount() const { return errors; }
+
+    const std::vector<Diagnostic> &pending() const { return diagnostics; }
+
+    // Writes the diagnostics recorded since the last flush to `out` in one
+    // write, each as
+    //     file:line:column: error: message
+    //         the source line
+    //                ^
+    void flush(std::ostream &out);
+
+private:
+    std::vector<Diagnostic> diagnostics;
+    size_t errors = 0;
+};
+
+#endif // DIAGNOSTICS_HPP_
@@ -0,0 +1,617 @@
+#include "driver.hpp"
+#include "XIR.hpp"
+#include "build.hpp"
+#include "bytecode.hpp"
+#include "compileCache.hpp"
+#include "dump.hpp"
+#include "elf.hpp"
+#include "emitter.hpp"
+#include "hash.hpp"
+#include "jit.hpp"
+#include "lir.hpp"
+#include "memory.hpp"
+#include "profile.hpp"
+#include "thelang.hpp"
+#include "timing.hpp"
+#include "vm.hpp"
+#include "x86.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+bool parseArguments(const std::vector<std::string> &args,
+                    const std::filesystem::path &directory,
+                    Invocation &invocation) {
+    Options &options = invocation.options;
+    invocation.directory = directory;
+    auto resolve = [&](const std::string &path) {
+        return (directory / path).string();
+    };
+
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string &arg = args[i];
+        if (arg.empty()) {
+            return false;
+        } else if (arg == "-O0") {
+            options.optimize = false;
+        } else if (arg == "-O1") {
+            options.optimize = true;
+        } else if (arg == "-g") {
+            options.debugLines = true;
+        } else if (arg == "--instrument") {
+            options.instrument = true;
+        } else if (arg == "--no-bounds-checks") {
+            options.boundsChecks = false;
+        } else if (arg == "--run") {
+            options.run = true;
+            options.target = "x86-64";
+        } else if (arg == "--vm") {
+            options.vm = true;
+        } else if (arg == "--vm-stats") {
+            options.vmStats = true;
+        } else if (arg == "--dump-bytecode") {
+            options.dumpBytecode = true;
+        } else if (arg == "-o" && i + 1 < args.size()) {
+            invocation.outputPath = args[++i];
+            if (invocation.outputPath != "-") {
+                invocation.outputPath = resolve(invocation.outputPath);
+            }
+        } else if (arg == "-j" && i + 1 < args.size()) {
+            invocation.jobs = std::atoi(args[++i].c_str());
+            invocation.batch = true;
+            if (invocation.jobs == 0) {
+                return false;
+            }
+        } else if (arg == "--time-report") {
+            options.timeReport = true;
+        } else if (arg == "--mem-report") {
+            options.memReport = true;
+        } else if (arg.rfind("--trace=", 0) == 0) {
+            if (arg.size() == 8) {
+                return false;
+            }
+            options.tracePath = resolve(arg.substr(8));
+        } else if (arg == "--dump-tokens" || arg == "--dump-tokens=json") {
+            options.dumpTokens = arg == "--dump-tokens" ? "text" : "json";
+        } else if (arg == "--dump-ast" || arg == "--dump-ast=json") {
+            options.dumpAst = arg == "--dump-ast" ? "text" : "json";
+        } else if (arg == "--dump-lir") {
+            options.dumpLir = true;
+        } else if (arg == "--profile-report") {
+            invocation.profileReport = resolve("xrt.profile");
+        } else if (arg.rfind("--profile-report=", 0) == 0) {
+            if (arg.size() == 17) {
+                return false;
+            }
+            invocation.profileReport = resolve(arg.substr(17));
+        } else if (arg.rfind("--cache=", 0) == 0) {
+            if (arg.size() == 8) {
+                return false;
+            }
+            options.cacheDirectory = resolve(arg.substr(8));
+        } else if (arg.rfind("--build=", 0) == 0) {
+            if (arg.size() == 8) {
+                return false;
+            }
+            invocation.build = resolve(arg.substr(8));
+        } else if (arg.rfind("--server=", 0) == 0) {
+            if (arg.size() == 9) {
+                return false;
+            }
+            invocation.server = resolve(arg.substr(9));
+        } else if (arg.rfind("--connect=", 0) == 0) {
+            if (arg.size() == 10) {
+                return false;
+            }
+            invocation.connect = resolve(arg.substr(10));
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            options.threads = std::atoi(arg.c_str() + 10);
+            if (options.threads == 0) {
+                return false;
+            }
+        } else if (arg.rfind("--emit=", 0) == 0) {
+            options.emit = arg.substr(7);
+            if (options.emit != "asm" && options.emit != "obj" &&
+                options.emit != "exe") {
+                return false;
+            }
+        } else if (arg.rfind("--target=", 0) == 0) {
+            options.target = arg.substr(9);
+            if (options.target != "c" && options.target != "x86-64") {
+                return false;
+            }
+        } else if (arg[0] == '@') {
+            std::ifstream list(resolve(arg.substr(1)));
+            if (!list) {
+                throw std::runtime_error("cannot read " + arg.substr(1));
+            }
+            for (std::string name; list >> name;) {
+                invocation.fileNames.push_back(resolve(name));
+            }
+            invocation.batch = true;
+        } else if (arg[0] != '-') {
+            invocation.fileNames.push_back(resolve(arg));
+        } else {
+            return false;
+        }
+    }
+
+    if (!invocation.server.empty()) {
+        // The server takes its work from clients.
+        return args.size() == 1;
+    }
+    if (!invocation.profileReport.empty()) {
+        return invocation.fileNames.empty() && invocation.build.empty();
+    }
+    if (!invocation.build.empty()) {
+        // One root module; the build finds the rest through its imports.
+        return invocation.fileNames.size() == 1 && !options.run &&
+               !options.vm && options.emit != "exe" &&
+               invocation.outputPath.empty();
+    }
+    invocation.batch = invocation.batch || invocation.fileNames.size() > 1;
+    return !invocation.fileNames.empty() &&
+           !(invocation.batch && (options.run || options.vm ||
+                                  invocation.outputPath == "-"));
+}
+
+bool OutputCache::find(const std::string &key, uint64_t sourceHash,
+                       Entry &entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it == entries.end() || it->second.entry.sourceHash != sourceHash) {
+        misses++;
+        return false;
+    }
+    hits++;
+    recent.splice(recent.begin(), recent, it->second.use);
+    entry = it->second.entry;
+    return true;
+}
+
+void OutputCache::store(const std::string &key, Entry entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        recent.splice(recent.begin(), recent, it->second.use);
+        it->second.entry = std::move(entry);
+        return;
+    }
+    while (!recent.empty() && entries.size() >= capacity) {
+        entries.erase(recent.back());
+        recent.pop_back();
+    }
+    recent.push_front(key);
+    entries[key] = {std::move(entry), recent.begin()};
+}
+
+std::string outputName(const Options &options, const std::string &stem) {
+    if (options.target == "c") {
+        return stem + (options.cacheDirectory.empty() ? ".c" : ".units");
+    }
+    if (options.emit == "asm") {
+        return stem + ".s";
+    }
+    return options.emit == "obj" ? stem + ".o" : stem;
+}
+
+std::string readFile(const std::string &fileName) {
+    std::ifstream file(fileName, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("cannot open " + fileName);
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+static void writeOutput(const Options &options, const std::string &outputPath,
+                        std::string_view output) {
+    TimeScope scope(options.timeline, "write output");
+    Emitter::writeFile(outputPath, output);
+    if (options.target == "x86-64" && options.emit == "exe" &&
+        outputPath != "-") {
+        std::filesystem::permissions(outputPath,
+                                     std::filesystem::perms::owner_exec |
+                                         std::filesystem::perms::group_exec |
+                                         std::filesystem::perms::others_exec,
+                                     std::filesystem::perm_options::add);
+    }
+}
+
+static void accountMemory(const LModule &module, MemoryUsage &usage) {
+    size_t count = 0;
+    size_t bytes = module.functions.capacity() * sizeof(LFunction);
+    for (const auto &function : module.functions) {
+        count += function.instructions.size();
+        bytes += function.instructions.capacity() * sizeof(LInst) +
+                 function.vregWidths.capacity() * sizeof(int) +
+                 function.frameObjects.capacity() * sizeof(int);
+        for (const auto &instruction : function.instructions) {
+            bytes += instruction.args.capacity() * sizeof(LOperand) +
+                     heapBytes(instruction.symbol);
+        }
+    }
+    usage.add("LIR instructions", count, bytes);
+}
+
+// A .lines file: for each run of code generated for one source line, its
+// address and the line, as "0x401a2c fib.x:3". Addresses are offsets into
+// .text for an object, and absolute for an executable.
+static std::string lineTable(const x86::Image &image,
+                             const std::string &fileName, uint64_t base) {
+    std::ostringstream out;
+    for (const auto &[offset, line] : image.lines) {
+        out << "0x" << std::hex << base + offset << std::dec << ' '
+            << fileName << ':' << line << '\n';
+    }
+    return out.str();
+}
+
+std::string generate(const Options &options, const std::string &fileName,
+                     CompilationContext &context, ASTGen &ast,
+                     std::ostream &diagnostics, int &status,
+                     std::string *lines) {
+    std::string sourceName = options.debugLines ? fileName : "";
+    Timeline *timeline = options.timeline;
+    if (options.instrument && (options.vm || options.target != "c")) {
+        throw std::runtime_error("--instrument needs --target=c");
+    }
+    if (options.vm) {
+        Lowering lowering(ast);
+        lowering.boundsChecks = options.boundsChecks;
+        LModule lir;
+        {
+            TimeScope scope(timeline, "lower");
+            lir = lowering.run();
+        }
+        if (options.memory) {
+            accountMemory(lir, *options.memory);
+        }
+        BModule module;
+        {
+            TimeScope scope(timeline, "compile bytecode");
+            module = compileBytecode(lir);
+        }
+        if (options.dumpBytecode) {
+            for (const auto &function : module.functions) {
+                diagnostics << bytecodeToString(function);
+            }
+        }
+        VM interpreter(module);
+        interpreter.countInstructions = options.vmStats;
+        TimeScope scope(timeline, "run");
+        auto start = std::chrono::steady_clock::now();
+        status = interpreter.run();
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        if (options.vmStats) {
+            double seconds = elapsed.count();
+            diagnostics << "vm: " << interpreter.executed << " instructions in "
+                        << seconds * 1000 << " ms ("
+                        << interpreter.executed / seconds / 1e6
+                        << " M instructions/s)" << std::endl;
+        }
+        return {};
+    }
+
+    if (options.target == "x86-64") {
+        Lowering lowering(ast);
+        lowering.boundsChecks = options.boundsChecks;
+        LModule module;
+        {
+            TimeScope scope(timeline, "lower");
+            module = lowering.run();
+        }
+        if (options.memory) {
+            accountMemory(module, *options.memory);
+        }
+        if (options.dumpLir) {
+            for (const auto &function : module.functions) {
+                diagnostics << lirToString(function);
+            }
+        }
+        x86::MModule machine;
+        {
+            TimeScope scope(timeline, "select instructions");
+            machine = x86::selectInstructions(module);
+        }
+        if (options.emit == "asm" && !options.run) {
+            TimeScope scope(timeline, "write assembly");
+            return x86::writeAssembly(machine, sourceName);
+        }
+        x86::Image image;
+        {
+            TimeScope scope(timeline, "encode");
+            image = x86::encode(machine);
+        }
+        if (options.run) {
+            JIT jit(image);
+            jit.writePerfMap();
+            TimeScope scope(timeline, "run");
+            status = jit.run();
+            return {};
+        }
+        TimeScope scope(timeline, options.emit == "obj" ? "write object"
+                                                        : "write executable");
+        if (lines && options.debugLines) {
+            *lines = lineTable(image, fileName,
+                               options.emit == "obj"
+                                   ? 0
+                                   : elf::executableTextAddress());
+        }
+        std::vector<uint8_t> bytes = options.emit == "obj"
+                                         ? elf::writeObject(image)
+                                         : elf::writeExecutable(image);
+        return std::string(bytes.begin(), bytes.end());
+    }
+
+    std::string output;
+    Emitter out(output);
+    IR ir(ast, &context.parser, out);
+    ir.boundsChecks = options.boundsChecks;
+    ir.threads = options.threads;
+    ir.timeline = timeline;
+    ir.sourceName = sourceName;
+    if (options.instrument) {
+        ir.profileSource = fileName;
+    }
+    if (options.cacheDirectory.empty()) {
+        ir.GenIR();
+        return output;
+    }
+    if (options.instrument) {
+        throw std::runtime_error("--instrument cannot be used with --cache");
+    }
+
+    PurityAnalysis purity;
+    if (options.optimize) {
+        TimeScope scope(timeline, "purity analysis");
+        purity.run(ast);
+        ir.purity = &purity;
+    }
+    CompileCache cache(options.cacheDirectory);
+    for (const auto &unit : ir.writeUnits(cache)) {
+        out.write(unit, '\n');
+    }
+    diagnostics << fileName << ": cache: reused " << cache.reused << " of "
+                << cache.reused + cache.written << " functions" << std::endl;
+    return output;
+}
+
+int compileFile(const Options &options, const std::string &fileName,
+                const std::string &outputPath, std::ostream &diagnostics,
+                OutputCache *cache) {
+    TimeScope scope(options.timeline, "compile", fileName);
+    std::string source;
+    {
+        TimeScope read(options.timeline, "read file");
+        source = readFile(fileName);
+    }
+    // Runs, dumps and .lines files are never cached, and --cache keeps units
+    // of its own.
+    if (options.run || options.vm || !options.cacheDirectory.empty() ||
+        !options.dumpTokens.empty() || !options.dumpAst.empty() ||
+        (options.debugLines && options.target == "x86-64" &&
+         options.emit != "asm")) {
+        cache = nullptr;
+    }
+
+    std::string key;
+    OutputCache::Entry entry;
+    if (cache) {
+        key = fileName + '\n' + outputPath + '\n' +
+              (options.optimize ? "-O1 " : "-O0 ") +
+              (options.boundsChecks ? "checked " : "unchecked ") +
+              (options.debugLines ? "-g " : "") +
+              (options.instrument ? "--instrument " : "") + options.target +
+              ' ' + options.emit;
+        Hasher hasher;
+        hasher.add(source);
+        entry.sourceHash = hasher.value();
+        if (cache->find(key, entry.sourceHash, entry)) {
+            diagnostics << entry.diagnostics;
+            writeOutput(options, outputPath, entry.output);
+            return 0;
+        }
+    }
+
+    // With a cache, diagnostics are collected so they can be replayed.
+    std::ostringstream collected;
+    std::ostream &report = cache ? collected : diagnostics;
+    int status = 0;
+    std::string lines;
+    try {
+        CompilationContext context(fileName, std::move(source), report);
+        CompileOptions compileOptions;
+        compileOptions.optimize = options.optimize;
+        compileOptions.timeline = options.timeline;
+        compileOptions.memory = options.memory;
+        ASTGen &ast = context.analyze(compileOptions);
+        if (!options.dumpTokens.empty()) {
+            TimeScope dump(options.timeline, "dump tokens");
+            report << dumpTokens(context.lexer, options.dumpTokens == "json");
+        }
+        if (!options.dumpAst.empty()) {
+            TimeScope dump(options.timeline, "dump AST");
+            report << dumpAst(ast, options.dumpAst == "json");
+        }
+        if (context.diagnostics.errorCount() > 0) {
+            if (cache) {
+                diagnostics << collected.str();
+            }
+            return 1;
+        }
+        entry.output = generate(options, fileName, context, ast, report,
+                                status, &lines);
+        if (options.memory) {
+            options.memory->add("output", 1, entry.output.capacity());
+        }
+    } catch (const std::runtime_error &) {
+        diagnostics << collected.str();
+        throw;
+    }
+    if (options.run || options.vm) {
+        return status;
+    }
+
+    writeOutput(options, outputPath, entry.output);
+    if (!lines.empty() && outputPath != "-") {
+        Emitter::writeFile(outputPath + ".lines", lines);
+    }
+    if (cache) {
+        entry.diagnostics = collected.str();
+        diagnostics << entry.diagnostics;
+        cache->store(key, std::move(entry));
+    }
+    return 0;
+}
+
+// Batch mode: compiles every file in one process, `jobs` at a time. Files
+// share nothing, so each worker just takes the next one. Returns 1 if any
+// file failed.
+static int compileAll(const Options &options,
+                      const std::vector<std::string> &fileNames,
+                      const std::string &outputDirectory, unsigned jobs,
+                      std::ostream &diagnostics, OutputCache *cache) {
+    std::atomic<size_t> next = 0;
+    std::atomic<bool> failed = false;
+    std::mutex reporting;
+    auto work = [&]() {
+        for (size_t i; (i = next++) < fileNames.size();) {
+            std::filesystem::path input(fileNames[i]);
+            std::filesystem::path directory = input.parent_path();
+            if (!outputDirectory.empty()) {
+                directory = outputDirectory;
+            }
+            std::string output =
+                (directory / outputName(options, input.stem().string()))
+                    .string();
+            // Each file's messages are written in one piece, keeping those
+            // of different workers apart.
+            std::ostringstream messages;
+            try {
+                if (compileFile(options, fileNames[i], output, messages,
+                                cache) != 0) {
+                    failed = true;
+                }
+            } catch (const std::runtime_error &error) {
+                messages << fileNames[i] << ": error: " << error.what()
+                         << "\n";
+                failed = true;
+            }
+            std::lock_guard<std::mutex> lock(reporting);
+            diagnostics << messages.str() << std::flush;
+        }
+    };
+
+    if (jobs == 0) {
+        jobs = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < std::min<size_t>(jobs, fileNames.size()); ++i) {
+        pool.emplace_back(work);
+    }
+    work();
+    for (auto &thread : pool) {
+        thread.join();
+    }
+    return failed ? 1 : 0;
+}
+
+// runInvocation without the timing.
+static int dispatch(const Invocation &invocation, Options options,
+                    std::ostream &diagnostics, OutputCache *cache) {
+    if (!invocation.profileReport.empty()) {
+        // Written with the other reports, so that it reaches --connect
+        // clients too.
+        try {
+            writeProfileReport(readProfile(invocation.profileReport),
+                               diagnostics);
+            return 0;
+        } catch (const std::runtime_error &error) {
+            diagnostics << "error: " << error.what() << std::endl;
+            return 1;
+        }
+    }
+    if (!invocation.build.empty()) {
+        // The modules already keep every core busy.
+        if (options.threads == 0) {
+            options.threads = 1;
+        }
+        try {
+            return buildModules(options, invocation.fileNames[0],
+                                invocation.build, invocation.jobs,
+                                diagnostics);
+        } catch (const std::runtime_error &error) {
+            diagnostics << "error: " << error.what() << std::endl;
+            return 1;
+        }
+    }
+    if (invocation.batch) {
+        // The files already keep every core busy.
+        if (options.threads == 0) {
+            options.threads = 1;
+        }
+        return compileAll(options, invocation.fileNames, invocation.outputPath,
+                          invocation.jobs, diagnostics, cache);
+    }
+
+    try {
+        return compileFile(options, invocation.fileNames[0],
+                           invocation.outputPath.empty()
+                               ? (invocation.directory /
+                                  outputName(options, "output"))
+                                     .string()
+                               : invocation.outputPath,
+                           diagnostics, cache);
+    } catch (const std::runtime_error &error) {
+        diagnostics << "error: " << error.what() << std::endl;
+        return 1;
+    }
+}
+
+int runInvocation(const Invocation &invocation, std::ostream &diagnostics,
+                  OutputCache *cache) {
+    const Options &options = invocation.options;
+    if (!options.timeReport && options.tracePath.empty() &&
+        !options.memReport) {
+        return dispatch(invocation, options, diagnostics, cache);
+    }
+
+    Timeline timeline;
+    timeline.sampleMemory = options.memReport;
+    MemoryUsage memory;
+    Options timed = options;
+    timed.timeline = &timeline;
+    if (options.memReport) {
+        timed.memory = &memory;
+    }
+    int status = dispatch(invocation, timed, diagnostics, cache);
+    if (options.timeReport) {
+        timeline.writeReport(diagnostics);
+    }
+    if (options.memReport) {
+        diagnostics << "memory report: " << std::fixed << std::setprecision(1)
+                    << peakResidentBytes() / (1024.0 * 1024.0)
+                    << " MiB peak RSS\n"
+                    << std::defaultfloat << std::setprecision(6);
+        memory.writeReport(diagnostics);
+        timeline.writePeakReport(diagnostics);
+    }
+    if (!options.tracePath.empty()) {
+        std::ostringstream trace;
+        timeline.writeTrace(trace);
+        try {
+            Emitter::writeFile(options.tracePath, trace.str());
+        } catch (const std::runtime_error &error) {
+            diagnostics << "error: " << error.what() << std::endl;
+            return 1;
+        }
+    }
+    return status;
+}
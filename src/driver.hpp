@@ -0,0 +1,144 @@
+#ifndef DRIVER_HPP_
+#define DRIVER_HPP_
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The command-line driver, shared by a plain LanguageC run and --server:
+// option parsing, and compiling one file or a batch of them.
+
+class MemoryUsage;
+class Timeline;
+
+struct Options {
+    bool optimize = true;
+    bool boundsChecks = true;
+    // -g: map the output back to lines of the source, with #line directives
+    // in C, .loc directives in assembly, and a .lines file beside an object
+    // or executable.
+    bool debugLines = false;
+    // --instrument: C that counts the calls and time of each function and
+    // how often each if is taken, and writes a profile at exit.
+    bool instrument = false;
+    std::string target = "c";
+    std::string emit = "asm";
+    unsigned threads = 0;
+    std::string cacheDirectory;
+    bool dumpLir = false;
+    bool run = false;
+    bool vm = false;
+    bool vmStats = false;
+    bool dumpBytecode = false;
+    // --dump-tokens and --dump-ast: "text", "json", or empty for none.
+    // Written with the diagnostics once the file is analyzed.
+    std::string dumpTokens;
+    std::string dumpAst;
+    // --time-report and --trace=PATH; runInvocation points `timeline` at
+    // the timeline they are made from.
+    bool timeReport = false;
+    std::string tracePath;
+    Timeline *timeline = nullptr;
+    // --mem-report; runInvocation points `memory` at the usage it reports.
+    bool memReport = false;
+    MemoryUsage *memory = nullptr;
+};
+
+// Everything one command line asks for.
+struct Invocation {
+    Options options;
+    std::vector<std::string> fileNames;
+    bool batch = false;
+    std::string outputPath;
+    unsigned jobs = 0;
+    // Where relative paths were resolved, and the default output goes.
+    std::filesystem::path directory;
+    // --build=DIR: the output directory of a module build.
+    std::string build;
+    // --server=PATH and --connect=PATH.
+    std::string server;
+    std::string connect;
+    // --profile-report[=PATH]: the profile to report on instead of
+    // compiling.
+    std::string profileReport;
+};
+
+// Fills `invocation` from the arguments after the program name. Relative
+// paths are taken relative to `directory`, which is the client's working
+// directory under --server. Returns false if the arguments are invalid; an
+// unreadable @list throws std::runtime_error.
+bool parseArguments(const std::vector<std::string> &args,
+                    const std::filesystem::path &directory,
+                    Invocation &invocation);
+
+// What --server remembers of earlier compilations: the output and the
+// diagnostics of each input file, kept while its source is unchanged. Once
+// `capacity` entries are kept, storing another drops the one used least
+// recently.
+class OutputCache {
+public:
+    struct Entry {
+        uint64_t sourceHash = 0;
+        std::string output;
+        std::string diagnostics;
+    };
+
+    bool find(const std::string &key, uint64_t sourceHash, Entry &entry);
+    void store(const std::string &key, Entry entry);
+
+    size_t capacity = 1024;
+    size_t hits = 0;
+    size_t misses = 0;
+
+private:
+    struct Slot {
+        Entry entry;
+        // Where the key is in `recent`.
+        std::list<std::string>::iterator use;
+    };
+
+    std::mutex mutex;
+    std::map<std::string, Slot> entries;
+    // Keys, most recently used first.
+    std::list<std::string> recent;
+};
+
+class ASTGen;
+class CompilationContext;
+
+// The name of the output file, without a directory: output.c and so on
+// for a single file, the input's name with the target's suffix in batch
+// mode.
+std::string outputName(const Options &options, const std::string &stem);
+
+// The contents of `fileName`; throws std::runtime_error if it cannot be
+// read.
+std::string readFile(const std::string &fileName);
+
+// Generates the output of a file `context` has analyzed into `ast`; --vm
+// and --run run it instead and set `status` to its exit status. With -g and
+// an object or executable, sets `lines` to the contents of its .lines file.
+std::string generate(const Options &options, const std::string &fileName,
+                     CompilationContext &context, ASTGen &ast,
+                     std::ostream &diagnostics, int &status,
+                     std::string *lines = nullptr);
+
+// Compiles `fileName` to `outputPath`, or runs it with --run and --vm, and
+// returns the exit status. Reports to `diagnostics`; throws
+// std::runtime_error on errors. With a cache, unchanged files are not
+// compiled again.
+int compileFile(const Options &options, const std::string &fileName,
+                const std::string &outputPath, std::ostream &diagnostics,
+                OutputCache *cache = nullptr);
+
+// Runs a parsed invocation other than --server and --connect and returns
+// the exit status; errors are reported to `diagnostics`.
+int runInvocation(const Invocation &invocation, std::ostream &diagnostics,
+                  OutputCache *cache = nullptr);
+
+#endif // DRIVER_HPP_
@@ -0,0 +1,329 @@
+#include "dump.hpp"
+#include "emitter.hpp"
+#include <vector>
+
+std::string dumpTokens(const Lexer &lexer, bool json) {
+    std::string buffer;
+    Emitter out(buffer);
+    out.write(json ? "[" : "");
+    bool first = true;
+    for (const auto &token : lexer.tokens) {
+        if (token->type == EoF) {
+            continue;
+        }
+        const char *kind = Lexer::token_to_string(token->type);
+        if (json) {
+            out.write(first ? "\n" : ",\n", "{\"kind\":", jsonString(kind),
+                      ",\"value\":", jsonString(token->value),
+                      ",\"line\":", token->line, ",\"column\":", token->col,
+                      '}');
+        } else {
+            out.write(token->line, ':', token->col, ' ', kind, ' ',
+                      token->value, '\n');
+        }
+        first = false;
+    }
+    out.write(json ? "\n]\n" : "");
+    return buffer;
+}
+
+namespace {
+
+// Writes a tree of nodes, each a kind and some attributes, either as lines
+// indented by depth or as nested JSON objects with a "children" array.
+class TreeWriter {
+public:
+    TreeWriter(Emitter &out, bool json) : out(out), json(json) {
+        levels.push_back({});
+    }
+
+    void begin(std::string_view kind) {
+        Level &parent = levels.back();
+        if (json) {
+            if (levels.size() == 1) {
+                out.write(parent.hasChildren ? ",\n" : "[\n");
+            } else {
+                out.write(parent.hasChildren ? "," : ",\"children\":[");
+            }
+            out.write("{\"kind\":", jsonString(kind));
+        } else {
+            if (!parent.hasChildren && levels.size() > 1) {
+                out.write('\n');
+            }
+            out.spaces(2 * (levels.size() - 1));
+            out.write(kind);
+        }
+        parent.hasChildren = true;
+        levels.push_back({});
+    }
+
+    void attribute(std::string_view name, std::string_view value) {
+        if (json) {
+            out.write(",", jsonString(name), ":", jsonString(value));
+        } else {
+            out.write(' ', name, '=', value);
+        }
+    }
+
+    void flag(std::string_view name) {
+        if (json) {
+            out.write(",", jsonString(name), ":true");
+        } else {
+            out.write(' ', name);
+        }
+    }
+
+    void end() {
+        bool hasChildren = levels.back().hasChildren;
+        levels.pop_back();
+        if (json) {
+            out.write(hasChildren ? "]}" : "}");
+        } else if (!hasChildren) {
+            out.write('\n');
+        }
+    }
+
+    void finish() {
+        if (json) {
+            out.write(levels.back().hasChildren ? "\n]\n" : "[]\n");
+        }
+    }
+
+private:
+    struct Level {
+        bool hasChildren = false;
+    };
+
+    Emitter &out;
+    bool json;
+    std::vector<Level> levels;
+};
+
+class AstDumper {
+public:
+    explicit AstDumper(TreeWriter &tree) : tree(tree) {}
+
+    void node(const Instruction *instruction) {
+        if (!instruction) {
+            return;
+        }
+        switch (instruction->type) {
+        case NodeType::FUNCTION_DECLARATION:
+            function(dynamic_cast<const FunctionDeclaration *>(instruction));
+            break;
+        case NodeType::VARIABLE_DECLARATION:
+            declaration(dynamic_cast<const VariableDeclaration *>(instruction));
+            break;
+        case NodeType::VARIABLE_REFERENCE: {
+            auto reference =
+                dynamic_cast<const VariableReference *>(instruction);
+            tree.begin("reference");
+            tree.attribute("name", reference->name);
+            tree.attribute("type", dataTypeToString(reference->variable_type));
+            tree.end();
+            break;
+        }
+        case NodeType::VARIABLE_ASSIGNMENT:
+            assignment(dynamic_cast<const VariableAssignment *>(instruction));
+            break;
+        case NodeType::FUNCTION_BODY:
+            block("block", dynamic_cast<const FunctionBody *>(instruction));
+            break;
+        case NodeType::RETURN_STATEMENT:
+            tree.begin("return");
+            expression(
+                dynamic_cast<const ReturnStatement *>(instruction)
+                    ->returned_value);
+            tree.end();
+            break;
+        case NodeType::EXPRESSION:
+        case NodeType::FUNCTION_CALL:
+            expression(dynamic_cast<const Expression *>(instruction));
+            break;
+        case NodeType::IF: {
+            auto statement = dynamic_cast<const IfStatement *>(instruction);
+            tree.begin("if");
+            expression(statement->condition);
+            block("then", statement->ifBody);
+            tree.end();
+            break;
+        }
+        case NodeType::ELSE:
+            block("else",
+                  dynamic_cast<const ElseStatement *>(instruction)->elseBody);
+            break;
+        case NodeType::WHILE: {
+            auto loop = dynamic_cast<const WhileStatement *>(instruction);
+            tree.begin("while");
+            if (loop->unrollHint) {
+                tree.attribute("unroll", std::to_string(loop->unrollHint));
+            }
+            expression(loop->condition);
+            block("do", loop->body);
+            tree.end();
+            break;
+        }
+        case NodeType::FOR: {
+            auto loop = dynamic_cast<const ForStatement *>(instruction);
+            tree.begin("for");
+            if (loop->tripCount >= 0) {
+                tree.attribute("trips", std::to_string(loop->tripCount));
+            }
+            if (loop->unrollFactor > 1) {
+                tree.attribute("unroll", std::to_string(loop->unrollFactor));
+            }
+            declaration(loop->init);
+            expression(loop->condition);
+            assignment(loop->step);
+            block("do", loop->body);
+            tree.end();
+            break;
+        }
+        case NodeType::PRINT_NODE: {
+            auto print = dynamic_cast<const PrintNode *>(instruction);
+            tree.begin("print");
+            if (!print->arguments.empty()) {
+                tree.attribute("format", print->arguments[0]);
+            }
+            for (auto argument : print->arguments2) {
+                expression(argument);
+            }
+            tree.end();
+            break;
+        }
+        }
+    }
+
+    void function(const FunctionDeclaration *function) {
+        tree.begin(function->body ? "function" : "declaration");
+        tree.attribute("name", function->name);
+        tree.attribute("returns", dataTypeToString(function->return_type));
+        for (auto parameter : function->parameters) {
+            tree.begin("parameter");
+            tree.attribute("name", parameter->name);
+            tree.attribute("type", dataTypeToString(parameter->variable_type));
+            tree.end();
+        }
+        if (function->body) {
+            for (auto instruction : function->body->getInstructions()) {
+                node(instruction);
+            }
+        }
+        tree.end();
+    }
+
+private:
+    void block(std::string_view kind, const FunctionBody *body) {
+        if (!body) {
+            return;
+        }
+        tree.begin(kind);
+        for (auto instruction : body->getInstructions()) {
+            node(instruction);
+        }
+        tree.end();
+    }
+
+    void declaration(const VariableDeclaration *declaration) {
+        if (!declaration) {
+            return;
+        }
+        tree.begin("let");
+        tree.attribute("name", declaration->name);
+        tree.attribute("type", dataTypeToString(declaration->variable_type));
+        if (declaration->is_global) {
+            tree.flag("global");
+        }
+        expression(declaration->initialization_value);
+        tree.end();
+    }
+
+    void assignment(const VariableAssignment *assignment) {
+        if (!assignment) {
+            return;
+        }
+        tree.begin("assign");
+        tree.attribute("name", assignment->variable->name);
+        expression(assignment->element);
+        expression(assignment->newValue);
+        tree.end();
+    }
+
+    void expression(const Expression *expression) {
+        if (!expression) {
+            return;
+        }
+        std::string type = dataTypeToString(expression->variable_type);
+        switch (expression->type) {
+        case Expression::Type::LITERAL:
+            tree.begin("literal");
+            tree.attribute("value", expression->literal_value);
+            tree.attribute("type", type);
+            tree.end();
+            return;
+        case Expression::Type::VARIABLE:
+        case Expression::Type::VARIABLE_REFERENCE:
+            tree.begin("variable");
+            tree.attribute("name", expression->variable_name);
+            tree.attribute("type", type);
+            if (expression->is_global) {
+                tree.flag("global");
+            }
+            tree.end();
+            return;
+        case Expression::Type::BINARY_OPERATION:
+            tree.begin("binary");
+            tree.attribute("op", operationToString(expression->operation));
+            tree.attribute("type", type);
+            break;
+        case Expression::Type::EQUAL_OPERATION:
+            tree.begin("equal");
+            break;
+        case Expression::Type::FUNCTION_CALL:
+        case Expression::Type::PRINT:
+            tree.begin("call");
+            tree.attribute("name", expression->function_name);
+            tree.attribute("type", type);
+            for (auto argument : expression->arguments) {
+                this->expression(argument);
+            }
+            tree.end();
+            return;
+        case Expression::Type::VARIABLE_ASSIGNMENT:
+            tree.begin("assign");
+            tree.attribute("name", expression->variable_name);
+            tree.attribute("value", expression->literal_value);
+            tree.end();
+            return;
+        case Expression::Type::INDEX:
+            tree.begin("index");
+            tree.attribute("type", type);
+            if (!expression->bounds_checked) {
+                tree.flag("unchecked");
+            }
+            break;
+        }
+        this->expression(expression->left_operand);
+        this->expression(expression->right_operand);
+        tree.end();
+    }
+
+    TreeWriter &tree;
+};
+
+} // namespace
+
+std::string dumpAst(const ASTGen &ast, bool json) {
+    std::string buffer;
+    Emitter out(buffer);
+    TreeWriter tree(out, json);
+    AstDumper dumper(tree);
+    for (auto declaration : ast.externs) {
+        dumper.function(declaration);
+    }
+    for (auto node : ast.nodes) {
+        dumper.node(node);
+    }
+    tree.finish();
+    return buffer;
+}
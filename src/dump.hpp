@@ -0,0 +1,15 @@
+#ifndef DUMP_HPP_
+#define DUMP_HPP_
+
+#include "parser.hpp"
+#include <string>
+
+// --dump-tokens and --dump-ast: the tokens of a source, and the tree the
+// back ends see (after the -O1 passes), as indented text or as JSON. Each
+// dump is built in one buffer, for the caller to write in one piece.
+
+std::string dumpTokens(const Lexer &lexer, bool json);
+
+std::string dumpAst(const ASTGen &ast, bool json);
+
+#endif // DUMP_HPP_
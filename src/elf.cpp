@@ -0,0 +1,345 @@
+#include "elf.hpp"
+#include <algorithm>
+#include <cstring>
+#include <elf.h>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+
+namespace elf {
+
+namespace {
+
+template <typename T> void put(std::vector<uint8_t> &out, const T &value) {
+    size_t offset = out.size();
+    out.resize(offset + sizeof(T));
+    std::memcpy(out.data() + offset, &value, sizeof(T));
+}
+
+constexpr uint64_t alignTo(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// The layout of executables: everything but .data shares one read-only,
+// executable segment loaded at `base`, with _start right after the headers
+// and the image's code after _start.
+constexpr uint64_t base = 0x400000;
+constexpr int maxSegments = 3;
+constexpr uint64_t textOffset =
+    alignTo(sizeof(Elf64_Ehdr) + maxSegments * sizeof(Elf64_Phdr), 16);
+constexpr uint64_t startSize = 16;
+
+void pad(std::vector<uint8_t> &out, uint64_t alignment) {
+    out.resize(alignTo(out.size(), alignment), 0);
+}
+
+class StringTable {
+public:
+    uint32_t add(const std::string &text) {
+        uint32_t offset = static_cast<uint32_t>(bytes.size());
+        bytes.insert(bytes.end(), text.begin(), text.end());
+        bytes.push_back(0);
+        return offset;
+    }
+
+    std::vector<uint8_t> bytes{0};
+};
+
+Elf64_Ehdr header(uint16_t type) {
+    Elf64_Ehdr ehdr{};
+    ehdr.e_ident[EI_MAG0] = ELFMAG0;
+    ehdr.e_ident[EI_MAG1] = ELFMAG1;
+    ehdr.e_ident[EI_MAG2] = ELFMAG2;
+    ehdr.e_ident[EI_MAG3] = ELFMAG3;
+    ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    ehdr.e_type = type;
+    ehdr.e_machine = EM_X86_64;
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+    return ehdr;
+}
+
+// Section header indexes of a relocatable object.
+enum ObjectSection : uint16_t {
+    NULL_SECTION,
+    TEXT,
+    RODATA,
+    DATA,
+    RELA_TEXT,
+    RELA_DATA,
+    SYMTAB,
+    STRTAB,
+    SHSTRTAB,
+    NOTE_GNU_STACK,
+    NUM_SECTIONS
+};
+
+uint16_t sectionIndex(x86::Section section) {
+    switch (section) {
+    case x86::Section::TEXT:
+        return TEXT;
+    case x86::Section::RODATA:
+        return RODATA;
+    case x86::Section::DATA:
+        return DATA;
+    case x86::Section::UNDEFINED:
+        return SHN_UNDEF;
+    }
+    return SHN_UNDEF;
+}
+
+uint32_t relocationType(x86::Relocation::Kind kind) {
+    switch (kind) {
+    case x86::Relocation::Kind::PC32:
+        return R_X86_64_PC32;
+    case x86::Relocation::Kind::PLT32:
+        return R_X86_64_PLT32;
+    case x86::Relocation::Kind::ABS64:
+        return R_X86_64_64;
+    }
+    return R_X86_64_NONE;
+}
+
+const x86::Symbol &lookup(const x86::Image &image, const std::string &name) {
+    const x86::Symbol *symbol = image.find(name);
+    if (!symbol) {
+        throw std::runtime_error("undefined symbol " + name);
+    }
+    return *symbol;
+}
+
+} // namespace
+
+std::vector<uint8_t> writeObject(const x86::Image &image) {
+    StringTable strtab;
+    std::vector<Elf64_Sym> symbols(1, Elf64_Sym{});
+    for (uint16_t section : {TEXT, RODATA, DATA}) {
+        Elf64_Sym symbol{};
+        symbol.st_info = ELF64_ST_INFO(STB_LOCAL, STT_SECTION);
+        symbol.st_shndx = section;
+        symbols.push_back(symbol);
+    }
+
+    // Locals must precede globals. Assembler-local .L labels are left out
+    // and referenced through their section symbol, as gas does.
+    std::unordered_map<std::string, uint32_t> indexes;
+    auto add = [&](const x86::Symbol &symbol) {
+        Elf64_Sym entry{};
+        entry.st_name = strtab.add(symbol.name);
+        int binding = symbol.global ? STB_GLOBAL : STB_LOCAL;
+        int type = symbol.function                              ? STT_FUNC
+                   : symbol.section == x86::Section::UNDEFINED ? STT_NOTYPE
+                                                               : STT_OBJECT;
+        entry.st_info = ELF64_ST_INFO(binding, type);
+        entry.st_shndx = sectionIndex(symbol.section);
+        entry.st_value = symbol.offset;
+        entry.st_size = symbol.size;
+        indexes[symbol.name] = static_cast<uint32_t>(symbols.size());
+        symbols.push_back(entry);
+    };
+    for (const auto &symbol : image.symbols) {
+        if (!symbol.global && symbol.name.rfind(".L", 0) != 0) {
+            add(symbol);
+        }
+    }
+    uint32_t firstGlobal = static_cast<uint32_t>(symbols.size());
+    for (const auto &symbol : image.symbols) {
+        if (symbol.global) {
+            add(symbol);
+        }
+    }
+
+    std::vector<Elf64_Rela> relaText, relaData;
+    for (const auto &relocation : image.relocations) {
+        const x86::Symbol &symbol = lookup(image, relocation.symbol);
+        Elf64_Rela rela{};
+        rela.r_offset = relocation.offset;
+        rela.r_addend = relocation.addend;
+        uint32_t index;
+        if (symbol.global) {
+            index = indexes.at(symbol.name);
+        } else {
+            index = sectionIndex(symbol.section);
+            rela.r_addend += static_cast<long long>(symbol.offset);
+        }
+        rela.r_info = ELF64_R_INFO(index, relocationType(relocation.kind));
+        (relocation.section == x86::Section::TEXT ? relaText : relaData)
+            .push_back(rela);
+    }
+
+    std::vector<uint8_t> out;
+    put(out, header(ET_REL));
+
+    std::vector<Elf64_Shdr> sections(NUM_SECTIONS, Elf64_Shdr{});
+    StringTable shstrtab;
+    auto place = [&](ObjectSection index, const char *name, uint32_t type,
+                     uint64_t flags, const void *data, size_t size,
+                     uint64_t alignment) {
+        Elf64_Shdr &shdr = sections[index];
+        shdr.sh_name = shstrtab.add(name);
+        shdr.sh_type = type;
+        shdr.sh_flags = flags;
+        shdr.sh_addralign = alignment;
+        pad(out, alignment);
+        shdr.sh_offset = out.size();
+        shdr.sh_size = size;
+        const auto *bytes = static_cast<const uint8_t *>(data);
+        out.insert(out.end(), bytes, bytes + size);
+        return &shdr;
+    };
+
+    place(TEXT, ".text", SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR,
+          image.text.data(), image.text.size(), 16);
+    place(RODATA, ".rodata", SHT_PROGBITS, SHF_ALLOC, image.rodata.data(),
+          image.rodata.size(), 1);
+    place(DATA, ".data", SHT_PROGBITS, SHF_ALLOC | SHF_WRITE,
+          image.data.data(), image.data.size(), 8);
+    for (auto [index, name, rela, target] :
+         {std::tuple{RELA_TEXT, ".rela.text", &relaText, TEXT},
+          std::tuple{RELA_DATA, ".rela.data", &relaData, DATA}}) {
+        Elf64_Shdr *shdr =
+            place(index, name, SHT_RELA, SHF_INFO_LINK, rela->data(),
+                  rela->size() * sizeof(Elf64_Rela), 8);
+        shdr->sh_link = SYMTAB;
+        shdr->sh_info = target;
+        shdr->sh_entsize = sizeof(Elf64_Rela);
+    }
+    Elf64_Shdr *symtab =
+        place(SYMTAB, ".symtab", SHT_SYMTAB, 0, symbols.data(),
+              symbols.size() * sizeof(Elf64_Sym), 8);
+    symtab->sh_link = STRTAB;
+    symtab->sh_info = firstGlobal;
+    symtab->sh_entsize = sizeof(Elf64_Sym);
+    place(STRTAB, ".strtab", SHT_STRTAB, 0, strtab.bytes.data(),
+          strtab.bytes.size(), 1);
+    place(NOTE_GNU_STACK, ".note.GNU-stack", SHT_PROGBITS, 0, nullptr, 0, 1);
+    // Its own name has to be in the table before the table is written.
+    uint32_t shstrtabName = shstrtab.add(".shstrtab");
+    sections[SHSTRTAB].sh_type = SHT_STRTAB;
+    sections[SHSTRTAB].sh_name = shstrtabName;
+    sections[SHSTRTAB].sh_addralign = 1;
+    sections[SHSTRTAB].sh_offset = out.size();
+    sections[SHSTRTAB].sh_size = shstrtab.bytes.size();
+    out.insert(out.end(), shstrtab.bytes.begin(), shstrtab.bytes.end());
+
+    pad(out, 8);
+    auto *ehdr = reinterpret_cast<Elf64_Ehdr *>(out.data());
+    ehdr->e_shoff = out.size();
+    ehdr->e_shentsize = sizeof(Elf64_Shdr);
+    ehdr->e_shnum = NUM_SECTIONS;
+    ehdr->e_shstrndx = SHSTRTAB;
+    for (const auto &shdr : sections) {
+        put(out, shdr);
+    }
+    return out;
+}
+
+std::vector<uint8_t> writeExecutable(const x86::Image &image) {
+    if (image.hasExternals()) {
+        throw std::runtime_error(
+            "program needs the runtime library; write an object instead");
+    }
+    const x86::Symbol &main = lookup(image, "main");
+
+    // .data gets a writable segment of its own; its address only has to
+    // agree with its file offset modulo the page size.
+    const uint64_t page = 0x1000;
+
+    // _start: call main; mov %eax, %edi; mov $SYS_exit_group, %eax; syscall
+    std::vector<uint8_t> text = {0xE8, 0, 0, 0, 0, 0x89, 0xC7,
+                                 0xB8, 231, 0, 0, 0, 0x0F, 0x05};
+    pad(text, startSize);
+    const uint64_t codeOffset = textOffset + text.size();
+    text.insert(text.end(), image.text.begin(), image.text.end());
+    const uint64_t rodataOffset = alignTo(textOffset + text.size(), 8);
+    const uint64_t codeEnd = rodataOffset + image.rodata.size();
+    const uint64_t dataOffset = alignTo(codeEnd, 8);
+    const uint64_t dataAddress =
+        base + alignTo(codeEnd, page) + dataOffset % page;
+
+    auto address = [&](x86::Section section) {
+        switch (section) {
+        case x86::Section::TEXT:
+            return base + codeOffset;
+        case x86::Section::RODATA:
+            return base + rodataOffset;
+        default:
+            return dataAddress;
+        }
+    };
+
+    int32_t toMain = static_cast<int32_t>(codeOffset + main.offset -
+                                          (textOffset + 5));
+    std::copy_n(reinterpret_cast<const uint8_t *>(&toMain), 4, &text[1]);
+
+    std::vector<uint8_t> data = image.data;
+    const uint64_t codeStart = codeOffset - textOffset;
+    for (const auto &relocation : image.relocations) {
+        const x86::Symbol &symbol = lookup(image, relocation.symbol);
+        uint64_t target =
+            address(symbol.section) + symbol.offset + relocation.addend;
+        uint64_t place = address(relocation.section) + relocation.offset;
+        uint8_t *field = relocation.section == x86::Section::TEXT
+                             ? &text[codeStart + relocation.offset]
+                             : &data[relocation.offset];
+        if (relocation.kind == x86::Relocation::Kind::ABS64) {
+            std::copy_n(reinterpret_cast<const uint8_t *>(&target), 8, field);
+        } else {
+            int32_t rel = static_cast<int32_t>(target - place);
+            std::copy_n(reinterpret_cast<const uint8_t *>(&rel), 4, field);
+        }
+    }
+
+    std::vector<Elf64_Phdr> segments;
+    Elf64_Phdr code{};
+    code.p_type = PT_LOAD;
+    code.p_flags = PF_R | PF_X;
+    code.p_vaddr = code.p_paddr = base;
+    code.p_filesz = code.p_memsz = codeEnd;
+    code.p_align = page;
+    segments.push_back(code);
+    if (!data.empty()) {
+        Elf64_Phdr writable{};
+        writable.p_type = PT_LOAD;
+        writable.p_flags = PF_R | PF_W;
+        writable.p_offset = dataOffset;
+        writable.p_vaddr = writable.p_paddr = dataAddress;
+        writable.p_filesz = writable.p_memsz = data.size();
+        writable.p_align = page;
+        segments.push_back(writable);
+    }
+    Elf64_Phdr stack{};
+    stack.p_type = PT_GNU_STACK;
+    stack.p_flags = PF_R | PF_W;
+    stack.p_align = 16;
+    segments.push_back(stack);
+
+    Elf64_Ehdr ehdr = header(ET_EXEC);
+    ehdr.e_entry = base + textOffset;
+    ehdr.e_phoff = sizeof(Elf64_Ehdr);
+    ehdr.e_phentsize = sizeof(Elf64_Phdr);
+    ehdr.e_phnum = static_cast<uint16_t>(segments.size());
+
+    std::vector<uint8_t> out;
+    put(out, ehdr);
+    for (const auto &segment : segments) {
+        put(out, segment);
+    }
+    out.resize(textOffset, 0);
+    out.insert(out.end(), text.begin(), text.end());
+    pad(out, 8);
+    out.insert(out.end(), image.rodata.begin(), image.rodata.end());
+    if (!data.empty()) {
+        pad(out, 8);
+        out.insert(out.end(), data.begin(), data.end());
+    }
+    return out;
+}
+
+uint64_t executableTextAddress() { return base + textOffset + startSize; }
+
+} // namespace elf
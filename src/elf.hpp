@@ -0,0 +1,27 @@
+#ifndef ELF_HPP_
+#define ELF_HPP_
+
+#include "x86.hpp"
+#include <cstdint>
+#include <vector>
+
+// ELF64 files for x86-64 Linux, written straight from an encoded image so
+// that no assembler runs at build time.
+namespace elf {
+
+// A relocatable object (ET_REL) with .text, .rodata and .data, a symbol
+// table and RELA relocations, ready for the system linker:
+// `cc output.o bin/libxrt.a`.
+std::vector<uint8_t> writeObject(const x86::Image &image);
+
+// A static executable (ET_EXEC) whose entry point calls main and exits
+// with its result. Throws std::runtime_error when the image references
+// external symbols or has no main.
+std::vector<uint8_t> writeExecutable(const x86::Image &image);
+
+// The address the image's .text is loaded at in an executable.
+uint64_t executableTextAddress();
+
+} // namespace elf
+
+#endif // ELF_HPP_
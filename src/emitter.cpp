@@ -0,0 +1,35 @@
+#include "emitter.hpp"
+#include <cstdio>
+#include <stdexcept>
+
+void Emitter::writeFile(const std::string &path, std::string_view contents) {
+    bool toStdout = path == "-";
+    FILE *file = toStdout ? stdout : std::fopen(path.c_str(), "wb");
+    if (!file) {
+        throw std::runtime_error("cannot open " + path + " for writing");
+    }
+    size_t written = std::fwrite(contents.data(), 1, contents.size(), file);
+    bool failed = written != contents.size();
+    failed |= toStdout ? std::fflush(file) != 0 : std::fclose(file) != 0;
+    if (failed) {
+        throw std::runtime_error("cannot write " + path);
+    }
+}
+
+std::string jsonString(std::string_view text) {
+    std::string quoted = "\"";
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if (c < 0x20) {
+            static const char digits[] = "0123456789abcdef";
+            quoted += "\\u00";
+            quoted += digits[c >> 4];
+            quoted += digits[c & 15];
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + '"';
+}
@@ -0,0 +1,56 @@
+#ifndef EMITTER_HPP_
+#define EMITTER_HPP_
+
+#include <charconv>
+#include <concepts>
+#include <string>
+#include <string_view>
+
+// Accumulates generated code in memory so it can be written out at once.
+//
+// write() takes any mix of strings, characters and integers and appends
+// each in place, so callers never concatenate temporary strings. The text
+// goes to a buffer the emitter owns, or to one the caller passes in, and
+// from there to a file or stdout with writeTo.
+class Emitter {
+public:
+    Emitter() : buffer(&own) { own.reserve(1 << 16); }
+    explicit Emitter(std::string &target) : buffer(&target) {}
+    Emitter(const Emitter &) = delete;
+    Emitter &operator=(const Emitter &) = delete;
+
+    template <typename... Args> void write(const Args &...args) {
+        (append(args), ...);
+    }
+
+    void spaces(size_t count) { buffer->append(count, ' '); }
+
+    const std::string &str() const { return *buffer; }
+
+    // Writes everything emitted so far to `path`; see writeFile.
+    void writeTo(const std::string &path) const { writeFile(path, *buffer); }
+
+    // Writes `contents` to `path`, or to stdout when `path` is "-". Throws
+    // std::runtime_error when the file cannot be written.
+    static void writeFile(const std::string &path, std::string_view contents);
+
+private:
+    void append(std::string_view text) { buffer->append(text); }
+    void append(char c) { buffer->push_back(c); }
+
+    template <std::integral T>
+        requires(!std::same_as<T, char> && !std::same_as<T, bool>)
+    void append(T value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer->append(digits, result.ptr);
+    }
+
+    std::string own;
+    std::string *buffer;
+};
+
+// `text` as a JSON string, quotes included.
+std::string jsonString(std::string_view text);
+
+#endif // EMITTER_HPP_
@@ -0,0 +1,280 @@
+#include "gvn.hpp"
+
+static bool isCommutative(Operation op) {
+    return op == Operation::ADD || op == Operation::MULTIPLY ||
+           op == Operation::EQUAL;
+}
+
+void ValueNumbering::run() {
+    purity.run(ast);
+
+    for (auto node : ast.nodes) {
+        if (node->type == NodeType::FUNCTION_DECLARATION) {
+            runOnFunction(dynamic_cast<FunctionDeclaration *>(node));
+        }
+    }
+}
+
+void ValueNumbering::runOnFunction(FunctionDeclaration *function) {
+    versions.clear();
+    valueTable.clear();
+    nodeNumbers.clear();
+    available.clear();
+    scopes.clear();
+
+    for (auto param : function->parameters) {
+        bump(param->name);
+    }
+    processBlock(function->body);
+}
+
+void ValueNumbering::processBlock(FunctionBody *body) {
+    scopes.emplace_back();
+    processBody(body);
+    for (uint32_t value : scopes.back()) {
+        available.erase(value);
+    }
+    scopes.pop_back();
+}
+
+void ValueNumbering::processBody(FunctionBody *body) {
+    // Iterate over a snapshot: materialized temporaries are inserted into
+    // `body` while we walk it.
+    for (auto instruction : body->getInstructions()) {
+        switch (instruction->type) {
+        case NodeType::VARIABLE_DECLARATION: {
+            auto v = dynamic_cast<VariableDeclaration *>(instruction);
+            processExpression(v->initialization_value, body, v);
+            bump(v->name);
+            break;
+        }
+        case NodeType::VARIABLE_ASSIGNMENT: {
+            auto assign = dynamic_cast<VariableAssignment *>(instruction);
+            processExpression(assign->element, body, assign);
+            processExpression(assign->newValue, body, assign);
+            bump(assign->variable->name);
+            break;
+        }
+        case NodeType::EXPRESSION:
+            processExpression(dynamic_cast<Expression *>(instruction), body,
+                              instruction);
+            break;
+        case NodeType::RETURN_STATEMENT:
+            processExpression(
+                dynamic_cast<ReturnStatement *>(instruction)->returned_value,
+                body, instruction);
+            break;
+        case NodeType::IF: {
+            auto if_ = dynamic_cast<IfStatement *>(instruction);
+            processExpression(if_->condition, body, if_);
+            processBlock(if_->ifBody);
+            if (if_->elseBody) {
+                processBlock(if_->elseBody);
+            }
+            break;
+        }
+        case NodeType::ELSE:
+            processBlock(dynamic_cast<ElseStatement *>(instruction)->elseBody);
+            break;
+        case NodeType::WHILE: {
+            auto loop = dynamic_cast<WhileStatement *>(instruction);
+            enterLoop(loop->body);
+            registering = false;
+            processExpression(loop->condition, body, loop);
+            registering = true;
+            processBlock(loop->body);
+            break;
+        }
+        case NodeType::FOR: {
+            auto loop = dynamic_cast<ForStatement *>(instruction);
+            processExpression(loop->init->initialization_value, body, loop);
+            bump(loop->init->name);
+            enterLoop(loop->body);
+            bump(loop->init->name);
+            bump(loop->step->variable->name);
+            registering = false;
+            processExpression(loop->condition, body, loop);
+            registering = true;
+            processBlock(loop->body);
+            registering = false;
+            processExpression(loop->step->newValue, body, loop);
+            registering = true;
+            break;
+        }
+        case NodeType::PRINT_NODE:
+            for (auto argument :
+                 dynamic_cast<PrintNode *>(instruction)->arguments2) {
+                processExpression(argument, body, instruction);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void ValueNumbering::processExpression(Expression *expression,
+                                       FunctionBody *block,
+                                       Instruction *anchor) {
+    if (!expression) {
+        return;
+    }
+    number(expression);
+    rewrite(expression, block, anchor);
+}
+
+uint32_t ValueNumbering::number(Expression *expression) {
+    if (!expression) {
+        return OPAQUE;
+    }
+
+    std::string key;
+    switch (expression->type) {
+    case Expression::Type::LITERAL:
+        key = "c" + dataTypeToString(expression->variable_type) + ":" +
+              expression->literal_value;
+        break;
+    case Expression::Type::VARIABLE_REFERENCE:
+        if (expression->is_global || expression->variable_type.isArray() ||
+            !versions.count(expression->variable_name)) {
+            return OPAQUE;
+        }
+        key = "v" + expression->variable_name + "#" +
+              std::to_string(versions[expression->variable_name]);
+        break;
+    case Expression::Type::BINARY_OPERATION: {
+        uint32_t left = number(expression->left_operand);
+        uint32_t right = number(expression->right_operand);
+        if (left == OPAQUE || right == OPAQUE) {
+            return OPAQUE;
+        }
+        if (isCommutative(expression->operation) && left > right) {
+            std::swap(left, right);
+        }
+        key = "b" + operationToString(expression->operation) + ":" +
+              std::to_string(left) + "," + std::to_string(right);
+        break;
+    }
+    case Expression::Type::FUNCTION_CALL: {
+        bool opaque = !isPure(expression->function_name);
+        key = "f" + expression->function_name + "(";
+        for (auto argument : expression->arguments) {
+            uint32_t value = number(argument);
+            opaque = opaque || value == OPAQUE;
+            key += std::to_string(value) + ",";
+        }
+        if (opaque) {
+            return OPAQUE;
+        }
+        key += ")";
+        break;
+    }
+    default:
+        return OPAQUE;
+    }
+
+    auto it = valueTable.find(key);
+    uint32_t value;
+    if (it != valueTable.end()) {
+        value = it->second;
+    } else {
+        value = static_cast<uint32_t>(valueTable.size()) + 1;
+        valueTable.emplace(key, value);
+    }
+    nodeNumbers[expression] = value;
+    return value;
+}
+
+void ValueNumbering::rewrite(Expression *expression, FunctionBody *block,
+                             Instruction *anchor) {
+    if (!expression) {
+        return;
+    }
+
+    bool candidate =
+        (expression->type == Expression::Type::BINARY_OPERATION ||
+         expression->type == Expression::Type::FUNCTION_CALL) &&
+        expression->variable_type.category != DataType::Category::UNKNOWN &&
+        nodeNumbers.count(expression) > 0;
+
+    uint32_t value = candidate ? nodeNumbers[expression] : OPAQUE;
+    if (candidate) {
+        auto it = available.find(value);
+        if (it != available.end()) {
+            if (!it->second.temp) {
+                materialize(it->second);
+            }
+            expression->becomeReference(it->second.temp);
+            eliminatedCount++;
+            return;
+        }
+    }
+
+    rewrite(expression->left_operand, block, anchor);
+    rewrite(expression->right_operand, block, anchor);
+    for (auto argument : expression->arguments) {
+        rewrite(argument, block, anchor);
+    }
+
+    if (candidate && registering) {
+        available[value] = {expression, block, anchor, nullptr};
+        scopes.back().push_back(value);
+    }
+}
+
+// Move the first computation of a value into a temporary declared right
+// before the statement that contained it, and make that site read the
+// temporary as well.
+void ValueNumbering::materialize(Available &value) {
+    Expression *first = value.first;
+    auto declaration = first->hoistInto(
+        ast.arena, reservedPrefix + "vn" + std::to_string(temporaryCount++));
+    value.temp = declaration;
+    Expression *computed = declaration->initialization_value;
+    value.block->insertInstructionBefore(value.anchor, declaration);
+
+    nodeNumbers[computed] = nodeNumbers[first];
+    nodeNumbers.erase(first);
+
+    // Values first computed inside the moved subtree are now computed by the
+    // declaration; later temporaries for them must be placed before it.
+    retarget(computed->left_operand, value.block, declaration);
+    retarget(computed->right_operand, value.block, declaration);
+    for (auto argument : computed->arguments) {
+        retarget(argument, value.block, declaration);
+    }
+}
+
+void ValueNumbering::retarget(Expression *expression, FunctionBody *block,
+                              Instruction *anchor) {
+    if (!expression) {
+        return;
+    }
+    auto number = nodeNumbers.find(expression);
+    if (number != nodeNumbers.end()) {
+        auto it = available.find(number->second);
+        if (it != available.end() && it->second.first == expression) {
+            it->second.block = block;
+            it->second.anchor = anchor;
+        }
+    }
+    retarget(expression->left_operand, block, anchor);
+    retarget(expression->right_operand, block, anchor);
+    for (auto argument : expression->arguments) {
+        retarget(argument, block, anchor);
+    }
+}
+
+void ValueNumbering::bump(const std::string &variable) {
+    versions[variable] = ++nextVersion;
+}
+
+// Everything assigned in the loop may differ between iterations; give it a
+// fresh number before the condition is numbered.
+void ValueNumbering::enterLoop(FunctionBody *body) {
+    std::unordered_set<std::string> assigned;
+    collectAssignedVariables(body, assigned);
+    for (const auto &name : assigned) {
+        bump(name);
+    }
+}
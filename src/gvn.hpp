@@ -0,0 +1,78 @@
+#ifndef GVN_HPP_
+#define GVN_HPP_
+
+#include "analysis.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Global value numbering over the AST.
+//
+// Every binary operation and pure function call gets a value number derived
+// from its operator and the value numbers of its operands, where a variable's
+// number changes each time it is (re)assigned. When a value number is seen
+// again in a block dominated by its first computation, the first computation
+// is hoisted into a `__vnN` temporary and both sites read the temporary.
+// Variables assigned in a loop get a fresh number on loop entry, so only
+// loop-invariant values from outside a loop are reused inside it.
+class ValueNumbering {
+public:
+    ValueNumbering(ASTGen &ast) : ast(ast) {}
+
+    void run();
+
+    // Number of recomputations replaced by a temporary.
+    size_t eliminated() const { return eliminatedCount; }
+    size_t temporaries() const { return temporaryCount; }
+
+    bool isPure(const std::string &functionName) const {
+        return purity.isPure(functionName);
+    }
+
+private:
+    struct Available {
+        Expression *first;
+        FunctionBody *block;
+        Instruction *anchor;
+        // The temporary it was hoisted into, once it is.
+        VariableDeclaration *temp = nullptr;
+    };
+
+    static constexpr uint32_t OPAQUE = 0;
+
+    void runOnFunction(FunctionDeclaration *function);
+    void processBody(FunctionBody *body);
+    void processExpression(Expression *expression, FunctionBody *block,
+                           Instruction *anchor);
+    void processBlock(FunctionBody *body);
+
+    uint32_t number(Expression *expression);
+    void rewrite(Expression *expression, FunctionBody *block,
+                 Instruction *anchor);
+    void materialize(Available &value);
+    void retarget(Expression *expression, FunctionBody *block,
+                  Instruction *anchor);
+    void bump(const std::string &variable);
+    void enterLoop(FunctionBody *body);
+
+    ASTGen &ast;
+    PurityAnalysis purity;
+
+    // Per-function state.
+    std::unordered_map<std::string, uint32_t> versions;
+    std::unordered_map<std::string, uint32_t> valueTable;
+    std::unordered_map<Expression *, uint32_t> nodeNumbers;
+    std::unordered_map<uint32_t, Available> available;
+    std::vector<std::vector<uint32_t>> scopes;
+    uint32_t nextVersion = 0;
+    // Cleared while numbering loop conditions and steps, which run on every
+    // iteration and so cannot provide a value to code after them.
+    bool registering = true;
+
+    size_t eliminatedCount = 0;
+    size_t temporaryCount = 0;
+};
+
+#endif // GVN_HPP_
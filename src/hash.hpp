@@ -0,0 +1,35 @@
+#ifndef HASH_HPP_
+#define HASH_HPP_
+
+#include <cstdint>
+#include <string_view>
+
+// 64-bit FNV-1a, fed a piece at a time. Each piece is followed by a
+// separator so that ("ab", "c") and ("a", "bc") hash differently.
+class Hasher {
+public:
+    void add(std::string_view text) {
+        for (unsigned char c : text) {
+            mix(c);
+        }
+        mix(0xff);
+    }
+
+    void add(uint64_t number) {
+        for (int i = 0; i < 8; ++i) {
+            mix(static_cast<unsigned char>(number >> (i * 8)));
+        }
+    }
+
+    uint64_t value() const { return state; }
+
+private:
+    void mix(unsigned char c) {
+        state ^= c;
+        state *= 0x100000001b3;
+    }
+
+    uint64_t state = 0xcbf29ce484222325;
+};
+
+#endif // HASH_HPP_
@@ -0,0 +1,148 @@
+#include "jit.hpp"
+#include "xrt.h"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+// Runtime entry points that generated code may call, resolved against the
+// copy of libxrt linked into the compiler.
+const std::unordered_map<std::string, void *> &runtimeSymbols() {
+    static const std::unordered_map<std::string, void *> symbols = {
+        {"xrt_print_str", reinterpret_cast<void *>(&xrt_print_str)},
+        {"xrt_print_cstr", reinterpret_cast<void *>(&xrt_print_cstr)},
+        {"xrt_print_int", reinterpret_cast<void *>(&xrt_print_int)},
+        {"xrt_print_bool", reinterpret_cast<void *>(&xrt_print_bool)},
+        {"xrt_print_char", reinterpret_cast<void *>(&xrt_print_char)},
+        {"xrt_print_newline", reinterpret_cast<void *>(&xrt_print_newline)},
+        {"xrt_push", reinterpret_cast<void *>(&xrt_push)},
+        {"xrt_index_error", reinterpret_cast<void *>(&xrt_index_error)},
+    };
+    return symbols;
+}
+
+// jmp *0(%rip), followed by the 8-byte target.
+constexpr size_t STUB_SIZE = 16;
+
+size_t alignTo(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+JIT::JIT(const x86::Image &image) : image(image) {
+    std::vector<const x86::Symbol *> externals;
+    std::unordered_map<std::string, size_t> stubs;
+    for (const auto &symbol : image.symbols) {
+        if (symbol.section == x86::Section::UNDEFINED) {
+            stubs[symbol.name] = externals.size();
+            externals.push_back(&symbol);
+        }
+    }
+
+    // Code, stubs and rodata share the pages that become executable; data
+    // starts on a page of its own and stays writable.
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    stubsOffset = alignTo(image.text.size(), 16);
+    rodataOffset = stubsOffset + externals.size() * STUB_SIZE;
+    dataOffset = alignTo(rodataOffset + image.rodata.size(), page);
+    size = alignTo(dataOffset + image.data.size(), page);
+
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("cannot map memory for the JIT");
+    }
+    memory = static_cast<uint8_t *>(mapping);
+    try {
+        std::memcpy(memory, image.text.data(), image.text.size());
+        std::memcpy(memory + rodataOffset, image.rodata.data(),
+                    image.rodata.size());
+        std::memcpy(memory + dataOffset, image.data.data(),
+                    image.data.size());
+
+        const auto &runtime = runtimeSymbols();
+        for (size_t k = 0; k < externals.size(); ++k) {
+            const std::string &name = externals[k]->name;
+            auto it = runtime.find(name);
+            if (it == runtime.end()) {
+                throw std::runtime_error("undefined symbol " + name);
+            }
+            uint8_t *stub = memory + stubsOffset + k * STUB_SIZE;
+            const uint8_t jump[] = {0xFF, 0x25, 0, 0, 0, 0};
+            std::memcpy(stub, jump, sizeof(jump));
+            uint64_t target = reinterpret_cast<uint64_t>(it->second);
+            std::memcpy(stub + sizeof(jump), &target, sizeof(target));
+        }
+
+        for (const auto &relocation : image.relocations) {
+            const x86::Symbol *symbol = image.find(relocation.symbol);
+            uintptr_t target;
+            if (symbol->section == x86::Section::UNDEFINED) {
+                target = reinterpret_cast<uintptr_t>(memory + stubsOffset) +
+                         stubs.at(symbol->name) * STUB_SIZE;
+            } else {
+                target = address(symbol->section, symbol->offset);
+            }
+            target += relocation.addend;
+            uintptr_t place = address(relocation.section, relocation.offset);
+            auto *field = reinterpret_cast<uint8_t *>(place);
+            if (relocation.kind == x86::Relocation::Kind::ABS64) {
+                uint64_t value = target;
+                std::memcpy(field, &value, sizeof(value));
+            } else {
+                int32_t value = static_cast<int32_t>(target - place);
+                std::memcpy(field, &value, sizeof(value));
+            }
+        }
+
+        if (mprotect(memory, dataOffset, PROT_READ | PROT_EXEC) != 0) {
+            throw std::runtime_error("cannot make JIT code executable");
+        }
+    } catch (...) {
+        munmap(memory, size);
+        throw;
+    }
+}
+
+JIT::~JIT() {
+    if (memory) {
+        munmap(memory, size);
+    }
+}
+
+uintptr_t JIT::address(x86::Section section, uint64_t offset) const {
+    size_t base = section == x86::Section::RODATA ? rodataOffset
+                  : section == x86::Section::DATA ? dataOffset
+                                                  : 0;
+    return reinterpret_cast<uintptr_t>(memory) + base + offset;
+}
+
+void JIT::writePerfMap() const {
+    std::ofstream map("/tmp/perf-" + std::to_string(getpid()) + ".map");
+    map << std::hex;
+    for (const auto &symbol : image.symbols) {
+        if (symbol.function) {
+            map << address(symbol.section, symbol.offset) << " "
+                << symbol.size << " " << symbol.name << "\n";
+        }
+    }
+}
+
+int JIT::run() {
+    const x86::Symbol *main = image.find("main");
+    if (!main || !main->function) {
+        throw std::runtime_error("program has no main function");
+    }
+    auto entry = reinterpret_cast<int (*)()>(
+        address(x86::Section::TEXT, main->offset));
+    int result = entry();
+    xrt_flush();
+    return result;
+}
@@ -0,0 +1,42 @@
+#ifndef JIT_HPP_
+#define JIT_HPP_
+
+#include "x86.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// Runs an encoded module inside the compiler process (--run).
+//
+// The image is copied into anonymous memory mapped read-write, relocated,
+// and then the code pages are switched to read-execute before anything
+// runs. Calls into the runtime go through small jump stubs placed next to
+// the code, since the runtime linked into the compiler may be further
+// away than a 32-bit displacement reaches.
+class JIT {
+public:
+    // Throws std::runtime_error when the image references a symbol that is
+    // neither defined in it nor part of the runtime, or mapping fails.
+    explicit JIT(const x86::Image &image);
+    ~JIT();
+    JIT(const JIT &) = delete;
+    JIT &operator=(const JIT &) = delete;
+
+    // Writes /tmp/perf-<pid>.map so perf can name the JITed functions.
+    void writePerfMap() const;
+
+    // Calls main and flushes stdout; returns main's result.
+    int run();
+
+private:
+    uintptr_t address(x86::Section section, uint64_t offset) const;
+
+    const x86::Image &image;
+    uint8_t *memory = nullptr;
+    size_t size = 0;
+    // Offsets of the stubs, rodata and data from the start of the mapping.
+    size_t stubsOffset = 0;
+    size_t rodataOffset = 0;
+    size_t dataOffset = 0;
+};
+
+#endif // JIT_HPP_
@@ -1,47 +1,98 @@
 #include "lexer.hpp"
+#include "ast.hpp"
+#include <sstream>
+#include <stdexcept>
 
 void Lexer::read() {
-    file_stream.open(file_name);
-    if (!file_stream.is_open()) {
-        std::cerr << "Cannot open file " << file_name << std::endl;
+    std::istringstream buffer(source);
+    std::istream *input = &buffer;
+    if (!hasSource) {
+        file_stream.open(file_name);
+        if (!file_stream.is_open()) {
+            throw std::runtime_error("cannot open " + file_name);
+        }
+        input = &file_stream;
     }
     std::string line;
-    while (std::getline(file_stream, line)) {
+    while (std::getline(*input, line)) {
         file_content += line + "\n";
     }
-    file_content[file_content.size() - 1] = '\0';
+    if (!file_content.empty()) {
+        file_content[file_content.size() - 1] = '\0';
+    }
+}
+
+std::string Lexer::sourceLine(int line) const {
+    size_t start = 0;
+    for (int i = 1; i < line && start != std::string::npos; ++i) {
+        start = file_content.find('\n', start);
+        if (start != std::string::npos) {
+            start++;
+        }
+    }
+    if (start == std::string::npos || start >= file_content.size()) {
+        return {};
+    }
+    size_t end = file_content.find('\n', start);
+    std::string text = file_content.substr(
+        start, end == std::string::npos ? std::string::npos : end - start);
+    // read() ends the content with a NUL in place of the last newline.
+    while (!text.empty() && (text.back() == '\0' || text.back() == '\r')) {
+        text.pop_back();
+    }
+    return text;
+}
+
+void Lexer::accountMemory(MemoryUsage &usage) const {
+    usage.add("source", 2, heapBytes(source) + heapBytes(file_content));
+    size_t bytes = words.capacity() * sizeof(std::string) +
+                   positions.capacity() * sizeof(positions[0]);
+    for (const auto &word : words) {
+        bytes += heapBytes(word);
+    }
+    usage.add("lexer words", words.size(), bytes);
+    bytes = tokens.capacity() * sizeof(tokens[0]) +
+            tokens.size() * sizeof(Token);
+    for (const auto &token : tokens) {
+        bytes += heapBytes(token->value);
+    }
+    usage.add("tokens", tokens.size(), bytes);
 }
 
 void Lexer::lex() {
-    int i = 0;
+    size_t i = 0;
     int line = 1;
-    int col = 1;
+    // Where the current line starts, for the columns of words.
+    size_t lineStart = 0;
+    auto addWord = [&](size_t start, size_t length) {
+        words.push_back(file_content.substr(start, length));
+        positions.push_back(
+            {line, static_cast<int>(start - lineStart) + 1});
+    };
 
     while (i < file_content.size()) {
         while (i < file_content.size() &&
                (isDelimiter(file_content[i]) || isSpace(file_content[i]))) {
             if (file_content[i] == '\n') {
                 line++;
-                col = 1;
-            } else if (file_content[i] != ' ') {
-                col++;
+                lineStart = i + 1;
             }
             i++;
         }
 
         if (file_content[i] == '#') {
             while (i < file_content.size() && file_content[i] != '\n') {
-                col++;
                 i++;
             }
         }
 
-        int word_end = i;
+        size_t word_end = i;
 
         if (file_content[word_end] == '"') {
             word_end++;
             while (word_end < file_content.size() &&
-                   file_content[word_end] != '"') {
+                   file_content[word_end] != '"' &&
+                   file_content[word_end] != '\0') {
                 word_end++;
             }
             if (word_end < file_content.size() &&
@@ -50,6 +101,7 @@ void Lexer::lex() {
             }
         } else {
             while (word_end < file_content.size() &&
+                   file_content[word_end] != '\0' &&
                    !isDelimiter(file_content[word_end]) &&
                    !isSpace(file_content[word_end]) &&
                    !isBreaker(file_content[word_end])) {
@@ -58,17 +110,34 @@ void Lexer::lex() {
         }
 
         if (i < word_end) {
-            std::string token = file_content.substr(i, word_end - i);
-            words.push_back(token);
+            addWord(i, word_end - i);
+            // A string may span lines.
+            for (size_t j = i; j < word_end; ++j) {
+                if (file_content[j] == '\n') {
+                    line++;
+                    lineStart = j + 1;
+                }
+            }
         }
 
-        if (isBreaker(file_content[word_end])) {
-            words.push_back(std::string(1, file_content[word_end]));
+        if (isCompoundOperator(word_end)) {
+            addWord(word_end, 2);
+            word_end++;
+        } else if (isBreaker(file_content[word_end])) {
+            addWord(word_end, 1);
+        } else if (word_end < file_content.size() &&
+                   file_content[word_end] == '\0') {
+            // The end of the file, which read() marks with a NUL, even
+            // right after a word or inside a string.
+            addWord(word_end, 1);
+        } else if (word_end < file_content.size() &&
+                   file_content[word_end] == '\n') {
+            line++;
+            lineStart = word_end + 1;
         }
 
         i = word_end;
         i++;
-        col++;
     }
 }
 
@@ -128,6 +197,15 @@ void Lexer::tokenalize() {
             } else if (word == "else") {
                 token->type = ELSE;
                 token->value = word;
+            } else if (word == "while") {
+                token->type = WHILE;
+                token->value = word;
+            } else if (word == "for") {
+                token->type = FOR;
+                token->value = word;
+            } else if (word == "import") {
+                token->type = IMPORT;
+                token->value = word;
             } else if (isNumber(word[0])) {
                 bool is_float = false;
                 for (int j = 0; j < word.size(); j++) {
@@ -151,6 +229,12 @@ void Lexer::tokenalize() {
             } else if (word[0] == '}') {
                 token->type = RBRACE;
                 token->value = "}";
+            } else if (word[0] == '[') {
+                token->type = LBRACKET;
+                token->value = word;
+            } else if (word[0] == ']') {
+                token->type = RBRACKET;
+                token->value = word;
             } else if (word[0] == '(') {
                 token->type = LPAREN;
                 token->value = word;
@@ -167,6 +251,9 @@ void Lexer::tokenalize() {
                 token->type = COMMA;
                 token->value = word;
             } else if (word[0] == '"') {
+                if (word.size() < 2 || word.back() != '"') {
+                    throw std::runtime_error("unterminated string");
+                }
                 std::string content;
                 for (int j = 0; j < word.size(); j++) {
                     if (word[j] != '"') {
@@ -187,6 +274,15 @@ void Lexer::tokenalize() {
             } else if (word[0] == '/') {
                 token->type = SLASH;
                 token->value = word;
+            } else if (word == ">=") {
+                token->type = GREATER_EQUAL;
+                token->value = word;
+            } else if (word == "<=") {
+                token->type = LESS_EQUAL;
+                token->value = word;
+            } else if (word == "!=") {
+                token->type = NOT_EQUAL;
+                token->value = word;
             } else if (word[0] == '>') {
                 token->type = GREATER;
                 token->value = word;
@@ -198,18 +294,36 @@ void Lexer::tokenalize() {
                 token->value = word;
             } else if (word[0] == '\0') {
                 token->type = EoF;
-                token->value = word;
             } else {
+                if (word.rfind(reservedPrefix, 0) == 0 && diagnostics) {
+                    auto [line, column] = positions[word_index];
+                    diagnostics->error(file_name, line, column,
+                                       "Name '" + word +
+                                           "' is reserved: names starting "
+                                           "with '" +
+                                           reservedPrefix +
+                                           "' are the compiler's.",
+                                       sourceLine(line));
+                }
                 token->type = IDENTIFIER;
                 token->value = word;
             }
 
+            token->line = positions[word_index].first;
+            token->col = positions[word_index].second;
             tokens.push_back(std::move(token));
             word_index++;
             token_index++;
         } catch (std::exception &e) {
-            std::cerr << "Error tokenizing word '" << words[word_index]
-                      << "': " << e.what() << std::endl;
+            if (diagnostics) {
+                auto [line, column] = positions[word_index];
+                diagnostics->error(file_name, line, column,
+                                   "Error tokenizing word '" +
+                                       words[word_index] + "': " + e.what(),
+                                   sourceLine(line));
+            }
+            // The word is dropped; the parser reports what that leaves.
+            word_index++;
         }
     }
 }
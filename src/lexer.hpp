@@ -1,3 +1,5 @@
+#include "diagnostics.hpp"
+#include "memory.hpp"
 #include <algorithm>
 #include <cstdint>
 #include <fstream>
@@ -51,31 +53,43 @@ typedef enum TokenType {
     TEST,
     IF,
     ELSE,
+    WHILE,
+    FOR,
+    IMPORT,
 } TokenType;
 
 typedef struct Token {
     TokenType type;
     std::string value;
-    int col;
-    int line;
+    int col = 0;
+    int line = 0;
 } Token;
 
 class Lexer {
 public:
     Token currentToken;
     Lexer(std::string file_name) { this->file_name = file_name; }
+    // Lexes `source` instead of reading a file; `file_name` only names it.
+    Lexer(std::string file_name, std::string source)
+        : file_name(std::move(file_name)), source(std::move(source)),
+          hasSource(true) {}
+
+    // Where tokenizing errors are recorded; they are dropped when unset.
+    Diagnostics *diagnostics = nullptr;
 
     void read();
     void lex();
     void tokenalize();
 
-    auto print_content() {
-        for (auto &w : words) {
-            std::cout << w << std::endl;
-        }
-    }
+    // Adds the source buffers, the words and the tokens to `usage`.
+    void accountMemory(MemoryUsage &usage) const;
+
+    const std::string &fileName() const { return file_name; }
 
-    auto token_to_string(TokenType type) {
+    // The text of source line `line` (1-based), for diagnostics.
+    std::string sourceLine(int line) const;
+
+    static const char *token_to_string(TokenType type) {
         switch (type) {
         case UNKNOWN:
             return "UNKNOWN";
@@ -159,19 +173,18 @@ public:
             return "IF";
         case ELSE:
             return "ELSE";
+        case WHILE:
+            return "WHILE";
+        case FOR:
+            return "FOR";
+        case IMPORT:
+            return "IMPORT";
         case PRINTLN_KW:
             return "PRINTLN";
         }
         return "UNKNOWN";
     }
 
-    auto print_tokens() {
-        for (auto &t : tokens) {
-            std::cout << token_to_string(t->type) << " " << t->value
-                      << std::endl;
-        }
-    }
-
     ~Lexer() {
         if (file_stream.is_open()) {
             file_stream.close();
@@ -200,13 +213,20 @@ protected:
     std::string file_name;
     std::string file_content;
     std::vector<std::string> words;
+    // The line and column of each word.
+    std::vector<std::pair<int, int>> positions;
     uint32_t index = 0;
     uint32_t word_index = 0;
     uint32_t token_index = 0;
-    std::vector<std::string> breakers = {"==", "&&", "->", "||", ")", "(", "{",
-                                         "}",  "[",  "]",  ",",  ";", ":", ","};
-    std::vector<char> delimiters = {'\t', '\r', '\n', ','};
+    std::vector<std::string> breakers = {"==", "&&", "->", "||", "<=", ">=",
+                                         "!=", ")",  "(",  "{",  "}",  "[",
+                                         "]",  ",",  ";",  ":",  ","};
+    // Two character operators that are kept together as one word.
+    std::vector<std::string> compoundOperators = {"==", "<=", ">=", "!="};
+    std::vector<char> delimiters = {'\t', '\r', '\n'};
     std::ifstream file_stream;
+    std::string source;
+    bool hasSource = false;
 
     bool isBreaker(char c) {
         for (const std::string &breaker : breakers) {
@@ -217,6 +237,18 @@ protected:
         return false;
     }
 
+    bool isCompoundOperator(size_t i) {
+        if (i + 1 >= file_content.size()) {
+            return false;
+        }
+        for (const std::string &op : compoundOperators) {
+            if (file_content[i] == op[0] && file_content[i + 1] == op[1]) {
+                return true;
+            }
+        }
+        return false;
+    }
+
     bool isDelimiter(char c) {
         return std::find(delimiters.begin(), delimiters.end(), c) !=
                delimiters.end();
@@ -0,0 +1,969 @@
+#include "lir.hpp"
+#include "analysis.hpp"
+#include <charconv>
+#include <cstdint>
+#include <stdexcept>
+
+// Fixed arrays up to this many elements are cleared with straight-line
+// stores; larger ones with a loop.
+static constexpr int MAX_INLINE_CLEAR = 16;
+
+// Layout of xrt_array in runtime/xrt.h.
+static constexpr long long ARRAY_DATA = 0;
+static constexpr long long ARRAY_LEN = 8;
+static constexpr int ARRAY_HEADER_SIZE = 24;
+
+Cond invertCond(Cond cond) {
+    switch (cond) {
+    case Cond::EQ:
+        return Cond::NE;
+    case Cond::NE:
+        return Cond::EQ;
+    case Cond::LT:
+        return Cond::GE;
+    case Cond::LE:
+        return Cond::GT;
+    case Cond::GT:
+        return Cond::LE;
+    case Cond::GE:
+        return Cond::LT;
+    }
+    return cond;
+}
+
+std::string condToString(Cond cond) {
+    switch (cond) {
+    case Cond::EQ:
+        return "eq";
+    case Cond::NE:
+        return "ne";
+    case Cond::LT:
+        return "lt";
+    case Cond::LE:
+        return "le";
+    case Cond::GT:
+        return "gt";
+    case Cond::GE:
+        return "ge";
+    }
+    return "?";
+}
+
+static bool comparisonCond(Operation op, Cond &cond) {
+    switch (op) {
+    case Operation::EQUAL:
+        cond = Cond::EQ;
+        return true;
+    case Operation::NOT_EQUAL:
+        cond = Cond::NE;
+        return true;
+    case Operation::LESS:
+        cond = Cond::LT;
+        return true;
+    case Operation::LESS_EQUAL:
+        cond = Cond::LE;
+        return true;
+    case Operation::GREATER:
+        cond = Cond::GT;
+        return true;
+    case Operation::GREATER_EQUAL:
+        cond = Cond::GE;
+        return true;
+    default:
+        return false;
+    }
+}
+
+int widthOf(const DataType &type) {
+    switch (type.category) {
+    case DataType::Category::STRING:
+    case DataType::Category::ARRAY:
+        return 8;
+    case DataType::Category::FLOAT:
+        throw std::runtime_error(
+            "the native backend does not support float values yet");
+    default:
+        return 4;
+    }
+}
+
+static std::string operandToString(const LOperand &operand) {
+    switch (operand.kind) {
+    case LOperand::Kind::VREG:
+        return "%" + std::to_string(operand.vreg);
+    case LOperand::Kind::IMM:
+        return std::to_string(operand.imm);
+    default:
+        return "_";
+    }
+}
+
+std::string unescapeString(const std::string &text) {
+    std::string result;
+    for (size_t k = 0; k < text.size(); ++k) {
+        if (text[k] != '\\' || k + 1 == text.size()) {
+            result += text[k];
+            continue;
+        }
+        char c = text[++k];
+        switch (c) {
+        case 'n':
+            result += '\n';
+            break;
+        case 't':
+            result += '\t';
+            break;
+        case 'r':
+            result += '\r';
+            break;
+        case 'b':
+            result += '\b';
+            break;
+        case 'f':
+            result += '\f';
+            break;
+        case '0':
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        case '5':
+        case '6':
+        case '7': {
+            int value = 0;
+            for (int digits = 0; digits < 3 && k < text.size() &&
+                                 text[k] >= '0' && text[k] <= '7';
+                 ++digits, ++k) {
+                value = value * 8 + (text[k] - '0');
+            }
+            --k;
+            result += static_cast<char>(value);
+            break;
+        }
+        default:
+            result += c;
+        }
+    }
+    return result;
+}
+
+std::string lirToString(const LFunction &function) {
+    std::string out = function.name + ":\n";
+    for (const auto &inst : function.instructions) {
+        std::string dst =
+            inst.dst >= 0 ? "%" + std::to_string(inst.dst) + " = " : "";
+        std::string a = operandToString(inst.a);
+        std::string b = operandToString(inst.b);
+        std::string label = "L" + std::to_string(inst.label);
+        std::string disp = std::to_string(inst.disp);
+        switch (inst.op) {
+        case LOp::CONST:
+        case LOp::MOV:
+            out += "  " + dst + a + "\n";
+            break;
+        case LOp::ADDR:
+            out += "  " + dst + "&" + inst.symbol + "\n";
+            break;
+        case LOp::FRAME:
+            out += "  " + dst + "frame " + disp + "\n";
+            break;
+        case LOp::BIN:
+            out += "  " + dst + a + " " + operationToString(inst.operation) +
+                   " " + b + "\n";
+            break;
+        case LOp::CMP:
+            out += "  " + dst + condToString(inst.cond) + " " + a + ", " + b +
+                   "\n";
+            break;
+        case LOp::LOAD:
+            out += "  " + dst + "load" + std::to_string(inst.width) + " [" +
+                   a + " + " + b + " * 8 + " + disp + "]\n";
+            break;
+        case LOp::STORE:
+            out += "  store" + std::to_string(inst.width) + " [" + a + " + " +
+                   b + " * 8 + " + disp + "], " + operandToString(inst.c) +
+                   "\n";
+            break;
+        case LOp::CALL: {
+            out += "  " + dst + "call " + inst.symbol + "(";
+            for (size_t i = 0; i < inst.args.size(); ++i) {
+                out += (i ? ", " : "") + operandToString(inst.args[i]);
+            }
+            out += ")\n";
+            break;
+        }
+        case LOp::PARAM:
+            out += "  " + dst + "param " + disp + "\n";
+            break;
+        case LOp::JMP:
+            out += "  jmp " + label + "\n";
+            break;
+        case LOp::JCC:
+            out += "  j" + condToString(inst.cond) + " " + a + ", " + b +
+                   ", " + label + "\n";
+            break;
+        case LOp::LABEL:
+            out += label + ":\n";
+            break;
+        case LOp::RET:
+            out += "  ret " + a + "\n";
+            break;
+        case LOp::CHECK:
+            out += "  check " + a + ", " + b + "\n";
+            break;
+        }
+    }
+    return out;
+}
+
+LModule Lowering::run() {
+    for (auto node : ast.nodes) {
+        if (node->type == NodeType::VARIABLE_DECLARATION) {
+            lowerGlobal(dynamic_cast<VariableDeclaration *>(node));
+        }
+    }
+    for (auto node : ast.nodes) {
+        if (node->type == NodeType::FUNCTION_DECLARATION) {
+            lowerFunction(dynamic_cast<FunctionDeclaration *>(node));
+        }
+    }
+    return std::move(module);
+}
+
+// Globals live in the data section, so their initializers must be literals.
+void Lowering::lowerGlobal(VariableDeclaration *declaration) {
+    const DataType &type = declaration->variable_type;
+    LGlobal global;
+    global.name = declaration->name;
+    global.size = widthOf(type);
+    if (type.isFixedArray()) {
+        global.size = 8 * type.length;
+    } else if (type.isArray()) {
+        global.size = ARRAY_HEADER_SIZE;
+    }
+
+    if (const Expression *init = declaration->initialization_value) {
+        if (init->type != Expression::Type::LITERAL) {
+            throw std::runtime_error(
+                "the native backend needs a literal initializer for global '" +
+                declaration->name + "'");
+        }
+        if (type.category == DataType::Category::STRING) {
+            global.stringLabel = stringLabel(init->literal_value);
+        } else {
+            global.value = lowerExpression(init).imm;
+        }
+    }
+
+    module.globals.push_back(global);
+    globals[declaration->name] = {Storage::GLOBAL, type, -1, -1,
+                                  declaration->name};
+}
+
+void Lowering::lowerFunction(FunctionDeclaration *function) {
+    module.functions.emplace_back();
+    current = &module.functions.back();
+    current->name = function->name;
+    current->numParams = static_cast<int>(function->parameters.size());
+    current->line = function->line;
+    line = function->line;
+
+    scopes.clear();
+    scopes.emplace_back();
+    reboundArrays.clear();
+    bound.clear();
+    forEachInstruction(function->body, [&](Instruction *instruction) {
+        auto assign = dynamic_cast<VariableAssignment *>(instruction);
+        if (assign && !assign->element &&
+            assign->variable->variable_type.isArray()) {
+            reboundArrays.insert(assign->variable->name);
+        }
+    });
+    for (size_t i = 0; i < function->parameters.size(); ++i) {
+        VariableDeclaration *param = function->parameters[i];
+        int width = widthOf(param->variable_type);
+        int vreg = newVreg(width);
+        LInst &inst = emit(LOp::PARAM);
+        inst.dst = vreg;
+        inst.width = width;
+        inst.disp = static_cast<long long>(i);
+        declare(param,
+                {Storage::VREG, param->variable_type, vreg, -1, {}});
+    }
+
+    lowerBody(function->body);
+
+    // Falling off the end returns zero, as `main` does in C.
+    if (current->instructions.empty() ||
+        current->instructions.back().op != LOp::RET) {
+        LInst &ret = emit(LOp::RET);
+        ret.a = LOperand::constant(0);
+        ret.width = widthOf(function->return_type);
+    }
+    current = nullptr;
+}
+
+void Lowering::lowerBody(FunctionBody *body) {
+    scopes.emplace_back();
+    const auto &instructions = body->getInstructions();
+    for (size_t i = 0; i < instructions.size(); ++i) {
+        Instruction *next =
+            i + 1 < instructions.size() ? instructions[i + 1] : nullptr;
+        if (instructions[i]->type == NodeType::ELSE) {
+            // Lowered together with the preceding if.
+            continue;
+        }
+        // A loop's jump back to its condition, lowered after its body, is
+        // on the loop's line again.
+        int outer = line;
+        if (instructions[i]->line != 0) {
+            line = instructions[i]->line;
+        }
+        lowerInstruction(instructions[i], next);
+        line = outer;
+    }
+    scopes.pop_back();
+}
+
+void Lowering::lowerInstruction(Instruction *instruction, Instruction *next) {
+    switch (instruction->type) {
+    case NodeType::VARIABLE_DECLARATION:
+        lowerDeclaration(dynamic_cast<VariableDeclaration *>(instruction));
+        break;
+    case NodeType::VARIABLE_ASSIGNMENT:
+        lowerAssignment(dynamic_cast<VariableAssignment *>(instruction));
+        break;
+    case NodeType::EXPRESSION:
+        lowerExpression(dynamic_cast<Expression *>(instruction));
+        break;
+    case NodeType::RETURN_STATEMENT: {
+        auto ret = dynamic_cast<ReturnStatement *>(instruction);
+        LOperand value = lowerExpression(ret->returned_value);
+        LInst &inst = emit(LOp::RET);
+        inst.a = value;
+        inst.width = widthOf(ret->returned_value->variable_type);
+        break;
+    }
+    case NodeType::IF: {
+        auto if_ = dynamic_cast<IfStatement *>(instruction);
+        auto else_ = next && next->type == NodeType::ELSE
+                         ? dynamic_cast<ElseStatement *>(next)
+                         : nullptr;
+        int elseLabel = newLabel();
+        lowerBranch(if_->condition, elseLabel, false);
+        lowerBody(if_->ifBody);
+        if (else_) {
+            int endLabel = newLabel();
+            emitJump(endLabel);
+            emitLabel(elseLabel);
+            lowerBody(else_->elseBody);
+            emitLabel(endLabel);
+        } else {
+            emitLabel(elseLabel);
+        }
+        break;
+    }
+    case NodeType::WHILE: {
+        // Rotated so each iteration runs one conditional jump:
+        //     if (!cond) goto end; top: body; if (cond) goto top; end:
+        auto loop = dynamic_cast<WhileStatement *>(instruction);
+        int top = newLabel(), end = newLabel();
+        lowerBranch(loop->condition, end, false);
+        emitLabel(top);
+        lowerBody(loop->body);
+        lowerBranch(loop->condition, top, true);
+        emitLabel(end);
+        break;
+    }
+    case NodeType::FOR: {
+        auto loop = dynamic_cast<ForStatement *>(instruction);
+        if (loop->unrollFactor > 1) {
+            lowerUnrolledFor(loop);
+        } else {
+            lowerFor(loop);
+        }
+        break;
+    }
+    case NodeType::PRINT_NODE:
+        lowerPrint(dynamic_cast<PrintNode *>(instruction));
+        break;
+    default:
+        break;
+    }
+}
+
+void Lowering::lowerFor(ForStatement *loop) {
+    scopes.emplace_back();
+    lowerDeclaration(loop->init);
+    int top = newLabel(), end = newLabel();
+    lowerBranch(loop->condition, end, false);
+    emitLabel(top);
+    lowerBody(loop->body);
+    lowerAssignment(loop->step);
+    lowerBranch(loop->condition, top, true);
+    emitLabel(end);
+    scopes.pop_back();
+}
+
+// Mirrors IR::writeUnrolledLoop: `unrollFactor` copies of the body per
+// iteration of a loop that stops at END, then the leftover iterations as
+// straight-line copies.
+void Lowering::lowerUnrolledFor(ForStatement *loop) {
+    long long chunks = loop->tripCount / loop->unrollFactor;
+    long long remainder = loop->tripCount % loop->unrollFactor;
+    long long start =
+        std::stoll(loop->init->initialization_value->literal_value);
+    long long end = start + chunks * loop->unrollFactor * loop->stepValue;
+
+    auto iteration = [&]() {
+        lowerBody(loop->body);
+        lowerAssignment(loop->step);
+    };
+
+    scopes.emplace_back();
+    lowerDeclaration(loop->init);
+    int counter = lookup(loop->init->name)->vreg;
+    if (chunks == 1) {
+        remainder += loop->unrollFactor;
+    } else {
+        int top = newLabel();
+        emitLabel(top);
+        for (int i = 0; i < loop->unrollFactor; ++i) {
+            iteration();
+        }
+        LInst &jump = emit(LOp::JCC);
+        jump.cond = loop->stepValue > 0 ? Cond::LT : Cond::GT;
+        jump.a = LOperand::reg(counter);
+        jump.b = LOperand::constant(end);
+        jump.label = top;
+    }
+    for (long long i = 0; i < remainder; ++i) {
+        iteration();
+    }
+    scopes.pop_back();
+}
+
+void Lowering::lowerDeclaration(VariableDeclaration *declaration) {
+    const DataType &type = declaration->variable_type;
+    if (type.isArray()) {
+        int bytes =
+            type.isFixedArray() ? 8 * type.length : ARRAY_HEADER_SIZE;
+        int object = static_cast<int>(current->frameObjects.size());
+        current->frameObjects.push_back(bytes);
+        zeroFrameObject(object, bytes);
+        if (!type.isFixedArray() && reboundArrays.count(declaration->name)) {
+            int pointer = newVreg(8);
+            LInst &frame = emit(LOp::FRAME);
+            frame.dst = pointer;
+            frame.width = 8;
+            frame.disp = object;
+            declare(declaration, {Storage::VREG, type, pointer, -1, {}});
+            return;
+        }
+        declare(declaration, {Storage::FRAME, type, -1, object, {}});
+        return;
+    }
+
+    int width = widthOf(type);
+    int vreg = newVreg(width);
+    if (declaration->initialization_value) {
+        assignTo(vreg, width, declaration->initialization_value);
+    } else {
+        emitMove(vreg, LOperand::constant(0), width);
+    }
+    // Declared after the initializer, which may refer to an outer variable
+    // of the same name.
+    declare(declaration, {Storage::VREG, type, vreg, -1, {}});
+}
+
+void Lowering::lowerAssignment(VariableAssignment *assignment) {
+    if (assignment->element) {
+        LOperand base, index;
+        long long disp = 0;
+        lowerElement(assignment->element, base, index, disp);
+        LOperand value = lowerExpression(assignment->newValue);
+        LInst &store = emit(LOp::STORE);
+        store.a = base;
+        store.b = index;
+        store.c = value;
+        store.disp = disp;
+        store.width = widthOf(assignment->element->variable_type);
+        return;
+    }
+
+    Variable *variable = lookup(assignment->variable->name);
+    if (!variable) {
+        throw std::runtime_error("unknown variable '" +
+                                 assignment->variable->name + "'");
+    }
+    int width = widthOf(variable->type);
+    if (variable->storage == Storage::VREG) {
+        // An array in a register is a pointer to it, so `a = b` points a at
+        // b's array.
+        assignTo(variable->vreg, width, assignment->newValue);
+        return;
+    }
+    if (variable->type.isArray()) {
+        throw std::runtime_error("array '" + assignment->variable->name +
+                                 "' cannot be assigned");
+    }
+
+    LOperand value = lowerExpression(assignment->newValue);
+    int address = newVreg(8);
+    LInst &addr = emit(LOp::ADDR);
+    addr.dst = address;
+    addr.width = 8;
+    addr.symbol = variable->global;
+    LInst &store = emit(LOp::STORE);
+    store.a = LOperand::reg(address);
+    store.c = value;
+    store.width = width;
+}
+
+void Lowering::assignTo(int vreg, int width, const Expression *value) {
+    int firstTemp = static_cast<int>(current->vregWidths.size());
+    LOperand result = lowerExpression(value);
+    if (result.isReg() && result.vreg >= firstTemp &&
+        !current->instructions.empty() &&
+        current->instructions.back().dst == result.vreg) {
+        current->instructions.back().dst = vreg;
+        return;
+    }
+    emitMove(vreg, result, width);
+}
+
+// println is specialized at compile time: the format is split at each `{}`
+// and every piece becomes a direct call to a typed print routine.
+void Lowering::lowerPrint(PrintNode *print) {
+    std::vector<LOperand> values;
+    for (auto argument : print->arguments2) {
+        values.push_back(lowerExpression(argument));
+    }
+
+    std::string format = print->arguments.empty() ? "" : print->arguments[0];
+    size_t argument = 0;
+    size_t pos = 0;
+    auto printText = [&](const std::string &text) {
+        if (text.empty()) {
+            return;
+        }
+        std::string label = stringLabel("\"" + text + "\"");
+        int address = newVreg(8);
+        LInst &addr = emit(LOp::ADDR);
+        addr.dst = address;
+        addr.width = 8;
+        addr.symbol = label;
+        emitCall("xrt_print_cstr", {LOperand::reg(address)});
+    };
+
+    while (argument < values.size()) {
+        size_t found = format.find("{}", pos);
+        if (found == std::string::npos) {
+            break;
+        }
+        printText(format.substr(pos, found - pos));
+        const DataType &type = print->arguments2[argument]->variable_type;
+        std::string routine;
+        switch (type.category) {
+        case DataType::Category::INT:
+            routine = "xrt_print_int";
+            break;
+        case DataType::Category::BOOL:
+            routine = "xrt_print_bool";
+            break;
+        case DataType::Category::CHAR:
+            routine = "xrt_print_char";
+            break;
+        case DataType::Category::STRING:
+            routine = "xrt_print_cstr";
+            break;
+        default:
+            throw std::runtime_error("the native backend cannot print a " +
+                                     dataTypeToString(type));
+        }
+        emitCall(routine, {values[argument]});
+        argument++;
+        pos = found + 2;
+    }
+    printText(format.substr(pos));
+    emitCall("xrt_print_newline", {});
+}
+
+LOperand Lowering::lowerExpression(const Expression *expression) {
+    switch (expression->type) {
+    case Expression::Type::LITERAL: {
+        const std::string &value = expression->literal_value;
+        switch (expression->variable_type.category) {
+        case DataType::Category::INT: {
+            long long number = 0;
+            auto [end, status] = std::from_chars(
+                value.data(), value.data() + value.size(), number);
+            if (status != std::errc() || end != value.data() + value.size() ||
+                number < INT32_MIN || number > INT32_MAX) {
+                throw std::runtime_error("integer " + value +
+                                         " does not fit in an int");
+            }
+            return LOperand::constant(number);
+        }
+        case DataType::Category::BOOL:
+            return LOperand::constant(value == "true" ? 1 : 0);
+        case DataType::Category::CHAR:
+            return LOperand::constant(
+                value.size() >= 3 && value[0] == '\''
+                    ? static_cast<unsigned char>(value[1])
+                    : static_cast<unsigned char>(value.empty() ? 0 : value[0]));
+        case DataType::Category::STRING: {
+            int address = newVreg(8);
+            LInst &addr = emit(LOp::ADDR);
+            addr.dst = address;
+            addr.width = 8;
+            addr.symbol = stringLabel(value);
+            return LOperand::reg(address);
+        }
+        default:
+            widthOf(expression->variable_type);
+            throw std::runtime_error("unsupported literal '" + value + "'");
+        }
+    }
+    case Expression::Type::VARIABLE_REFERENCE: {
+        Variable *variable = lookup(expression);
+        if (!variable) {
+            throw std::runtime_error("unknown variable '" +
+                                     expression->variable_name + "'");
+        }
+        if (variable->type.isArray()) {
+            return arrayPointer(expression);
+        }
+        if (variable->storage == Storage::VREG) {
+            return LOperand::reg(variable->vreg);
+        }
+        int width = widthOf(variable->type);
+        int address = newVreg(8);
+        LInst &addr = emit(LOp::ADDR);
+        addr.dst = address;
+        addr.width = 8;
+        addr.symbol = variable->global;
+        int value = newVreg(width);
+        LInst &load = emit(LOp::LOAD);
+        load.dst = value;
+        load.a = LOperand::reg(address);
+        load.width = width;
+        return LOperand::reg(value);
+    }
+    case Expression::Type::BINARY_OPERATION: {
+        LOperand left = lowerExpression(expression->left_operand);
+        LOperand right = lowerExpression(expression->right_operand);
+        Cond cond{};
+        bool comparison = comparisonCond(expression->operation, cond);
+        int width = widthOf(expression->left_operand->variable_type);
+
+        if (left.isImm() && right.isImm() && !comparison &&
+            !(expression->operation == Operation::DIVIDE &&
+              right.imm == 0)) {
+            // Fold in 32-bit arithmetic, as the machine would compute it.
+            int32_t a = static_cast<int32_t>(left.imm);
+            int32_t b = static_cast<int32_t>(right.imm);
+            uint32_t ua = static_cast<uint32_t>(a);
+            uint32_t ub = static_cast<uint32_t>(b);
+            switch (expression->operation) {
+            case Operation::ADD:
+                return LOperand::constant(static_cast<int32_t>(ua + ub));
+            case Operation::SUBTRACT:
+                return LOperand::constant(static_cast<int32_t>(ua - ub));
+            case Operation::MULTIPLY:
+                return LOperand::constant(static_cast<int32_t>(ua * ub));
+            case Operation::DIVIDE:
+                if (!(a == INT32_MIN && b == -1)) {
+                    return LOperand::constant(a / b);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+        if (left.isImm()) {
+            int temp = newVreg(width);
+            emitMove(temp, left, width);
+            left = LOperand::reg(temp);
+        }
+
+        int result = newVreg(comparison ? 4 : width);
+        LInst &inst = emit(comparison ? LOp::CMP : LOp::BIN);
+        inst.dst = result;
+        inst.a = left;
+        inst.b = right;
+        inst.width = width;
+        inst.operation = expression->operation;
+        inst.cond = cond;
+        return LOperand::reg(result);
+    }
+    case Expression::Type::FUNCTION_CALL:
+        return lowerCall(expression);
+    case Expression::Type::INDEX: {
+        LOperand base, index;
+        long long disp = 0;
+        lowerElement(expression, base, index, disp);
+        int width = widthOf(expression->variable_type);
+        int value = newVreg(width);
+        LInst &load = emit(LOp::LOAD);
+        load.dst = value;
+        load.a = base;
+        load.b = index;
+        load.disp = disp;
+        load.width = width;
+        return LOperand::reg(value);
+    }
+    default:
+        throw std::runtime_error(
+            "the native backend cannot lower this expression");
+    }
+}
+
+LOperand Lowering::lowerCall(const Expression *call) {
+    if (call->function_name == "len") {
+        return arrayLength(call->arguments[0]);
+    }
+    if (call->function_name == "push") {
+        LOperand array = lowerExpression(call->arguments[0]);
+        LOperand value = lowerExpression(call->arguments[1]);
+        emitCall("xrt_push", {array, value});
+        return LOperand::constant(0);
+    }
+
+    std::vector<LOperand> args;
+    for (auto argument : call->arguments) {
+        args.push_back(lowerExpression(argument));
+    }
+    int width = widthOf(call->variable_type);
+    int result = newVreg(width);
+    emitCall(call->function_name, args, result, width);
+    return LOperand::reg(result);
+}
+
+void Lowering::lowerBranch(const Expression *condition, int label,
+                           bool when) {
+    Cond cond{};
+    if (condition->type == Expression::Type::BINARY_OPERATION &&
+        comparisonCond(condition->operation, cond)) {
+        LOperand left = lowerExpression(condition->left_operand);
+        LOperand right = lowerExpression(condition->right_operand);
+        int width = widthOf(condition->left_operand->variable_type);
+        if (left.isImm()) {
+            int temp = newVreg(width);
+            emitMove(temp, left, width);
+            left = LOperand::reg(temp);
+        }
+        LInst &jump = emit(LOp::JCC);
+        jump.cond = when ? cond : invertCond(cond);
+        jump.a = left;
+        jump.b = right;
+        jump.width = width;
+        jump.label = label;
+        return;
+    }
+
+    LOperand value = lowerExpression(condition);
+    if (value.isImm()) {
+        if ((value.imm != 0) == when) {
+            emitJump(label);
+        }
+        return;
+    }
+    LInst &jump = emit(LOp::JCC);
+    jump.cond = when ? Cond::NE : Cond::EQ;
+    jump.a = value;
+    jump.b = LOperand::constant(0);
+    jump.width = current->vregWidths[value.vreg];
+    jump.label = label;
+}
+
+void Lowering::lowerElement(const Expression *element, LOperand &base,
+                            LOperand &index, long long &disp) {
+    const Expression *array = element->left_operand;
+    LOperand pointer = arrayPointer(array);
+    index = lowerExpression(element->right_operand);
+
+    if (boundsChecks && element->bounds_checked) {
+        LOperand length = arrayLength(array);
+        if (!index.isImm() || !length.isImm() || index.imm < 0 ||
+            index.imm >= length.imm) {
+            LInst &check = emit(LOp::CHECK);
+            check.a = index;
+            check.b = length;
+            check.width = 4;
+        }
+    }
+
+    if (array->variable_type.isFixedArray()) {
+        base = pointer;
+    } else {
+        int data = newVreg(8);
+        LInst &load = emit(LOp::LOAD);
+        load.dst = data;
+        load.a = pointer;
+        load.disp = ARRAY_DATA;
+        load.width = 8;
+        base = LOperand::reg(data);
+    }
+
+    disp = 0;
+    if (index.isImm()) {
+        disp = index.imm * 8;
+        index = LOperand();
+    }
+}
+
+// The address of a fixed array's first element, or of a growable array's
+// header.
+LOperand Lowering::arrayPointer(const Expression *array) {
+    Variable *variable = lookup(array);
+    if (!variable) {
+        throw std::runtime_error("unknown array '" + array->variable_name +
+                                 "'");
+    }
+    if (variable->storage == Storage::VREG) {
+        return LOperand::reg(variable->vreg);
+    }
+    int pointer = newVreg(8);
+    switch (variable->storage) {
+    case Storage::VREG:
+        break;
+    case Storage::FRAME: {
+        LInst &frame = emit(LOp::FRAME);
+        frame.dst = pointer;
+        frame.width = 8;
+        frame.disp = variable->frameObject;
+        break;
+    }
+    case Storage::GLOBAL: {
+        LInst &addr = emit(LOp::ADDR);
+        addr.dst = pointer;
+        addr.width = 8;
+        addr.symbol = variable->global;
+        break;
+    }
+    }
+    return LOperand::reg(pointer);
+}
+
+LOperand Lowering::arrayLength(const Expression *array) {
+    if (array->variable_type.isFixedArray()) {
+        return LOperand::constant(array->variable_type.length);
+    }
+    LOperand pointer = arrayPointer(array);
+    int length = newVreg(4);
+    LInst &load = emit(LOp::LOAD);
+    load.dst = length;
+    load.a = pointer;
+    load.disp = ARRAY_LEN;
+    load.width = 4;
+    return LOperand::reg(length);
+}
+
+void Lowering::zeroFrameObject(int object, int bytes) {
+    int base = newVreg(8);
+    LInst &frame = emit(LOp::FRAME);
+    frame.dst = base;
+    frame.width = 8;
+    frame.disp = object;
+
+    int slots = bytes / 8;
+    if (slots <= MAX_INLINE_CLEAR) {
+        for (int i = 0; i < slots; ++i) {
+            LInst &store = emit(LOp::STORE);
+            store.a = LOperand::reg(base);
+            store.c = LOperand::constant(0);
+            store.disp = 8LL * i;
+            store.width = 8;
+        }
+        return;
+    }
+
+    int counter = newVreg(4);
+    int top = newLabel();
+    emitMove(counter, LOperand::constant(0), 4);
+    emitLabel(top);
+    LInst &store = emit(LOp::STORE);
+    store.a = LOperand::reg(base);
+    store.b = LOperand::reg(counter);
+    store.c = LOperand::constant(0);
+    store.width = 8;
+    LInst &increment = emit(LOp::BIN);
+    increment.dst = counter;
+    increment.a = LOperand::reg(counter);
+    increment.b = LOperand::constant(1);
+    increment.operation = Operation::ADD;
+    LInst &jump = emit(LOp::JCC);
+    jump.cond = Cond::LT;
+    jump.a = LOperand::reg(counter);
+    jump.b = LOperand::constant(slots);
+    jump.label = top;
+}
+
+int Lowering::newVreg(int width) {
+    current->vregWidths.push_back(width);
+    return static_cast<int>(current->vregWidths.size()) - 1;
+}
+
+LInst &Lowering::emit(LOp op) {
+    LInst &inst = current->instructions.emplace_back(op);
+    inst.line = line;
+    return inst;
+}
+
+void Lowering::emitMove(int dst, LOperand value, int width) {
+    LInst &inst = emit(value.isImm() ? LOp::CONST : LOp::MOV);
+    inst.dst = dst;
+    inst.a = value;
+    inst.width = width;
+}
+
+void Lowering::emitLabel(int label) { emit(LOp::LABEL).label = label; }
+
+void Lowering::emitJump(int label) { emit(LOp::JMP).label = label; }
+
+void Lowering::emitCall(const std::string &symbol, std::vector<LOperand> args,
+                        int dst, int width) {
+    LInst &call = emit(LOp::CALL);
+    call.symbol = symbol;
+    call.args = std::move(args);
+    call.dst = dst;
+    call.width = width;
+}
+
+std::string Lowering::stringLabel(const std::string &quoted) {
+    auto it = stringLabels.find(quoted);
+    if (it != stringLabels.end()) {
+        return it->second;
+    }
+    std::string label = ".Lstr" + std::to_string(module.strings.size());
+    // Stored without the surrounding quotes.
+    module.strings.emplace_back(label, quoted.substr(1, quoted.size() - 2));
+    stringLabels.emplace(quoted, label);
+    return label;
+}
+
+Lowering::Variable *Lowering::lookup(const std::string &name) {
+    for (auto scope = scopes.rbegin(); scope != scopes.rend(); ++scope) {
+        auto it = scope->find(name);
+        if (it != scope->end()) {
+            return &it->second;
+        }
+    }
+    auto it = globals.find(name);
+    return it != globals.end() ? &it->second : nullptr;
+}
+
+Lowering::Variable *Lowering::lookup(const Expression *reference) {
+    if (reference->declaration) {
+        auto it = bound.find(reference->declaration);
+        return it != bound.end() ? &it->second : nullptr;
+    }
+    return lookup(reference->variable_name);
+}
+
+void Lowering::declare(const VariableDeclaration *declaration,
+                       Variable variable) {
+    scopes.back()[declaration->name] = variable;
+    bound[declaration] = variable;
+}
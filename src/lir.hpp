@@ -0,0 +1,193 @@
+#ifndef LIR_HPP_
+#define LIR_HPP_
+
+#include "astGen.hpp"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// A linear, register-based IR that native backends lower to machine code.
+//
+// Each function is a flat list of instructions over an unbounded set of
+// virtual registers. Control flow uses labels and (conditional) jumps.
+// Values are 4 bytes (int, bool, char) or 8 bytes (strings and array
+// pointers) wide; array elements always occupy 8-byte slots.
+enum class LOp {
+    CONST,  // dst = a (immediate)
+    ADDR,   // dst = &symbol
+    FRAME,  // dst = address of frame object `disp`
+    MOV,    // dst = a
+    BIN,    // dst = a binop b
+    CMP,    // dst = a cond b ? 1 : 0
+    LOAD,   // dst = [a + b * 8 + disp]
+    STORE,  // [a + b * 8 + disp] = c
+    CALL,   // dst = symbol(args...); dst may be absent
+    PARAM,  // dst = incoming argument `disp`
+    JMP,    // goto label
+    JCC,    // if (a cond b) goto label
+    LABEL,  // label:
+    RET,    // return a
+    CHECK,  // abort unless 0 <= a < b (unsigned compare)
+};
+
+enum class Cond { EQ, NE, LT, LE, GT, GE };
+
+Cond invertCond(Cond cond);
+std::string condToString(Cond cond);
+
+struct LOperand {
+    enum class Kind { NONE, VREG, IMM };
+
+    Kind kind = Kind::NONE;
+    int vreg = -1;
+    long long imm = 0;
+
+    static LOperand reg(int vreg) { return {Kind::VREG, vreg, 0}; }
+    static LOperand constant(long long value) {
+        return {Kind::IMM, -1, value};
+    }
+
+    bool isReg() const { return kind == Kind::VREG; }
+    bool isImm() const { return kind == Kind::IMM; }
+    bool isNone() const { return kind == Kind::NONE; }
+};
+
+struct LInst {
+    LOp op;
+    int dst = -1;
+    LOperand a, b, c;
+    Operation operation = Operation::ADD;
+    Cond cond = Cond::EQ;
+    int label = -1;
+    // Width in bytes of the value defined, loaded, stored or compared.
+    int width = 4;
+    long long disp = 0;
+    std::string symbol;
+    std::vector<LOperand> args;
+    // The source line of the statement it was lowered from; 0 if unknown.
+    int line = 0;
+
+    LInst(LOp op) : op(op) {}
+};
+
+struct LFunction {
+    std::string name;
+    int numParams = 0;
+    std::vector<LInst> instructions;
+    // Width in bytes of each virtual register.
+    std::vector<int> vregWidths;
+    // Size in bytes of each frame object (fixed arrays and the headers of
+    // growable arrays).
+    std::vector<int> frameObjects;
+    int numLabels = 0;
+    // The source line the function starts on.
+    int line = 0;
+};
+
+struct LGlobal {
+    std::string name;
+    int size = 4;
+    // Initial value of a scalar, or the label of a string literal.
+    long long value = 0;
+    std::string stringLabel;
+};
+
+struct LModule {
+    std::vector<LFunction> functions;
+    std::vector<LGlobal> globals;
+    // Label and contents (as written in the source) of each string literal.
+    std::vector<std::pair<std::string, std::string>> strings;
+};
+
+std::string lirToString(const LFunction &function);
+
+// The bytes of a string literal as written in the source (and in a gas
+// `.string` directive), with its escapes decoded.
+std::string unescapeString(const std::string &text);
+
+// Lowers the AST to LIR. Throws std::runtime_error for constructs the native
+// backends do not support.
+class Lowering {
+public:
+    Lowering(ASTGen &ast) : ast(ast) {}
+
+    LModule run();
+
+    // Cleared by --no-bounds-checks.
+    bool boundsChecks = true;
+
+private:
+    enum class Storage { VREG, FRAME, GLOBAL };
+
+    struct Variable {
+        Storage storage;
+        DataType type;
+        int vreg = -1;
+        int frameObject = -1;
+        std::string global;
+    };
+
+    void lowerFunction(FunctionDeclaration *function);
+    void lowerGlobal(VariableDeclaration *declaration);
+    void lowerBody(FunctionBody *body);
+    void lowerInstruction(Instruction *instruction, Instruction *next);
+    void lowerDeclaration(VariableDeclaration *declaration);
+    void lowerAssignment(VariableAssignment *assignment);
+    void lowerPrint(PrintNode *print);
+    void lowerFor(ForStatement *loop);
+    void lowerUnrolledFor(ForStatement *loop);
+
+    LOperand lowerExpression(const Expression *expression);
+    LOperand lowerCall(const Expression *call);
+    // Jumps to `label` when `condition` evaluates to `when`.
+    void lowerBranch(const Expression *condition, int label, bool when);
+    // Computes the element address of an INDEX expression, checking the
+    // index if needed. Sets `base`, `index` and `disp` for a LOAD or STORE.
+    void lowerElement(const Expression *element, LOperand &base,
+                      LOperand &index, long long &disp);
+    LOperand arrayPointer(const Expression *array);
+    LOperand arrayLength(const Expression *array);
+
+    // Lowers `value` into variable register `vreg`, retargeting the last
+    // instruction when it just computed a fresh temporary.
+    void assignTo(int vreg, int width, const Expression *value);
+
+    int newVreg(int width);
+    int newLabel() { return current->numLabels++; }
+    LInst &emit(LOp op);
+    void emitMove(int dst, LOperand value, int width);
+    void emitLabel(int label);
+    void emitJump(int label);
+    void emitCall(const std::string &symbol, std::vector<LOperand> args,
+                  int dst = -1, int width = 4);
+    std::string stringLabel(const std::string &quoted);
+    void zeroFrameObject(int object, int bytes);
+
+    Variable *lookup(const std::string &name);
+    // The variable `reference` reads: the declaration a pass bound it to,
+    // or else the one its name resolves to.
+    Variable *lookup(const Expression *reference);
+    void declare(const VariableDeclaration *declaration, Variable variable);
+
+    ASTGen &ast;
+    LModule module;
+    LFunction *current = nullptr;
+    // The line of the statement being lowered, given to what it emits.
+    int line = 0;
+    std::vector<std::unordered_map<std::string, Variable>> scopes;
+    std::unordered_map<std::string, Variable> globals;
+    std::unordered_map<std::string, std::string> stringLabels;
+    // Every variable of the current function by declaration, for the
+    // references passes bind to their temporaries.
+    std::unordered_map<const VariableDeclaration *, Variable> bound;
+    // Growable arrays of the current function that are assigned whole
+    // (`a = b`). They are kept in a register that points at the array,
+    // rather than addressed in the frame, so that they can be pointed
+    // elsewhere.
+    std::unordered_set<std::string> reboundArrays;
+};
+
+int widthOf(const DataType &type);
+
+#endif // LIR_HPP_
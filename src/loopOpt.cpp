@@ -0,0 +1,229 @@
+#include "loopOpt.hpp"
+
+static std::string expressionKey(const Expression *expression) {
+    if (!expression) {
+        return "";
+    }
+    switch (expression->type) {
+    case Expression::Type::BINARY_OPERATION:
+        return "(" + expressionKey(expression->left_operand) +
+               operationToString(expression->operation) +
+               expressionKey(expression->right_operand) + ")";
+    case Expression::Type::FUNCTION_CALL: {
+        std::string key = expression->function_name + "(";
+        for (auto argument : expression->arguments) {
+            key += expressionKey(argument) + ",";
+        }
+        return key + ")";
+    }
+    case Expression::Type::VARIABLE_REFERENCE:
+        return expression->variable_name;
+    default:
+        return expression->literal_value;
+    }
+}
+
+void LoopOptimizer::run() {
+    purity.run(ast);
+
+    for (auto node : ast.nodes) {
+        if (node->type == NodeType::FUNCTION_DECLARATION) {
+            optimizeBody(dynamic_cast<FunctionDeclaration *>(node)->body);
+        }
+    }
+}
+
+void LoopOptimizer::optimizeBody(FunctionBody *body) {
+    for (auto instruction : body->getInstructions()) {
+        switch (instruction->type) {
+        case NodeType::IF: {
+            auto if_ = dynamic_cast<IfStatement *>(instruction);
+            optimizeBody(if_->ifBody);
+            if (if_->elseBody) {
+                optimizeBody(if_->elseBody);
+            }
+            break;
+        }
+        case NodeType::ELSE:
+            optimizeBody(dynamic_cast<ElseStatement *>(instruction)->elseBody);
+            break;
+        case NodeType::WHILE: {
+            auto loop = dynamic_cast<WhileStatement *>(instruction);
+            optimizeBody(loop->body);
+            hoistInvariants(body, loop, loop->body, {loop->condition});
+
+            bool hasLoop = false;
+            if (bodySize(loop->body, hasLoop) <= MAX_UNROLL_BODY &&
+                !hasLoop) {
+                loop->unrollHint = UNROLL_FACTOR;
+            }
+            break;
+        }
+        case NodeType::FOR: {
+            auto loop = dynamic_cast<ForStatement *>(instruction);
+            optimizeBody(loop->body);
+            hoistInvariants(body, loop, loop->body,
+                            {loop->condition, loop->step->newValue});
+            planUnroll(loop);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+void LoopOptimizer::hoistInvariants(FunctionBody *block, Instruction *loop,
+                                    FunctionBody *loopBody,
+                                    const std::vector<Expression *> &header) {
+    preheaderBlock = block;
+    preheaderAnchor = loop;
+    assigned.clear();
+    hoistedValues.clear();
+
+    collectAssignedVariables(loopBody, assigned);
+    if (loop->type == NodeType::FOR) {
+        auto forLoop = dynamic_cast<ForStatement *>(loop);
+        assigned.insert(forLoop->init->name);
+        assigned.insert(forLoop->step->variable->name);
+    }
+
+    for (auto expression : header) {
+        hoist(expression);
+    }
+    forEachExpression(loopBody,
+                      [&](Expression *expression) { hoist(expression); });
+}
+
+// Hoist the largest invariant subexpressions of `expression`.
+void LoopOptimizer::hoist(Expression *expression) {
+    if (!expression) {
+        return;
+    }
+
+    bool computation =
+        expression->type == Expression::Type::BINARY_OPERATION ||
+        expression->type == Expression::Type::FUNCTION_CALL;
+    if (computation &&
+        expression->variable_type.category != DataType::Category::UNKNOWN &&
+        isInvariant(expression) && purity.isSpeculatable(expression)) {
+        std::string key = expressionKey(expression);
+        auto it = hoistedValues.find(key);
+        if (it != hoistedValues.end()) {
+            expression->becomeReference(it->second);
+        } else {
+            auto declaration = expression->hoistInto(
+                ast.arena,
+                reservedPrefix + "licm" + std::to_string(temporaryCount++));
+            preheaderBlock->insertInstructionBefore(preheaderAnchor,
+                                                    declaration);
+            hoistedValues.emplace(key, declaration);
+        }
+        hoistedCount++;
+        return;
+    }
+
+    hoist(expression->left_operand);
+    hoist(expression->right_operand);
+    for (auto argument : expression->arguments) {
+        hoist(argument);
+    }
+}
+
+bool LoopOptimizer::isInvariant(Expression *expression) const {
+    if (!expression) {
+        return true;
+    }
+    switch (expression->type) {
+    case Expression::Type::LITERAL:
+        return true;
+    case Expression::Type::VARIABLE_REFERENCE:
+        // Globals can change behind any call to an impure function, and
+        // arrays behind any call they are passed to.
+        return !expression->is_global &&
+               !expression->variable_type.isArray() &&
+               assigned.count(expression->variable_name) == 0;
+    case Expression::Type::BINARY_OPERATION:
+        return isInvariant(expression->left_operand) &&
+               isInvariant(expression->right_operand);
+    case Expression::Type::FUNCTION_CALL:
+        for (auto argument : expression->arguments) {
+            if (!isInvariant(argument)) {
+                return false;
+            }
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+void LoopOptimizer::planUnroll(ForStatement *loop) {
+    bool hasLoop = false;
+    if (bodySize(loop->body, hasLoop) > MAX_UNROLL_BODY || hasLoop) {
+        return;
+    }
+    loop->unrollHint = UNROLL_FACTOR;
+
+    const std::string &counter = loop->init->name;
+    long long start = 0, bound = 0, step = 0;
+    Expression *condition = loop->condition;
+    Expression *increment = loop->step->newValue;
+
+    if (!isIntegerLiteral(loop->init->initialization_value, start) ||
+        loop->step->variable->name != counter ||
+        condition->type != Expression::Type::BINARY_OPERATION ||
+        !isReferenceTo(condition->left_operand, counter) ||
+        !isIntegerLiteral(condition->right_operand, bound) ||
+        increment->type != Expression::Type::BINARY_OPERATION ||
+        !isReferenceTo(increment->left_operand, counter) ||
+        !isIntegerLiteral(increment->right_operand, step) || step <= 0) {
+        return;
+    }
+
+    std::unordered_set<std::string> bodyAssigned;
+    collectAssignedVariables(loop->body, bodyAssigned);
+    if (bodyAssigned.count(counter)) {
+        return;
+    }
+
+    long long trips = -1;
+    if (increment->operation == Operation::ADD) {
+        if (condition->operation == Operation::LESS) {
+            trips = bound > start ? (bound - start + step - 1) / step : 0;
+        } else if (condition->operation == Operation::LESS_EQUAL) {
+            trips = bound >= start ? (bound - start) / step + 1 : 0;
+        }
+    } else if (increment->operation == Operation::SUBTRACT) {
+        if (condition->operation == Operation::GREATER) {
+            trips = start > bound ? (start - bound + step - 1) / step : 0;
+        } else if (condition->operation == Operation::GREATER_EQUAL) {
+            trips = start >= bound ? (start - bound) / step + 1 : 0;
+        }
+        step = -step;
+    }
+    if (trips < 0) {
+        return;
+    }
+
+    loop->tripCount = trips;
+    loop->stepValue = step;
+    if (trips >= 2) {
+        loop->unrollFactor =
+            static_cast<int>(std::min<long long>(UNROLL_FACTOR, trips));
+        loop->unrollHint = 0;
+        unrolledCount++;
+    }
+}
+
+int LoopOptimizer::bodySize(FunctionBody *body, bool &hasLoop) {
+    int size = 0;
+    forEachInstruction(body, [&](Instruction *instruction) {
+        size++;
+        if (instruction->type == NodeType::WHILE ||
+            instruction->type == NodeType::FOR) {
+            hasLoop = true;
+        }
+    });
+    return size;
+}
@@ -0,0 +1,58 @@
+#ifndef LOOP_OPT_HPP_
+#define LOOP_OPT_HPP_
+
+#include "analysis.hpp"
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// Loop optimizations on the AST; runs before value numbering.
+//
+// Loop-invariant code motion moves binary operations and calls to
+// speculatable functions whose operands are not assigned inside a loop into
+// `__licmN` temporaries declared right before the loop. Inner loops are
+// handled first, so invariants bubble out as far as they can go.
+//
+// Counted for loops (literal start and bound, literal step, counter not
+// assigned in the body) get their trip count computed. When the count is
+// known and the body is small the loop is marked for partial unrolling,
+// which the emitter performs; other small loops get a `#pragma GCC unroll`
+// hint so the C compiler can do it.
+class LoopOptimizer {
+public:
+    LoopOptimizer(ASTGen &ast) : ast(ast) {}
+
+    void run();
+
+    size_t hoisted() const { return hoistedCount; }
+    size_t unrolled() const { return unrolledCount; }
+
+    static constexpr int UNROLL_FACTOR = 4;
+    // Largest body, in statements, that is unrolled or given a hint.
+    static constexpr int MAX_UNROLL_BODY = 16;
+
+private:
+    void optimizeBody(FunctionBody *body);
+    void hoistInvariants(FunctionBody *block, Instruction *loop,
+                         FunctionBody *loopBody,
+                         const std::vector<Expression *> &header);
+    void hoist(Expression *expression);
+    bool isInvariant(Expression *expression) const;
+    void planUnroll(ForStatement *loop);
+    int bodySize(FunctionBody *body, bool &hasLoop);
+
+    ASTGen &ast;
+    PurityAnalysis purity;
+
+    // State for the loop currently being hoisted from.
+    FunctionBody *preheaderBlock = nullptr;
+    Instruction *preheaderAnchor = nullptr;
+    std::unordered_set<std::string> assigned;
+    std::unordered_map<std::string, VariableDeclaration *> hoistedValues;
+
+    size_t hoistedCount = 0;
+    size_t temporaryCount = 0;
+    size_t unrolledCount = 0;
+};
+
+#endif // LOOP_OPT_HPP_
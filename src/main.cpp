@@ -1,19 +1,135 @@
-#include "XIR.hpp"
-#include "parser.hpp"
+#include "driver.hpp"
+#include "server.hpp"
+#include <filesystem>
 #include <iostream>
 #include <string>
+#include <vector>
+
+static int usage(const char *program) {
+    std::cerr << "Usage: " << program
+              << " [-O0|-O1] [-g] [--instrument] [--no-bounds-checks]"
+                 " [--target=c|x86-64] [-o path] [-j N] file_name..."
+              << std::endl;
+    std::cerr << "  --target=c       write output.c (default); build with"
+              << std::endl;
+    std::cerr << "                   cc -I runtime output.c bin/libxrt.a"
+              << std::endl;
+    std::cerr << "  --target=x86-64  write output.s; link with libxrt.a"
+              << std::endl;
+    std::cerr << "  --emit=asm|obj|exe  with x86-64, write output.s (default),"
+              << std::endl;
+    std::cerr << "                   output.o, or a static executable `output`"
+              << std::endl;
+    std::cerr << "                   for programs that need no runtime"
+              << std::endl;
+    std::cerr << "  -o path          write to path instead; - is stdout"
+              << std::endl;
+    std::cerr << "  -g               map the output to lines of the source, for"
+              << std::endl;
+    std::cerr << "                   debuggers and perf: #line in C, .loc in"
+              << std::endl;
+    std::cerr << "                   assembly, and a .lines file of addresses"
+              << std::endl;
+    std::cerr << "                   beside an object or executable"
+              << std::endl;
+    std::cerr << "  --instrument     with --target=c, count each function's"
+              << std::endl;
+    std::cerr << "                   calls and time and how often each if is"
+              << std::endl;
+    std::cerr << "                   taken; the program writes them to"
+              << std::endl;
+    std::cerr << "                   $XRT_PROFILE or xrt.profile at exit"
+              << std::endl;
+    std::cerr << "  --profile-report[=PATH]" << std::endl;
+    std::cerr << "                   print the hot functions and ifs of a"
+              << std::endl;
+    std::cerr << "                   profile (default: xrt.profile)"
+              << std::endl;
+    std::cerr << "  -j N             compile several files on N threads"
+              << std::endl;
+    std::cerr << "                   (default: one per core); each a.x writes"
+              << std::endl;
+    std::cerr << "                   a.c, a.s, a.o or a beside itself, or in"
+              << std::endl;
+    std::cerr << "                   the -o directory" << std::endl;
+    std::cerr << "  @list            compile the files named in list"
+              << std::endl;
+    std::cerr << "  --cache=DIR      write each function to its own unit in"
+              << std::endl;
+    std::cerr << "                   DIR, reusing units of unchanged functions,"
+              << std::endl;
+    std::cerr << "                   and list them in output.units (C only)"
+              << std::endl;
+    std::cerr << "  --threads=N      generate C on N threads (default: one per"
+              << std::endl;
+    std::cerr << "                   core); the output is the same either way"
+              << std::endl;
+    std::cerr << "  --run            compile to memory and run main (x86-64)"
+              << std::endl;
+    std::cerr << "  --vm             compile to bytecode and interpret main"
+              << std::endl;
+    std::cerr << "  --vm-stats       with --vm, report instructions executed"
+              << std::endl;
+    std::cerr << "  --dump-bytecode  print the bytecode (--vm only)"
+              << std::endl;
+    std::cerr << "  --dump-tokens[=json]" << std::endl;
+    std::cerr << "                   print the tokens, as text or JSON"
+              << std::endl;
+    std::cerr << "  --dump-ast[=json]" << std::endl;
+    std::cerr << "                   print the tree after the AST passes"
+              << std::endl;
+    std::cerr << "  --dump-lir       print the linear IR (x86-64 only)"
+              << std::endl;
+    std::cerr << "  --time-report    print the time spent in each phase"
+              << std::endl;
+    std::cerr << "  --trace=PATH     write the phases, and each function's"
+              << std::endl;
+    std::cerr << "                   parsing and code generation, as Chrome"
+              << std::endl;
+    std::cerr << "                   trace-event JSON (ui.perfetto.dev)"
+              << std::endl;
+    std::cerr << "  --mem-report     print the memory the tokens, AST, symbol"
+              << std::endl;
+    std::cerr << "                   tables and output take, and how each"
+              << std::endl;
+    std::cerr << "                   phase raised the peak resident set"
+              << std::endl;
+    std::cerr << "  --build=DIR      compile file_name and the modules it"
+              << std::endl;
+    std::cerr << "                   imports, each to its own output in DIR,"
+              << std::endl;
+    std::cerr << "                   skipping modules that are up to date"
+              << std::endl;
+    std::cerr << "  --server=SOCKET  stay running and compile for clients,"
+              << std::endl;
+    std::cerr << "                   keeping the output of unchanged files"
+              << std::endl;
+    std::cerr << "  --connect=SOCKET have the server compile instead"
+              << std::endl;
+    return 1;
+}
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " file_name" << std::endl;
+    std::vector<std::string> args(argv + 1, argv + argc);
+    Invocation invocation;
+    try {
+        if (!parseArguments(args, {}, invocation)) {
+            return usage(argv[0]);
+        }
+    } catch (const std::runtime_error &error) {
+        std::cerr << "error: " << error.what() << std::endl;
         return 1;
     }
-    Lexer lexer(argv[1]);
-    Parser parser(lexer);
-    parser.parse();
-
-    IR ir(argv[1], "output.c", parser.ast, &parser);
-    ir.GenIR();
 
-    return 0;
+    if (!invocation.server.empty()) {
+        return runServer(invocation.server);
+    }
+    if (!invocation.connect.empty()) {
+        // The server resolves paths against the client's directory itself.
+        std::erase_if(args, [](const std::string &arg) {
+            return arg.rfind("--connect=", 0) == 0;
+        });
+        return runClient(invocation.connect, args);
+    }
+    return runInvocation(invocation, std::cerr);
 }
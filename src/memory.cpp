@@ -0,0 +1,54 @@
+#include "memory.hpp"
+#include <cstdlib>
+#include <cxxabi.h>
+#include <iomanip>
+#include <sys/resource.h>
+
+void MemoryUsage::add(std::string_view category, size_t count, size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &existing : categories) {
+        if (existing.name == category) {
+            existing.count += count;
+            existing.bytes += bytes;
+            return;
+        }
+    }
+    categories.push_back({std::string(category), count, bytes});
+}
+
+void MemoryUsage::writeReport(std::ostream &out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t total = 0;
+    out << "  " << std::left << std::setw(32) << "category" << std::right
+        << std::setw(10) << "count" << std::setw(12) << "KiB" << "\n";
+    for (const auto &category : categories) {
+        out << "  " << std::left << std::setw(32) << category.name
+            << std::right << std::setw(10) << category.count << std::setw(12)
+            << std::fixed << std::setprecision(1) << category.bytes / 1024.0
+            << "\n";
+        total += category.bytes;
+    }
+    out << "  " << std::left << std::setw(42) << "total" << std::right
+        << std::setw(12) << total / 1024.0 << "\n";
+    out << std::defaultfloat << std::setprecision(6) << std::flush;
+}
+
+std::string typeName(const std::type_info &type) {
+    int status = 0;
+    char *name = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+    if (status != 0) {
+        return type.name();
+    }
+    std::string result = name;
+    std::free(name);
+    return result;
+}
+
+size_t peakResidentBytes() {
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+    // In KiB on Linux.
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
@@ -0,0 +1,69 @@
+#ifndef MEMORY_HPP_
+#define MEMORY_HPP_
+
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <typeinfo>
+#include <vector>
+
+// Where compile memory goes (--mem-report). Once a compilation has built
+// its data structures, each subsystem adds what they hold to a category:
+// the source buffers, the tokens, the AST nodes of each kind, the symbol
+// tables and the generated output. Sizes are those of the containers and
+// the objects in them, including the heap text of strings, but not the
+// allocator's own overhead.
+
+class MemoryUsage {
+public:
+    // Adds `count` objects taking `bytes` in all to `category`. Safe to
+    // call from any thread.
+    void add(std::string_view category, size_t count, size_t bytes);
+
+    // A table of the count and size of each category, in the order they
+    // were first added.
+    void writeReport(std::ostream &out) const;
+
+private:
+    struct Category {
+        std::string name;
+        size_t count = 0;
+        size_t bytes = 0;
+    };
+
+    mutable std::mutex mutex;
+    std::vector<Category> categories;
+};
+
+// The bytes `text` keeps on the heap; none for short strings stored in the
+// string itself.
+inline size_t heapBytes(const std::string &text) {
+    const char *data = text.data();
+    const char *self = reinterpret_cast<const char *>(&text);
+    if (data >= self && data < self + sizeof(text)) {
+        return 0;
+    }
+    return text.capacity() + 1;
+}
+
+// The bytes a std::unordered_map with string keys takes: its buckets, one
+// node per entry (the next pointer, the entry and its cached hash) and the
+// text of long keys.
+template <typename Map> size_t hashMapBytes(const Map &map) {
+    size_t bytes = map.bucket_count() * sizeof(void *);
+    for (const auto &entry : map) {
+        bytes += sizeof(void *) + sizeof(entry) + sizeof(size_t) +
+                 heapBytes(entry.first);
+    }
+    return bytes;
+}
+
+// The name of `type` as written in the source.
+std::string typeName(const std::type_info &type);
+
+// The peak resident set size of the process so far, in bytes.
+size_t peakResidentBytes();
+
+#endif // MEMORY_HPP_
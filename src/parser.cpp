@@ -1,27 +1,82 @@
 #include "parser.hpp"
+#include "hash.hpp"
+#include <cctype>
+#include <charconv>
+#include <climits>
 
 using Type = DataType::Category;
 
+// The most elements a fixed-size array may have; each takes 8 bytes.
+static constexpr long long maxArrayLength = 1 << 24;
+
+// The value of the decimal `text`, or -1 unless it is a number from 0 to
+// `limit`.
+static long long parseNumber(const std::string &text, long long limit) {
+    long long value = 0;
+    auto [end, status] =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    if (status != std::errc() || end != text.data() + text.size() ||
+        value < 0 || value > limit) {
+        return -1;
+    }
+    return value;
+}
+
 void Parser::expect(TokenType type) {
     if (type == getCurrentToken().type) {
         return;
     }
-    std::cerr << "Expected " << lexer.token_to_string(type) << " but got "
-              << lexer.token_to_string(getCurrentToken().type) << std::endl;
+    error(std::string("Expected ") + lexer.token_to_string(type) +
+          " but got " + lexer.token_to_string(getCurrentToken().type));
+}
+
+void Parser::error(const std::string &message) {
+    // Once a file has ended early, whatever else is missing says nothing
+    // new.
+    if (match(EoF)) {
+        if (endReported) {
+            return;
+        }
+        endReported = true;
+    }
+    error(getCurrentToken(), message);
+}
+
+void Parser::error(const Token &at, const std::string &message) {
+    if (diagnostics) {
+        diagnostics->error(lexer.fileName(), at.line, at.col, message,
+                           at.line > 0 ? lexer.sourceLine(at.line) : "");
+    }
 }
 
 void Parser::consume(TokenType type) {
     expect(type);
-    index++;
+    // A file that ends early is read as ending in as many EoF tokens as the
+    // parser asks for.
+    if (index < lexer.tokens.size() && !match(EoF)) {
+        index++;
+    }
 }
 
-Token Parser::getCurrentToken() { return *lexer.tokens[index]; }
+Token Parser::getCurrentToken() {
+    return index < lexer.tokens.size() ? *lexer.tokens[index] : endOfFile();
+}
 
 Token Parser::getNextToken() {
     if (hasNextToken()) {
         return *lexer.tokens[index + 1];
     }
-    throw std::runtime_error("There is no next token");
+    return endOfFile();
+}
+
+Token Parser::endOfFile() {
+    Token end;
+    end.type = EoF;
+    if (!lexer.tokens.empty()) {
+        end.line = lexer.tokens.back()->line;
+        end.col = lexer.tokens.back()->col;
+    }
+    return end;
 }
 
 Token Parser::getPreviousToken() { return *lexer.tokens[index - 1]; }
@@ -46,6 +101,20 @@ bool Parser::isOperator(TokenType type) {
     }
 }
 
+bool Parser::isComparison(TokenType type) {
+    switch (type) {
+    case EQUAL:
+    case NOT_EQUAL:
+    case LESS:
+    case LESS_EQUAL:
+    case GREATER:
+    case GREATER_EQUAL:
+        return true;
+    default:
+        return false;
+    }
+}
+
 Operation Parser::getOperationType(TokenType type) {
     switch (type) {
     case PLUS:
@@ -58,23 +127,46 @@ Operation Parser::getOperationType(TokenType type) {
         return Operation::DIVIDE;
     case EQUAL:
         return Operation::EQUAL;
+    case NOT_EQUAL:
+        return Operation::NOT_EQUAL;
+    case LESS:
+        return Operation::LESS;
+    case LESS_EQUAL:
+        return Operation::LESS_EQUAL;
+    case GREATER:
+        return Operation::GREATER;
+    case GREATER_EQUAL:
+        return Operation::GREATER_EQUAL;
     default:
         throw std::runtime_error("Invalid operation type");
     }
 }
 
 void Parser::parse() {
-    lexer.read();
-    lexer.lex();
-    lexer.tokenalize();
-    lexer.print_tokens();
+    {
+        TimeScope scope(timeline, "read");
+        lexer.read();
+    }
+    {
+        TimeScope scope(timeline, "lex");
+        lexer.lex();
+    }
+    {
+        TimeScope scope(timeline, "tokenalize");
+        lexer.tokenalize();
+    }
     index = 0;
 
+    TimeScope scope(timeline, "parse");
+
     while (index < lexer.tokens.size()) {
         if (getCurrentToken().type == EoF) {
             break;
         }
         switch (getCurrentToken().type) {
+        case IMPORT:
+            parseImport();
+            break;
         case FUNCTION:
             parseFunction();
             break;
@@ -83,26 +175,81 @@ void Parser::parse() {
             ast.addNode(a);
             break;
         }
-        case IDENTIFIER: {
-            auto a = parseVariableReference();
-            std::cout << a->name << std::endl;
-            ast.addNode(a);
-            break;
-        }
         default:
+            // Skips to the next declaration, such as past the rest of a
+            // function whose body ended early on an error.
+            error(std::string("Unexpected token: ") +
+                  lexer.token_to_string(getCurrentToken().type));
+            while (!match(EoF) && !match(FUNCTION) && !match(LET) &&
+                   !match(IMPORT)) {
+                index++;
+            }
             break;
         }
     }
-
-    ast.printAST();
     print_cuurent_scope();
 }
 
+// `import name;` declares the functions of module `name` by parsing its
+// interface, which is just a list of bodiless function declarations.
+void Parser::parseImport() {
+    consume(IMPORT);
+    Token nameToken = getCurrentToken();
+    std::string name = nameToken.value;
+    expect(IDENTIFIER);
+    consume(IDENTIFIER);
+    expect(SEMICOLON);
+    consume(SEMICOLON);
+
+    if (!interfaces) {
+        throw std::runtime_error("cannot import '" + name +
+                                 "' outside a module build (--build)");
+    }
+    auto interface = interfaces->find(name);
+    if (interface == interfaces->end()) {
+        throw std::runtime_error("unknown module '" + name + "'");
+    }
+
+    Lexer declarations(name + ".xi", interface->second);
+    declarations.diagnostics = diagnostics;
+    Parser module(declarations);
+    module.diagnostics = diagnostics;
+    module.parse();
+    ast.usesArrays = ast.usesArrays || module.ast.usesArrays;
+
+    for (auto imported : module.ast.externs) {
+        auto [previous, added] = importedFrom.emplace(imported->name, name);
+        if (!added) {
+            if (previous->second != name) {
+                error(nameToken, "'" + imported->name +
+                                     "' is imported from both '" +
+                                     previous->second + "' and '" + name +
+                                     "'.");
+            }
+            continue;
+        }
+        std::vector<VariableDeclaration *> parameters;
+        for (auto parameter : imported->parameters) {
+            parameters.push_back(make<VariableDeclaration>(
+                parameter->name, parameter->variable_type,
+                make<Expression>(parameter->name, parameter->variable_type)));
+        }
+        auto func = make<FunctionDeclaration>(imported->name, parameters,
+                                              imported->return_type, nullptr);
+        globalSymbolTable->AddFunction(func->name, func);
+        ast.externs.push_back(func);
+    }
+}
+
 void Parser::parseFunction() {
+    TimeScope scope(timeline, "parse function");
+    size_t first = index;
     expect(FUNCTION);
     consume(FUNCTION);
 
-    std::string name = getCurrentToken().value;
+    Token nameToken = getCurrentToken();
+    std::string name = nameToken.value;
+    scope.setDetail(name);
     std::vector<VariableDeclaration *> parameters;
     expect(IDENTIFIER);
     consume(IDENTIFIER);
@@ -112,7 +259,7 @@ void Parser::parseFunction() {
 
     enterScope();
 
-    while (getCurrentToken().type != RPAREN) {
+    while (!match(RPAREN) && !match(EoF)) {
         std::string paramName = getCurrentToken().value;
         expect(IDENTIFIER);
         consume(IDENTIFIER);
@@ -120,10 +267,10 @@ void Parser::parseFunction() {
         consume(COLON);
         DataType paramType = parseDataType();
 
-        Expression *param = new Expression(paramName, paramType);
+        Expression *param = make<Expression>(paramName, paramType);
         VariableDeclaration *var =
-            new VariableDeclaration(paramName, paramType, param);
-        globalSymbolTable->parentScope->AddVariable(paramName, var);
+            make<VariableDeclaration>(paramName, paramType, param);
+        globalSymbolTable->AddVariable(paramName, var);
         parameters.emplace_back(var);
         if (getCurrentToken().type != RPAREN) {
             expect(COMMA);
@@ -139,83 +286,135 @@ void Parser::parseFunction() {
 
     DataType returnType = parseDataType();
 
+    if (importedFrom.count(name)) {
+        error(nameToken, "'" + name + "' is already imported from '" +
+                             importedFrom[name] + "'.");
+    }
+
+    // A declaration only: the function is defined in another module.
+    if (match(SEMICOLON)) {
+        consume(SEMICOLON);
+        FunctionDeclaration *func = locate(
+            make<FunctionDeclaration>(name, parameters, returnType, nullptr),
+            first);
+        globalSymbolTable->parentScope->AddFunction(name, func);
+        ast.externs.push_back(func);
+        exitScope();
+        return;
+    }
+
     expect(LBRACE);
     consume(LBRACE);
 
-    FunctionBody *body = new FunctionBody();
+    FunctionBody *body = make<FunctionBody>();
+
+    // Register the function before its body so recursive calls resolve.
+    FunctionDeclaration *func = locate(
+        make<FunctionDeclaration>(name, parameters, returnType, body), first);
+    globalSymbolTable->parentScope->AddFunction(name, func);
 
     body = parseBody(body);
 
     expect(RBRACE);
     consume(RBRACE);
 
-    FunctionDeclaration *func =
-        new FunctionDeclaration(name, parameters, returnType, body);
+    Hasher tokens;
+    Hasher lines;
+    for (size_t i = first; i < index; ++i) {
+        tokens.add(static_cast<uint64_t>(lexer.tokens[i]->type));
+        tokens.add(lexer.tokens[i]->value);
+        lines.add(static_cast<uint64_t>(lexer.tokens[i]->line));
+    }
+    func->tokenHash = tokens.value();
+    func->lineHash = lines.value();
+
     ast.addNode(func);
-    globalSymbolTable->AddFunction(name, func);
     exitScope();
 }
 
 FunctionBody *Parser::parseBody(FunctionBody *body) {
-    while (getCurrentToken().type != RBRACE) {
+    while (!match(RBRACE) && !match(EoF)) {
         if (getCurrentToken().type == LET) {
             auto var = parseVariableDeclaration();
             body->addInstruction(var);
-            globalSymbolTable->parentScope->AddVariable(var->name, var);
+            globalSymbolTable->AddVariable(var->name, var);
         } else if (getCurrentToken().type == RETURN) {
             // TODO: Handle return type
             parseReturnStatement(body, DataType::Category::INT);
         } else if (getCurrentToken().type == IF) {
             auto stats = parseIfStatement();
             body->addInstruction(stats);
+        } else if (getCurrentToken().type == WHILE) {
+            body->addInstruction(parseWhileStatement());
+        } else if (getCurrentToken().type == FOR) {
+            body->addInstruction(parseForStatement());
         } else if (getCurrentToken().type == ELSE) {
+            size_t first = index;
             consume(ELSE);
-            FunctionBody *elseBody = new FunctionBody();
-            expect(LBRACE);
-            consume(LBRACE);
-            elseBody = parseBody(elseBody);
-            expect(RBRACE);
-            consume(RBRACE);
-            ElseStatement *elseStatement = new ElseStatement(elseBody, body);
-            body->addInstruction(elseStatement);
+            FunctionBody *elseBody = parseBlock();
+            body->addInstruction(
+                locate(make<ElseStatement>(elseBody, body), first));
         } else if (getCurrentToken().type == PRINTLN_KW) {
             auto print = parsePrintStatement();
             body->addInstruction(print);
         } else if (getCurrentToken().type == IDENTIFIER) {
-            if (getNextToken().type == EQUAL) {
+            if (getNextToken().type == EQUAL ||
+                getNextToken().type == LBRACKET) {
                 auto var = parseVariableAssignment();
                 body->addInstruction(var);
             } else {
-                auto var = parseVariableReference();
-                body->addInstruction(var);
+                size_t first = index;
+                Expression *expression = parseExpression();
+                expect(SEMICOLON);
+                consume(SEMICOLON);
+                body->addInstruction(locate(expression, first));
             }
         } else {
-            std::cerr << "Unexpected token: "
-                      << lexer.token_to_string(getCurrentToken().type)
-                      << std::endl;
+            error(std::string("Unexpected token: ") +
+                  lexer.token_to_string(getCurrentToken().type));
             break;
         }
     }
     return body;
 }
 
+FunctionBody *Parser::parseBlock() {
+    // Without its `{`, the block would take the statements after it.
+    if (!match(LBRACE)) {
+        expect(LBRACE);
+        return make<FunctionBody>();
+    }
+    consume(LBRACE);
+
+    enterScope();
+    FunctionBody *body = parseBody(make<FunctionBody>());
+    exitScope();
+
+    expect(RBRACE);
+    consume(RBRACE);
+    return body;
+}
+
 void Parser::parseReturnStatement(FunctionBody *body, DataType returnType) {
+    size_t first = index;
     expect(RETURN);
     consume(RETURN);
 
     Expression *expression = parseExpression();
 
     if (expression) {
-        body->addReturnStatement(expression);
+        locate(body->addReturnStatement(ast.arena, expression), first);
         body->setReturnType(returnType);
         consume(SEMICOLON);
     }
 }
 
 VariableDeclaration *Parser::parseVariableDeclaration() {
+    size_t first = index;
     expect(LET);
     consume(LET);
-    std::string name = getCurrentToken().value;
+    Token nameToken = getCurrentToken();
+    std::string name = nameToken.value;
     consume(IDENTIFIER);
     expect(COLON);
     consume(COLON);
@@ -224,125 +423,68 @@ VariableDeclaration *Parser::parseVariableDeclaration() {
 
     if (match(EQUAL)) {
         consume(EQUAL);
-        if (match(IDENTIFIER)) {
-            std::string functionName = getCurrentToken().value;
-            consume(IDENTIFIER);
-            std::vector<Expression *> arguments;
-            expect(LPAREN);
-            consume(LPAREN);
-
-            while (getCurrentToken().type != RPAREN) {
-                Expression *argument = parseExpression();
-                arguments.push_back(argument);
-                if (match(COMMA)) {
-                    consume(COMMA);
-                } else {
-                    break;
-                }
-            }
-
-            expect(RPAREN);
-            consume(RPAREN);
+        initialization_value = parseExpression();
+    }
 
-            initialization_value =
-                new FunctionCall(functionName, arguments, type);
-        } else {
-            initialization_value = parseExpression();
-        }
+    if (type.isArray() && initialization_value) {
+        error(nameToken,
+              "Array '" + name + "' cannot be initialized from a value.");
+        initialization_value = nullptr;
     }
 
-    VariableDeclaration *variableDeclaration =
-        new VariableDeclaration(name, type, initialization_value);
+    VariableDeclaration *variableDeclaration = locate(
+        make<VariableDeclaration>(name, type, initialization_value), first);
     expect(SEMICOLON);
     consume(SEMICOLON);
 
     if (scopeStack.empty()) {
+        variableDeclaration->is_global = true;
         globalSymbolTable->AddVariable(name, variableDeclaration);
     }
 
     return variableDeclaration;
 }
 
-VariableReference *Parser::parseVariableReference() {
-    std::string name = getCurrentToken().value;
-    if (globalSymbolTable->parentScope->hasVariable(name)) {
-        auto var = globalSymbolTable->parentScope->GetVariable(name);
-        return new VariableReference(
-            name, var->initialization_value,
-            globalSymbolTable->parentScope->GetVariable(name)->variable_type);
-    }
-    return nullptr;
-}
-
 Expression *Parser::parseCondition() {
-    if (match(LPAREN)) {
-        consume(LPAREN);
-
-        expect(IDENTIFIER);
-        std::string identifier = getCurrentToken().value;
-        VariableReference *ref = parseVariableReference();
-        consume(IDENTIFIER);
-
-        Expression *expression =
-            new Expression(identifier, ref->variable_type, ref->name);
+    expect(LPAREN);
+    consume(LPAREN);
 
-        consume(EQUAL);
+    Expression *condition = parseExpression();
 
-        Expression *right = parseTerm();
-
-        expect(RPAREN);
-        consume(RPAREN);
+    expect(RPAREN);
+    consume(RPAREN);
 
-        return new Expression(Operation::EQUAL, expression, right);
+    if (!condition) {
+        throw std::runtime_error("Invalid condition");
     }
-
-    throw std::runtime_error("Invalid condition");
-    return nullptr;
+    return condition;
 }
 
 Expression *Parser::parseExpression() {
-    Expression *expression = parseTerm();
+    Expression *expression = parseAdditive();
 
-    if (match(TRUE)) {
-        consume(TRUE);
-        expression = new Expression(true);
-        return expression;
-    } else if (match(FALSE)) {
-        consume(FALSE);
-        expression = new Expression(false);
-        return expression;
+    while (isComparison(getCurrentToken().type)) {
+        TokenType op = getCurrentToken().type;
+        consume(op);
+        Expression *right = parseAdditive();
+        expression = make<Expression>(getOperationType(op), expression, right);
     }
 
-    while (match(LPAREN)) {
-        consume(LPAREN);
-        std::string funcName = expression->variable_name;
-        std::vector<Expression *> args;
-
-        while (!match(RPAREN)) {
-            Expression *arg = parseExpression();
-            args.push_back(arg);
-            if (match(COMMA)) {
-                consume(COMMA);
-            }
-        }
+    return expression;
+}
 
-        expect(RPAREN);
-        consume(RPAREN);
+Expression *Parser::parseAdditive() {
+    Expression *left = parseTerm();
 
-        DataType returnType = determineFunctionReturnType(funcName, args);
-        Expression *funcCall = new Expression(funcName, args, returnType);
-        expression = funcCall;
-    }
+    while (getCurrentToken().type == PLUS || getCurrentToken().type == MINUS) {
+        TokenType op = getCurrentToken().type;
+        consume(op);
 
-    while (isOperator(getCurrentToken().type)) {
-        Token op = getCurrentToken();
-        consume(op.type);
         Expression *right = parseTerm();
-        expression =
-            new Expression(getOperationType(op.type), expression, right);
+        left = make<Expression>(getOperationType(op), left, right);
     }
 
-    return expression;
+    return left;
 }
 
 Expression *Parser::parseTerm() {
@@ -355,9 +497,9 @@ Expression *Parser::parseTerm() {
         Expression *right = parseFactor();
 
         if (op == STAR) {
-            left = new Expression(Operation::MULTIPLY, left, right);
+            left = make<Expression>(Operation::MULTIPLY, left, right);
         } else if (op == SLASH) {
-            left = new Expression(Operation::DIVIDE, left, right);
+            left = make<Expression>(Operation::DIVIDE, left, right);
         }
     }
 
@@ -368,48 +510,55 @@ Expression *Parser::parseFactor() {
     Expression *primary = nullptr;
 
     if (getCurrentToken().type == NUMBER) {
+        if (parseNumber(getCurrentToken().value, INT_MAX) < 0) {
+            error("Integer " + getCurrentToken().value +
+                  " does not fit in an int.");
+        }
         primary =
-            new Expression(getCurrentToken().value, DataType::Category::INT);
+            make<Expression>(getCurrentToken().value, DataType::Category::INT);
         consume(NUMBER);
     } else if (getCurrentToken().type == FLOAT_LITERAL) {
-        primary =
-            new Expression(getCurrentToken().value, DataType::Category::FLOAT);
+        primary = make<Expression>(getCurrentToken().value,
+                                   DataType::Category::FLOAT);
         consume(FLOAT_LITERAL);
-    } else if (getCurrentToken().type == BOOL) {
-        primary =
-            new Expression(getCurrentToken().value, DataType::Category::BOOL);
-        consume(BOOL);
-        if (getCurrentToken().value == "true") {
-            consume(TRUE);
-        } else if (getCurrentToken().value == "false") {
-            consume(FALSE);
-        }
+    } else if (getCurrentToken().type == TRUE) {
+        consume(TRUE);
+        primary = make<Expression>(true);
+    } else if (getCurrentToken().type == FALSE) {
+        consume(FALSE);
+        primary = make<Expression>(false);
     } else if (getCurrentToken().type == CHAR) {
         primary =
-            new Expression(getCurrentToken().value, DataType::Category::CHAR);
+            make<Expression>(getCurrentToken().value, DataType::Category::CHAR);
         consume(CHAR);
     } else if (getCurrentToken().type == STRING_LITERAL) {
-        primary = new Expression("\"" + getCurrentToken().value + "\"",
-                                 DataType::Category::STRING);
+        primary = make<Expression>("\"" + getCurrentToken().value + "\"",
+                                   DataType::Category::STRING);
         consume(STRING_LITERAL);
     } else if (getCurrentToken().type == IDENTIFIER) {
         std::string variableName = getCurrentToken().value;
         consume(IDENTIFIER);
 
-        if (globalSymbolTable->parentScope->hasVariable(variableName)) {
-            DataType variableType =
-                globalSymbolTable->parentScope->GetVariable(variableName)
-                    ->variable_type;
-            std::string variableValue =
-                globalSymbolTable->GetVariable(variableName)
-                    ->initialization_value->literal_value;
-            primary = new Expression(variableName, parseVariableReference(),
-                                     variableType, variableValue);
-            primary->variable_reference =
-                globalSymbolTable->parentScope->GetVariableRef(variableName);
+        if (match(LPAREN)) {
+            primary = parseFunctionCall(variableName);
+        } else if (match(LBRACKET)) {
+            primary = parseIndex(variableName);
+        } else if (auto var = globalSymbolTable->GetVariable(variableName)) {
+            std::string variableValue;
+            if (var->initialization_value) {
+                variableValue = var->initialization_value->literal_value;
+            }
+            primary = make<Expression>(
+                variableName,
+                make<VariableReference>(variableName, var->initialization_value,
+                                        var->variable_type),
+                var->variable_type, variableValue);
+            primary->is_global = var->is_global;
         } else {
-            std::cerr << "Variable '" << variableName << "' is undefined."
-                      << std::endl;
+            error(getPreviousToken(),
+                  "Variable '" + variableName + "' is undefined.");
+            primary = make<Expression>(variableName, nullptr,
+                                       DataType::Category::UNKNOWN, "");
         }
     } else if (getCurrentToken().type == LPAREN) {
         consume(LPAREN);
@@ -417,11 +566,79 @@ Expression *Parser::parseFactor() {
         expect(RPAREN);
         consume(RPAREN);
     } else {
+        error(std::string("Expected an expression but got ") +
+              lexer.token_to_string(getCurrentToken().type));
     }
 
     return primary;
 }
 
+Expression *Parser::parseArrayReference(const std::string &name) {
+    auto var = globalSymbolTable->GetVariable(name);
+    if (!var || !var->variable_type.isArray()) {
+        error("'" + name + "' is not an array.");
+        return make<Expression>(name, nullptr, DataType::Category::UNKNOWN, "");
+    }
+    auto array = make<Expression>(
+        name,
+        make<VariableReference>(name, var->initialization_value,
+                                var->variable_type),
+        var->variable_type, "");
+    array->is_global = var->is_global;
+    return array;
+}
+
+Expression *Parser::parseIndex(const std::string &arrayName) {
+    Expression *array = parseArrayReference(arrayName);
+
+    expect(LBRACKET);
+    consume(LBRACKET);
+    Expression *index = parseExpression();
+    expect(RBRACKET);
+    consume(RBRACKET);
+
+    return make<Expression>(array, index, array->variable_type.elementType());
+}
+
+void Parser::parseArguments(std::vector<Expression *> &arguments) {
+    // Stops at the end of the statement, or at a token no expression starts
+    // with, and leaves the missing `)` to the caller to report.
+    while (!match(RPAREN) && !match(SEMICOLON) && !match(RBRACE) &&
+           !match(EoF)) {
+        if (match(COMMA)) {
+            consume(COMMA);
+            continue;
+        }
+        size_t first = index;
+        Expression *argument = parseExpression();
+        if (index == first) {
+            break;
+        }
+        arguments.push_back(argument);
+    }
+}
+
+Expression *Parser::parseFunctionCall(const std::string &functionName) {
+    Token call = getPreviousToken();
+    expect(LPAREN);
+    consume(LPAREN);
+
+    std::vector<Expression *> arguments;
+    parseArguments(arguments);
+
+    expect(RPAREN);
+    consume(RPAREN);
+
+    DataType returnType =
+        determineFunctionReturnType(call, functionName, arguments);
+    return make<Expression>(functionName, arguments, returnType);
+}
+
+// len(array) and push(array, value).
+bool Parser::isBuiltinFunction(const std::string &functionName) {
+    return functionName == "len" || functionName == "push";
+}
+
 DataType Parser::parseDataType() {
     DataType type = DataType::Category::UNKNOWN;
     if (getCurrentToken().type == INT) {
@@ -440,78 +657,196 @@ DataType Parser::parseDataType() {
         type = DataType::Category::STRING;
         consume(STRING);
     } else {
-        throw std::runtime_error("Invalid data type");
+        error(std::string("Expected a type but got ") +
+              lexer.token_to_string(getCurrentToken().type));
+        return type;
+    }
+
+    // int[10] is a fixed-size array, int[] a growable one.
+    if (match(LBRACKET)) {
+        consume(LBRACKET);
+        int length = -1;
+        if (match(NUMBER)) {
+            long long value = parseNumber(getCurrentToken().value,
+                                          maxArrayLength);
+            if (value < 1) {
+                error("Array length " + getCurrentToken().value +
+                      " is not between 1 and " +
+                      std::to_string(maxArrayLength) + ".");
+                value = 1;
+            }
+            length = static_cast<int>(value);
+            consume(NUMBER);
+        }
+        expect(RBRACKET);
+        consume(RBRACKET);
+        type = DataType::array(type.category, length);
+        ast.usesArrays = true;
     }
     return type;
 }
 
 DataType
-Parser::determineFunctionReturnType(const std::string &functionName,
+Parser::determineFunctionReturnType(const Token &call,
+                                    const std::string &functionName,
                                     const std::vector<Expression *> &args) {
-    if (globalSymbolTable->parentScope->hasFunction(functionName)) {
-        DataType functionType =
-            globalSymbolTable->parentScope->GetFunction(functionName)
-                ->return_type;
+    if (isBuiltinFunction(functionName)) {
+        if (args.empty() || !args[0] || !args[0]->variable_type.isArray()) {
+            error(call, "'" + functionName + "' expects an array.");
+        } else if (functionName == "push" &&
+                   (args.size() != 2 ||
+                    args[0]->variable_type.isFixedArray())) {
+            error(call, "'push' expects a growable array and a value.");
+        }
+        return functionName == "len" ? DataType(DataType::Category::INT)
+                                     : DataType();
+    }
+
+    if (auto function = globalSymbolTable->GetFunction(functionName)) {
+        DataType functionType = function->return_type;
+
+        for (size_t i = 0; i < args.size() && i < function->parameters.size();
+             ++i) {
+            DataType param = function->parameters[i]->variable_type;
+            if (param.isArray() && args[i] &&
+                (!args[i]->variable_type.isArray() ||
+                 args[i]->variable_type.element != param.element ||
+                 args[i]->variable_type.length != param.length)) {
+                error(call, "Argument " + std::to_string(i + 1) + " of '" +
+                                functionName + "' must be " +
+                                dataTypeToString(param) + ".");
+            }
+        }
 
         if (functionType.category != DataType::Category::UNKNOWN) {
-            return functionType.category;
+            return functionType;
         } else {
-            std::cerr << "Function '" << functionName
-                      << "' has an undefined return type." << std::endl;
+            error(call, "Function '" + functionName +
+                            "' has an undefined return type.");
         }
     } else {
-        std::cerr << "Function '" << functionName << "' is undefined."
-                  << std::endl;
+        error(call, "Function '" + functionName + "' is undefined.");
     }
 
     return DataType(DataType::Category::UNKNOWN);
 }
 
-VariableAssignment *Parser::parseVariableAssignment() {
-    std::string name = getCurrentToken().value;
+VariableAssignment *Parser::parseVariableAssignment(bool terminated) {
+    size_t first = index;
+    Token nameToken = getCurrentToken();
+    std::string name = nameToken.value;
     consume(IDENTIFIER);
+
+    Expression *element = nullptr;
+    if (match(LBRACKET)) {
+        element = parseIndex(name);
+    }
     expect(EQUAL);
     consume(EQUAL);
 
     Expression *assignmentValue = parseExpression();
 
-    expect(SEMICOLON);
-    consume(SEMICOLON);
+    if (terminated) {
+        expect(SEMICOLON);
+        consume(SEMICOLON);
+    }
 
-    auto *var = globalSymbolTable->parentScope->GetVariable(name);
+    auto *var = globalSymbolTable->GetVariable(name);
 
-    if (var) {
+    if (var && element) {
+        auto assignment = make<VariableAssignment>(
+            var, var->initialization_value, assignmentValue);
+        assignment->element = element;
+        return locate(assignment, first);
+    } else if (var) {
+        if (var->variable_type.isArray()) {
+            checkArrayAssignment(nameToken, var, assignmentValue);
+        }
         Expression *oldValue = var->initialization_value;
-        globalSymbolTable->parentScope->setNewVariableValue(name,
-                                                            assignmentValue);
-        return new VariableAssignment(var, oldValue, assignmentValue);
+        globalSymbolTable->setNewVariableValue(name, assignmentValue);
+        return locate(make<VariableAssignment>(var, oldValue, assignmentValue),
+                      first);
     } else {
-        std::cerr << "Variable not found: " << name << std::endl;
+        error(nameToken, "Variable not found: " + name);
         return nullptr;
     }
 }
 
+// `a = b` makes the growable array a refer to b, as passing b to a
+// parameter does. Fixed-size arrays are not values, and a global must not
+// be left referring to a function's local array.
+void Parser::checkArrayAssignment(const Token &at, VariableDeclaration *array,
+                                  const Expression *value) {
+    const DataType &type = array->variable_type;
+    if (type.isFixedArray()) {
+        error(at, "Array '" + array->name +
+                      "' has a fixed size; assign its elements instead.");
+    } else if (array->is_global) {
+        error(at, "Global array '" + array->name + "' cannot be assigned.");
+    } else if (value && (!value->variable_type.isArray() ||
+                         value->variable_type.isFixedArray() ||
+                         value->variable_type.element != type.element ||
+                         value->type != Expression::Type::VARIABLE_REFERENCE)) {
+        error(at, "Array '" + array->name + "' can only be assigned another " +
+                      dataTypeToString(type) + ".");
+    }
+}
+
 IfStatement *Parser::parseIfStatement() {
+    size_t first = index;
     expect(IF);
     consume(IF);
 
     Expression *condition = parseCondition();
-    FunctionBody *ifBody = new FunctionBody();
-    FunctionBody *elseBody = new FunctionBody();
+    FunctionBody *ifBody = parseBlock();
+    FunctionBody *elseBody = make<FunctionBody>();
 
-    expect(LBRACE);
-    consume(LBRACE);
+    return locate(make<IfStatement>(condition, ifBody, elseBody), first);
+}
 
-    ifBody = parseBody(ifBody);
+WhileStatement *Parser::parseWhileStatement() {
+    size_t first = index;
+    expect(WHILE);
+    consume(WHILE);
 
-    expect(RBRACE);
-    consume(RBRACE);
+    Expression *condition = parseCondition();
+    FunctionBody *body = parseBlock();
 
-    return new IfStatement(condition, ifBody, elseBody);
+    return locate(make<WhileStatement>(condition, body), first);
+}
+
+// for (let i: int = 0; i < n; i = i + 1){ ... }
+ForStatement *Parser::parseForStatement() {
+    size_t first = index;
+    expect(FOR);
+    consume(FOR);
+    expect(LPAREN);
+    consume(LPAREN);
+
+    enterScope();
+
+    VariableDeclaration *init = parseVariableDeclaration();
+    globalSymbolTable->AddVariable(init->name, init);
+
+    Expression *condition = parseExpression();
+    expect(SEMICOLON);
+    consume(SEMICOLON);
+
+    VariableAssignment *step = parseVariableAssignment(false);
+
+    expect(RPAREN);
+    consume(RPAREN);
+
+    FunctionBody *body = parseBlock();
+
+    exitScope();
+
+    return locate(make<ForStatement>(init, condition, step, body), first);
 }
 
 PrintNode *Parser::parsePrintStatement() {
     PrintNode *printNode = nullptr;
+    size_t first = index;
     expect(PRINTLN_KW);
     std::string functionName = getCurrentToken().value;
     consume(PRINTLN_KW);
@@ -528,28 +863,7 @@ PrintNode *Parser::parsePrintStatement() {
         stringArgs.push_back(argValue);
     }
 
-    if (match(COMMA)) {
-        consume(COMMA);
-    }
-
-    while (!match(RPAREN)) {
-        if (match(COMMA)) {
-            consume(COMMA);
-        }
-        std::string argValue = getCurrentToken().value;
-        if (globalSymbolTable->parentScope->hasVariable(argValue)) {
-            VariableReference *var =
-                globalSymbolTable->parentScope->GetVariableRef(argValue);
-            expressionArgs.push_back(
-                new Expression(var->name, var->variable_type,
-                               var->initialization_value->literal_value));
-        } else {
-            Expression *arg = parseExpression();
-            expressionArgs.push_back(arg);
-        }
-
-        consume(IDENTIFIER);
-    }
+    parseArguments(expressionArgs);
 
     expect(RPAREN);
     consume(RPAREN);
@@ -557,6 +871,62 @@ PrintNode *Parser::parsePrintStatement() {
     expect(SEMICOLON);
     consume(SEMICOLON);
 
-    printNode = new PrintNode(functionName, stringArgs, expressionArgs);
+    printNode = locate(
+        make<PrintNode>(functionName, stringArgs, expressionArgs), first);
     return printNode;
 }
+
+void Parser::accountMemory(MemoryUsage &usage) const {
+    size_t scopes = 1 + scopeStack.size();
+    size_t bytes = globalSymbolTable->bytes();
+    for (const SymbolTable *scope : scopeStack) {
+        bytes += scope->bytes();
+    }
+    usage.add("symbol tables", scopes, bytes);
+
+    // Largest first; the sizes are those of the nodes themselves.
+    std::vector<Arena::Usage> kinds = ast.arena.usage();
+    std::stable_sort(kinds.begin(), kinds.end(),
+                     [](const Arena::Usage &a, const Arena::Usage &b) {
+                         return a.bytes > b.bytes;
+                     });
+    size_t nodes = 0;
+    for (const auto &kind : kinds) {
+        usage.add("AST " + typeName(*kind.type), kind.count, kind.bytes);
+        nodes += kind.bytes;
+    }
+    // What the arena takes beyond the nodes: the unused ends of its
+    // blocks and its bookkeeping, and the list of top-level nodes.
+    usage.add("AST arena overhead", 1,
+              ast.arena.reservedBytes() - nodes +
+                  ast.nodes.capacity() * sizeof(ast.nodes[0]));
+}
+
+std::string moduleInterface(const ASTGen &ast) {
+    auto source = [](DataType type) {
+        std::string name = dataTypeToString(type);
+        std::transform(name.begin(), name.end(), name.begin(),
+                       [](unsigned char c) { return std::tolower(c); });
+        return name;
+    };
+    std::string interface;
+    for (auto node : ast.nodes) {
+        if (node->type != NodeType::FUNCTION_DECLARATION) {
+            continue;
+        }
+        auto func = dynamic_cast<const FunctionDeclaration *>(node);
+        if (func->name == "main") {
+            continue;
+        }
+        interface += "fn " + func->name + "(";
+        for (size_t i = 0; i < func->parameters.size(); ++i) {
+            if (i > 0) {
+                interface += ", ";
+            }
+            interface += func->parameters[i]->name + ": " +
+                         source(func->parameters[i]->variable_type);
+        }
+        interface += "): " + source(func->return_type) + ";\n";
+    }
+    return interface;
+}
@@ -3,8 +3,10 @@
 
 // clang-format off
 #include "lexer.hpp"
+#include <map>
 #include <unordered_map>
 #include "astGen.hpp"
+#include "timing.hpp"
 // clang-format on
 
 struct SymbolTable {
@@ -30,17 +32,6 @@ struct SymbolTable {
         return nullptr;
     }
 
-    VariableReference *GetVariableRef(const std::string &name) {
-        if (variables.count(name) > 0) {
-            return new VariableReference(name,
-                                         variables[name]->initialization_value,
-                                         variables[name]->variable_type);
-        } else if (parentScope) {
-            return parentScope->GetVariableRef(name);
-        }
-        return nullptr;
-    }
-
     FunctionDeclaration *GetFunction(const std::string &name) {
         if (functions.count(name) > 0) {
             return functions[name];
@@ -69,14 +60,18 @@ struct SymbolTable {
     }
 
     void setNewVariableValue(const std::string &name, Expression *newValue) {
-        if (hasVariable(name)) {
-            VariableDeclaration *var = variables[name];
+        if (VariableDeclaration *var = GetVariable(name)) {
             var->valueChanged = true;
             var->oldValue = var->initialization_value;
             var->newValue = newValue;
         }
     }
 
+    size_t bytes() const {
+        return sizeof(*this) + hashMapBytes(variables) +
+               hashMapBytes(functions);
+    }
+
     SymbolTable(SymbolTable *parent = nullptr) : parentScope(parent) {}
 
     ~SymbolTable() {}
@@ -87,47 +82,67 @@ class Parser {
 private:
     Lexer &lexer;
     size_t index;
+    // Whether an error at the end of the file has been reported.
+    bool endReported = false;
 
     void expect(TokenType type);
     Token getCurrentToken();
     Token getNextToken();
     Token getPreviousToken();
+    // What the parser reads past the last token.
+    Token endOfFile();
     bool hasNextToken();
     void consume(TokenType type);
     bool match(TokenType type);
 
     bool isOperator(TokenType type);
+    bool isComparison(TokenType type);
     Operation getOperationType(TokenType type);
 
     DataType parseDataType();
-    DataType determineFunctionReturnType(const std::string &functionName,
+    DataType determineFunctionReturnType(const Token &call,
+                                         const std::string &functionName,
                                          const std::vector<Expression *> &args);
     // Parser
+    void parseImport();
     void parseFunction();
     void parseReturnStatement(FunctionBody *body, DataType returnType);
     VariableDeclaration *parseVariableDeclaration();
-    VariableReference *parseVariableReference();
     Expression *parseExpression();
+    Expression *parseAdditive();
     Expression *parseTerm();
     Expression *parseFactor();
-    VariableAssignment *parseVariableAssignment();
+    VariableAssignment *parseVariableAssignment(bool terminated = true);
+    void checkArrayAssignment(const Token &at, VariableDeclaration *array,
+                              const Expression *value);
     IfStatement *parseIfStatement();
+    WhileStatement *parseWhileStatement();
+    ForStatement *parseForStatement();
     Expression *parseCondition();
+    // Parses comma-separated expressions up to a closing `)`.
+    void parseArguments(std::vector<Expression *> &arguments);
+    Expression *parseFunctionCall(const std::string &functionName);
+    Expression *parseArrayReference(const std::string &name);
+    Expression *parseIndex(const std::string &arrayName);
+    bool isBuiltinFunction(const std::string &functionName);
     FunctionBody *parseBody(FunctionBody *body);
+    FunctionBody *parseBlock();
     PrintNode *parsePrintStatement();
 
     // SymbolTable
 
     void enterScope() {
-        SymbolTable *newScope = new SymbolTable(globalSymbolTable);
-        scopeStack.push_back(newScope);
-        globalSymbolTable = newScope;
+        scopeStack.push_back(globalSymbolTable);
+        globalSymbolTable = new SymbolTable(globalSymbolTable);
     }
 
     void exitScope() {
         if (!scopeStack.empty()) {
             SymbolTable *parentScope = scopeStack.back();
             scopeStack.pop_back();
+            if (memory) {
+                memory->add("symbol tables", 1, globalSymbolTable->bytes());
+            }
             delete globalSymbolTable;
             globalSymbolTable = parentScope;
         } else {
@@ -137,7 +152,24 @@ private:
 
     void print_cuurent_scope() {}
 
+    // Allocates an AST node in the tree's arena.
+    template <typename T, typename... Args> T *make(Args &&...args) {
+        return ast.arena.make<T>(std::forward<Args>(args)...);
+    }
+
+    // Gives `node` the location of the token at `first`, where its
+    // statement starts.
+    template <typename T> T *locate(T *node, size_t first) {
+        if (node) {
+            node->line = lexer.tokens[first]->line;
+            node->column = lexer.tokens[first]->col;
+        }
+        return node;
+    }
+
     std::vector<SymbolTable *> scopeStack;
+    // The module each imported function came from.
+    std::unordered_map<std::string, std::string> importedFrom;
 
 public:
     SymbolTable *globalSymbolTable;
@@ -146,13 +178,44 @@ public:
     }
     Parser(const Parser &) = delete;
 
-    ~Parser() {}
+    ~Parser() {
+        // Scopes left open when parsing threw, then the global scope.
+        while (!scopeStack.empty()) {
+            exitScope();
+        }
+        delete globalSymbolTable;
+    }
 
     void parse();
 
-    void printAST() { ast.printAST(); }
+    // Where syntax and type errors are recorded; they are dropped when
+    // unset.
+    Diagnostics *diagnostics = nullptr;
+
+    // Records an error at `at`, or at the current token.
+    void error(const Token &at, const std::string &message);
+    void error(const std::string &message);
+
+    // The interface of each module `import` may name, as written by
+    // moduleInterface(); without them, imports are an error.
+    const std::map<std::string, std::string> *interfaces = nullptr;
+
+    // Times the phases of parsing and each function when set.
+    Timeline *timeline = nullptr;
+
+    // Where the symbol tables of scopes are accounted as they close, when
+    // set; accountMemory() adds those still open.
+    MemoryUsage *memory = nullptr;
+
+    // Adds the open symbol tables and the AST nodes, by kind, to `usage`.
+    void accountMemory(MemoryUsage &usage) const;
 
     ASTGen ast;
 };
 
+// The interface of the module `ast` was parsed from: a declaration of each
+// function it defines other than main, in source syntax, e.g.
+//     fn sum(values: int[], count: int): int;
+std::string moduleInterface(const ASTGen &ast);
+
 #endif /* PARSER_HPP_ */
@@ -0,0 +1,193 @@
+#include "profile.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Decodes the little-endian fields of a profile.
+class Reader {
+public:
+    Reader(std::string data, const std::string &path)
+        : data(std::move(data)), path(path) {}
+
+    uint64_t number(int size) {
+        need(size);
+        uint64_t value = 0;
+        for (int i = 0; i < size; ++i) {
+            value |= uint64_t(uint8_t(data[position + i])) << (8 * i);
+        }
+        position += size;
+        return value;
+    }
+
+    std::string string() {
+        uint64_t length = number(4);
+        need(length);
+        std::string text = data.substr(position, length);
+        position += length;
+        return text;
+    }
+
+    bool atEnd() const { return position == data.size(); }
+
+private:
+    void need(uint64_t size) {
+        if (size > data.size() - position) {
+            throw std::runtime_error(path + " is cut short");
+        }
+    }
+
+    std::string data;
+    const std::string &path;
+    size_t position = 0;
+};
+
+// The lines of each source a report quotes, read once.
+class Sources {
+public:
+    // Line `line` of `source` without its indentation, or nothing if the
+    // source cannot be read.
+    std::string line(const std::string &source, int32_t line) {
+        auto it = files.find(source);
+        if (it == files.end()) {
+            std::vector<std::string> lines;
+            std::ifstream in(source);
+            for (std::string text; std::getline(in, text);) {
+                lines.push_back(text);
+            }
+            it = files.emplace(source, std::move(lines)).first;
+        }
+        if (line < 1 || size_t(line) > it->second.size()) {
+            return {};
+        }
+        const std::string &text = it->second[line - 1];
+        size_t start = text.find_first_not_of(" \t");
+        return start == std::string::npos ? "" : text.substr(start);
+    }
+
+private:
+    std::map<std::string, std::vector<std::string>> files;
+};
+
+} // namespace
+
+Profile readProfile(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("cannot read " + path);
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string data = buffer.str();
+    if (data.compare(0, 8, "XRTPROF1") != 0) {
+        throw std::runtime_error(path + " is not a profile");
+    }
+
+    Reader reader(data.substr(8), path);
+    Profile profile;
+    profile.ticksPerSecond = reader.number(8);
+    uint64_t modules = reader.number(4);
+    for (uint64_t m = 0; m < modules; ++m) {
+        std::string source = reader.string();
+        uint64_t functions = reader.number(4);
+        uint64_t branches = reader.number(4);
+        for (uint64_t i = 0; i < functions; ++i) {
+            Profile::Function function;
+            function.source = source;
+            function.line = int32_t(reader.number(4));
+            function.name = reader.string();
+            function.calls = reader.number(8);
+            function.inclusive = reader.number(8);
+            function.exclusive = reader.number(8);
+            profile.functions.push_back(std::move(function));
+        }
+        for (uint64_t i = 0; i < branches; ++i) {
+            Profile::Branch branch;
+            branch.source = source;
+            branch.line = int32_t(reader.number(4));
+            branch.column = int32_t(reader.number(4));
+            branch.taken = reader.number(8);
+            branch.notTaken = reader.number(8);
+            profile.branches.push_back(std::move(branch));
+        }
+    }
+    if (!reader.atEnd()) {
+        throw std::runtime_error(path + " has data after the profile");
+    }
+    return profile;
+}
+
+void writeProfileReport(const Profile &profile, std::ostream &out,
+                        size_t limit) {
+    Sources sources;
+    double perMs = profile.ticksPerSecond / 1e3;
+    auto ms = [&](uint64_t ticks) { return perMs > 0 ? ticks / perMs : 0.0; };
+
+    std::vector<const Profile::Function *> functions;
+    uint64_t total = 0;
+    for (const auto &function : profile.functions) {
+        if (function.calls > 0) {
+            functions.push_back(&function);
+            total += function.exclusive;
+        }
+    }
+    std::stable_sort(functions.begin(), functions.end(),
+                     [](const auto *a, const auto *b) {
+                         return a->exclusive > b->exclusive;
+                     });
+
+    out << "profile report: " << std::fixed << std::setprecision(3)
+        << ms(total) << " ms in " << functions.size() << " functions\n";
+    out << "  " << std::right << std::setw(12) << "calls" << std::setw(12)
+        << "total ms" << std::setw(12) << "self ms" << std::setw(8) << "%"
+        << "  function\n";
+    for (size_t i = 0; i < std::min(limit, functions.size()); ++i) {
+        const Profile::Function &function = *functions[i];
+        out << "  " << std::setw(12) << function.calls << std::setw(12)
+            << std::setprecision(3) << ms(function.inclusive) << std::setw(12)
+            << ms(function.exclusive) << std::setw(8) << std::setprecision(1)
+            << (total > 0 ? function.exclusive * 100.0 / total : 0.0) << "  "
+            << function.name << " (" << function.source << ':'
+            << function.line << ")\n";
+    }
+    if (functions.size() > limit) {
+        out << "  and " << functions.size() - limit << " more\n";
+    }
+
+    std::vector<const Profile::Branch *> branches;
+    for (const auto &branch : profile.branches) {
+        if (branch.taken + branch.notTaken > 0) {
+            branches.push_back(&branch);
+        }
+    }
+    std::stable_sort(branches.begin(), branches.end(),
+                     [](const auto *a, const auto *b) {
+                         return a->taken + a->notTaken >
+                                b->taken + b->notTaken;
+                     });
+    if (!branches.empty()) {
+        out << "branches:\n";
+        out << "  " << std::setw(12) << "count" << std::setw(8) << "taken"
+            << "  if\n";
+    }
+    for (size_t i = 0; i < std::min(limit, branches.size()); ++i) {
+        const Profile::Branch &branch = *branches[i];
+        uint64_t count = branch.taken + branch.notTaken;
+        out << "  " << std::setw(12) << count << std::setw(7)
+            << std::setprecision(1) << branch.taken * 100.0 / count << "%  "
+            << branch.source << ':' << branch.line << ':' << branch.column;
+        std::string text = sources.line(branch.source, branch.line);
+        if (!text.empty()) {
+            out << "  " << text;
+        }
+        out << '\n';
+    }
+    if (branches.size() > limit) {
+        out << "  and " << branches.size() - limit << " more\n";
+    }
+    out << std::defaultfloat << std::setprecision(6) << std::flush;
+}
@@ -0,0 +1,47 @@
+#ifndef PROFILE_HPP_
+#define PROFILE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// The profile a program compiled with --instrument writes at exit (its
+// layout is described in runtime/xrt.c), and --profile-report.
+
+struct Profile {
+    struct Function {
+        std::string source;
+        std::string name;
+        int32_t line = 0;
+        uint64_t calls = 0;
+        // In ticks; see ticksPerSecond.
+        uint64_t inclusive = 0;
+        uint64_t exclusive = 0;
+    };
+    struct Branch {
+        std::string source;
+        int32_t line = 0;
+        int32_t column = 0;
+        uint64_t taken = 0;
+        uint64_t notTaken = 0;
+    };
+
+    uint64_t ticksPerSecond = 0;
+    // Those of every instrumented module, in the order they registered.
+    std::vector<Function> functions;
+    std::vector<Branch> branches;
+};
+
+// Reads the profile at `path`; throws std::runtime_error if it cannot be
+// read or is not a profile.
+Profile readProfile(const std::string &path);
+
+// Prints the `limit` functions that took the most time of their own, and
+// the `limit` if statements run most often, with how often each was taken.
+// Each is followed by its line of source when the source can be read.
+void writeProfileReport(const Profile &profile, std::ostream &out,
+                        size_t limit = 20);
+
+#endif // PROFILE_HPP_
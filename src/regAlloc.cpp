@@ -0,0 +1,289 @@
+#include "regAlloc.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+namespace {
+
+// A fixed-size bit set sized for the number of virtual registers.
+class BitSet {
+public:
+    explicit BitSet(size_t bits = 0) : words((bits + 63) / 64, 0) {}
+
+    void set(int bit) { words[bit / 64] |= uint64_t(1) << (bit % 64); }
+    void reset(int bit) { words[bit / 64] &= ~(uint64_t(1) << (bit % 64)); }
+    bool test(int bit) const {
+        return (words[bit / 64] >> (bit % 64)) & 1;
+    }
+
+    // this |= other; returns whether anything changed.
+    bool merge(const BitSet &other) {
+        bool changed = false;
+        for (size_t i = 0; i < words.size(); ++i) {
+            uint64_t merged = words[i] | other.words[i];
+            changed = changed || merged != words[i];
+            words[i] = merged;
+        }
+        return changed;
+    }
+
+    template <typename F> void forEach(F &&visit) const {
+        for (size_t i = 0; i < words.size(); ++i) {
+            uint64_t word = words[i];
+            while (word) {
+                int bit = __builtin_ctzll(word);
+                visit(static_cast<int>(i * 64 + bit));
+                word &= word - 1;
+            }
+        }
+    }
+
+private:
+    std::vector<uint64_t> words;
+};
+
+struct Block {
+    size_t first;
+    size_t last;
+    std::vector<size_t> successors;
+    BitSet uses, defs, liveIn, liveOut;
+};
+
+} // namespace
+
+void lirUses(const LInst &inst, std::vector<int> &uses) {
+    uses.clear();
+    for (const LOperand *operand : {&inst.a, &inst.b, &inst.c}) {
+        if (operand->isReg()) {
+            uses.push_back(operand->vreg);
+        }
+    }
+    for (const auto &argument : inst.args) {
+        if (argument.isReg()) {
+            uses.push_back(argument.vreg);
+        }
+    }
+}
+
+int lirDef(const LInst &inst) { return inst.dst; }
+
+static bool endsBlock(LOp op) {
+    return op == LOp::JMP || op == LOp::JCC || op == LOp::RET;
+}
+
+// Instruction i reads its operands at position 2i and writes its result at
+// 2i + 1, so a result may share a register with an operand that dies there.
+std::vector<LinearScan::Interval>
+LinearScan::buildIntervals(const LFunction &function) const {
+    const auto &code = function.instructions;
+    size_t numVregs = function.vregWidths.size();
+
+    std::vector<Block> blocks;
+    std::unordered_map<int, size_t> labelBlocks;
+    for (size_t i = 0; i < code.size(); ++i) {
+        if (blocks.empty() || code[i].op == LOp::LABEL ||
+            endsBlock(code[i - 1].op)) {
+            blocks.push_back({i, i, {}, BitSet(numVregs), BitSet(numVregs),
+                              BitSet(numVregs), BitSet(numVregs)});
+        }
+        blocks.back().last = i;
+        if (code[i].op == LOp::LABEL) {
+            labelBlocks[code[i].label] = blocks.size() - 1;
+        }
+    }
+
+    std::vector<int> uses;
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        Block &block = blocks[b];
+        const LInst &last = code[block.last];
+        if (last.op == LOp::JMP || last.op == LOp::JCC) {
+            block.successors.push_back(labelBlocks.at(last.label));
+        }
+        if (last.op != LOp::JMP && last.op != LOp::RET &&
+            b + 1 < blocks.size()) {
+            block.successors.push_back(b + 1);
+        }
+        for (size_t i = block.first; i <= block.last; ++i) {
+            lirUses(code[i], uses);
+            for (int vreg : uses) {
+                if (!block.defs.test(vreg)) {
+                    block.uses.set(vreg);
+                }
+            }
+            if (code[i].dst >= 0) {
+                block.defs.set(code[i].dst);
+            }
+        }
+    }
+
+    // liveIn = uses | (liveOut - defs), iterated backwards to a fixpoint.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t b = blocks.size(); b-- > 0;) {
+            Block &block = blocks[b];
+            for (size_t successor : block.successors) {
+                block.liveOut.merge(blocks[successor].liveIn);
+            }
+            BitSet in = block.uses;
+            block.liveOut.forEach([&](int vreg) {
+                if (!block.defs.test(vreg)) {
+                    in.set(vreg);
+                }
+            });
+            changed = block.liveIn.merge(in) || changed;
+        }
+    }
+
+    const int NONE = -1;
+    std::vector<Interval> intervals(numVregs);
+    for (size_t v = 0; v < numVregs; ++v) {
+        intervals[v] = {static_cast<int>(v), NONE, NONE};
+    }
+    auto extend = [&](int vreg, int position) {
+        Interval &interval = intervals[vreg];
+        if (interval.start == NONE || position < interval.start) {
+            interval.start = position;
+        }
+        if (interval.end == NONE || position > interval.end) {
+            interval.end = position;
+        }
+    };
+
+    std::vector<int> calls;
+    for (const Block &block : blocks) {
+        int blockStart = static_cast<int>(2 * block.first);
+        int blockEnd = static_cast<int>(2 * block.last + 1);
+        block.liveIn.forEach([&](int vreg) { extend(vreg, blockStart); });
+        block.liveOut.forEach([&](int vreg) { extend(vreg, blockEnd); });
+        for (size_t i = block.first; i <= block.last; ++i) {
+            int position = static_cast<int>(2 * i);
+            lirUses(code[i], uses);
+            for (int vreg : uses) {
+                extend(vreg, position);
+            }
+            if (code[i].dst >= 0) {
+                // Parameters all arrive at once on entry.
+                extend(code[i].dst,
+                       code[i].op == LOp::PARAM ? 0 : position + 1);
+            }
+            if (code[i].op == LOp::CALL) {
+                calls.push_back(position);
+            }
+        }
+    }
+
+    std::vector<Interval> live;
+    for (auto &interval : intervals) {
+        if (interval.start == NONE) {
+            continue;
+        }
+        // Live across a call: defined before it and needed after it.
+        auto call = std::upper_bound(calls.begin(), calls.end(),
+                                     interval.start - 1);
+        interval.crossesCall = call != calls.end() && *call < interval.end;
+        live.push_back(interval);
+    }
+    std::stable_sort(live.begin(), live.end(),
+                     [](const Interval &a, const Interval &b) {
+                         return a.start < b.start;
+                     });
+    return live;
+}
+
+LinearScan::Result LinearScan::run(const LFunction &function) {
+    size_t numVregs = function.vregWidths.size();
+    Result result;
+    result.registers.assign(numVregs, -1);
+    result.spillSlots.assign(numVregs, -1);
+
+    std::vector<Interval> intervals = buildIntervals(function);
+    // Active intervals holding a register, kept sorted by end.
+    std::vector<Interval> active;
+    std::vector<int> freeRegisters;
+    std::vector<bool> calleeUsed;
+
+    auto isCalleeSaved = [&](int reg) {
+        return std::find(calleeSaved.begin(), calleeSaved.end(), reg) !=
+               calleeSaved.end();
+    };
+    auto isFree = [&](int reg) {
+        for (const auto &interval : active) {
+            if (result.registers[interval.vreg] == reg) {
+                return false;
+            }
+        }
+        return true;
+    };
+    auto spill = [&](int vreg) {
+        result.registers[vreg] = -1;
+        result.spillSlots[vreg] = result.numSpillSlots++;
+    };
+    auto activate = [&](const Interval &interval, int reg) {
+        result.registers[interval.vreg] = reg;
+        if (isCalleeSaved(reg) &&
+            std::find(result.usedCalleeSaved.begin(),
+                      result.usedCalleeSaved.end(),
+                      reg) == result.usedCalleeSaved.end()) {
+            result.usedCalleeSaved.push_back(reg);
+        }
+        auto position = std::upper_bound(
+            active.begin(), active.end(), interval,
+            [](const Interval &a, const Interval &b) { return a.end < b.end; });
+        active.insert(position, interval);
+    };
+
+    for (const Interval &current : intervals) {
+        // Expire intervals that ended before this one starts.
+        active.erase(std::remove_if(active.begin(), active.end(),
+                                    [&](const Interval &interval) {
+                                        return interval.end < current.start;
+                                    }),
+                     active.end());
+
+        std::vector<int> candidates;
+        if (!current.crossesCall) {
+            candidates = callerSaved;
+        }
+        // Prefer callee-saved registers that are already being saved.
+        for (int reg : result.usedCalleeSaved) {
+            candidates.push_back(reg);
+        }
+        for (int reg : calleeSaved) {
+            candidates.push_back(reg);
+        }
+
+        int chosen = -1;
+        for (int reg : candidates) {
+            if (isFree(reg)) {
+                chosen = reg;
+                break;
+            }
+        }
+        if (chosen >= 0) {
+            activate(current, chosen);
+            continue;
+        }
+
+        // Spill whichever usable interval ends last.
+        auto victim = active.end();
+        for (auto it = active.begin(); it != active.end(); ++it) {
+            int reg = result.registers[it->vreg];
+            if (current.crossesCall && !isCalleeSaved(reg)) {
+                continue;
+            }
+            if (victim == active.end() || it->end > victim->end) {
+                victim = it;
+            }
+        }
+        if (victim != active.end() && victim->end > current.end) {
+            int reg = result.registers[victim->vreg];
+            spill(victim->vreg);
+            active.erase(victim);
+            activate(current, reg);
+        } else {
+            spill(current.vreg);
+        }
+    }
+    return result;
+}
@@ -0,0 +1,55 @@
+#ifndef REG_ALLOC_HPP_
+#define REG_ALLOC_HPP_
+
+#include "lir.hpp"
+#include <vector>
+
+// Linear-scan register allocation (Poletto and Sarkar) over an LFunction.
+//
+// Liveness is computed per basic block, and each virtual register gets one
+// live interval spanning every position where it may be live. Intervals
+// are walked in order of their start. Each interval takes a free register,
+// or the active interval ending furthest away is spilled to a stack slot.
+// An interval that is live across a call may only use a callee-saved
+// register. A register never changes location, so spill code is left to
+// instruction selection, which reads spilled values from memory.
+class LinearScan {
+public:
+    struct Result {
+        // Physical register of each virtual register, or -1 when spilled
+        // (or never used).
+        std::vector<int> registers;
+        // Stack slot of each spilled virtual register, or -1.
+        std::vector<int> spillSlots;
+        int numSpillSlots = 0;
+        // Callee-saved registers handed out, which the prologue must save.
+        std::vector<int> usedCalleeSaved;
+    };
+
+    // Registers are target numbers. The caller-saved ones are tried first
+    // for intervals that do not cross a call.
+    LinearScan(std::vector<int> callerSaved, std::vector<int> calleeSaved)
+        : callerSaved(std::move(callerSaved)),
+          calleeSaved(std::move(calleeSaved)) {}
+
+    Result run(const LFunction &function);
+
+private:
+    struct Interval {
+        int vreg;
+        int start;
+        int end;
+        bool crossesCall = false;
+    };
+
+    std::vector<Interval> buildIntervals(const LFunction &function) const;
+
+    std::vector<int> callerSaved;
+    std::vector<int> calleeSaved;
+};
+
+// Virtual registers read and written by `inst`.
+void lirUses(const LInst &inst, std::vector<int> &uses);
+int lirDef(const LInst &inst);
+
+#endif // REG_ALLOC_HPP_
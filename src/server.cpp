@@ -0,0 +1,214 @@
+#include "server.hpp"
+#include "driver.hpp"
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+static const char protocolVersion[] = "thelang-1";
+
+// The socket to remove when the server is stopped.
+static char boundPath[sizeof(sockaddr_un::sun_path)];
+
+static void stopServer(int) {
+    unlink(boundPath);
+    _exit(0);
+}
+
+static sockaddr_un socketAddress(const std::string &socketPath) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("socket path too long: " + socketPath);
+    }
+    std::strcpy(address.sun_path, socketPath.c_str());
+    return address;
+}
+
+// Connects to the server on `socketPath`; returns -1 if there is none.
+static int connectTo(const std::string &socketPath) {
+    sockaddr_un address = socketAddress(socketPath);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) !=
+        0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void writeAll(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t written = write(fd, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::string("write: ") +
+                                     std::strerror(errno));
+        }
+        data.remove_prefix(written);
+    }
+}
+
+static std::string readAll(int fd) {
+    std::string data;
+    char buffer[65536];
+    for (;;) {
+        ssize_t count = read(fd, buffer, sizeof(buffer));
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error(std::string("read: ") +
+                                     std::strerror(errno));
+        }
+        if (count == 0) {
+            return data;
+        }
+        data.append(buffer, count);
+    }
+}
+
+// What the server cannot do for a client: anything that runs the program
+// or writes to the server's own stdout.
+static bool servable(const Invocation &invocation) {
+    const Options &options = invocation.options;
+    return invocation.server.empty() && invocation.connect.empty() &&
+           !options.run && !options.vm && !options.dumpLir &&
+           !options.dumpBytecode && invocation.outputPath != "-";
+}
+
+static int serve(const std::string &request, std::ostream &diagnostics,
+                 OutputCache &cache) {
+    std::vector<std::string> fields;
+    for (size_t start = 0, end; start < request.size(); start = end + 1) {
+        end = request.find('\0', start);
+        if (end == std::string::npos) {
+            diagnostics << "error: truncated request" << std::endl;
+            return 1;
+        }
+        fields.push_back(request.substr(start, end - start));
+    }
+    if (fields.size() < 2 || fields[0] != protocolVersion) {
+        diagnostics << "error: client and server versions differ" << std::endl;
+        return 1;
+    }
+
+    Invocation invocation;
+    std::vector<std::string> args(fields.begin() + 2, fields.end());
+    try {
+        if (!parseArguments(args, fields[1], invocation)) {
+            diagnostics << "error: invalid arguments" << std::endl;
+            return 1;
+        }
+    } catch (const std::runtime_error &error) {
+        diagnostics << "error: " << error.what() << std::endl;
+        return 1;
+    }
+    if (!servable(invocation)) {
+        diagnostics << "error: not supported by --server" << std::endl;
+        return 1;
+    }
+    // Whatever one request runs into goes back to its client; it must not
+    // take down the server and the other clients with it.
+    try {
+        return runInvocation(invocation, diagnostics, &cache);
+    } catch (const std::exception &error) {
+        diagnostics << "error: " << error.what() << std::endl;
+        return 1;
+    }
+}
+
+int runServer(const std::string &socketPath) {
+    try {
+        sockaddr_un address = socketAddress(socketPath);
+        int probe = connectTo(socketPath);
+        if (probe >= 0) {
+            close(probe);
+            throw std::runtime_error("a server is already running on " +
+                                     socketPath);
+        }
+        // Left behind by a server that was not stopped cleanly.
+        unlink(socketPath.c_str());
+
+        int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listener < 0 ||
+            bind(listener, reinterpret_cast<sockaddr *>(&address),
+                 sizeof(address)) != 0 ||
+            listen(listener, 64) != 0) {
+            throw std::runtime_error("cannot listen on " + socketPath + ": " +
+                                     std::strerror(errno));
+        }
+        std::strcpy(boundPath, address.sun_path);
+        std::signal(SIGINT, stopServer);
+        std::signal(SIGTERM, stopServer);
+        // A client that goes away must not take the server with it.
+        std::signal(SIGPIPE, SIG_IGN);
+        std::cerr << "listening on " << socketPath << std::endl;
+
+        static OutputCache cache;
+        for (;;) {
+            int client = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client < 0) {
+                continue;
+            }
+            std::thread([client]() {
+                try {
+                    std::ostringstream diagnostics;
+                    int status = serve(readAll(client), diagnostics, cache);
+                    writeAll(client,
+                             std::to_string(status) + "\n" + diagnostics.str());
+                } catch (const std::exception &) {
+                    // The client has gone; there is no one to tell.
+                }
+                close(client);
+            }).detach();
+        }
+    } catch (const std::runtime_error &error) {
+        std::cerr << "error: " << error.what() << std::endl;
+        return 1;
+    }
+}
+
+int runClient(const std::string &socketPath,
+              const std::vector<std::string> &args) {
+    try {
+        int fd = connectTo(socketPath);
+        if (fd < 0) {
+            throw std::runtime_error("no server on " + socketPath);
+        }
+        char directory[4096];
+        if (!getcwd(directory, sizeof(directory))) {
+            throw std::runtime_error("cannot get the working directory");
+        }
+        std::string request = protocolVersion + std::string(1, '\0') +
+                              directory + std::string(1, '\0');
+        for (const auto &arg : args) {
+            request += arg;
+            request += '\0';
+        }
+        writeAll(fd, request);
+        shutdown(fd, SHUT_WR);
+        std::string reply = readAll(fd);
+        close(fd);
+
+        size_t newline = reply.find('\n');
+        if (newline == std::string::npos) {
+            throw std::runtime_error("no reply from server");
+        }
+        std::cerr << std::string_view(reply).substr(newline + 1);
+        return std::atoi(reply.c_str());
+    } catch (const std::runtime_error &error) {
+        std::cerr << "error: " << error.what() << std::endl;
+        return 1;
+    }
+}
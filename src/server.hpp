@@ -0,0 +1,26 @@
+#ifndef SERVER_HPP_
+#define SERVER_HPP_
+
+#include <string>
+#include <vector>
+
+// --server keeps one compiler process running on a Unix domain socket, so
+// a rebuild pays neither process startup nor a cold start: outputs of
+// unchanged files are kept in memory and simply written again. A client
+// (--connect) sends its working directory and arguments and prints what
+// the server reports.
+//
+// A request is a series of NUL-terminated strings: the protocol version,
+// the working directory, then the arguments; the client then shuts down
+// its side. The reply is the exit status on a line of its own, followed by
+// the diagnostics.
+
+// Serves requests on `socketPath` until killed. Returns 1 if it cannot
+// listen there.
+int runServer(const std::string &socketPath);
+
+// Has the server on `socketPath` run `args` and returns their exit status.
+int runClient(const std::string &socketPath,
+              const std::vector<std::string> &args);
+
+#endif // SERVER_HPP_
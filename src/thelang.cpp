@@ -0,0 +1,99 @@
+#include "thelang.hpp"
+#include "XIR.hpp"
+#include "boundsCheck.hpp"
+#include "gvn.hpp"
+#include "lir.hpp"
+#include "loopOpt.hpp"
+#include "x86.hpp"
+
+CompilationContext::CompilationContext(std::string name, std::string source)
+    : CompilationContext(std::move(name), std::move(source), collected) {}
+
+CompilationContext::CompilationContext(std::string name, std::string source,
+                                       std::ostream &diagnostics)
+    : sink(&diagnostics), lexer(std::move(name), std::move(source)),
+      parser(lexer) {
+    lexer.diagnostics = &this->diagnostics;
+    parser.diagnostics = &this->diagnostics;
+}
+
+CompilationContext::~CompilationContext() { flushDiagnostics(); }
+
+ASTGen &CompilationContext::analyze(const CompileOptions &options) {
+    if (!options.interfaces.empty()) {
+        parser.interfaces = &options.interfaces;
+    }
+    parser.timeline = options.timeline;
+    parser.memory = options.memory;
+    try {
+        parser.parse();
+    } catch (const std::runtime_error &) {
+        flushDiagnostics();
+        throw;
+    }
+    flushDiagnostics();
+    // A tree with errors may be missing nodes the passes expect.
+    if (options.optimize && diagnostics.errorCount() == 0) {
+        TimeScope scope(options.timeline, "optimize");
+        {
+            TimeScope pass(options.timeline, "loop optimizer");
+            LoopOptimizer loops(parser.ast);
+            loops.run();
+        }
+        {
+            TimeScope pass(options.timeline, "bounds check elimination");
+            BoundsCheckElimination bounds(parser.ast);
+            bounds.run();
+        }
+        {
+            TimeScope pass(options.timeline, "value numbering");
+            ValueNumbering gvn(parser.ast);
+            gvn.run();
+        }
+    }
+    if (options.memory) {
+        lexer.accountMemory(*options.memory);
+        parser.accountMemory(*options.memory);
+    }
+    return parser.ast;
+}
+
+CompileResult CompilationContext::compile(const CompileOptions &options) {
+    CompileResult result;
+    try {
+        ASTGen &ast = analyze(options);
+        if (diagnostics.errorCount() > 0) {
+            result.diagnostics = collected.str();
+            return result;
+        }
+        if (options.target == "x86-64") {
+            Lowering lowering(ast);
+            lowering.boundsChecks = options.boundsChecks;
+            result.output = x86::writeAssembly(
+                x86::selectInstructions(lowering.run()),
+                options.debugLines ? lexer.fileName() : "");
+        } else {
+            Emitter out(result.output);
+            IR ir(ast, &parser, out);
+            ir.boundsChecks = options.boundsChecks;
+            ir.threads = options.threads;
+            ir.timeline = options.timeline;
+            if (options.debugLines) {
+                ir.sourceName = lexer.fileName();
+            }
+            ir.GenIR();
+        }
+        result.ok = true;
+    } catch (const std::runtime_error &error) {
+        diagnostics.error(lexer.fileName(), 0, 0, error.what());
+    }
+    flushDiagnostics();
+    result.diagnostics = collected.str();
+    result.ok = result.ok && result.diagnostics.empty();
+    return result;
+}
+
+CompileResult compile(std::string source, const CompileOptions &options) {
+    CompilationContext context("<source>", std::move(source));
+    return context.compile(options);
+}
@@ -0,0 +1,83 @@
+#ifndef THELANG_HPP_
+#define THELANG_HPP_
+
+#include "parser.hpp"
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <string>
+
+// The compiler as a library (libthelang).
+//
+// A CompilationContext owns everything one compilation touches: the source
+// and its tokens, the AST and the arena behind it, and the diagnostics. The
+// compiler keeps no global or static mutable state, so any number of
+// contexts may be used on different threads at once.
+
+struct CompileOptions {
+    bool optimize = true;
+    bool boundsChecks = true;
+    // -g: #line directives in C, and .file and .loc directives in assembly,
+    // naming the source by the context's name.
+    bool debugLines = false;
+    // "c" for C source, "x86-64" for assembly.
+    std::string target = "c";
+    // Threads C code generation may use.
+    unsigned threads = 1;
+    // The interfaces of the modules the source may import, by name (see
+    // moduleInterface()).
+    std::map<std::string, std::string> interfaces;
+    // Records how long each phase takes when set (see timing.hpp).
+    Timeline *timeline = nullptr;
+    // When set, analyze() adds what the tokens, the AST and the symbol
+    // tables take to it (see memory.hpp).
+    MemoryUsage *memory = nullptr;
+};
+
+struct CompileResult {
+    // False if compilation failed or reported anything.
+    bool ok = false;
+    std::string output;
+    // What the compiler reported, one message per line.
+    std::string diagnostics;
+};
+
+class CompilationContext {
+public:
+    // Compiles `source`, which `name` stands for in messages. Diagnostics
+    // are collected into the result of compile().
+    CompilationContext(std::string name, std::string source);
+    // Compiles `source`, writing the diagnostics to `diagnostics` once
+    // analyze() is done, and any recorded later when the context goes away.
+    CompilationContext(std::string name, std::string source,
+                       std::ostream &diagnostics);
+    CompilationContext(const CompilationContext &) = delete;
+    CompilationContext &operator=(const CompilationContext &) = delete;
+    ~CompilationContext();
+
+    // Parses the program and, with options.optimize, runs the AST passes;
+    // the tree is then ready for any back end unless errors were recorded
+    // in `diagnostics`. Throws std::runtime_error.
+    ASTGen &analyze(const CompileOptions &options);
+
+    // Writes the diagnostics recorded so far.
+    void flushDiagnostics() { diagnostics.flush(*sink); }
+
+    // analyze(), then generates options.target into the result. Errors are
+    // reported as diagnostics rather than thrown.
+    CompileResult compile(const CompileOptions &options);
+
+private:
+    std::ostringstream collected;
+    std::ostream *sink;
+
+public:
+    Diagnostics diagnostics;
+    Lexer lexer;
+    Parser parser;
+};
+
+// Compiles `source` in a context of its own.
+CompileResult compile(std::string source, const CompileOptions &options = {});
+
+#endif // THELANG_HPP_
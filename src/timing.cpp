@@ -0,0 +1,132 @@
+#include "timing.hpp"
+#include "emitter.hpp"
+#include <algorithm>
+#include <iomanip>
+
+void Timeline::record(const char *phase, std::string detail,
+                      Clock::time_point start, Clock::time_point end,
+                      size_t peakBefore, size_t peakAfter) {
+    using std::chrono::duration_cast;
+    using std::chrono::nanoseconds;
+    Span span{phase, std::move(detail),
+              duration_cast<nanoseconds>(start - origin).count(),
+              duration_cast<nanoseconds>(end - start).count(), 0,
+              peakBefore, peakAfter};
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [thread, added] = threads.emplace(std::this_thread::get_id(),
+                                           static_cast<int>(threads.size()));
+    span.thread = thread->second;
+    spans.push_back(std::move(span));
+}
+
+std::vector<Timeline::Total> Timeline::totals() const {
+    std::vector<Total> totals;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::string_view, size_t> indexes;
+    for (const auto &span : spans) {
+        auto [index, added] = indexes.emplace(span.phase, totals.size());
+        if (added) {
+            totals.push_back({span.phase});
+        }
+        Total &total = totals[index->second];
+        total.count++;
+        total.time += span.duration;
+        if (span.peakAfter != 0) {
+            total.grew += span.peakAfter - span.peakBefore;
+            total.peak = std::max(total.peak, span.peakAfter);
+        }
+    }
+    return totals;
+}
+
+long long Timeline::elapsed() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    long long last = 0;
+    for (const auto &span : spans) {
+        last = std::max(last, span.start + span.duration);
+    }
+    return last;
+}
+
+void Timeline::writeReport(std::ostream &out) const {
+    std::vector<Total> totals = this->totals();
+    std::stable_sort(totals.begin(), totals.end(),
+                     [](const Total &a, const Total &b) {
+                         return a.time > b.time;
+                     });
+
+    double wall = elapsed() / 1e6;
+    out << "time report: " << std::fixed << std::setprecision(3) << wall
+        << " ms wall\n";
+    out << "  " << std::left << std::setw(28) << "phase" << std::right
+        << std::setw(8) << "count" << std::setw(12) << "ms" << std::setw(8)
+        << "%" << "\n";
+    for (const auto &total : totals) {
+        double ms = total.time / 1e6;
+        out << "  " << std::left << std::setw(28) << total.phase << std::right
+            << std::setw(8) << total.count << std::setw(12)
+            << std::setprecision(3) << ms << std::setw(8)
+            << std::setprecision(1) << (wall > 0 ? ms * 100 / wall : 0.0)
+            << "\n";
+    }
+    out << std::defaultfloat << std::setprecision(6) << std::flush;
+}
+
+void Timeline::writePeakReport(std::ostream &out) const {
+    std::vector<Total> totals = this->totals();
+    std::stable_sort(totals.begin(), totals.end(),
+                     [](const Total &a, const Total &b) {
+                         return a.grew > b.grew;
+                     });
+
+    constexpr double MiB = 1024.0 * 1024.0;
+    out << "  " << std::left << std::setw(32) << "phase" << std::right
+        << std::setw(10) << "count" << std::setw(12) << "grew MiB"
+        << std::setw(12) << "peak MiB" << "\n";
+    out << std::fixed << std::setprecision(1);
+    for (const auto &total : totals) {
+        // Not sampled.
+        if (total.peak == 0) {
+            continue;
+        }
+        out << "  " << std::left << std::setw(32) << total.phase << std::right
+            << std::setw(10) << total.count << std::setw(12)
+            << total.grew / MiB << std::setw(12) << total.peak / MiB << "\n";
+    }
+    out << std::defaultfloat << std::setprecision(6) << std::flush;
+}
+
+// Complete ("X") events in microseconds, one per span, and a name for each
+// thread.
+void Timeline::writeTrace(std::ostream &out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto &[id, thread] : threads) {
+        out << (first ? "" : ",\n")
+            << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << thread << ",\"args\":{\"name\":\""
+            << "thread " << thread
+            << "\"}}";
+        first = false;
+    }
+    for (const auto &span : spans) {
+        out << (first ? "" : ",\n") << "{\"name\":";
+        out << jsonString(span.detail.empty() ? span.phase : span.detail);
+        out << ",\"cat\":";
+        out << jsonString(span.phase);
+        out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << span.thread
+            << ",\"ts\":" << span.start / 1000 << '.' << std::setfill('0')
+            << std::setw(3) << span.start % 1000 << ",\"dur\":"
+            << span.duration / 1000 << '.' << std::setw(3)
+            << span.duration % 1000 << std::setfill(' ');
+        if (!span.detail.empty()) {
+            out << ",\"args\":{\"phase\":";
+            out << jsonString(span.phase);
+            out << '}';
+        }
+        out << '}';
+        first = false;
+    }
+    out << "\n]}\n";
+}
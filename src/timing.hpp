@@ -0,0 +1,127 @@
+#ifndef TIMING_HPP_
+#define TIMING_HPP_
+
+#include "memory.hpp"
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Where compile time goes (--time-report, --trace). Each phase opens a
+// TimeScope on the compilation's Timeline; without a timeline, a scope does
+// nothing, not even read the clock. For --mem-report, scopes also note how
+// much the process's peak resident set grew during their phase.
+
+class Timeline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Timeline() : origin(Clock::now()) {}
+
+    // Records a span of `phase`; `detail` names what it worked on, such as
+    // a function. `peakBefore` and `peakAfter` are the peak resident set
+    // size at its start and end, if sampled. Safe to call from any thread.
+    void record(const char *phase, std::string detail, Clock::time_point start,
+                Clock::time_point end, size_t peakBefore = 0,
+                size_t peakAfter = 0);
+
+    // Whether scopes sample the peak resident set size.
+    bool sampleMemory = false;
+
+    // What the spans of one phase add up to.
+    struct Total {
+        std::string phase;
+        size_t count = 0;
+        // In nanoseconds.
+        long long time = 0;
+        // Over the sampled spans: how much they raised the peak resident
+        // set size, and the highest peak they reached.
+        size_t grew = 0;
+        size_t peak = 0;
+    };
+
+    // The totals of each phase, in order of first use.
+    std::vector<Total> totals() const;
+
+    // Nanoseconds from the timeline's creation to the end of its last span.
+    long long elapsed() const;
+
+    // A table of the time spent in each phase, slowest first. Phases nest,
+    // so the times include those of the phases inside them.
+    void writeReport(std::ostream &out) const;
+
+    // The spans as Chrome trace-event JSON, for chrome://tracing or
+    // https://ui.perfetto.dev.
+    void writeTrace(std::ostream &out) const;
+
+    // A table of how much each phase raised the peak resident set size,
+    // most first, and the highest peak it reached. The peak belongs to the
+    // whole process, so with several threads a phase is charged for what
+    // others allocated meanwhile. Phases nest, as in writeReport().
+    void writePeakReport(std::ostream &out) const;
+
+private:
+    struct Span {
+        const char *phase;
+        std::string detail;
+        long long start;
+        long long duration;
+        int thread;
+        size_t peakBefore;
+        size_t peakAfter;
+    };
+
+    Clock::time_point origin;
+    mutable std::mutex mutex;
+    std::vector<Span> spans;
+    // Small numbers for the threads that recorded spans, in order of first
+    // use.
+    std::map<std::thread::id, int> threads;
+};
+
+// Records the time from its construction to its destruction as a span of
+// `phase`, if there is a timeline.
+class TimeScope {
+public:
+    TimeScope(Timeline *timeline, const char *phase,
+              std::string_view detail = {})
+        : timeline(timeline), phase(phase) {
+        if (timeline) {
+            this->detail = detail;
+            if (timeline->sampleMemory) {
+                peakBefore = peakResidentBytes();
+            }
+            start = Timeline::Clock::now();
+        }
+    }
+    TimeScope(const TimeScope &) = delete;
+    TimeScope &operator=(const TimeScope &) = delete;
+
+    ~TimeScope() {
+        if (timeline) {
+            auto end = Timeline::Clock::now();
+            timeline->record(phase, std::move(detail), start, end, peakBefore,
+                             timeline->sampleMemory ? peakResidentBytes() : 0);
+        }
+    }
+
+    // For a detail only known once the phase is under way.
+    void setDetail(std::string_view value) {
+        if (timeline) {
+            detail = value;
+        }
+    }
+
+private:
+    Timeline *timeline;
+    const char *phase;
+    std::string detail;
+    Timeline::Clock::time_point start;
+    size_t peakBefore = 0;
+};
+
+#endif // TIMING_HPP_
@@ -0,0 +1,373 @@
+#include "vm.hpp"
+#include "xrt.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+// Register and frame stack sizes, in 8-byte slots.
+constexpr size_t REGISTER_STACK = 1 << 20;
+constexpr size_t FRAME_STACK = 1 << 20;
+
+// 32-bit results are kept sign-extended in their 64-bit registers.
+inline int64_t wrap32(int64_t value) {
+    return static_cast<int32_t>(static_cast<uint32_t>(value));
+}
+
+inline bool compare(Cond cond, int64_t left, int64_t right) {
+    switch (cond) {
+    case Cond::EQ:
+        return left == right;
+    case Cond::NE:
+        return left != right;
+    case Cond::LT:
+        return left < right;
+    case Cond::LE:
+        return left <= right;
+    case Cond::GT:
+        return left > right;
+    case Cond::GE:
+        return left >= right;
+    }
+    return false;
+}
+
+inline int32_t *slot32(int64_t address) {
+    return reinterpret_cast<int32_t *>(address);
+}
+
+inline int64_t *slot64(int64_t address) {
+    return reinterpret_cast<int64_t *>(address);
+}
+
+} // namespace
+
+VM::VM(const BModule &module) : module(module) {
+    rodata = module.rodata;
+    data.assign((module.data.size() + 7) / 8, 0);
+    std::memcpy(data.data(), module.data.data(), module.data.size());
+    for (const auto &[offset, string] : module.dataPointers) {
+        int64_t pointer = reinterpret_cast<int64_t>(rodata.data() + string);
+        std::memcpy(reinterpret_cast<char *>(data.data()) + offset, &pointer,
+                    sizeof(pointer));
+    }
+    registers.reset(new int64_t[REGISTER_STACK]);
+    frames.reset(new int64_t[FRAME_STACK]);
+}
+
+void VM::translate(const void *const *handlers) {
+    functions.clear();
+    for (const auto &function : module.functions) {
+        Function translated;
+        translated.numRegisters = function.numRegisters;
+        translated.frameSize = function.frameSize;
+        translated.params = function.paramRegisters.data();
+        translated.callArgs = function.callArgs.data();
+        translated.code.reserve(function.code.size());
+        for (const auto &inst : function.code) {
+            Threaded threaded;
+            threaded.handler = handlers[static_cast<int>(inst.op)];
+            threaded.a = inst.a;
+            threaded.b = inst.b;
+            threaded.c = inst.c;
+            threaded.cond = inst.cond;
+            threaded.target = nullptr;
+            threaded.k = inst.k;
+            // Addresses of strings and globals are known from here on.
+            if (inst.op == Opcode::LOADA) {
+                const char *base =
+                    inst.b == SEGMENT_RODATA
+                        ? rodata.data()
+                        : reinterpret_cast<const char *>(data.data());
+                threaded.handler = handlers[static_cast<int>(Opcode::LOADI)];
+                threaded.k = reinterpret_cast<int64_t>(base + inst.k);
+            }
+            translated.code.push_back(threaded);
+        }
+        for (size_t i = 0; i < function.code.size(); ++i) {
+            if (function.code[i].target >= 0) {
+                translated.code[i].target =
+                    translated.code.data() + function.code[i].target;
+            }
+        }
+        functions.push_back(std::move(translated));
+    }
+}
+
+int VM::run() {
+    if (module.main < 0) {
+        throw std::runtime_error("program has no main function");
+    }
+    int result = countInstructions ? execute<true>() : execute<false>();
+    xrt_flush();
+    return result;
+}
+
+template <bool Count> int VM::execute() {
+    static const void *const handlers[] = {
+#define BYTECODE_LABEL(name) &&op_##name,
+        BYTECODE_OPCODES(BYTECODE_LABEL)
+#undef BYTECODE_LABEL
+    };
+    translate(handlers);
+
+    struct CallFrame {
+        const Threaded *ret;
+        int64_t *registers;
+        uint8_t *frame;
+        const Function *function;
+        int32_t dst;
+    };
+    std::vector<CallFrame> calls;
+    calls.reserve(64);
+
+    const Function *function = &functions[module.main];
+    const Threaded *ip = function->code.data();
+    int64_t *r = registers.get();
+    uint8_t *frame = reinterpret_cast<uint8_t *>(frames.get());
+    int64_t *const registerLimit = registers.get() + REGISTER_STACK;
+    uint8_t *const frameLimit =
+        reinterpret_cast<uint8_t *>(frames.get() + FRAME_STACK);
+    uint64_t count = 0;
+    int64_t value;
+
+#define DISPATCH()                                                             \
+    do {                                                                       \
+        if (Count) {                                                           \
+            ++count;                                                           \
+        }                                                                      \
+        goto *ip->handler;                                                     \
+    } while (0)
+#define NEXT()                                                                 \
+    do {                                                                       \
+        ++ip;                                                                  \
+        DISPATCH();                                                            \
+    } while (0)
+#define BRANCH(condition)                                                      \
+    do {                                                                       \
+        ip = (condition) ? ip->target : ip + 1;                                \
+        DISPATCH();                                                            \
+    } while (0)
+
+    DISPATCH();
+
+op_MOV:
+    r[ip->a] = r[ip->b];
+    NEXT();
+op_LOADI:
+op_LOADA:
+    r[ip->a] = ip->k;
+    NEXT();
+op_FRAME:
+    r[ip->a] = reinterpret_cast<int64_t>(frame + ip->k);
+    NEXT();
+op_ADD:
+    r[ip->a] = wrap32(r[ip->b] + r[ip->c]);
+    NEXT();
+op_ADDI:
+    r[ip->a] = wrap32(r[ip->b] + ip->k);
+    NEXT();
+op_SUB:
+    r[ip->a] = wrap32(r[ip->b] - r[ip->c]);
+    NEXT();
+op_SUBI:
+    r[ip->a] = wrap32(r[ip->b] - ip->k);
+    NEXT();
+op_MUL:
+    r[ip->a] = wrap32(static_cast<uint32_t>(r[ip->b]) *
+                      static_cast<uint32_t>(r[ip->c]));
+    NEXT();
+op_MULI:
+    r[ip->a] = wrap32(static_cast<uint32_t>(r[ip->b]) *
+                      static_cast<uint32_t>(ip->k));
+    NEXT();
+op_DIV:
+    r[ip->a] =
+        static_cast<int32_t>(r[ip->b]) / static_cast<int32_t>(r[ip->c]);
+    NEXT();
+op_DIVI:
+    r[ip->a] = static_cast<int32_t>(r[ip->b]) / static_cast<int32_t>(ip->k);
+    NEXT();
+op_CMP:
+    r[ip->a] = compare(ip->cond, r[ip->b], r[ip->c]);
+    NEXT();
+op_CMPI:
+    r[ip->a] = compare(ip->cond, r[ip->b], ip->k);
+    NEXT();
+op_LOAD32:
+    r[ip->a] = *slot32(r[ip->b] + ip->k);
+    NEXT();
+op_LOAD64:
+    r[ip->a] = *slot64(r[ip->b] + ip->k);
+    NEXT();
+op_LOADX32:
+    r[ip->a] = *slot32(r[ip->b] + r[ip->c] * 8 + ip->k);
+    NEXT();
+op_LOADX64:
+    r[ip->a] = *slot64(r[ip->b] + r[ip->c] * 8 + ip->k);
+    NEXT();
+op_STORE32:
+    *slot32(r[ip->b] + ip->k) = static_cast<int32_t>(r[ip->a]);
+    NEXT();
+op_STORE64:
+    *slot64(r[ip->b] + ip->k) = r[ip->a];
+    NEXT();
+op_STOREX32:
+    *slot32(r[ip->b] + r[ip->c] * 8 + ip->k) = static_cast<int32_t>(r[ip->a]);
+    NEXT();
+op_STOREX64:
+    *slot64(r[ip->b] + r[ip->c] * 8 + ip->k) = r[ip->a];
+    NEXT();
+op_JMP:
+    ip = ip->target;
+    DISPATCH();
+op_JEQ:
+    BRANCH(r[ip->a] == r[ip->b]);
+op_JNE:
+    BRANCH(r[ip->a] != r[ip->b]);
+op_JLT:
+    BRANCH(r[ip->a] < r[ip->b]);
+op_JLE:
+    BRANCH(r[ip->a] <= r[ip->b]);
+op_JGT:
+    BRANCH(r[ip->a] > r[ip->b]);
+op_JGE:
+    BRANCH(r[ip->a] >= r[ip->b]);
+op_JEQI:
+    BRANCH(r[ip->a] == ip->k);
+op_JNEI:
+    BRANCH(r[ip->a] != ip->k);
+op_JLTI:
+    BRANCH(r[ip->a] < ip->k);
+op_JLEI:
+    BRANCH(r[ip->a] <= ip->k);
+op_JGTI:
+    BRANCH(r[ip->a] > ip->k);
+op_JGEI:
+    BRANCH(r[ip->a] >= ip->k);
+op_CALL: {
+    const Function *callee = &functions[ip->a];
+    int64_t *next = r + function->numRegisters;
+    uint8_t *nextFrame = frame + function->frameSize;
+    if (next + callee->numRegisters > registerLimit ||
+        nextFrame + callee->frameSize > frameLimit) {
+        xrt_flush();
+        throw std::runtime_error("stack overflow");
+    }
+    const int32_t *args = function->callArgs + ip->c;
+    for (int64_t n = 0; n < ip->k; ++n) {
+        next[callee->params[n]] = r[args[n]];
+    }
+    calls.push_back({ip + 1, r, frame, function, ip->b});
+    r = next;
+    frame = nextFrame;
+    function = callee;
+    ip = callee->code.data();
+    DISPATCH();
+}
+op_RET:
+    value = r[ip->a];
+    goto doReturn;
+op_RETI:
+    value = ip->k;
+doReturn: {
+    if (calls.empty()) {
+        executed = count;
+        return static_cast<int>(value);
+    }
+    const CallFrame &caller = calls.back();
+    r = caller.registers;
+    frame = caller.frame;
+    function = caller.function;
+    ip = caller.ret;
+    if (caller.dst >= 0) {
+        r[caller.dst] = value;
+    }
+    calls.pop_back();
+    DISPATCH();
+}
+op_CHECK:
+    if (static_cast<uint32_t>(r[ip->a]) >= static_cast<uint32_t>(r[ip->b])) {
+        xrt_index_error(static_cast<int32_t>(r[ip->a]),
+                        static_cast<int32_t>(r[ip->b]));
+    }
+    NEXT();
+op_CHECKI:
+    if (static_cast<uint32_t>(r[ip->a]) >= static_cast<uint32_t>(ip->k)) {
+        xrt_index_error(static_cast<int32_t>(r[ip->a]),
+                        static_cast<int32_t>(ip->k));
+    }
+    NEXT();
+op_PRINT_INT:
+    xrt_print_int(static_cast<int32_t>(r[ip->a]));
+    NEXT();
+op_PRINT_BOOL:
+    xrt_print_bool(static_cast<int32_t>(r[ip->a]));
+    NEXT();
+op_PRINT_CHAR:
+    xrt_print_char(static_cast<int32_t>(r[ip->a]));
+    NEXT();
+op_PRINT_STR:
+    xrt_print_cstr(reinterpret_cast<const char *>(r[ip->a]));
+    NEXT();
+op_PRINT_NEWLINE:
+    xrt_print_newline();
+    NEXT();
+op_PUSH:
+    xrt_push(reinterpret_cast<xrt_array *>(r[ip->a]), r[ip->b]);
+    NEXT();
+op_ADDI_JLT:
+    r[ip->a] = wrap32(r[ip->a] + ip->k);
+    BRANCH(r[ip->a] < r[ip->b]);
+op_ADDI_JLE:
+    r[ip->a] = wrap32(r[ip->a] + ip->k);
+    BRANCH(r[ip->a] <= r[ip->b]);
+op_ADDI_JGT:
+    r[ip->a] = wrap32(r[ip->a] + ip->k);
+    BRANCH(r[ip->a] > r[ip->b]);
+op_ADDI_JGE:
+    r[ip->a] = wrap32(r[ip->a] + ip->k);
+    BRANCH(r[ip->a] >= r[ip->b]);
+op_ADDI_JNE:
+    r[ip->a] = wrap32(r[ip->a] + ip->k);
+    BRANCH(r[ip->a] != r[ip->b]);
+op_ADDI_JLTI:
+    r[ip->a] = wrap32(r[ip->a] + ip->k);
+    BRANCH(r[ip->a] < ip->b);
+op_ADDI_JLEI:
+    r[ip->a] = wrap32(r[ip->a] + ip->k);
+    BRANCH(r[ip->a] <= ip->b);
+op_ADDI_JGTI:
+    r[ip->a] = wrap32(r[ip->a] + ip->k);
+    BRANCH(r[ip->a] > ip->b);
+op_ADDI_JGEI:
+    r[ip->a] = wrap32(r[ip->a] + ip->k);
+    BRANCH(r[ip->a] >= ip->b);
+op_ADDI_JNEI:
+    r[ip->a] = wrap32(r[ip->a] + ip->k);
+    BRANCH(r[ip->a] != ip->b);
+op_ADDM: {
+    int32_t *slot = slot32(r[ip->b] + ip->k);
+    *slot = static_cast<int32_t>(wrap32(*slot + r[ip->a]));
+    NEXT();
+}
+op_ADDMI: {
+    int32_t *slot = slot32(r[ip->b] + ip->k);
+    *slot = static_cast<int32_t>(wrap32(*slot + ip->a));
+    NEXT();
+}
+op_ADDXM: {
+    int32_t *slot = slot32(r[ip->b] + r[ip->c] * 8 + ip->k);
+    *slot = static_cast<int32_t>(wrap32(*slot + r[ip->a]));
+    NEXT();
+}
+op_ADDXMI: {
+    int32_t *slot = slot32(r[ip->b] + r[ip->c] * 8 + ip->k);
+    *slot = static_cast<int32_t>(wrap32(*slot + ip->a));
+    NEXT();
+}
+
+#undef BRANCH
+#undef NEXT
+#undef DISPATCH
+}
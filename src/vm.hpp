@@ -0,0 +1,58 @@
+#ifndef VM_HPP_
+#define VM_HPP_
+
+#include "bytecode.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Interprets a bytecode module (--vm).
+//
+// Before running, each function is translated to threaded code: every
+// instruction carries the address of its handler, and each handler ends by
+// jumping straight to the next one (computed goto), so there is no central
+// dispatch switch. Calls get a fresh window of registers and frame memory
+// on two fixed-size stacks.
+class VM {
+public:
+    explicit VM(const BModule &module);
+
+    // Runs main and flushes stdout; returns main's result. Throws
+    // std::runtime_error when the program has no main or overflows the
+    // stack.
+    int run();
+
+    // Counts executed instructions into `executed` (--vm-stats).
+    bool countInstructions = false;
+    uint64_t executed = 0;
+
+private:
+    struct Threaded {
+        const void *handler;
+        int32_t a, b, c;
+        Cond cond;
+        const Threaded *target;
+        int64_t k;
+    };
+
+    struct Function {
+        std::vector<Threaded> code;
+        int numRegisters;
+        int64_t frameSize;
+        const int32_t *params;
+        const int32_t *callArgs;
+    };
+
+    void translate(const void *const *handlers);
+    template <bool Count> int execute();
+
+    const BModule &module;
+    std::vector<Function> functions;
+    std::vector<char> rodata;
+    std::vector<int64_t> data;
+    // Left uninitialized, so only the pages a program touches are committed.
+    std::unique_ptr<int64_t[]> registers;
+    std::unique_ptr<int64_t[]> frames;
+};
+
+#endif // VM_HPP_
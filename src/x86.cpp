@@ -0,0 +1,713 @@
+#include "x86.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace x86 {
+
+static const Reg ARGUMENT_REGISTERS[] = {RDI, RSI, RDX, RCX, R8, R9};
+static constexpr int NUM_ARGUMENT_REGISTERS = 6;
+
+bool Operand::operator==(const Operand &other) const {
+    if (kind != other.kind) {
+        return false;
+    }
+    switch (kind) {
+    case Kind::REG:
+        return reg == other.reg;
+    case Kind::IMM:
+        return imm == other.imm;
+    case Kind::MEM:
+        return base == other.base && index == other.index &&
+               scale == other.scale && disp == other.disp &&
+               symbol == other.symbol;
+    case Kind::LABEL:
+        return label == other.label;
+    case Kind::SYMBOL:
+        return symbol == other.symbol;
+    default:
+        return true;
+    }
+}
+
+static CC toCC(Cond cond) {
+    switch (cond) {
+    case Cond::EQ:
+        return CC::E;
+    case Cond::NE:
+        return CC::NE;
+    case Cond::LT:
+        return CC::L;
+    case Cond::LE:
+        return CC::LE;
+    case Cond::GT:
+        return CC::G;
+    case Cond::GE:
+        return CC::GE;
+    }
+    return CC::E;
+}
+
+namespace {
+
+class Selector {
+public:
+    Selector(const LFunction &function, const LinearScan::Result &allocation)
+        : function(function), allocation(allocation) {}
+
+    MFunction run();
+
+private:
+    struct Check {
+        int label;
+        Operand index;
+        Operand length;
+    };
+
+    void layoutFrame();
+    void select(size_t i);
+    void selectParams(size_t &i);
+    void selectBinary(const LInst &inst);
+    void selectCall(const LInst &inst);
+    void selectRet(const LInst &inst, bool last);
+    void writeEpilogue();
+    // Sets flags for `a - b`, with `a` in a register or memory.
+    void compare(int size, Operand a, Operand b);
+    Operand address(const LInst &inst);
+
+    Operand loc(int vreg) const;
+    Operand operand(const LOperand &operand) const;
+    int widthOf(int vreg) const { return function.vregWidths[vreg]; }
+    Operand inRegister(Operand operand, Reg scratch, int size);
+    void move(int size, Operand src, Operand dst);
+    // Moves every value in `sources` into the matching location in
+    // `targets`, where targets may overlap the sources.
+    void parallelMove(const std::vector<Operand> &sources,
+                      const std::vector<Operand> &targets,
+                      const std::vector<int> &sizes);
+
+    void emit(Op op, int size, Operand src = {}, Operand dst = {});
+    void emitJump(Op op, int label, CC cc = CC::E);
+    void emitLabel(int label) { emit(Op::LABEL, 0, Operand::lbl(label)); }
+
+    const LFunction &function;
+    const LinearScan::Result &allocation;
+    MFunction out;
+    // The source line of the LIR instruction being selected.
+    int line = 0;
+
+    std::vector<long long> frameObjectOffsets;
+    long long frameSize = 0;
+    int epilogueLabel = -1;
+    std::vector<Check> checks;
+};
+
+MFunction Selector::run() {
+    out.name = function.name;
+    out.numLabels = function.numLabels;
+    epilogueLabel = out.numLabels++;
+    line = function.line;
+    layoutFrame();
+
+    emit(Op::PUSH, 8, Operand::r(RBP));
+    emit(Op::MOV, 8, Operand::r(RSP), Operand::r(RBP));
+    for (int reg : allocation.usedCalleeSaved) {
+        emit(Op::PUSH, 8, Operand::r(static_cast<Reg>(reg)));
+    }
+    if (frameSize > 0) {
+        emit(Op::SUB, 8, Operand::i(frameSize), Operand::r(RSP));
+    }
+
+    for (size_t i = 0; i < function.instructions.size(); ++i) {
+        line = function.instructions[i].line;
+        if (function.instructions[i].op == LOp::PARAM) {
+            selectParams(i);
+            continue;
+        }
+        select(i);
+    }
+
+    writeEpilogue();
+
+    // Out-of-line bounds failures; the stack is still aligned here.
+    for (const auto &check : checks) {
+        emitLabel(check.label);
+        emit(Op::PUSH, 8, check.index);
+        emit(Op::PUSH, 8, check.length);
+        emit(Op::POP, 8, {}, Operand::r(RSI));
+        emit(Op::POP, 8, {}, Operand::r(RDI));
+        emit(Op::CALL, 8, Operand::sym("xrt_index_error"));
+    }
+    return std::move(out);
+}
+
+// rbp-relative layout, from the top: saved callee-saved registers, spill
+// slots, then frame objects. rsp stays 16-byte aligned below it all.
+void Selector::layoutFrame() {
+    long long saved = 8LL * allocation.usedCalleeSaved.size();
+    long long offset = saved + 8LL * allocation.numSpillSlots;
+    for (int size : function.frameObjects) {
+        offset += size;
+        frameObjectOffsets.push_back(-offset);
+    }
+    frameSize = offset - saved;
+    if ((saved + frameSize) % 16 != 0) {
+        frameSize += 8;
+    }
+}
+
+Operand Selector::loc(int vreg) const {
+    int reg = allocation.registers[vreg];
+    if (reg >= 0) {
+        return Operand::r(static_cast<Reg>(reg));
+    }
+    long long saved = 8LL * allocation.usedCalleeSaved.size();
+    return Operand::mem(RBP,
+                        -(saved + 8LL * (allocation.spillSlots[vreg] + 1)));
+}
+
+Operand Selector::operand(const LOperand &operand) const {
+    if (operand.isImm()) {
+        return Operand::i(operand.imm);
+    }
+    return loc(operand.vreg);
+}
+
+Operand Selector::inRegister(Operand operand, Reg scratch, int size) {
+    if (operand.isReg()) {
+        return operand;
+    }
+    move(size, operand, Operand::r(scratch));
+    return Operand::r(scratch);
+}
+
+void Selector::move(int size, Operand src, Operand dst) {
+    if (src == dst) {
+        return;
+    }
+    if (src.isImm() && src.imm == 0 && dst.isReg()) {
+        emit(Op::XOR, 4, dst, dst);
+        return;
+    }
+    if (src.isMem() && dst.isMem()) {
+        emit(Op::MOV, size, src, Operand::r(RAX));
+        src = Operand::r(RAX);
+    }
+    emit(Op::MOV, size, src, dst);
+}
+
+void Selector::parallelMove(const std::vector<Operand> &sources,
+                            const std::vector<Operand> &targets,
+                            const std::vector<int> &sizes) {
+    // Moving in order is safe unless some target is still needed as a
+    // source of a later move.
+    bool conflict = false;
+    for (size_t t = 0; t < targets.size() && !conflict; ++t) {
+        for (size_t s = t + 1; s < sources.size(); ++s) {
+            if (sources[s].isReg() && targets[t].isReg() &&
+                sources[s].reg == targets[t].reg) {
+                conflict = true;
+                break;
+            }
+        }
+    }
+    if (!conflict) {
+        for (size_t k = 0; k < sources.size(); ++k) {
+            move(sizes[k], sources[k], targets[k]);
+        }
+        return;
+    }
+    for (const auto &source : sources) {
+        emit(Op::PUSH, 8, source);
+    }
+    for (size_t k = targets.size(); k-- > 0;) {
+        emit(Op::POP, 8, {}, targets[k]);
+    }
+}
+
+void Selector::emit(Op op, int size, Operand src, Operand dst) {
+    MInst inst;
+    inst.op = op;
+    inst.size = size;
+    inst.src = src;
+    inst.dst = dst;
+    inst.line = line;
+    out.code.push_back(inst);
+}
+
+void Selector::emitJump(Op op, int label, CC cc) {
+    emit(op, 0, Operand::lbl(label));
+    out.code.back().cc = cc;
+}
+
+void Selector::selectParams(size_t &i) {
+    std::vector<Operand> sources, targets;
+    std::vector<int> sizes;
+    std::vector<const LInst *> onStack;
+    for (; i < function.instructions.size() &&
+           function.instructions[i].op == LOp::PARAM;
+         ++i) {
+        const LInst &inst = function.instructions[i];
+        if (inst.disp >= NUM_ARGUMENT_REGISTERS) {
+            onStack.push_back(&inst);
+            continue;
+        }
+        sources.push_back(Operand::r(ARGUMENT_REGISTERS[inst.disp]));
+        targets.push_back(loc(inst.dst));
+        sizes.push_back(inst.width);
+    }
+    --i;
+
+    parallelMove(sources, targets, sizes);
+    // Stack arguments sit above the return address and saved rbp. They are
+    // loaded last since their targets may be argument registers.
+    for (const LInst *inst : onStack) {
+        move(inst->width,
+             Operand::mem(RBP, 16 + 8 * (inst->disp - NUM_ARGUMENT_REGISTERS)),
+             loc(inst->dst));
+    }
+    // The upper half of a 32-bit argument register is undefined, and
+    // indexing reads the full register.
+    for (size_t k = 0; k < targets.size(); ++k) {
+        if (sizes[k] == 4 && targets[k].isReg()) {
+            emit(Op::MOV, 4, targets[k], targets[k]);
+        }
+    }
+}
+
+void Selector::select(size_t i) {
+    const LInst &inst = function.instructions[i];
+    switch (inst.op) {
+    case LOp::CONST:
+    case LOp::MOV:
+        move(inst.width, operand(inst.a), loc(inst.dst));
+        break;
+    case LOp::ADDR:
+    case LOp::FRAME: {
+        Operand target = loc(inst.dst);
+        Operand reg = target.isReg() ? target : Operand::r(RAX);
+        Operand source =
+            inst.op == LOp::ADDR
+                ? Operand::rip(inst.symbol)
+                : Operand::mem(RBP, frameObjectOffsets[inst.disp]);
+        emit(Op::LEA, 8, source, reg);
+        move(8, reg, target);
+        break;
+    }
+    case LOp::BIN:
+        selectBinary(inst);
+        break;
+    case LOp::CMP: {
+        compare(inst.width, operand(inst.a), operand(inst.b));
+        emit(Op::SETCC, 1, {}, Operand::r(RAX));
+        out.code.back().cc = toCC(inst.cond);
+        emit(Op::MOVZX8, 4, Operand::r(RAX), Operand::r(RAX));
+        move(4, Operand::r(RAX), loc(inst.dst));
+        break;
+    }
+    case LOp::LOAD: {
+        Operand source = address(inst);
+        Operand target = loc(inst.dst);
+        if (target.isReg()) {
+            emit(Op::MOV, inst.width, source, target);
+        } else {
+            emit(Op::MOV, inst.width, source, Operand::r(RAX));
+            emit(Op::MOV, inst.width, Operand::r(RAX), target);
+        }
+        break;
+    }
+    case LOp::STORE: {
+        Operand target = address(inst);
+        Operand value = operand(inst.c);
+        if (value.isMem()) {
+            value = inRegister(value, RDX, inst.width);
+        }
+        emit(Op::MOV, inst.width, value, target);
+        break;
+    }
+    case LOp::CALL:
+        selectCall(inst);
+        break;
+    case LOp::PARAM:
+        break;
+    case LOp::JMP:
+        emitJump(Op::JMP, inst.label);
+        break;
+    case LOp::JCC:
+        compare(inst.width, operand(inst.a), operand(inst.b));
+        emitJump(Op::JCC, inst.label, toCC(inst.cond));
+        break;
+    case LOp::LABEL:
+        emitLabel(inst.label);
+        break;
+    case LOp::RET:
+        selectRet(inst, i + 1 == function.instructions.size());
+        break;
+    case LOp::CHECK: {
+        Operand index = operand(inst.a);
+        Operand length = operand(inst.b);
+        int label = out.numLabels++;
+        checks.push_back({label, index, length});
+        if (index.isImm()) {
+            index = inRegister(index, RAX, 4);
+        }
+        compare(4, index, length);
+        // Unsigned, so negative indexes fail too.
+        emitJump(Op::JCC, label, CC::AE);
+        break;
+    }
+    }
+}
+
+void Selector::compare(int size, Operand a, Operand b) {
+    if (a.isImm() || (a.isMem() && b.isMem())) {
+        a = inRegister(a, RAX, size);
+    }
+    if (b.isImm() && b.imm == 0 && a.isReg()) {
+        emit(Op::TEST, size, a, a);
+        return;
+    }
+    emit(Op::CMP, size, b, a);
+}
+
+// Memory operand for a LOAD or STORE: [a + b * 8 + disp].
+Operand Selector::address(const LInst &inst) {
+    Operand base = inRegister(operand(inst.a), R11, 8);
+    Reg index = NO_REG;
+    if (inst.b.isReg()) {
+        Operand value = loc(inst.b.vreg);
+        if (value.isReg()) {
+            index = value.reg;
+        } else {
+            // A 32-bit load zero-extends into the full register.
+            emit(Op::MOV, 4, value, Operand::r(RAX));
+            index = RAX;
+        }
+    }
+    return Operand::mem(base.reg, inst.disp, index, index == NO_REG ? 1 : 8);
+}
+
+void Selector::selectBinary(const LInst &inst) {
+    int size = inst.width;
+    Operand a = operand(inst.a);
+    Operand b = operand(inst.b);
+    Operand d = loc(inst.dst);
+
+    if (inst.operation == Operation::DIVIDE) {
+        move(size, a, Operand::r(RAX));
+        emit(Op::CDQ, size);
+        if (b.isImm()) {
+            move(size, b, Operand::r(R11));
+            b = Operand::r(R11);
+        }
+        emit(Op::IDIV, size, b);
+        move(size, Operand::r(RAX), d);
+        return;
+    }
+
+    Op op;
+    switch (inst.operation) {
+    case Operation::ADD:
+        op = Op::ADD;
+        break;
+    case Operation::SUBTRACT:
+        op = Op::SUB;
+        break;
+    case Operation::MULTIPLY:
+        op = Op::IMUL;
+        break;
+    default:
+        throw std::runtime_error("unsupported binary operation " +
+                                 operationToString(inst.operation));
+    }
+    bool commutative = op != Op::SUB;
+
+    if (op == Op::IMUL && b.isImm()) {
+        Operand target = d.isReg() ? d : Operand::r(RAX);
+        emit(Op::IMUL, size, a, target);
+        out.code.back().hasImm = true;
+        out.code.back().imm = b.imm;
+        move(size, target, d);
+        return;
+    }
+
+    // Read-modify-write in place: d = d op b.
+    if (d == a && (d.isReg() || op != Op::IMUL) && !(d.isMem() && b.isMem())) {
+        emit(op, size, b, d);
+        return;
+    }
+    if (d.isReg() && d == b && commutative) {
+        emit(op, size, a, d);
+        return;
+    }
+    if (d.isReg() && !(d == b)) {
+        move(size, a, d);
+        emit(op, size, b, d);
+        return;
+    }
+    move(size, a, Operand::r(RAX));
+    emit(op, size, b, Operand::r(RAX));
+    move(size, Operand::r(RAX), d);
+}
+
+void Selector::selectCall(const LInst &inst) {
+    size_t count = inst.args.size();
+    size_t onStack =
+        count > NUM_ARGUMENT_REGISTERS ? count - NUM_ARGUMENT_REGISTERS : 0;
+    long long padding = onStack % 2 ? 8 : 0;
+
+    if (padding) {
+        emit(Op::SUB, 8, Operand::i(padding), Operand::r(RSP));
+    }
+    for (size_t k = count; k-- > NUM_ARGUMENT_REGISTERS;) {
+        emit(Op::PUSH, 8, operand(inst.args[k]));
+    }
+
+    std::vector<Operand> sources, targets;
+    std::vector<int> sizes;
+    for (size_t k = 0; k < count && k < NUM_ARGUMENT_REGISTERS; ++k) {
+        const LOperand &argument = inst.args[k];
+        sources.push_back(operand(argument));
+        targets.push_back(Operand::r(ARGUMENT_REGISTERS[k]));
+        sizes.push_back(argument.isReg() ? widthOf(argument.vreg) : 4);
+    }
+    parallelMove(sources, targets, sizes);
+
+    emit(Op::CALL, 8, Operand::sym(inst.symbol));
+    if (onStack) {
+        emit(Op::ADD, 8, Operand::i(8LL * onStack + padding),
+             Operand::r(RSP));
+    }
+    if (inst.dst >= 0) {
+        move(inst.width, Operand::r(RAX), loc(inst.dst));
+    }
+}
+
+void Selector::selectRet(const LInst &inst, bool last) {
+    move(inst.width, operand(inst.a), Operand::r(RAX));
+    if (!last) {
+        emitJump(Op::JMP, epilogueLabel);
+    }
+}
+
+void Selector::writeEpilogue() {
+    emitLabel(epilogueLabel);
+    long long saved = 8LL * allocation.usedCalleeSaved.size();
+    if (saved > 0) {
+        emit(Op::LEA, 8, Operand::mem(RBP, -saved), Operand::r(RSP));
+        for (auto reg = allocation.usedCalleeSaved.rbegin();
+             reg != allocation.usedCalleeSaved.rend(); ++reg) {
+            emit(Op::POP, 8, {}, Operand::r(static_cast<Reg>(*reg)));
+        }
+    } else {
+        emit(Op::MOV, 8, Operand::r(RBP), Operand::r(RSP));
+    }
+    emit(Op::POP, 8, {}, Operand::r(RBP));
+    emit(Op::RET, 8);
+}
+
+} // namespace
+
+MModule selectInstructions(const LModule &module) {
+    LinearScan allocator({RCX, RSI, RDI, R8, R9, R10},
+                         {RBX, R12, R13, R14, R15});
+    MModule result;
+    for (const auto &function : module.functions) {
+        LinearScan::Result allocation = allocator.run(function);
+        result.functions.push_back(Selector(function, allocation).run());
+    }
+    result.globals = module.globals;
+    result.strings = module.strings;
+    return result;
+}
+
+std::string regName(Reg reg, int size) {
+    static const char *names64[] = {"rax", "rcx", "rdx", "rbx", "rsp", "rbp",
+                                    "rsi", "rdi", "r8",  "r9",  "r10", "r11",
+                                    "r12", "r13", "r14", "r15"};
+    static const char *names32[] = {"eax",  "ecx",  "edx",  "ebx",
+                                    "esp",  "ebp",  "esi",  "edi",
+                                    "r8d",  "r9d",  "r10d", "r11d",
+                                    "r12d", "r13d", "r14d", "r15d"};
+    static const char *names8[] = {"al",   "cl",   "dl",   "bl",
+                                   "spl",  "bpl",  "sil",  "dil",
+                                   "r8b",  "r9b",  "r10b", "r11b",
+                                   "r12b", "r13b", "r14b", "r15b"};
+    switch (size) {
+    case 1:
+        return names8[reg];
+    case 4:
+        return names32[reg];
+    default:
+        return names64[reg];
+    }
+}
+
+std::string ccName(CC cc) {
+    switch (cc) {
+    case CC::E:
+        return "e";
+    case CC::NE:
+        return "ne";
+    case CC::L:
+        return "l";
+    case CC::LE:
+        return "le";
+    case CC::G:
+        return "g";
+    case CC::GE:
+        return "ge";
+    case CC::B:
+        return "b";
+    case CC::AE:
+        return "ae";
+    }
+    return "";
+}
+
+static std::string labelName(const MFunction &function, int label) {
+    return ".L" + function.name + "_" + std::to_string(label);
+}
+
+static std::string formatOperand(const MFunction &function,
+                                 const Operand &operand, int size) {
+    switch (operand.kind) {
+    case Operand::Kind::REG:
+        return "%" + regName(operand.reg, size);
+    case Operand::Kind::IMM:
+        return "$" + std::to_string(operand.imm);
+    case Operand::Kind::MEM: {
+        if (!operand.symbol.empty()) {
+            return operand.symbol + "(%rip)";
+        }
+        std::string text = operand.disp ? std::to_string(operand.disp) : "";
+        text += "(%" + regName(operand.base, 8);
+        if (operand.index != NO_REG) {
+            text += ",%" + regName(operand.index, 8) + "," +
+                    std::to_string(operand.scale);
+        }
+        return text + ")";
+    }
+    case Operand::Kind::LABEL:
+        return labelName(function, operand.label);
+    case Operand::Kind::SYMBOL:
+        return operand.symbol;
+    default:
+        return "";
+    }
+}
+
+static std::string writeInstruction(const MFunction &function,
+                                    const MInst &inst) {
+    std::string suffix = inst.size == 8 ? "q" : "l";
+    auto src = [&](int size) {
+        return formatOperand(function, inst.src, size);
+    };
+    auto dst = [&](int size) {
+        return formatOperand(function, inst.dst, size);
+    };
+
+    switch (inst.op) {
+    case Op::MOV:
+        return "mov" + suffix + " " + src(inst.size) + ", " + dst(inst.size);
+    case Op::MOVZX8:
+        return "movzbl " + src(1) + ", " + dst(4);
+    case Op::LEA:
+        return "leaq " + src(8) + ", " + dst(8);
+    case Op::ADD:
+        return "add" + suffix + " " + src(inst.size) + ", " + dst(inst.size);
+    case Op::SUB:
+        return "sub" + suffix + " " + src(inst.size) + ", " + dst(inst.size);
+    case Op::IMUL:
+        if (inst.hasImm) {
+            return "imul" + suffix + " $" + std::to_string(inst.imm) + ", " +
+                   src(inst.size) + ", " + dst(inst.size);
+        }
+        return "imul" + suffix + " " + src(inst.size) + ", " + dst(inst.size);
+    case Op::IDIV:
+        return "idiv" + suffix + " " + src(inst.size);
+    case Op::CDQ:
+        return inst.size == 8 ? "cqto" : "cltd";
+    case Op::CMP:
+        return "cmp" + suffix + " " + src(inst.size) + ", " + dst(inst.size);
+    case Op::TEST:
+        return "test" + suffix + " " + src(inst.size) + ", " + dst(inst.size);
+    case Op::XOR:
+        return "xor" + suffix + " " + src(inst.size) + ", " + dst(inst.size);
+    case Op::SETCC:
+        return "set" + ccName(inst.cc) + " " + dst(1);
+    case Op::JCC:
+        return "j" + ccName(inst.cc) + " " + src(8);
+    case Op::JMP:
+        return "jmp " + src(8);
+    case Op::CALL:
+        return "call " + src(8);
+    case Op::RET:
+        return "ret";
+    case Op::PUSH:
+        return "pushq " + src(8);
+    case Op::POP:
+        return "popq " + dst(8);
+    case Op::LABEL:
+        return "";
+    }
+    return "";
+}
+
+std::string writeAssembly(const MModule &module, std::string_view sourceName) {
+    std::string out = "    .text\n";
+    if (!sourceName.empty()) {
+        out += "    .file 1 \"";
+        for (char c : sourceName) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            out += c;
+        }
+        out += "\"\n";
+    }
+    for (const auto &function : module.functions) {
+        out += "\n    .globl " + function.name + "\n";
+        out += "    .type " + function.name + ", @function\n";
+        out += function.name + ":\n";
+        int line = 0;
+        for (const auto &inst : function.code) {
+            if (!sourceName.empty() && inst.op != Op::LABEL &&
+                inst.line != 0 && inst.line != line) {
+                line = inst.line;
+                out += "    .loc 1 " + std::to_string(line) + "\n";
+            }
+            if (inst.op == Op::LABEL) {
+                out += labelName(function, inst.src.label) + ":\n";
+            } else {
+                out += "    " + writeInstruction(function, inst) + "\n";
+            }
+        }
+        out += "    .size " + function.name + ", .-" + function.name + "\n";
+    }
+
+    if (!module.strings.empty()) {
+        out += "\n    .section .rodata\n";
+        for (const auto &[label, text] : module.strings) {
+            out += label + ":\n    .string \"" + text + "\"\n";
+        }
+    }
+
+    if (!module.globals.empty()) {
+        out += "\n    .data\n";
+        for (const auto &global : module.globals) {
+            out += "    .p2align 3\n" + global.name + ":\n";
+            if (!global.stringLabel.empty()) {
+                out += "    .quad " + global.stringLabel + "\n";
+            } else if (global.size == 4) {
+                out += "    .long " + std::to_string(global.value) + "\n";
+            } else {
+                out += "    .zero " + std::to_string(global.size) + "\n";
+            }
+        }
+    }
+
+    out += "\n    .section .note.GNU-stack,\"\",@progbits\n";
+    return out;
+}
+
+} // namespace x86
@@ -0,0 +1,198 @@
+#ifndef X86_HPP_
+#define X86_HPP_
+
+#include "lir.hpp"
+#include "regAlloc.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// x86-64 (System V) code generation from LIR.
+//
+// Instruction selection turns each LIR instruction into a few machine
+// instructions over the registers chosen by LinearScan. rax, rdx and r11
+// are never allocated: they are scratch for division, return values and
+// spilled operands. The result is printed as GNU assembly or encoded
+// directly into machine code for the ELF writer.
+namespace x86 {
+
+// Hardware encoding order.
+enum Reg {
+    RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+    R8, R9, R10, R11, R12, R13, R14, R15,
+    NO_REG = -1
+};
+
+enum class CC { E, NE, L, LE, G, GE, B, AE };
+
+struct Operand {
+    enum class Kind { NONE, REG, IMM, MEM, LABEL, SYMBOL };
+
+    Kind kind = Kind::NONE;
+    Reg reg = NO_REG;
+    long long imm = 0;
+    // MEM: [base + index * scale + disp], or [rip + symbol + disp] when
+    // `symbol` is set.
+    Reg base = NO_REG;
+    Reg index = NO_REG;
+    int scale = 1;
+    long long disp = 0;
+    std::string symbol;
+    int label = -1;
+
+    static Operand r(Reg reg) {
+        Operand o;
+        o.kind = Kind::REG;
+        o.reg = reg;
+        return o;
+    }
+    static Operand i(long long value) {
+        Operand o;
+        o.kind = Kind::IMM;
+        o.imm = value;
+        return o;
+    }
+    static Operand mem(Reg base, long long disp, Reg index = NO_REG,
+                       int scale = 1) {
+        Operand o;
+        o.kind = Kind::MEM;
+        o.base = base;
+        o.disp = disp;
+        o.index = index;
+        o.scale = scale;
+        return o;
+    }
+    static Operand rip(const std::string &symbol) {
+        Operand o;
+        o.kind = Kind::MEM;
+        o.symbol = symbol;
+        return o;
+    }
+    static Operand lbl(int label) {
+        Operand o;
+        o.kind = Kind::LABEL;
+        o.label = label;
+        return o;
+    }
+    static Operand sym(const std::string &symbol) {
+        Operand o;
+        o.kind = Kind::SYMBOL;
+        o.symbol = symbol;
+        return o;
+    }
+
+    bool isReg() const { return kind == Kind::REG; }
+    bool isImm() const { return kind == Kind::IMM; }
+    bool isMem() const { return kind == Kind::MEM; }
+    bool operator==(const Operand &other) const;
+};
+
+enum class Op {
+    MOV,    // mov src, dst
+    MOVZX8, // movzb src8, dst
+    LEA,
+    ADD,
+    SUB,
+    IMUL, // imul src, dst; with `imm` set, imul $imm, src, dst
+    IDIV, // idiv src
+    CDQ,  // sign-extend eax into edx
+    CMP,  // cmp src, dst (flags from dst - src)
+    TEST,
+    XOR,
+    SETCC, // setcc dst8
+    JCC,
+    JMP,
+    CALL,
+    RET,
+    PUSH,
+    POP,
+    LABEL,
+};
+
+struct MInst {
+    Op op;
+    // Operand size in bytes: 4 or 8 (1 for SETCC).
+    int size = 4;
+    Operand src, dst;
+    CC cc = CC::E;
+    long long imm = 0;
+    bool hasImm = false;
+    // The source line it was selected for; 0 if unknown.
+    int line = 0;
+};
+
+struct MFunction {
+    std::string name;
+    std::vector<MInst> code;
+    int numLabels = 0;
+};
+
+struct MModule {
+    std::vector<MFunction> functions;
+    std::vector<LGlobal> globals;
+    std::vector<std::pair<std::string, std::string>> strings;
+};
+
+MModule selectInstructions(const LModule &module);
+
+// GNU assembler (AT&T syntax) text for a whole module. With `sourceName`
+// (-g), .file and .loc directives map the code to lines of that source, for
+// the assembler to record as DWARF line information.
+std::string writeAssembly(const MModule &module,
+                          std::string_view sourceName = {});
+
+// Machine code for a whole module, laid out in sections for an object file
+// or executable writer.
+enum class Section { TEXT, RODATA, DATA, UNDEFINED };
+
+struct Symbol {
+    std::string name;
+    Section section = Section::UNDEFINED;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    // Functions are global; string literals and variables are local.
+    bool global = false;
+    bool function = false;
+};
+
+struct Relocation {
+    enum class Kind {
+        PC32,  // 32-bit S + A - P
+        PLT32, // call to a possibly external function
+        ABS64, // 64-bit S + A
+    };
+
+    Kind kind;
+    Section section; // where the field is
+    uint64_t offset;
+    std::string symbol;
+    long long addend;
+};
+
+struct Image {
+    std::vector<uint8_t> text, rodata, data;
+    // Defined symbols, then external ones in order of first use.
+    std::vector<Symbol> symbols;
+    std::vector<Relocation> relocations;
+    // Where the code of each source line starts: a .text offset and the
+    // line, in order of offset, whenever the line changes.
+    std::vector<std::pair<uint64_t, int>> lines;
+
+    const Symbol *find(const std::string &name) const;
+    bool hasExternals() const;
+};
+
+// Encodes every instruction, choosing short branches where they reach.
+// Calls between functions of the module are resolved directly; other
+// symbol references are left as relocations. Throws std::runtime_error for
+// an instruction form it cannot encode.
+Image encode(const MModule &module);
+
+std::string regName(Reg reg, int size);
+std::string ccName(CC cc);
+
+} // namespace x86
+
+#endif // X86_HPP_
@@ -0,0 +1,606 @@
+#include "x86.hpp"
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace x86 {
+
+const Symbol *Image::find(const std::string &name) const {
+    for (const auto &symbol : symbols) {
+        if (symbol.name == name) {
+            return &symbol;
+        }
+    }
+    return nullptr;
+}
+
+bool Image::hasExternals() const {
+    for (const auto &symbol : symbols) {
+        if (symbol.section == Section::UNDEFINED) {
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+
+bool fitsInt8(long long value) { return value >= -128 && value <= 127; }
+
+bool fitsInt32(long long value) {
+    return value >= INT32_MIN && value <= INT32_MAX;
+}
+
+uint8_t ccCode(CC cc) {
+    switch (cc) {
+    case CC::E:
+        return 0x4;
+    case CC::NE:
+        return 0x5;
+    case CC::L:
+        return 0xC;
+    case CC::LE:
+        return 0xE;
+    case CC::G:
+        return 0xF;
+    case CC::GE:
+        return 0xD;
+    case CC::B:
+        return 0x2;
+    case CC::AE:
+        return 0x3;
+    }
+    return 0x4;
+}
+
+void append(std::vector<uint8_t> &bytes, uint64_t value, int size) {
+    for (int k = 0; k < size; ++k) {
+        bytes.push_back(static_cast<uint8_t>(value >> (8 * k)));
+    }
+}
+
+void patch(std::vector<uint8_t> &bytes, size_t offset, uint64_t value,
+           int size) {
+    for (int k = 0; k < size; ++k) {
+        bytes[offset + k] = static_cast<uint8_t>(value >> (8 * k));
+    }
+}
+
+// The bytes of one instruction, with at most one 32-bit symbol reference:
+// a call target or a rip-relative operand.
+struct Encoded {
+    std::vector<uint8_t> bytes;
+    int fixup = -1;
+    std::string symbol;
+    long long disp = 0;
+    bool call = false;
+};
+
+// Encodes everything but branches, whose size depends on the layout.
+class InstructionEncoder {
+public:
+    Encoded run(const MInst &inst);
+
+private:
+    // ALU instructions in the classic 8-opcode group: `extension` is the
+    // ModRM reg field of the immediate forms, and `opcode` the r/m, reg
+    // form (the reg, r/m form is opcode + 2).
+    void alu(const MInst &inst, int extension, uint8_t opcode);
+    void mov(const MInst &inst);
+    void imul(const MInst &inst);
+
+    // Emits a REX prefix when any of its bits are needed, or when `byteRm`
+    // is set and rm names spl, bpl, sil or dil.
+    void rex(bool wide, int reg, const Operand &rm, bool byteRm = false);
+    void modrm(int reg, const Operand &rm);
+    void immediate(long long value, int size);
+    [[noreturn]] void unsupported(const MInst &inst);
+
+    Encoded out;
+};
+
+Encoded InstructionEncoder::run(const MInst &inst) {
+    out = Encoded();
+    bool wide = inst.size == 8;
+    switch (inst.op) {
+    case Op::MOV:
+        mov(inst);
+        break;
+    case Op::MOVZX8:
+        if (!inst.src.isReg() || !inst.dst.isReg()) {
+            unsupported(inst);
+        }
+        rex(false, inst.dst.reg, inst.src, true);
+        out.bytes.insert(out.bytes.end(), {0x0F, 0xB6});
+        modrm(inst.dst.reg, inst.src);
+        break;
+    case Op::LEA:
+        if (!inst.src.isMem() || !inst.dst.isReg()) {
+            unsupported(inst);
+        }
+        rex(true, inst.dst.reg, inst.src);
+        out.bytes.push_back(0x8D);
+        modrm(inst.dst.reg, inst.src);
+        break;
+    case Op::ADD:
+        alu(inst, 0, 0x01);
+        break;
+    case Op::SUB:
+        alu(inst, 5, 0x29);
+        break;
+    case Op::XOR:
+        alu(inst, 6, 0x31);
+        break;
+    case Op::CMP:
+        alu(inst, 7, 0x39);
+        break;
+    case Op::TEST: {
+        // Commutative, so either operand may be the register.
+        Operand reg = inst.src.isReg() ? inst.src : inst.dst;
+        Operand rm = inst.src.isReg() ? inst.dst : inst.src;
+        if (!reg.isReg() || rm.isImm()) {
+            unsupported(inst);
+        }
+        rex(wide, reg.reg, rm);
+        out.bytes.push_back(0x85);
+        modrm(reg.reg, rm);
+        break;
+    }
+    case Op::IMUL:
+        imul(inst);
+        break;
+    case Op::IDIV:
+        if (inst.src.isImm()) {
+            unsupported(inst);
+        }
+        rex(wide, 0, inst.src);
+        out.bytes.push_back(0xF7);
+        modrm(7, inst.src);
+        break;
+    case Op::CDQ:
+        if (wide) {
+            out.bytes.push_back(0x48);
+        }
+        out.bytes.push_back(0x99);
+        break;
+    case Op::SETCC:
+        rex(false, 0, inst.dst, true);
+        out.bytes.push_back(0x0F);
+        out.bytes.push_back(0x90 | ccCode(inst.cc));
+        modrm(0, inst.dst);
+        break;
+    case Op::CALL:
+        if (inst.src.kind != Operand::Kind::SYMBOL) {
+            unsupported(inst);
+        }
+        out.bytes.push_back(0xE8);
+        out.fixup = static_cast<int>(out.bytes.size());
+        out.symbol = inst.src.symbol;
+        out.call = true;
+        append(out.bytes, 0, 4);
+        break;
+    case Op::RET:
+        out.bytes.push_back(0xC3);
+        break;
+    case Op::PUSH:
+        if (inst.src.isReg()) {
+            if (inst.src.reg >= R8) {
+                out.bytes.push_back(0x41);
+            }
+            out.bytes.push_back(0x50 | (inst.src.reg & 7));
+        } else if (inst.src.isImm()) {
+            if (fitsInt8(inst.src.imm)) {
+                out.bytes.push_back(0x6A);
+                immediate(inst.src.imm, 1);
+            } else {
+                out.bytes.push_back(0x68);
+                immediate(inst.src.imm, 4);
+            }
+        } else {
+            rex(false, 0, inst.src);
+            out.bytes.push_back(0xFF);
+            modrm(6, inst.src);
+        }
+        break;
+    case Op::POP:
+        if (inst.dst.isReg()) {
+            if (inst.dst.reg >= R8) {
+                out.bytes.push_back(0x41);
+            }
+            out.bytes.push_back(0x58 | (inst.dst.reg & 7));
+        } else if (inst.dst.isMem()) {
+            rex(false, 0, inst.dst);
+            out.bytes.push_back(0x8F);
+            modrm(0, inst.dst);
+        } else {
+            unsupported(inst);
+        }
+        break;
+    case Op::JCC:
+    case Op::JMP:
+    case Op::LABEL:
+        unsupported(inst);
+    }
+    return std::move(out);
+}
+
+void InstructionEncoder::alu(const MInst &inst, int extension,
+                             uint8_t opcode) {
+    bool wide = inst.size == 8;
+    const Operand &src = inst.src;
+    const Operand &dst = inst.dst;
+    if (src.isImm() && !dst.isImm()) {
+        if (!fitsInt32(src.imm) && wide) {
+            unsupported(inst);
+        }
+        rex(wide, 0, dst);
+        bool small = fitsInt8(src.imm);
+        out.bytes.push_back(small ? 0x83 : 0x81);
+        modrm(extension, dst);
+        immediate(src.imm, small ? 1 : 4);
+    } else if (src.isReg() && (dst.isReg() || dst.isMem())) {
+        rex(wide, src.reg, dst);
+        out.bytes.push_back(opcode);
+        modrm(src.reg, dst);
+    } else if (src.isMem() && dst.isReg()) {
+        rex(wide, dst.reg, src);
+        out.bytes.push_back(opcode + 2);
+        modrm(dst.reg, src);
+    } else {
+        unsupported(inst);
+    }
+}
+
+void InstructionEncoder::mov(const MInst &inst) {
+    bool wide = inst.size == 8;
+    const Operand &src = inst.src;
+    const Operand &dst = inst.dst;
+    if (src.isReg() && (dst.isReg() || dst.isMem())) {
+        rex(wide, src.reg, dst);
+        out.bytes.push_back(0x89);
+        modrm(src.reg, dst);
+    } else if (src.isMem() && dst.isReg()) {
+        rex(wide, dst.reg, src);
+        out.bytes.push_back(0x8B);
+        modrm(dst.reg, src);
+    } else if (src.isImm() && dst.isReg() &&
+               (!wide || (src.imm >= 0 && src.imm <= UINT32_MAX))) {
+        // A 32-bit move zero-extends into the full register.
+        rex(false, 0, dst);
+        out.bytes.push_back(0xB8 | (dst.reg & 7));
+        immediate(src.imm, 4);
+    } else if (src.isImm() && (!wide || fitsInt32(src.imm))) {
+        rex(wide, 0, dst);
+        out.bytes.push_back(0xC7);
+        modrm(0, dst);
+        immediate(src.imm, 4);
+    } else if (src.isImm() && dst.isReg()) {
+        rex(true, 0, dst);
+        out.bytes.push_back(0xB8 | (dst.reg & 7));
+        immediate(src.imm, 8);
+    } else {
+        unsupported(inst);
+    }
+}
+
+void InstructionEncoder::imul(const MInst &inst) {
+    bool wide = inst.size == 8;
+    if (!inst.dst.isReg() || inst.src.isImm()) {
+        unsupported(inst);
+    }
+    rex(wide, inst.dst.reg, inst.src);
+    if (!inst.hasImm) {
+        out.bytes.insert(out.bytes.end(), {0x0F, 0xAF});
+        modrm(inst.dst.reg, inst.src);
+        return;
+    }
+    bool small = fitsInt8(inst.imm);
+    out.bytes.push_back(small ? 0x6B : 0x69);
+    modrm(inst.dst.reg, inst.src);
+    immediate(inst.imm, small ? 1 : 4);
+}
+
+void InstructionEncoder::rex(bool wide, int reg, const Operand &rm,
+                             bool byteRm) {
+    uint8_t prefix = 0x40;
+    if (wide) {
+        prefix |= 0x08;
+    }
+    if (reg >= R8) {
+        prefix |= 0x04;
+    }
+    bool force = false;
+    if (rm.isReg()) {
+        if (rm.reg >= R8) {
+            prefix |= 0x01;
+        }
+        force = byteRm && rm.reg >= RSP && rm.reg <= RDI;
+    } else if (rm.isMem() && rm.symbol.empty()) {
+        if (rm.index != NO_REG && rm.index >= R8) {
+            prefix |= 0x02;
+        }
+        if (rm.base >= R8) {
+            prefix |= 0x01;
+        }
+    }
+    if (prefix != 0x40 || force) {
+        out.bytes.push_back(prefix);
+    }
+}
+
+void InstructionEncoder::modrm(int reg, const Operand &rm) {
+    uint8_t regBits = static_cast<uint8_t>((reg & 7) << 3);
+    if (rm.isReg()) {
+        out.bytes.push_back(0xC0 | regBits | (rm.reg & 7));
+        return;
+    }
+    if (!rm.symbol.empty()) {
+        // [rip + disp32], resolved by a relocation.
+        out.bytes.push_back(0x05 | regBits);
+        out.fixup = static_cast<int>(out.bytes.size());
+        out.symbol = rm.symbol;
+        out.disp = rm.disp;
+        append(out.bytes, 0, 4);
+        return;
+    }
+
+    // rsp and r12 as a base need a SIB byte; rbp and r13 as a base need
+    // a displacement.
+    bool sib = rm.index != NO_REG || (rm.base & 7) == RSP;
+    uint8_t mod;
+    if (rm.disp == 0 && (rm.base & 7) != RBP) {
+        mod = 0x00;
+    } else if (fitsInt8(rm.disp)) {
+        mod = 0x40;
+    } else {
+        mod = 0x80;
+    }
+    out.bytes.push_back(mod | regBits | (sib ? 0x04 : (rm.base & 7)));
+    if (sib) {
+        uint8_t scale = rm.scale == 8 ? 3 : rm.scale == 4 ? 2
+                                        : rm.scale == 2 ? 1
+                                                        : 0;
+        int index = rm.index == NO_REG ? RSP : (rm.index & 7);
+        out.bytes.push_back(
+            static_cast<uint8_t>(scale << 6 | index << 3 | (rm.base & 7)));
+    }
+    if (mod == 0x40) {
+        immediate(rm.disp, 1);
+    } else if (mod == 0x80) {
+        immediate(rm.disp, 4);
+    }
+}
+
+void InstructionEncoder::immediate(long long value, int size) {
+    append(out.bytes, static_cast<uint64_t>(value), size);
+}
+
+void InstructionEncoder::unsupported(const MInst &inst) {
+    throw std::runtime_error("cannot encode instruction (op " +
+                             std::to_string(static_cast<int>(inst.op)) + ")");
+}
+
+// A function's instructions, with branches kept apart so their size can
+// be chosen once label offsets are known.
+struct Item {
+    Encoded code;
+    const MInst *inst;
+    bool isShort = true;
+
+    bool isBranch() const {
+        return inst->op == Op::JCC || inst->op == Op::JMP;
+    }
+    size_t size() const {
+        if (inst->op == Op::LABEL) {
+            return 0;
+        }
+        if (isBranch()) {
+            return isShort ? 2 : inst->op == Op::JCC ? 6 : 5;
+        }
+        return code.bytes.size();
+    }
+};
+
+class ModuleEncoder {
+public:
+    explicit ModuleEncoder(const MModule &module) : module(module) {}
+
+    Image run();
+
+private:
+    void encodeFunction(const MFunction &function);
+    void reference(Section section, uint64_t offset, const std::string &name,
+                   long long addend, bool call);
+
+    const MModule &module;
+    Image image;
+    std::unordered_map<std::string, size_t> functionOffsets;
+    std::unordered_set<std::string> externals;
+
+    // Calls to resolve once every function is placed.
+    struct Call {
+        uint64_t offset;
+        std::string symbol;
+    };
+    std::vector<Call> calls;
+};
+
+Image ModuleEncoder::run() {
+    for (const auto &function : module.functions) {
+        encodeFunction(function);
+    }
+
+    for (const auto &[label, text] : module.strings) {
+        Symbol symbol;
+        symbol.name = label;
+        symbol.section = Section::RODATA;
+        symbol.offset = image.rodata.size();
+        std::string bytes = unescapeString(text);
+        image.rodata.insert(image.rodata.end(), bytes.begin(), bytes.end());
+        image.rodata.push_back(0);
+        symbol.size = bytes.size() + 1;
+        image.symbols.push_back(symbol);
+    }
+
+    for (const auto &global : module.globals) {
+        image.data.resize((image.data.size() + 7) & ~size_t(7), 0);
+        Symbol symbol;
+        symbol.name = global.name;
+        symbol.section = Section::DATA;
+        symbol.offset = image.data.size();
+        if (!global.stringLabel.empty()) {
+            reference(Section::DATA, symbol.offset, global.stringLabel, 0,
+                      false);
+            append(image.data, 0, 8);
+        } else if (global.size == 4) {
+            append(image.data, static_cast<uint64_t>(global.value), 4);
+        } else {
+            image.data.resize(image.data.size() + global.size, 0);
+        }
+        symbol.size = image.data.size() - symbol.offset;
+        image.symbols.push_back(symbol);
+    }
+
+    for (const auto &call : calls) {
+        auto it = functionOffsets.find(call.symbol);
+        if (it == functionOffsets.end()) {
+            reference(Section::TEXT, call.offset, call.symbol, -4, true);
+            continue;
+        }
+        long long rel = static_cast<long long>(it->second) -
+                        static_cast<long long>(call.offset + 4);
+        patch(image.text, call.offset, static_cast<uint64_t>(rel), 4);
+    }
+    return std::move(image);
+}
+
+void ModuleEncoder::reference(Section section, uint64_t offset,
+                              const std::string &name, long long addend,
+                              bool call) {
+    // Only calls leave the module; data references name a string literal
+    // or a variable defined here.
+    if (call && externals.insert(name).second) {
+        Symbol external;
+        external.name = name;
+        external.global = true;
+        image.symbols.push_back(external);
+    }
+    Relocation relocation;
+    relocation.kind = call ? Relocation::Kind::PLT32
+                      : section == Section::TEXT ? Relocation::Kind::PC32
+                                                 : Relocation::Kind::ABS64;
+    relocation.section = section;
+    relocation.offset = offset;
+    relocation.symbol = name;
+    relocation.addend = addend;
+    image.relocations.push_back(relocation);
+}
+
+void ModuleEncoder::encodeFunction(const MFunction &function) {
+    InstructionEncoder encoder;
+    std::vector<Item> items;
+    for (const auto &inst : function.code) {
+        Item item{{}, &inst};
+        if (inst.op != Op::LABEL && !item.isBranch()) {
+            item.code = encoder.run(inst);
+        }
+        items.push_back(std::move(item));
+    }
+
+    // Start with every branch short and lengthen the ones that do not
+    // reach until nothing changes. Sizes only grow, so this terminates.
+    std::vector<size_t> labels(function.numLabels, 0);
+    std::vector<size_t> offsets(items.size(), 0);
+    bool changed = true;
+    while (changed) {
+        size_t offset = 0;
+        for (size_t k = 0; k < items.size(); ++k) {
+            offsets[k] = offset;
+            if (items[k].inst->op == Op::LABEL) {
+                labels[items[k].inst->src.label] = offset;
+            }
+            offset += items[k].size();
+        }
+        changed = false;
+        for (size_t k = 0; k < items.size(); ++k) {
+            if (!items[k].isBranch() || !items[k].isShort) {
+                continue;
+            }
+            long long rel =
+                static_cast<long long>(labels[items[k].inst->src.label]) -
+                static_cast<long long>(offsets[k] + 2);
+            if (!fitsInt8(rel)) {
+                items[k].isShort = false;
+                changed = true;
+            }
+        }
+    }
+
+    size_t start = image.text.size();
+    functionOffsets[function.name] = start;
+    int line = 0;
+    for (size_t k = 0; k < items.size(); ++k) {
+        const Item &item = items[k];
+        const MInst &inst = *item.inst;
+        if (inst.op == Op::LABEL) {
+            continue;
+        }
+        if (inst.line != 0 && inst.line != line) {
+            line = inst.line;
+            image.lines.push_back({image.text.size(), line});
+        }
+        if (item.isBranch()) {
+            long long end = static_cast<long long>(offsets[k] + item.size());
+            long long rel =
+                static_cast<long long>(labels[inst.src.label]) - end;
+            if (item.isShort) {
+                image.text.push_back(inst.op == Op::JMP
+                                         ? 0xEB
+                                         : uint8_t(0x70 | ccCode(inst.cc)));
+                append(image.text, static_cast<uint64_t>(rel), 1);
+            } else {
+                if (inst.op == Op::JMP) {
+                    image.text.push_back(0xE9);
+                } else {
+                    image.text.push_back(0x0F);
+                    image.text.push_back(0x80 | ccCode(inst.cc));
+                }
+                append(image.text, static_cast<uint64_t>(rel), 4);
+            }
+            continue;
+        }
+
+        size_t at = image.text.size();
+        image.text.insert(image.text.end(), item.code.bytes.begin(),
+                          item.code.bytes.end());
+        if (item.code.fixup < 0) {
+            continue;
+        }
+        uint64_t field = at + item.code.fixup;
+        if (item.code.call) {
+            calls.push_back({field, item.code.symbol});
+        } else {
+            // rip points past the whole instruction, which may have an
+            // immediate after the displacement.
+            long long tail = static_cast<long long>(item.code.bytes.size()) -
+                             item.code.fixup;
+            reference(Section::TEXT, field, item.code.symbol,
+                      item.code.disp - tail, false);
+        }
+    }
+
+    Symbol symbol;
+    symbol.name = function.name;
+    symbol.section = Section::TEXT;
+    symbol.offset = start;
+    symbol.size = image.text.size() - start;
+    symbol.global = true;
+    symbol.function = true;
+    image.symbols.push_back(symbol);
+}
+
+} // namespace
+
+Image encode(const MModule &module) { return ModuleEncoder(module).run(); }
+
+} // namespace x86
@@ -0,0 +1,26 @@
+
+fn square(n: int): int{
+    return n * n;
+}
+
+fn poly(a: int, b: int): int{
+    let s: int = (a + b) * (a + b);
+    let d: int = (a - b) * (a - b);
+    return s + d + square(a + b) - square(b + a);
+}
+
+fn main(): int{
+    let x: int = 7;
+    let y: int = 3;
+    let p: int = x * y + (x + y);
+    let q: int = (x + y) * x * y;
+    if (x * y = 21){
+        println("x * y is {}", x * y);
+        let r: int = y + x;
+        println("r is {}", r);
+    }
+    x = x + 1;
+    let z: int = x * y;
+    println("p {} q {} z {} poly {}", p, q, z, poly(x, y));
+    return 0;
+}
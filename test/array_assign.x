@@ -0,0 +1,50 @@
+fn fill(v: int[], n: int): int{
+    for (let i: int = 0; i < n; i = i + 1){
+        push(v, i);
+    }
+    return len(v);
+}
+
+fn longer(a: int[], b: int[]): int{
+    let v: int[];
+    v = a;
+    if (len(b) > len(a)){
+        v = b;
+    }
+    let total: int = 0;
+    for (let i: int = 0; i < len(v); i = i + 1){
+        total = total + v[i];
+    }
+    return total;
+}
+
+fn main(): int{
+    let a: int[];
+    let b: int[];
+    fill(a, 8);
+    fill(b, 8);
+    b = a;
+    for (let i: int = 0; i < len(a); i = i + 1){
+        a[i] = 8;
+        b[i] = b[i] * a[i];
+    }
+    println("b[7] is {}", b[7]);
+
+    push(b, 5);
+    println("len(a) is {} a[8] is {}", len(a), a[8]);
+
+    let c: int[];
+    fill(c, 20);
+    println("longer is {} then {}", longer(a, c), longer(c, a));
+
+    let d: int[];
+    for (let round: int = 0; round < 3; round = round + 1){
+        d = c;
+        if (round = 1){
+            d = a;
+        }
+        d[0] = d[0] + round;
+    }
+    println("a[0] is {} c[0] is {}", a[0], c[0]);
+    return b[0] + c[0];
+}
@@ -0,0 +1,34 @@
+
+fn sum(v: int[]): int{
+    let total: int = 0;
+    for (let i: int = 0; i < len(v); i = i + 1){
+        total = total + v[i];
+    }
+    return total;
+}
+
+fn main(): int{
+    let squares: int[8];
+    for (let i: int = 0; i < 8; i = i + 1){
+        squares[i] = i * i;
+    }
+    println("last square is {}", squares[len(squares) - 1]);
+
+    let v: int[];
+    for (let i: int = 0; i < 100; i = i + 1){
+        push(v, i);
+    }
+    let diffs: int = 0;
+    for (let i: int = 1; i < len(v); i = i + 1){
+        diffs = diffs + v[i] - v[i - 1];
+    }
+    println("sum is {} len is {} diffs {}", sum(v), len(v), diffs);
+
+    let back: int = 0;
+    for (let i: int = len(v) - 1; i >= 0; i = i - 1){
+        back = back + v[i] * i;
+    }
+    let k: int = 3;
+    println("back is {} v[k] is {}", back, v[k]);
+    return squares[2] + v[7];
+}
@@ -0,0 +1,29 @@
+#!/bin/sh
+# Compiles each program in test/errors, which are broken or cut short the
+# way a file is while it is being edited, and checks that the compiler
+# reports the error named on its `# expect:` line and exits with status 1,
+# rather than crashing or hanging.
+# usage: test/errors.sh [compiler flags...]
+root=$(cd "$(dirname "$0")/.." && pwd)
+compiler=$root/bin/LanguageC
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+failed=0
+for program in "$root"/test/errors/*.x; do
+    name=$(basename "$program")
+    expected=$(sed -n 's/^# expect: //p' "$program")
+    timeout 10 "$compiler" "$@" -o "$work/out.c" "$program" \
+        > "$work/log" 2>&1
+    status=$?
+    if [ "$status" -ne 1 ]; then
+        echo "$name: exit status $status, not 1"
+        failed=1
+    elif ! grep -qF "$expected" "$work/log"; then
+        echo "$name: no error \"$expected\""
+        cat "$work/log"
+        failed=1
+    fi
+done
+[ "$failed" -eq 0 ] && echo "every error reported"
+exit "$failed"
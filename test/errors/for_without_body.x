@@ -0,0 +1,3 @@
+# expect: Expected LBRACE but got RBRACE
+fn main(): int {
+    for (let i: int = 0; i < 3; i = i + 1) }
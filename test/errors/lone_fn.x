@@ -0,0 +1,2 @@
+# expect: Expected IDENTIFIER but got End of File
+fn
\ No newline at end of file
@@ -0,0 +1,2 @@
+# expect: Unexpected token: IDENTIFIER
+main
@@ -0,0 +1,8 @@
+# expect: Expected RPAREN but got RBRACE
+fn add(a: int, b: int): int {
+    return a + b;
+}
+
+fn main(): int {
+    return add(1, 2
+}
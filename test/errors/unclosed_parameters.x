@@ -0,0 +1,2 @@
+# expect: Expected RPAREN but got End of File
+fn main(
\ No newline at end of file
@@ -0,0 +1,3 @@
+# expect: unterminated string
+fn main(): int {
+    println("unterminated);
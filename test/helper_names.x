@@ -0,0 +1,45 @@
+fn g(x: int): int{
+    println("g {}", x);
+    return x * 2;
+}
+
+fn numbered(a: int, b: int): int{
+    let _vn0: int = 100;
+    let p: int = (a + b) * (a + b) + _vn0;
+    return p;
+}
+
+fn hoisted(a: int, b: int): int{
+    let _licm0: int = 9;
+    let s: int = 0;
+    for (let i: int = 0; i < 3; i = i + 1){
+        s = s + a * b + _licm0;
+    }
+    return s;
+}
+
+fn sum(v: int[]): int{
+    let _v_array: int = 3;
+    let _v_data: int = 4;
+    let total: int = 0;
+    for (let i: int = 0; i < len(v); i = i + 1){
+        total = total + v[i] * _v_array + _v_data;
+    }
+    return total;
+}
+
+fn main(): int{
+    let _print0: int = 7;
+    println("{} {}", g(1), g(_print0));
+    let _arg0: int = 7;
+    let q: int = g(2) + g(_arg0);
+    println("q is {}", q);
+    println("numbered {} hoisted {}", numbered(3, 4), hoisted(4, 2));
+    let _w_array: int = 5;
+    let w: int[];
+    for (let i: int = 0; i < _w_array; i = i + 1){
+        push(w, i);
+    }
+    println("sum {}", sum(w));
+    return q;
+}
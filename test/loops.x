@@ -0,0 +1,36 @@
+
+fn scale(k: int): int{
+    return k * 3 + 1;
+}
+
+fn main(): int{
+    let n: int = 10;
+    let sum: int = 0;
+    for (let i: int = 0; i < 10; i = i + 1){
+        sum = sum + i * scale(n);
+    }
+    println("sum is {}", sum);
+
+    let count: int = 0;
+    let j: int = 0;
+    while (j < n * 2){
+        count = count + n * n;
+        j = j + 1;
+    }
+    println("count is {}", count);
+
+    let down: int = 0;
+    for (let k: int = 9; k >= 0; k = k - 2){
+        down = down + k;
+    }
+    println("down is {}", down);
+
+    let total: int = 0;
+    for (let a: int = 0; a < n; a = a + 1){
+        for (let b: int = 0; b <= 2; b = b + 1){
+            total = total + a * b + scale(n);
+        }
+    }
+    println("total is {}", total);
+    return 0;
+}
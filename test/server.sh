@@ -0,0 +1,35 @@
+#!/bin/sh
+# Checks that a --server outlives a client sending a file cut short, as a
+# watch loop does when it rebuilds a half-saved file: each program in
+# test/errors must get its error back, and the server must then still
+# compile a correct program.
+# usage: test/server.sh
+root=$(cd "$(dirname "$0")/.." && pwd)
+compiler=$root/bin/LanguageC
+work=$(mktemp -d)
+trap 'kill $server 2> /dev/null; rm -rf "$work"' EXIT
+cd "$work"
+
+"$compiler" --server="$work/socket" 2> /dev/null &
+server=$!
+while [ ! -S socket ]; do sleep 0.01; done
+
+failed=0
+for program in "$root"/test/errors/*.x; do
+    timeout 10 "$compiler" --connect=socket -o out.c "$program" \
+        > log 2>&1
+    status=$?
+    if [ "$status" -ne 1 ]; then
+        echo "$(basename "$program"): exit status $status, not 1"
+        cat log
+        failed=1
+    fi
+done
+
+kill -0 $server 2> /dev/null ||
+    { echo "the server exited"; exit 1; }
+timeout 10 "$compiler" --connect=socket -o out.c "$root/test/arith.x" ||
+    { echo "the server did not compile test/arith.x"; exit 1; }
+[ -s out.c ] || { echo "no output for test/arith.x"; exit 1; }
+[ "$failed" -eq 0 ] && echo "server survived every error"
+exit "$failed"